@@ -21,6 +21,7 @@
 
 #include "keeper-errors.h"
 
+#include <QDBusConnection>
 #include <QObject>
 #include <QScopedPointer>
 #include <QStringList>
@@ -39,7 +40,7 @@ public:
     explicit KeeperClient(QObject* parent = nullptr);
     ~KeeperClient();
 
-    Q_PROPERTY(QStringList backupUuids READ backupUuids CONSTANT)
+    Q_PROPERTY(QStringList backupUuids READ backupUuids NOTIFY backupUuidsChanged)
     QStringList backupUuids();
 
     Q_PROPERTY(QString status READ status NOTIFY statusChanged)
@@ -63,28 +64,64 @@ public:
 
     Q_INVOKABLE void cancel();
 
+    // resumes the backup or restore interrupted by the last service shutdown.
+    // It returns immediately, resumeReady tells whether there was anything to resume
+    Q_INVOKABLE void resume();
+
 // C++
 public:
+    // talks to the service on the given bus instead of the session bus
+    explicit KeeperClient(QDBusConnection const & connection, QObject* parent = nullptr);
+
     keeper::Items getBackupChoices(keeper::Error & error) const;
     keeper::Items getRestoreChoices(QString const & storage, keeper::Error & error) const;
+    // the files of a backup from getRestoreChoices() whose path matches pattern
+    keeper::Items getBackupContents(QString const & uuid, QString const & storage, QString const & pattern, keeper::Error & error) const;
     void startBackup(QStringList const& uuids, QString const & storage) const;
     void startRestore(QStringList const& uuids, QString const & storage) const;
 
     keeper::Items getState() const;
     QStringList getStorageAccounts() const;
 
+    // non-blocking versions of the calls above.
+    // They return immediately and the result is delivered by the matching *Ready signal
+    void getBackupChoicesAsync();
+    void getRestoreChoicesAsync(QString const & storage);
+    void getBackupContentsAsync(QString const & uuid, QString const & storage, QString const & pattern);
+    void getStorageAccountsAsync();
+
+    // the local copies of the backup choices and of the task states kept by the client
+    keeper::Items backupChoices() const;
+    keeper::Items taskStates() const;
+
 Q_SIGNALS:
     void statusChanged();
     void progressChanged();
     void readyToBackupChanged();
     void backupBusyChanged();
+    void backupUuidsChanged();
+
+    void backupChoicesReady(keeper::Items const & choices, keeper::Error error);
+    void restoreChoicesReady(QString const & storage, keeper::Items const & choices, keeper::Error error);
+    void backupContentsReady(QString const & uuid, keeper::Items const & files, keeper::Error error);
+    void storageAccountsReady(QStringList const & accounts);
+    void resumeReady(bool resumed);
+
+    void backupEnabledChanged(QString const & uuid, bool enabled);
+    // the task properties that changed, as sent by the service.
+    // Tasks mapped to an empty item were removed
+    void taskStatesChanged(keeper::Items const & changed);
 
     void taskStatusChanged(QString const & displayName, QString const & status, double percentage, keeper::Error error);
     void finished();
 
 private Q_SLOTS:
+    void updateBackups();
+    void stateChanged(quint64 version, keeper::Items const & changed);
     void stateUpdated();
 
 private:
+    void syncState();
+
     QScopedPointer<KeeperClientPrivate> const d;
 };
@@ -22,6 +22,7 @@
 #include "client/keeper-errors.h"
 
 #include <QJsonObject>
+#include <QStringList>
 
 typedef QMap<QString, QVariantMap> QVariantDictMap;
 
@@ -45,11 +46,18 @@ public:
     static QString const VERSION_KEY;
     static QString const FILE_NAME_KEY;
     static QString const DIR_NAME_KEY;
+    static QString const PART_FILE_NAMES_KEY;
+    static QString const CATALOG_FILE_NAME_KEY;
     static QString const DISPLAY_NAME_KEY;
     static QString const STATUS_KEY;
     static QString const ERROR_KEY;
     static QString const PERCENT_DONE_KEY;
     static QString const SPEED_KEY;
+    static QString const SIZE_ESTIMATE_KEY;
+    static QString const FILE_COUNT_KEY;
+
+    // in state deltas, the properties of a task that are no longer set
+    static QString const REMOVED_PROPERTIES_KEY;
 
     // values
     static QString const FOLDER_VALUE;
@@ -76,6 +84,19 @@ public:
     keeper::Error get_error(bool *valid = nullptr) const;
     QString get_file_name(bool *valid = nullptr) const;
 
+    // the remote files of a backup stored in parts, in order.
+    // Manifests only keep string values, so they are stored as a JSON array
+    QStringList get_part_file_names(bool *valid = nullptr) const;
+    void set_part_file_names(QStringList const & file_names);
+
+    // the remote file holding the catalog of the files in the backup
+    QString get_catalog_file_name(bool *valid = nullptr) const;
+
+    // estimated size in bytes and number of files of a folder backup choice.
+    // They are only set once the folder has been walked
+    qint64 get_size_estimate(bool *valid = nullptr) const;
+    qint64 get_file_count(bool *valid = nullptr) const;
+
     // d-bus
     static void registerMetaType();
 };
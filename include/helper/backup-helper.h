@@ -27,6 +27,7 @@
 #include <QObject>
 #include <QScopedPointer>
 #include <QString>
+#include <QStringList>
 
 #include <memory>
 
@@ -48,12 +49,16 @@ public:
     static constexpr int MAX_INACTIVITY_TIME = 15000;
 
     void set_uploader(std::shared_ptr<Uploader> const& uploader);
+    // the helper asked for its uploader and waits until keeper gives it,
+    // so it is not inactive meanwhile
+    void hold();
     void start(QStringList const& urls) override;
     void stop() override;
     int get_helper_socket() const;
     QString to_string(Helper::State state) const override;
     void set_state(State) override;
     QString get_uploader_committed_file_name() const;
+    QStringList get_uploader_committed_part_file_names() const;
 protected:
     void on_helper_finished() override;
 
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+/**
+ * The list of files stored in a backup archive.
+ *
+ * It is stored next to the archive as a small compressed sidecar file,
+ * so the contents of a backup can be listed and searched without
+ * downloading the archive.
+ */
+class FileCatalog
+{
+public:
+
+    struct Entry
+    {
+        QString path;
+        qint64 size {0};
+        // seconds since the epoch
+        qint64 mtime {0};
+        // sha256 of the file contents
+        QByteArray hash;
+        // position of the file header in the archive,
+        // or -1 if the archive can't be seeked (e.g. it is compressed)
+        qint64 offset {-1};
+    };
+
+    FileCatalog();
+    ~FileCatalog();
+
+    void add(Entry const & entry);
+    QVector<Entry> entries() const;
+    bool is_empty() const;
+
+    // returns the entries whose path contains pattern, ignoring case.
+    // Patterns with '*' or '?' are matched as wildcards against the
+    // whole path or the file name. An empty pattern matches every entry.
+    QVector<Entry> find(QString const & pattern) const;
+
+    // compressed binary representation
+    QByteArray to_data() const;
+    static FileCatalog from_data(QByteArray const & data, bool * ok = nullptr);
+
+private:
+    QVector<Entry> entries_;
+};
@@ -36,4 +36,12 @@ public:
     Metadata(QString const& uuid, QString const& display_name);
 
     QJsonObject json() const;
+
+    // the D-Bus path the helper of a task uses to talk to the service.
+    // It is only used for helper url substitution and never stored.
+    static QString const HELPER_BUS_PATH_KEY;
+
+    // the trace the helper adds its spans to, or an empty string.
+    // Like the bus path, it is only used for helper url substitution
+    static QString const TRACE_ID_KEY;
 };
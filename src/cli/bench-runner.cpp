@@ -0,0 +1,466 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Xavi Garcia <xavi.garcia.mena@canonical.com>
+ */
+
+#include "bench-runner.h"
+
+#include <client/client.h>
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+namespace
+{
+    constexpr const char STATUS_QUEUED[]    = "queued";
+    constexpr const char STATUS_FINISHING[] = "finishing";
+    constexpr const char STATUS_COMPLETE[]  = "complete";
+
+    constexpr const char GENERATED_DIR_PREFIX[] = "keeper-bench-";
+    constexpr qint64 GENERATE_CHUNK_SIZE {64 * 1024};
+    // the same dataset on every run, so runs can be compared
+    constexpr unsigned DATASET_SEED {20160901};
+
+    bool is_final(QString const & status)
+    {
+        return status == QLatin1String("complete")
+            || status == QLatin1String("cancelled")
+            || status == QLatin1String("failed");
+    }
+
+    qint64 span(qint64 from, qint64 to)
+    {
+        return from < 0 || to < 0 ? -1 : to - from;
+    }
+
+    // the average of the spans that were measured, or -1 if none was
+    template<typename Tasks>
+    qint64 mean_span(Tasks const & tasks, std::function<qint64(typename Tasks::mapped_type const &)> const & get_span)
+    {
+        qint64 total {0};
+        int n {0};
+        for (auto const & task : tasks)
+        {
+            auto const value = get_span(task);
+            if (value >= 0)
+            {
+                total += value;
+                ++n;
+            }
+        }
+        return n ? total / n : -1;
+    }
+
+    // from the earliest start to the latest end of the tasks that measured both, or -1 if none did;
+    // the tasks run concurrently, so this is the wall time the dataset actually took to move
+    template<typename Tasks>
+    qint64 wall_span(Tasks const & tasks,
+                     std::function<qint64(typename Tasks::mapped_type const &)> const & get_from,
+                     std::function<qint64(typename Tasks::mapped_type const &)> const & get_to)
+    {
+        qint64 from {-1};
+        qint64 to {-1};
+        for (auto const & task : tasks)
+        {
+            auto const task_from = get_from(task);
+            auto const task_to = get_to(task);
+            if (span(task_from, task_to) < 0)
+                continue;
+            from = from < 0 ? task_from : qMin(from, task_from);
+            to = qMax(to, task_to);
+        }
+        return span(from, to);
+    }
+
+    double per_second(double amount, qint64 msec)
+    {
+        return msec > 0 ? amount * 1000.0 / msec : 0.0;
+    }
+
+    std::string format_msec(qint64 msec)
+    {
+        return msec < 0 ? std::string("-") : std::to_string(msec) + " ms";
+    }
+}
+
+BenchRunner::BenchRunner(KeeperClient * client, QObject * parent)
+    : QObject(parent)
+    , client_(client)
+{
+}
+
+BenchRunner::~BenchRunner() = default;
+
+void BenchRunner::run(Options const & options)
+{
+    options_ = options;
+    clock_.start();
+
+    connect(client_, &KeeperClient::backupChoicesReady, this, &BenchRunner::on_backup_choices);
+    connect(client_, &KeeperClient::restoreChoicesReady, this, [this](QString const &, keeper::Items const & choices, keeper::Error error){
+        on_restore_choices(choices, error);
+    });
+    connect(client_, &KeeperClient::taskStatesChanged, this, &BenchRunner::on_task_states_changed);
+
+    client_->getBackupChoicesAsync();
+}
+
+void BenchRunner::on_backup_choices(keeper::Items const & choices, keeper::Error error)
+{
+    if (error != keeper::Error::OK)
+    {
+        fail(QStringLiteral("Error obtaining the backup choices: %1").arg(int(error)));
+        return;
+    }
+
+    QStringList uuids;
+    section_paths_.clear();
+    for (auto const & section : options_.sections)
+    {
+        QString uuid;
+        for (auto iter = choices.begin(); iter != choices.end() && uuid.isEmpty(); ++iter)
+        {
+            if (iter->get_type() == keeper::Item::FOLDER_VALUE && iter->get_display_name() == section)
+            {
+                uuid = iter.key();
+                section_paths_ << iter->get_property_value(keeper::Item::SUBTYPE_KEY).toString();
+            }
+        }
+        if (uuid.isEmpty())
+        {
+            fail(QStringLiteral("The following section was not found: %1").arg(section));
+            return;
+        }
+        uuids << uuid;
+    }
+
+    if (options_.generate_bytes > 0 && !generate_dataset(section_paths_.first()))
+    {
+        fail(QStringLiteral("Error generating the dataset in %1").arg(section_paths_.first()));
+        return;
+    }
+    measure_dataset();
+
+    start_phase(Phase::BACKUP, uuids);
+}
+
+void BenchRunner::on_restore_choices(keeper::Items const & choices, keeper::Error error)
+{
+    if (error != keeper::Error::OK)
+    {
+        fail(QStringLiteral("Error obtaining the restore choices: %1").arg(int(error)));
+        return;
+    }
+
+    // restore the newest backup of every section, which is the one just made
+    QStringList uuids;
+    for (auto const & section : options_.sections)
+    {
+        QString uuid;
+        QString newest_dir_name;
+        for (auto iter = choices.begin(); iter != choices.end(); ++iter)
+        {
+            if (iter->get_type() == keeper::Item::FOLDER_VALUE
+                && iter->get_display_name() == section
+                && iter->get_dir_name() > newest_dir_name)
+            {
+                uuid = iter.key();
+                newest_dir_name = iter->get_dir_name();
+            }
+        }
+        if (uuid.isEmpty())
+        {
+            fail(QStringLiteral("No backup of %1 was found in the storage").arg(section));
+            return;
+        }
+        uuids << uuid;
+    }
+
+    start_phase(Phase::RESTORE, uuids);
+}
+
+void BenchRunner::start_phase(Phase phase, QStringList const & uuids)
+{
+    phase_ = phase;
+    auto & result = results_[int(phase)];
+    result.start = clock_.elapsed();
+    for (auto const & uuid : uuids)
+    {
+        result.tasks[uuid] = TaskTimes();
+    }
+
+    std::cout << (phase == Phase::BACKUP ? "Backing up " : "Restoring ")
+              << options_.sections.join(QStringLiteral(", ")).toStdString() << "..." << std::endl;
+
+    if (phase == Phase::BACKUP)
+        client_->startBackup(uuids, options_.storage);
+    else
+        client_->startRestore(uuids, options_.storage);
+}
+
+void BenchRunner::on_task_states_changed(keeper::Items const & changed)
+{
+    auto & result = results_[int(phase_)];
+    if (result.tasks.isEmpty() || result.end > 0)
+        return;
+
+    auto const now = clock_.elapsed();
+    auto const states = client_->taskStates();
+    for (auto iter = changed.begin(); iter != changed.end(); ++iter)
+    {
+        auto task = result.tasks.find(iter.key());
+        auto const state = states.value(iter.key());
+        if (task == result.tasks.end() || state.isEmpty())
+            continue;
+
+        auto const status = state.get_status();
+        task->display_name = state.get_display_name();
+        task->status = status;
+
+        // several tasks may run at once, so the launch is measured from
+        // the states of the task itself: the last time it was seen queued
+        // until it was first seen with its helper started
+        if (status == QLatin1String(STATUS_QUEUED))
+        {
+            task->ready = now;
+        }
+        else if (task->launched < 0)
+        {
+            if (task->ready < 0)
+                task->ready = result.start;
+            task->launched = now;
+        }
+        if (task->first_byte < 0 && state.get_percent_done() > 0)
+        {
+            task->first_byte = now;
+        }
+        if (task->data_complete < 0 && status == QLatin1String(STATUS_FINISHING))
+        {
+            task->data_complete = now;
+        }
+        if (task->done < 0 && is_final(status))
+        {
+            task->done = now;
+        }
+    }
+
+    for (auto const & task : result.tasks)
+    {
+        if (task.done < 0)
+            return;
+    }
+    result.end = now;
+
+    bool all_complete = true;
+    for (auto const & task : result.tasks)
+    {
+        all_complete = all_complete && task.status == QLatin1String(STATUS_COMPLETE);
+    }
+
+    if (phase_ == Phase::BACKUP && all_complete)
+        client_->getRestoreChoicesAsync(options_.storage);
+    else
+        finish();
+}
+
+void BenchRunner::finish()
+{
+    if (!generated_dir_.isEmpty())
+    {
+        QDir(generated_dir_).removeRecursively();
+    }
+
+    QJsonObject dataset;
+    dataset[QStringLiteral("bytes")] = double(dataset_bytes_);
+    dataset[QStringLiteral("files")] = double(dataset_files_);
+    dataset[QStringLiteral("generated")] = options_.generate_bytes > 0;
+
+    QJsonObject report;
+    report[QStringLiteral("storage")] = options_.storage;
+    report[QStringLiteral("sections")] = QJsonArray::fromStringList(options_.sections);
+    report[QStringLiteral("dataset")] = dataset;
+
+    std::cout << std::endl << "Dataset: " << dataset_bytes_ << " bytes in " << dataset_files_ << " files" << std::endl;
+
+    bool succeeded = true;
+    QString const names[] = {QStringLiteral("backup"), QStringLiteral("restore")};
+    for (int i = 0; i < 2; ++i)
+    {
+        auto const & result = results_[i];
+        if (result.tasks.isEmpty())
+        {
+            succeeded = false;
+            continue;
+        }
+        auto const json = phase_to_json(result);
+        succeeded = succeeded && json[QStringLiteral("succeeded")].toBool();
+        report[names[i]] = json;
+        print_phase(names[i], result);
+    }
+
+    if (!options_.json_path.isEmpty())
+    {
+        auto const data = QJsonDocument(report).toJson();
+        if (options_.json_path == QLatin1String("-"))
+        {
+            std::cout << data.constData() << std::flush;
+        }
+        else
+        {
+            QFile file(options_.json_path);
+            if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(data) != data.size())
+            {
+                std::cerr << "Error writing the report to " << options_.json_path.toStdString() << std::endl;
+                succeeded = false;
+            }
+        }
+    }
+
+    QCoreApplication::exit(succeeded ? 0 : 1);
+}
+
+void BenchRunner::fail(QString const & message)
+{
+    std::cerr << message.toStdString() << std::endl;
+    if (!generated_dir_.isEmpty())
+    {
+        QDir(generated_dir_).removeRecursively();
+    }
+    QCoreApplication::exit(1);
+}
+
+bool BenchRunner::generate_dataset(QString const & parent_dir)
+{
+    generated_dir_ = QDir(parent_dir).filePath(QStringLiteral("%1%2").arg(GENERATED_DIR_PREFIX).arg(QDateTime::currentMSecsSinceEpoch()));
+    if (!QDir().mkpath(generated_dir_))
+        return false;
+
+    // random contents, so compression doesn't make the numbers look better than they are
+    std::mt19937 generator(DATASET_SEED);
+    auto const n_files = qMax(options_.n_files, 1);
+    auto const file_size = options_.generate_bytes / n_files;
+    QByteArray chunk(int(GENERATE_CHUNK_SIZE), Qt::Uninitialized);
+    for (int i = 0; i < n_files; ++i)
+    {
+        QFile file(QDir(generated_dir_).filePath(QStringLiteral("file-%1").arg(i)));
+        if (!file.open(QIODevice::WriteOnly))
+            return false;
+
+        for (qint64 written = 0; written < file_size; )
+        {
+            auto const n = qMin(GENERATE_CHUNK_SIZE, file_size - written);
+            for (int j = 0; j < n; ++j)
+                chunk[j] = char(generator());
+            if (file.write(chunk.constData(), n) != n)
+                return false;
+            written += n;
+        }
+    }
+    return true;
+}
+
+void BenchRunner::measure_dataset()
+{
+    dataset_bytes_ = dataset_files_ = 0;
+    for (auto const & path : section_paths_)
+    {
+        QDirIterator it(path, QDir::Files | QDir::Hidden | QDir::NoSymLinks, QDirIterator::Subdirectories);
+        while (it.hasNext())
+        {
+            it.next();
+            dataset_bytes_ += it.fileInfo().size();
+            ++dataset_files_;
+        }
+    }
+}
+
+QJsonObject BenchRunner::phase_to_json(PhaseResult const & result) const
+{
+    using Tasks = QMap<QString, TaskTimes>;
+    auto const duration = result.end - result.start;
+    auto const transfer = wall_span<Tasks>(result.tasks, [](TaskTimes const & t){ return t.first_byte; },
+                                                         [](TaskTimes const & t){ return t.data_complete; });
+
+    QJsonObject ret;
+    ret[QStringLiteral("duration_ms")] = double(duration);
+    ret[QStringLiteral("mb_per_sec")] = per_second(dataset_bytes_ / 1e6, duration);
+    ret[QStringLiteral("files_per_sec")] = per_second(dataset_files_, duration);
+    ret[QStringLiteral("transfer_mb_per_sec")] = per_second(dataset_bytes_ / 1e6, transfer);
+    ret[QStringLiteral("helper_launch_ms")] = double(mean_span<Tasks>(result.tasks, [](TaskTimes const & t){ return span(t.ready, t.launched); }));
+    ret[QStringLiteral("time_to_first_byte_ms")] = double(mean_span<Tasks>(result.tasks, [](TaskTimes const & t){ return span(t.launched, t.first_byte); }));
+    ret[QStringLiteral("commit_ms")] = double(mean_span<Tasks>(result.tasks, [](TaskTimes const & t){ return span(t.data_complete, t.done); }));
+
+    bool succeeded = true;
+    QJsonArray tasks;
+    for (auto const & t : result.tasks)
+    {
+        succeeded = succeeded && t.status == QLatin1String(STATUS_COMPLETE);
+
+        QJsonObject task;
+        task[QStringLiteral("section")] = t.display_name;
+        task[QStringLiteral("status")] = t.status;
+        task[QStringLiteral("queued_ms")] = double(span(result.start, t.ready));
+        task[QStringLiteral("launch_ms")] = double(span(t.ready, t.launched));
+        task[QStringLiteral("first_byte_ms")] = double(span(t.launched, t.first_byte));
+        task[QStringLiteral("transfer_ms")] = double(span(t.first_byte, t.data_complete));
+        task[QStringLiteral("commit_ms")] = double(span(t.data_complete, t.done));
+        task[QStringLiteral("total_ms")] = double(span(result.start, t.done));
+        tasks.append(task);
+    }
+    ret[QStringLiteral("succeeded")] = succeeded;
+    ret[QStringLiteral("tasks")] = tasks;
+    return ret;
+}
+
+void BenchRunner::print_phase(QString const & title, PhaseResult const & result) const
+{
+    auto const json = phase_to_json(result);
+    auto const value = [&json](char const * key){ return qint64(json[QString::fromLatin1(key)].toDouble()); };
+
+    std::cout << std::endl << title.toUpper().toStdString() << std::endl
+              << std::fixed << std::setprecision(2)
+              << "  duration       " << format_msec(value("duration_ms")) << std::endl
+              << "  throughput     " << json[QStringLiteral("mb_per_sec")].toDouble() << " MB/s, "
+                                     << json[QStringLiteral("files_per_sec")].toDouble() << " files/s" << std::endl
+              << "  transfer       " << json[QStringLiteral("transfer_mb_per_sec")].toDouble() << " MB/s" << std::endl
+              << "  helper launch  " << format_msec(value("helper_launch_ms")) << std::endl
+              << "  first byte     " << format_msec(value("time_to_first_byte_ms")) << std::endl
+              << "  commit         " << format_msec(value("commit_ms")) << std::endl << std::endl;
+
+    std::cout << "  " << std::left << std::setw(20) << "section" << std::setw(12) << "status" << std::right
+              << std::setw(12) << "queued" << std::setw(12) << "launch" << std::setw(12) << "first byte"
+              << std::setw(12) << "transfer" << std::setw(12) << "commit" << std::setw(12) << "total" << std::endl;
+    for (auto const & task : json[QStringLiteral("tasks")].toArray())
+    {
+        auto const t = task.toObject();
+        auto const ms = [&t](char const * key){ return format_msec(qint64(t[QString::fromLatin1(key)].toDouble())); };
+        std::cout << "  " << std::left << std::setw(20) << t[QStringLiteral("section")].toString().toStdString()
+                  << std::setw(12) << t[QStringLiteral("status")].toString().toStdString() << std::right
+                  << std::setw(12) << ms("queued_ms") << std::setw(12) << ms("launch_ms") << std::setw(12) << ms("first_byte_ms")
+                  << std::setw(12) << ms("transfer_ms") << std::setw(12) << ms("commit_ms") << std::setw(12) << ms("total_ms") << std::endl;
+    }
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Xavi Garcia <xavi.garcia.mena@canonical.com>
+ */
+
+#pragma once
+
+#include <client/keeper-items.h>
+
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QMap>
+#include <QObject>
+#include <QStringList>
+#include <QVector>
+
+class KeeperClient;
+
+/**
+ * Runs a backup and then a restore of some sections and measures them.
+ *
+ * The timings come from the task states sent by the service:
+ *   launch:   from the last state of the task that was "queued" until
+ *             the first one that wasn't, i.e. until its helper reported.
+ *             Tasks stay queued until they get a slot, so with more
+ *             sections than slots it includes the wait for one
+ *   transfer: from the first byte until the helper has sent all the data
+ *   commit:   from there until the task is complete
+ */
+class BenchRunner : public QObject
+{
+    Q_OBJECT
+public:
+    struct Options
+    {
+        QStringList sections;
+        QString storage;
+        // bytes and files of the dataset written into the first section.
+        // Nothing is generated if generate_bytes is 0
+        qint64 generate_bytes {0};
+        int n_files {100};
+        // the report is also written here as JSON. '-' is stdout
+        QString json_path;
+    };
+
+    explicit BenchRunner(KeeperClient * client, QObject * parent = nullptr);
+    ~BenchRunner();
+    Q_DISABLE_COPY(BenchRunner)
+
+    // runs asynchronously, exits the application once the report is printed
+    void run(Options const & options);
+
+private:
+    enum class Phase {BACKUP, RESTORE};
+
+    struct TaskTimes
+    {
+        QString display_name;
+        QString status;
+        qint64 ready {-1};
+        qint64 launched {-1};
+        qint64 first_byte {-1};
+        qint64 data_complete {-1};
+        qint64 done {-1};
+    };
+
+    struct PhaseResult
+    {
+        qint64 start {0};
+        qint64 end {0};
+        QMap<QString, TaskTimes> tasks;
+    };
+
+    void on_backup_choices(keeper::Items const & choices, keeper::Error error);
+    void on_restore_choices(keeper::Items const & choices, keeper::Error error);
+    void on_task_states_changed(keeper::Items const & changed);
+    void start_phase(Phase phase, QStringList const & uuids);
+    void finish();
+    void fail(QString const & message);
+
+    bool generate_dataset(QString const & parent_dir);
+    void measure_dataset();
+
+    QJsonObject phase_to_json(PhaseResult const & result) const;
+    void print_phase(QString const & title, PhaseResult const & result) const;
+
+    KeeperClient * client_;
+    Options options_;
+    QElapsedTimer clock_;
+    Phase phase_ {Phase::BACKUP};
+    PhaseResult results_[2];
+    QStringList section_paths_;
+    QString generated_dir_;
+    qint64 dataset_bytes_ {0};
+    qint64 dataset_files_ {0};
+};
@@ -18,10 +18,12 @@
  */
 #include "command-line-client.h"
 #include "command-line-client-view.h"
+#include "bench-runner.h"
 
 #include <client/client.h>
 
 #include <QCoreApplication>
+#include <QDateTime>
 #include <QDebug>
 
 #include <iostream>
@@ -42,33 +44,105 @@ CommandLineClient::~CommandLineClient() = default;
 
 void CommandLineClient::run_list_sections(bool remote, QString const & storage)
 {
-    keeper::Items choices_values;
-    keeper::Error error;
+    // the choices arrive asynchronously, the application exits once they are listed
     if(!remote)
     {
-        choices_values = keeper_client_->getBackupChoices(error);
-        check_for_choices_error(error);
-        list_backup_sections(choices_values);
+        connect(keeper_client_.data(), &KeeperClient::backupChoicesReady, this, [this](keeper::Items const & choices_values, keeper::Error error){
+            check_for_choices_error(error);
+            list_backup_sections(choices_values);
+            QCoreApplication::exit(0);
+        });
+        keeper_client_->getBackupChoicesAsync();
     }
     else
     {
-        choices_values = keeper_client_->getRestoreChoices(storage, error);
-        check_for_choices_error(error);
-        list_restore_sections(choices_values);
+        connect(keeper_client_.data(), &KeeperClient::restoreChoicesReady, this, [this](QString const &, keeper::Items const & choices_values, keeper::Error error){
+            check_for_choices_error(error);
+            list_restore_sections(choices_values);
+            QCoreApplication::exit(0);
+        });
+        keeper_client_->getRestoreChoicesAsync(storage);
     }
 }
 
 void CommandLineClient::run_list_storage_accounts()
 {
-    list_storage_accounts(keeper_client_->getStorageAccounts());
+    connect(keeper_client_.data(), &KeeperClient::storageAccountsReady, this, [this](QStringList const & accounts){
+        list_storage_accounts(accounts);
+        QCoreApplication::exit(0);
+    });
+    keeper_client_->getStorageAccountsAsync();
 }
 
 void CommandLineClient::run_backup(QStringList & sections, QString const & storage)
+{
+    connect(keeper_client_.data(), &KeeperClient::backupChoicesReady, this, [this, sections, storage](keeper::Items const & choices_values, keeper::Error error){
+        check_for_choices_error(error);
+        start_backup(choices_values, sections, storage);
+    });
+    keeper_client_->getBackupChoicesAsync();
+}
+
+void CommandLineClient::run_restore(QStringList & sections, QString const & storage)
+{
+    connect(keeper_client_.data(), &KeeperClient::restoreChoicesReady, this, [this, sections, storage](QString const &, keeper::Items const & choices_values, keeper::Error error){
+        check_for_choices_error(error);
+        start_restore(choices_values, sections, storage);
+    });
+    keeper_client_->getRestoreChoicesAsync(storage);
+}
+
+void CommandLineClient::run_list_contents(QStringList const & sections, QString const & storage, QString const & pattern)
+{
+    // the contents of the sections are requested one after the other, so they are listed in order
+    connect(keeper_client_.data(), &KeeperClient::backupContentsReady, this, [this, storage, pattern](QString const &, keeper::Items const & files, keeper::Error error){
+        auto const section = contents_sections_.takeFirst();
+        contents_uuids_.removeFirst();
+        if (error != keeper::Error::OK)
+        {
+            view_->print_error_message(QStringLiteral("Error listing the contents of %1: %2\n").arg(section).arg(view_->get_error_string(error)));
+            exit(1);
+        }
+        list_contents(files);
+
+        if (contents_uuids_.isEmpty())
+            QCoreApplication::exit(0);
+        else
+            keeper_client_->getBackupContentsAsync(contents_uuids_.first(), storage, pattern);
+    });
+
+    connect(keeper_client_.data(), &KeeperClient::restoreChoicesReady, this, [this, sections, storage, pattern](QString const &, keeper::Items const & choices_values, keeper::Error error){
+        check_for_choices_error(error);
+
+        for (auto const & section : sections)
+        {
+            QString uuid;
+            for (auto iter = choices_values.begin(); iter != choices_values.end() && uuid.isEmpty(); ++iter)
+            {
+                auto const & values = (*iter);
+                if (values.is_valid() && QStringLiteral("%1:%2").arg(values.get_display_name()).arg(values.get_dir_name()) == section)
+                    uuid = iter.key();
+            }
+            if (uuid.isEmpty())
+            {
+                view_->print_error_message(QStringLiteral("The following section was not found: %1\n").arg(section));
+                exit(1);
+            }
+            contents_sections_ << section;
+            contents_uuids_ << uuid;
+        }
+
+        if (contents_uuids_.isEmpty())
+            QCoreApplication::exit(0);
+        else
+            keeper_client_->getBackupContentsAsync(contents_uuids_.first(), storage, pattern);
+    });
+    keeper_client_->getRestoreChoicesAsync(storage);
+}
+
+void CommandLineClient::start_backup(keeper::Items const & choices_values, QStringList const & sections, QString const & storage)
 {
     auto unhandled_sections = sections;
-    keeper::Error error;
-    auto choices_values = keeper_client_->getBackupChoices(error);
-    check_for_choices_error(error);
     QStringList uuids;
 
     auto uuids_choices = choices_values.get_uuids();
@@ -110,13 +184,9 @@ void CommandLineClient::run_backup(QStringList & sections, QString const & stora
     view_->start_printing_tasks();
 }
 
-void CommandLineClient::run_restore(QStringList & sections, QString const & storage)
+void CommandLineClient::start_restore(keeper::Items const & choices_values, QStringList const & sections, QString const & storage)
 {
     auto unhandled_sections = sections;
-    keeper::Error error;
-
-    auto choices_values = keeper_client_->getRestoreChoices(storage, error);
-    check_for_choices_error(error);
     QStringList uuids;
 
     auto uuids_choices = choices_values.get_uuids();
@@ -164,6 +234,24 @@ void CommandLineClient::run_cancel() const
     keeper_client_->cancel();
 }
 
+void CommandLineClient::run_bench(QStringList const & sections, QString const & storage, qint64 generate_bytes, int n_files, QString const & json_path)
+{
+    // the bench prints its own report and exits when the restore is done,
+    // not when the backup tasks finish
+    keeper_client_->disconnect(this);
+    keeper_client_->disconnect(view_.data());
+
+    BenchRunner::Options options;
+    options.sections = sections;
+    options.storage = storage;
+    options.generate_bytes = generate_bytes;
+    options.n_files = n_files;
+    options.json_path = json_path;
+
+    auto runner = new BenchRunner(keeper_client_.data(), this);
+    runner->run(options);
+}
+
 void CommandLineClient::list_backup_sections(keeper::Items const & choices_values)
 {
     QStringList sections;
@@ -211,6 +299,21 @@ void CommandLineClient::list_storage_accounts(QStringList const & accounts)
     view_->print_sections(accounts);
 }
 
+void CommandLineClient::list_contents(keeper::Items const & files)
+{
+    QStringList lines;
+    for (auto iter = files.begin(); iter != files.end(); ++iter)
+    {
+        auto const size = (*iter).get_property_value(QStringLiteral("size")).toLongLong();
+        auto const mtime = QDateTime::fromMSecsSinceEpoch((*iter).get_property_value(QStringLiteral("mtime")).toLongLong() * 1000);
+        lines << QStringLiteral("%1 %2 %3")
+                    .arg(size, 12)
+                    .arg(mtime.toString(Qt::ISODate))
+                    .arg(iter.key());
+    }
+    view_->print_sections(lines);
+}
+
 void CommandLineClient::on_progress_changed()
 {
     view_->progress_changed(keeper_client_->progress());
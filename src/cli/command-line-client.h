@@ -24,6 +24,7 @@
 #include <QTimer>
 #include "../../include/client/keeper-items.h"
 
+class BenchRunner;
 class KeeperClient;
 class CommandLineClientView;
 
@@ -40,7 +41,9 @@ public:
     void run_list_storage_accounts();
     void run_backup(QStringList & sections, QString const & storage);
     void run_restore(QStringList & sections, QString const & storage);
+    void run_list_contents(QStringList const & sections, QString const & storage, QString const & pattern);
     void run_cancel() const;
+    void run_bench(QStringList const & sections, QString const & storage, qint64 generate_bytes, int n_files, QString const & json_path);
 
 private Q_SLOTS:
     void on_progress_changed();
@@ -49,10 +52,16 @@ private Q_SLOTS:
 
 private:
     bool find_choice_value(QVariantMap const & choice, QString const & id, QVariant & value);
+    void start_backup(keeper::Items const & choices, QStringList const & sections, QString const & storage);
+    void start_restore(keeper::Items const & choices, QStringList const & sections, QString const & storage);
     void list_backup_sections(keeper::Items const & choices);
     void list_restore_sections(keeper::Items const & choices);
     void list_storage_accounts(QStringList const & accounts);
+    void list_contents(keeper::Items const & files);
     void check_for_choices_error(keeper::Error error);
     QScopedPointer<KeeperClient> keeper_client_;
     QScopedPointer<CommandLineClientView> view_;
+    // sections whose contents are still to be listed, and their uuids
+    QStringList contents_sections_;
+    QStringList contents_uuids_;
 };
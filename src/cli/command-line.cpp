@@ -30,20 +30,38 @@ namespace
     constexpr const char ARGUMENT_LIST_STORAGE_ACCOUNTS[] = "list-storage-configs";
     constexpr const char ARGUMENT_BACKUP[]                = "backup";
     constexpr const char ARGUMENT_RESTORE[]               = "restore";
+    constexpr const char ARGUMENT_LIST_CONTENTS[]         = "list-contents";
+    constexpr const char ARGUMENT_BENCH[]                 = "bench";
 
     // argument descriptions
     constexpr const char ARGUMENT_LIST_SECTIONS_DESCRIPTION[]         = "List the sections available to backup";
     constexpr const char ARGUMENT_LIST_STORAGE_ACCOUNTS_DESCRIPTION[] = "List the available storage accounts";
     constexpr const char ARGUMENT_BACKUP_DESCRIPTION[]                = "Starts a backup";
     constexpr const char ARGUMENT_RESTORE_DESCRIPTION[]               = "Starts a restore";
+    constexpr const char ARGUMENT_LIST_CONTENTS_DESCRIPTION[]         = "Lists the files stored in a backup";
+    constexpr const char ARGUMENT_BENCH_DESCRIPTION[]                 = "Measures a backup and a restore of some sections";
 
     // options
     constexpr const char OPTION_STORAGE[]          = "storage";
     constexpr const char OPTION_SECTIONS[]         = "sections";
+    constexpr const char OPTION_FIND[]             = "find";
+    constexpr const char OPTION_GENERATE[]         = "generate";
+    constexpr const char OPTION_FILES[]            = "files";
+    constexpr const char OPTION_JSON[]             = "json";
+    constexpr const char OPTION_OVERWRITE[]        = "overwrite";
+
+    constexpr int DEFAULT_BENCH_FILES {100};
 
     // option descriptions
     constexpr const char OPTION_STORAGE_DESCRIPTION[]          = "Defines the available storage to use. Pass 'default' to use the default one";
     constexpr const char OPTION_SECTIONS_DESCRIPTION[]         = "Lists the sections to backup or restore";
+    constexpr const char OPTION_SECTION_DESCRIPTION[]          = "The section to list, as shown by list-sections";
+    constexpr const char OPTION_FIND_DESCRIPTION[]             = "Lists only the files whose path contains the pattern. Use '*' and '?' as wildcards";
+    constexpr const char OPTION_BENCH_SECTIONS_DESCRIPTION[]   = "Lists the sections to measure";
+    constexpr const char OPTION_GENERATE_DESCRIPTION[]         = "Generates a dataset of this many MB in the first section. It is removed when the bench ends";
+    constexpr const char OPTION_FILES_DESCRIPTION[]            = "Number of files of the generated dataset";
+    constexpr const char OPTION_JSON_DESCRIPTION[]             = "Also writes the report as JSON to this file. Pass '-' to write it to the standard output";
+    constexpr const char OPTION_OVERWRITE_DESCRIPTION[]        = "Required to run a bench. The restore writes over the files in the sections, and the backups are left in the storage";
 }
 
 CommandLineParser::CommandLineParser()
@@ -56,6 +74,8 @@ CommandLineParser::CommandLineParser()
     parser_->addPositionalArgument(ARGUMENT_LIST_STORAGE_ACCOUNTS, QCoreApplication::translate("main", ARGUMENT_LIST_STORAGE_ACCOUNTS_DESCRIPTION));
     parser_->addPositionalArgument(ARGUMENT_BACKUP, QCoreApplication::translate("main", ARGUMENT_BACKUP_DESCRIPTION));
     parser_->addPositionalArgument(ARGUMENT_RESTORE, QCoreApplication::translate("main", ARGUMENT_RESTORE_DESCRIPTION));
+    parser_->addPositionalArgument(ARGUMENT_LIST_CONTENTS, QCoreApplication::translate("main", ARGUMENT_LIST_CONTENTS_DESCRIPTION));
+    parser_->addPositionalArgument(ARGUMENT_BENCH, QCoreApplication::translate("main", ARGUMENT_BENCH_DESCRIPTION));
 }
 
 bool CommandLineParser::parse(QStringList const & arguments, QCoreApplication const & app, CommandLineParser::CommandArgs & cmd_args)
@@ -86,6 +106,14 @@ bool CommandLineParser::parse(QStringList const & arguments, QCoreApplication co
         {
             return handle_restore(app, cmd_args);
         }
+        else if (args.at(0) == ARGUMENT_LIST_CONTENTS)
+        {
+            return handle_list_contents(app, cmd_args);
+        }
+        else if (args.at(0) == ARGUMENT_BENCH)
+        {
+            return handle_bench(app, cmd_args);
+        }
         else
         {
             std::cerr << "Bad argument." << std::endl;
@@ -213,6 +241,135 @@ bool CommandLineParser::handle_restore(QCoreApplication const & app, CommandLine
     return true;
 }
 
+bool CommandLineParser::handle_list_contents(QCoreApplication const & app, CommandLineParser::CommandArgs & cmd_args)
+{
+    parser_->clearPositionalArguments();
+    parser_->addPositionalArgument(ARGUMENT_LIST_CONTENTS, QCoreApplication::translate("main", ARGUMENT_LIST_CONTENTS_DESCRIPTION));
+
+    parser_->addOptions({
+            {{"s", OPTION_SECTIONS},
+                QCoreApplication::translate("main", OPTION_SECTION_DESCRIPTION),
+                QCoreApplication::translate("main", OPTION_SECTION_DESCRIPTION)
+            },
+            {{"r", OPTION_STORAGE},
+                QCoreApplication::translate("main", OPTION_STORAGE_DESCRIPTION),
+                QCoreApplication::translate("main", OPTION_STORAGE_DESCRIPTION)
+            },
+            {{"f", OPTION_FIND},
+                QCoreApplication::translate("main", OPTION_FIND_DESCRIPTION),
+                QCoreApplication::translate("main", OPTION_FIND_DESCRIPTION)
+            },
+        });
+    parser_->process(app);
+
+    // it didn't exit... we're good
+    cmd_args.sections.clear();
+    cmd_args.storage.clear();
+    cmd_args.pattern.clear();
+    cmd_args.cmd = CommandLineParser::Command::LIST_CONTENTS;
+    if (!parser_->isSet(OPTION_SECTIONS))
+    {
+        std::cerr << "You need to specify the section to list its contents." << std::endl;
+        return false;
+    }
+    if (parser_->isSet(OPTION_STORAGE))
+    {
+        cmd_args.storage = get_storage_string(parser_->value(OPTION_STORAGE));
+    }
+    if (parser_->isSet(OPTION_FIND))
+    {
+        cmd_args.pattern = parser_->value(OPTION_FIND);
+    }
+    cmd_args.sections = parser_->value(OPTION_SECTIONS).split(',');
+
+    return true;
+}
+
+bool CommandLineParser::handle_bench(QCoreApplication const & app, CommandLineParser::CommandArgs & cmd_args)
+{
+    parser_->clearPositionalArguments();
+    parser_->addPositionalArgument(ARGUMENT_BENCH, QCoreApplication::translate("main", ARGUMENT_BENCH_DESCRIPTION));
+
+    parser_->addOptions({
+            {{"s", OPTION_SECTIONS},
+                QCoreApplication::translate("main", OPTION_BENCH_SECTIONS_DESCRIPTION),
+                QCoreApplication::translate("main", OPTION_BENCH_SECTIONS_DESCRIPTION)
+            },
+            {{"r", OPTION_STORAGE},
+                QCoreApplication::translate("main", OPTION_STORAGE_DESCRIPTION),
+                QCoreApplication::translate("main", OPTION_STORAGE_DESCRIPTION)
+            },
+            {{"g", OPTION_GENERATE},
+                QCoreApplication::translate("main", OPTION_GENERATE_DESCRIPTION),
+                QCoreApplication::translate("main", OPTION_GENERATE_DESCRIPTION)
+            },
+            {{"n", OPTION_FILES},
+                QCoreApplication::translate("main", OPTION_FILES_DESCRIPTION),
+                QCoreApplication::translate("main", OPTION_FILES_DESCRIPTION)
+            },
+            {{"j", OPTION_JSON},
+                QCoreApplication::translate("main", OPTION_JSON_DESCRIPTION),
+                QCoreApplication::translate("main", OPTION_JSON_DESCRIPTION)
+            },
+            {{"o", OPTION_OVERWRITE},
+                QCoreApplication::translate("main", OPTION_OVERWRITE_DESCRIPTION)
+            },
+        });
+    parser_->process(app);
+
+    // it didn't exit... we're good
+    cmd_args.sections.clear();
+    cmd_args.storage.clear();
+    cmd_args.generate_bytes = 0;
+    cmd_args.n_files = DEFAULT_BENCH_FILES;
+    cmd_args.json_path.clear();
+    cmd_args.cmd = CommandLineParser::Command::BENCH;
+    if (!parser_->isSet(OPTION_SECTIONS))
+    {
+        std::cerr << "You need to specify some sections to run a bench." << std::endl;
+        return false;
+    }
+    // the sections are the real user folders
+    if (!parser_->isSet(OPTION_OVERWRITE))
+    {
+        std::cerr << "A bench restores its backups over the files in the sections, and its generated dataset is written into the first one." << std::endl;
+        std::cerr << "Pass --" << OPTION_OVERWRITE << " to run it anyway." << std::endl;
+        return false;
+    }
+    if (parser_->isSet(OPTION_STORAGE))
+    {
+        cmd_args.storage = get_storage_string(parser_->value(OPTION_STORAGE));
+    }
+    if (parser_->isSet(OPTION_GENERATE))
+    {
+        bool ok;
+        auto const megabytes = parser_->value(OPTION_GENERATE).toDouble(&ok);
+        if (!ok || megabytes <= 0)
+        {
+            std::cerr << "The size of the dataset to generate must be a positive number of MB." << std::endl;
+            return false;
+        }
+        cmd_args.generate_bytes = qint64(megabytes * 1000 * 1000);
+    }
+    if (parser_->isSet(OPTION_FILES))
+    {
+        bool ok;
+        cmd_args.n_files = parser_->value(OPTION_FILES).toInt(&ok);
+        if (!ok || cmd_args.n_files <= 0)
+        {
+            std::cerr << "The number of files to generate must be a positive number." << std::endl;
+            return false;
+        }
+    }
+    if (parser_->isSet(OPTION_JSON))
+    {
+        cmd_args.json_path = parser_->value(OPTION_JSON);
+    }
+    cmd_args.sections = parser_->value(OPTION_SECTIONS).split(',');
+
+    return true;
+}
+
 bool CommandLineParser::check_number_of_args(QStringList const & args)
 {
     if (args.size() > 1)
@@ -27,12 +27,17 @@ class CommandLineParser
 {
 public:
     Q_ENUMS(Command)
-    enum class Command {LIST_LOCAL_SECTIONS, LIST_REMOTE_SECTIONS, LIST_STORAGE_ACCOUNTS, BACKUP, RESTORE};
+    enum class Command {LIST_LOCAL_SECTIONS, LIST_REMOTE_SECTIONS, LIST_STORAGE_ACCOUNTS, BACKUP, RESTORE, LIST_CONTENTS, BENCH};
     struct CommandArgs
     {
         Command cmd;
         QStringList sections;
         QString storage;
+        QString pattern;
+        // bench
+        qint64 generate_bytes;
+        int n_files;
+        QString json_path;
     };
 
     CommandLineParser();
@@ -46,6 +51,8 @@ private:
     bool handle_list_storage_accounts(QCoreApplication const & app, CommandArgs & cmd_args);
     bool handle_backup(QCoreApplication const & app, CommandArgs & cmd_args);
     bool handle_restore(QCoreApplication const & app, CommandArgs & cmd_args);
+    bool handle_list_contents(QCoreApplication const & app, CommandArgs & cmd_args);
+    bool handle_bench(QCoreApplication const & app, CommandArgs & cmd_args);
 
     bool check_number_of_args(QStringList const & args);
 
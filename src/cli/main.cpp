@@ -21,7 +21,7 @@
 #include "command-line-client.h"
 
 #include <dbus-types.h>
-#include <util/logging.h>
+#include <util/async-logger.h>
 #include "util/unix-signal-handler.h"
 
 #include <keeper_user_interface.h>
@@ -38,7 +38,7 @@
 int
 main(int argc, char **argv)
 {
-    qInstallMessageHandler(util::loggingFunction);
+    util::AsyncLogger logger;
 
     QCoreApplication app(argc, argv);
     DBusTypes::registerMetaTypes();
@@ -68,15 +68,12 @@ main(int argc, char **argv)
         {
             case CommandLineParser::Command::LIST_LOCAL_SECTIONS:
                 client.run_list_sections(false);
-                exit(0);
                 break;
             case CommandLineParser::Command::LIST_STORAGE_ACCOUNTS:
                 client.run_list_storage_accounts();
-                exit(0);
                 break;
             case CommandLineParser::Command::LIST_REMOTE_SECTIONS:
                 client.run_list_sections(true, cmd_args.storage);
-                exit(0);
                 break;
             case CommandLineParser::Command::BACKUP:
                 client.run_backup(cmd_args.sections, cmd_args.storage);
@@ -84,6 +81,12 @@ main(int argc, char **argv)
             case CommandLineParser::Command::RESTORE:
                 client.run_restore(cmd_args.sections, cmd_args.storage);
                 break;
+            case CommandLineParser::Command::LIST_CONTENTS:
+                client.run_list_contents(cmd_args.sections, cmd_args.storage, cmd_args.pattern);
+                break;
+            case CommandLineParser::Command::BENCH:
+                client.run_bench(cmd_args.sections, cmd_args.storage, cmd_args.generate_bytes, cmd_args.n_files, cmd_args.json_path);
+                break;
         };
     }
 
@@ -17,31 +17,28 @@
  *     Marcus Tomlinson <marcus.tomlinson@canonical.com>
  */
 
+#include <QDBusPendingCallWatcher>
 #include <QTimer>
 
 #include <client/client.h>
 
 #include <qdbus-stubs/keeper_user_interface.h>
-#include <qdbus-stubs/DBusPropertiesInterface.h>
 #include <qdbus-stubs/dbus-types.h>
 
+#include <functional>
+
 struct KeeperClientPrivate final
 {
     Q_DISABLE_COPY(KeeperClientPrivate)
 
     enum class TasksMode { IDLE_MODE, BACKUP_MODE, RESTORE_MODE };
 
-    explicit KeeperClientPrivate(QObject* /* parent */)
+    explicit KeeperClientPrivate(QDBusConnection const & connection)
         : userIface(new DBusInterfaceKeeperUser(
                           DBusTypes::KEEPER_SERVICE,
                           DBusTypes::KEEPER_USER_PATH,
-                          QDBusConnection::sessionBus()
+                          connection
                           ))
-        , propertiesIface(new DBusPropertiesInterface(
-                           DBusTypes::KEEPER_SERVICE,
-                           DBusTypes::KEEPER_USER_PATH,
-                           QDBusConnection::sessionBus()
-                         ))
     {
     }
 
@@ -107,8 +104,92 @@ struct KeeperClientPrivate final
         return keeper::Items();
     }
 
+    // merges the changed task properties into the local copy of the state.
+    // Tasks mapped to an empty property map were removed by the service.
+    void mergeState(keeper::Items const & changed)
+    {
+        for (auto iter = changed.begin(); iter != changed.end(); ++iter)
+        {
+            if (iter->isEmpty())
+            {
+                state.remove(iter.key());
+                continue;
+            }
+            auto& item = state[iter.key()];
+            for (auto field = iter->begin(); field != iter->end(); ++field)
+            {
+                if (field.key() == keeper::Item::REMOVED_PROPERTIES_KEY)
+                {
+                    for (auto const& removed : field.value().toStringList())
+                    {
+                        item.remove(removed);
+                    }
+                    continue;
+                }
+                item.insert(field.key(), field.value());
+            }
+        }
+    }
+
+    // calls on_finished in the context thread once the reply of call arrives
+    static void watchCall(QDBusPendingCall const & call,
+                          QObject* context,
+                          std::function<void(QDBusPendingCallWatcher &)> const & on_finished)
+    {
+        auto watcher = new QDBusPendingCallWatcher(call, context);
+        QObject::connect(watcher, &QDBusPendingCallWatcher::finished, context, [watcher, on_finished](){
+            on_finished(*watcher);
+            watcher->deleteLater();
+        });
+    }
+
+    // the service refused to start the tasks, so the client is no longer busy
+    void watchStart(QDBusPendingCall const & call, KeeperClient* client, QString const & what)
+    {
+        watchCall(call, client, [this, client, what](QDBusPendingCallWatcher & watcher){
+            if (!watcher.isError())
+            {
+                return;
+            }
+            qWarning() << what << watcher.error().message();
+            status = mode == TasksMode::RESTORE_MODE ? QStringLiteral("Restore Failed") : QStringLiteral("Backup Failed");
+            mode = TasksMode::IDLE_MODE;
+            Q_EMIT client->statusChanged();
+            backupBusy = false;
+            Q_EMIT client->backupBusyChanged();
+        });
+    }
+
+    static void warnOnError(QDBusPendingCall const & call, QObject* context, QString const & what)
+    {
+        watchCall(call, context, [what](QDBusPendingCallWatcher & watcher){
+            if (watcher.isError())
+            {
+                qWarning() << what << watcher.error().message();
+            }
+        });
+    }
+
+    // replaces the local list of backup choices, keeping the "enabled" flags
+    // of the ones that were already known or enabled before the list arrived
+    void setBackups(keeper::Items const & choices)
+    {
+        auto previous = backups;
+        backups = choices;
+        for (auto iter = backups.begin(); iter != backups.end(); ++iter)
+        {
+            iter.value()["enabled"] = previous.value(iter.key()).value("enabled", false);
+        }
+        for (auto iter = previous.begin(); iter != previous.end(); ++iter)
+        {
+            if (!backups.contains(iter.key()) && iter.value().value("enabled").toBool())
+            {
+                backups.insert(iter.key(), iter.value());
+            }
+        }
+    }
+
     QScopedPointer<DBusInterfaceKeeperUser> userIface;
-    QScopedPointer<DBusPropertiesInterface> propertiesIface;
     QString status;
     keeper::Items backups;
     double progress = 0;
@@ -116,25 +197,48 @@ struct KeeperClientPrivate final
     bool backupBusy = false;
     QMap<QString, TaskStatus> taskStatus;
     TasksMode mode = TasksMode::IDLE_MODE;
+    keeper::Items state;
+    quint64 stateVersion = 0;
+    // the highest version announced by StateChanged
+    quint64 latestStateVersion = 0;
+    bool syncPending = false;
 };
 
 KeeperClient::KeeperClient(QObject* parent) :
+    KeeperClient(QDBusConnection::sessionBus(), parent)
+{
+}
+
+KeeperClient::KeeperClient(QDBusConnection const & connection, QObject* parent) :
     QObject(parent),
-    d(new KeeperClientPrivate(this))
+    d(new KeeperClientPrivate(connection))
 {
     DBusTypes::registerMetaTypes();
 
-    // Store backups list locally with an additional "enabled" pair to keep track enabled states
-    // TODO: We should be listening to a backupChoicesChanged signal to keep this list updated
-    keeper::Error error;
-    d->backups = getBackupChoices(error);
+    // Store backups list locally with an additional "enabled" pair to keep track enabled states.
+    // It is fetched again every time the service says the choices changed
+    updateBackups();
+    connect(d->userIface.data(), &DBusInterfaceKeeperUser::BackupChoicesChanged, this, &KeeperClient::updateBackups);
 
-    for(auto iter = d->backups.begin(); iter != d->backups.end(); ++iter)
-    {
-        iter.value()["enabled"] = false;
-    }
+    // the service sends only the task properties that changed,
+    // so we keep a local copy of the state up to date with them
+    connect(d->userIface.data(), &DBusInterfaceKeeperUser::StateChanged, this, &KeeperClient::stateChanged);
+}
 
-    connect(d->propertiesIface.data(), &DBusPropertiesInterface::PropertiesChanged, this, &KeeperClient::stateUpdated);
+// the list is fetched without blocking, backupUuidsChanged tells when it arrives
+void KeeperClient::updateBackups()
+{
+    KeeperClientPrivate::watchCall(d->userIface->asyncCall("GetBackupChoices"), this, [this](QDBusPendingCallWatcher & call){
+        keeper::Error error;
+        auto choices = KeeperClientPrivate::getValue(call.reply(), error);
+        if (error != keeper::Error::OK)
+        {
+            qWarning() << "Error retrieving the backup choices:" << int(error);
+            return;
+        }
+        d->setBackups(choices);
+        Q_EMIT backupUuidsChanged();
+    });
 }
 
 KeeperClient::~KeeperClient() = default;
@@ -175,6 +279,7 @@ bool KeeperClient::backupBusy()
 
 void KeeperClient::enableBackup(QString uuid, bool enabled)
 {
+    auto const changed = d->backups.value(uuid).value("enabled").toBool() != enabled;
     d->backups[uuid]["enabled"] = enabled;
 
     for (auto const& backup : d->backups)
@@ -191,6 +296,10 @@ void KeeperClient::enableBackup(QString uuid, bool enabled)
     d->taskStatus[uuid] = KeeperClientPrivate::TaskStatus{"", 0.0};
 
     Q_EMIT readyToBackupChanged();
+    if (changed)
+    {
+        Q_EMIT backupEnabledChanged(uuid, enabled);
+    }
 }
 
 void KeeperClient::enableRestore(QString uuid, bool enabled)
@@ -213,7 +322,9 @@ void KeeperClient::startBackup(QString const & storage)
 
     if (!backupList.empty())
     {
-        startBackup(backupList, storage);
+        d->watchStart(d->userIface->asyncCall("StartBackup", backupList, storage),
+                      this,
+                      QStringLiteral("Error starting backup:"));
 
         d->mode = KeeperClientPrivate::TasksMode::BACKUP_MODE;
         d->status = "Preparing Backup...";
@@ -237,7 +348,9 @@ void KeeperClient::startRestore(QString const & storage)
 
     if (!restoreList.empty())
     {
-        startRestore(restoreList, storage);
+        d->watchStart(d->userIface->asyncCall("StartRestore", restoreList, storage),
+                      this,
+                      QStringLiteral("Error starting restore:"));
 
         d->mode = KeeperClientPrivate::TasksMode::RESTORE_MODE;
         d->status = "Preparing Restore...";
@@ -249,12 +362,44 @@ void KeeperClient::startRestore(QString const & storage)
 
 void KeeperClient::cancel()
 {
-    QDBusReply<void> cancelReply = d->userIface->call("Cancel");
+    KeeperClientPrivate::warnOnError(d->userIface->asyncCall("Cancel"), this, QStringLiteral("Error canceling"));
+}
 
-    if (!cancelReply.isValid())
-    {
-        qWarning() << "Error canceling" << cancelReply.error().message();
-    }
+void KeeperClient::resume()
+{
+    KeeperClientPrivate::watchCall(d->userIface->asyncCall("Resume"), this, [this](QDBusPendingCallWatcher & call){
+        QDBusPendingReply<QString> reply = call;
+        if (!reply.isValid())
+        {
+            qWarning() << "Error resuming:" << reply.error().message();
+            Q_EMIT resumeReady(false);
+            return;
+        }
+
+        // the resumed tasks report their progress as a backup or as a restore
+        auto const mode = reply.value();
+        if (mode == QLatin1String("backup"))
+        {
+            d->mode = KeeperClientPrivate::TasksMode::BACKUP_MODE;
+        }
+        else if (mode == QLatin1String("restore"))
+        {
+            d->mode = KeeperClientPrivate::TasksMode::RESTORE_MODE;
+        }
+        else
+        {
+            Q_EMIT resumeReady(false);
+            return;
+        }
+
+        d->status = d->mode == KeeperClientPrivate::TasksMode::BACKUP_MODE
+                  ? QStringLiteral("Resuming Backup...")
+                  : QStringLiteral("Resuming Restore...");
+        Q_EMIT statusChanged();
+        d->backupBusy = true;
+        Q_EMIT backupBusyChanged();
+        Q_EMIT resumeReady(true);
+    });
 }
 
 QString KeeperClient::getBackupName(QString uuid)
@@ -274,24 +419,24 @@ keeper::Items KeeperClient::getRestoreChoices(QString const & storage, keeper::E
     return KeeperClientPrivate::getValue(choices, error);
 }
 
-void KeeperClient::startBackup(const QStringList& uuids, QString const & storage) const
+keeper::Items KeeperClient::getBackupContents(QString const & uuid, QString const & storage, QString const & pattern, keeper::Error & error) const
 {
-    QDBusReply<void> backupReply = d->userIface->call("StartBackup", uuids, storage);
+    QDBusMessage contents = d->userIface->call("GetBackupContents", uuid, storage, pattern);
+    return KeeperClientPrivate::getValue(contents, error);
+}
 
-    if (!backupReply.isValid())
-    {
-        qWarning() << "Error starting backup:" << backupReply.error().message();
-    }
+void KeeperClient::startBackup(const QStringList& uuids, QString const & storage) const
+{
+    KeeperClientPrivate::warnOnError(d->userIface->asyncCall("StartBackup", uuids, storage),
+                                     d->userIface.data(),
+                                     QStringLiteral("Error starting backup:"));
 }
 
 void KeeperClient::startRestore(const QStringList& uuids, QString const & storage) const
 {
-    QDBusReply<void> backupReply = d->userIface->call("StartRestore", uuids, storage);
-
-    if (!backupReply.isValid())
-    {
-        qWarning() << "Error starting restore:" << backupReply.error().message();
-    }
+    KeeperClientPrivate::warnOnError(d->userIface->asyncCall("StartRestore", uuids, storage),
+                                     d->userIface.data(),
+                                     QStringLiteral("Error starting restore:"));
 }
 
 keeper::Items KeeperClient::getState() const
@@ -312,9 +457,130 @@ QStringList KeeperClient::getStorageAccounts() const
      return accountsReply.value();
 }
 
+void KeeperClient::getBackupChoicesAsync()
+{
+    KeeperClientPrivate::watchCall(d->userIface->asyncCall("GetBackupChoices"), this, [this](QDBusPendingCallWatcher & call){
+        keeper::Error error;
+        auto choices = KeeperClientPrivate::getValue(call.reply(), error);
+        if (error == keeper::Error::OK)
+        {
+            d->setBackups(choices);
+            Q_EMIT backupUuidsChanged();
+        }
+        Q_EMIT backupChoicesReady(choices, error);
+    });
+}
+
+void KeeperClient::getRestoreChoicesAsync(QString const & storage)
+{
+    KeeperClientPrivate::watchCall(d->userIface->asyncCall("GetRestoreChoices", storage), this, [this, storage](QDBusPendingCallWatcher & call){
+        keeper::Error error;
+        auto choices = KeeperClientPrivate::getValue(call.reply(), error);
+        Q_EMIT restoreChoicesReady(storage, choices, error);
+    });
+}
+
+void KeeperClient::getBackupContentsAsync(QString const & uuid, QString const & storage, QString const & pattern)
+{
+    KeeperClientPrivate::watchCall(d->userIface->asyncCall("GetBackupContents", uuid, storage, pattern), this, [this, uuid](QDBusPendingCallWatcher & call){
+        keeper::Error error;
+        auto files = KeeperClientPrivate::getValue(call.reply(), error);
+        Q_EMIT backupContentsReady(uuid, files, error);
+    });
+}
+
+void KeeperClient::getStorageAccountsAsync()
+{
+    KeeperClientPrivate::watchCall(d->userIface->asyncCall("GetStorageAccounts"), this, [this](QDBusPendingCallWatcher & call){
+        QDBusPendingReply<QStringList> reply = call;
+        if (!reply.isValid())
+        {
+            qWarning() << "Error retrieving storage accounts:" << reply.error().message();
+        }
+        Q_EMIT storageAccountsReady(reply.value());
+    });
+}
+
+keeper::Items KeeperClient::backupChoices() const
+{
+    return d->backups;
+}
+
+keeper::Items KeeperClient::taskStates() const
+{
+    return d->state;
+}
+
+void KeeperClient::stateChanged(quint64 version, keeper::Items const & changed)
+{
+    d->latestStateVersion = qMax(d->latestStateVersion, version);
+
+    if (d->syncPending)
+    {
+        // the sync in flight, or the one following it, picks this change up
+        return;
+    }
+
+    if (version <= d->stateVersion)
+    {
+        // already included in a previous sync
+        return;
+    }
+
+    if (version == d->stateVersion + 1)
+    {
+        d->mergeState(changed);
+        d->stateVersion = version;
+        Q_EMIT taskStatesChanged(changed);
+        stateUpdated();
+    }
+    else
+    {
+        // we missed some changes, fetch them without blocking
+        syncState();
+    }
+}
+
+void KeeperClient::syncState()
+{
+    d->syncPending = true;
+    KeeperClientPrivate::watchCall(d->userIface->GetStateSince(d->stateVersion), this, [this](QDBusPendingCallWatcher & call){
+        d->syncPending = false;
+        QDBusPendingReply<keeper::Items, quint64, bool> reply = call;
+        if (!reply.isValid())
+        {
+            qWarning() << "Error retrieving state:" << reply.error().message();
+            return;
+        }
+        auto changed = reply.argumentAt<0>();
+        if (reply.argumentAt<2>())
+        {
+            // a full state, so the tasks missing from it were removed
+            for (auto iter = d->state.begin(); iter != d->state.end(); ++iter)
+            {
+                if (!changed.contains(iter.key()))
+                {
+                    changed.insert(iter.key(), keeper::Item());
+                }
+            }
+            d->state.clear();
+        }
+        d->mergeState(changed);
+        d->stateVersion = reply.argumentAt<1>();
+        Q_EMIT taskStatesChanged(changed);
+        stateUpdated();
+
+        if (d->latestStateVersion > d->stateVersion)
+        {
+            // changes were announced while the reply was on its way
+            syncState();
+        }
+    });
+}
+
 void KeeperClient::stateUpdated()
 {
-    auto states = getState();
+    auto const & states = d->state;
 
     if (!states.empty())
     {
@@ -19,6 +19,8 @@
 
 #include "client/keeper-items.h"
 
+#include <QJsonArray>
+#include <QJsonDocument>
 #include <QtDBus>
 #include <QVariantMap>
 
@@ -37,11 +39,16 @@ const QString Item::TITLE_KEY = QStringLiteral("title");
 const QString Item::VERSION_KEY = QStringLiteral("version");
 const QString Item::FILE_NAME_KEY = QStringLiteral("file-name");
 const QString Item::DIR_NAME_KEY = QStringLiteral("dir-name");
+const QString Item::PART_FILE_NAMES_KEY = QStringLiteral("part-file-names");
+const QString Item::CATALOG_FILE_NAME_KEY = QStringLiteral("catalog-file-name");
 const QString Item::DISPLAY_NAME_KEY = QStringLiteral("display-name");
 const QString Item::STATUS_KEY = QStringLiteral("action");
 const QString Item::ERROR_KEY = QStringLiteral("error");
 const QString Item::PERCENT_DONE_KEY = QStringLiteral("percent-done");
 const QString Item::SPEED_KEY = QStringLiteral("speed");
+const QString Item::SIZE_ESTIMATE_KEY = QStringLiteral("size-estimate");
+const QString Item::FILE_COUNT_KEY = QStringLiteral("file-count");
+const QString Item::REMOVED_PROPERTIES_KEY = QStringLiteral("removed-properties");
 
 
 // values
@@ -157,6 +164,37 @@ QString Item::get_file_name(bool *valid) const
     return get_property<QString>(FILE_NAME_KEY, valid);
 }
 
+QStringList Item::get_part_file_names(bool *valid) const
+{
+    auto const value = get_property<QString>(PART_FILE_NAMES_KEY, valid);
+
+    QStringList ret;
+    for (auto const & file_name : QJsonDocument::fromJson(value.toUtf8()).array())
+        ret << file_name.toString();
+    return ret;
+}
+
+void Item::set_part_file_names(QStringList const & file_names)
+{
+    auto const value = QJsonDocument(QJsonArray::fromStringList(file_names)).toJson(QJsonDocument::Compact);
+    set_property_value(PART_FILE_NAMES_KEY, QString::fromUtf8(value));
+}
+
+QString Item::get_catalog_file_name(bool *valid) const
+{
+    return get_property<QString>(CATALOG_FILE_NAME_KEY, valid);
+}
+
+qint64 Item::get_size_estimate(bool *valid) const
+{
+    return get_property<qint64>(SIZE_ESTIMATE_KEY, valid);
+}
+
+qint64 Item::get_file_count(bool *valid) const
+{
+    return get_property<qint64>(FILE_COUNT_KEY, valid);
+}
+
 void Item::registerMetaType()
 {
     qRegisterMetaType<Item>("Item");
@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include "backup-choices-model.h"
+
+namespace
+{
+    constexpr const char ENABLED_KEY[] = "enabled";
+
+    // the uuid is the key of the choice, so it never changes
+    QVector<int> const ALL_ROLES {
+        BackupChoicesModel::DisplayNameRole,
+        BackupChoicesModel::TypeRole,
+        BackupChoicesModel::EnabledRole,
+        BackupChoicesModel::SizeEstimateRole,
+        BackupChoicesModel::FileCountRole
+    };
+}
+
+BackupChoicesModel::BackupChoicesModel(QObject* parent)
+    : QAbstractListModel(parent)
+{
+}
+
+BackupChoicesModel::~BackupChoicesModel() = default;
+
+KeeperClient* BackupChoicesModel::client() const
+{
+    return client_;
+}
+
+void BackupChoicesModel::setClient(KeeperClient* client)
+{
+    if (client_ == client)
+        return;
+
+    if (client_)
+        client_->disconnect(this);
+
+    client_ = client;
+    if (client_)
+    {
+        connect(client_.data(), &KeeperClient::backupUuidsChanged, this, [this](){
+            setChoices(client_->backupChoices());
+        });
+        connect(client_.data(), &KeeperClient::backupEnabledChanged, this, &BackupChoicesModel::setEnabled);
+        setChoices(client_->backupChoices());
+    }
+    else
+    {
+        setChoices(keeper::Items());
+    }
+
+    Q_EMIT clientChanged();
+}
+
+int BackupChoicesModel::rowCount(QModelIndex const & parent) const
+{
+    return parent.isValid() ? 0 : uuids_.size();
+}
+
+QVariant BackupChoicesModel::data(QModelIndex const & index, int role) const
+{
+    if (!index.isValid() || index.row() >= uuids_.size())
+        return QVariant();
+
+    if (role == UuidRole)
+        return uuids_[index.row()];
+
+    return roleValue(choices_.value(uuids_[index.row()]), role);
+}
+
+bool BackupChoicesModel::setData(QModelIndex const & index, QVariant const & value, int role)
+{
+    if (!index.isValid() || index.row() >= uuids_.size() || role != EnabledRole)
+        return false;
+
+    auto const & uuid = uuids_[index.row()];
+    if (client_)
+        client_->enableBackup(uuid, value.toBool());
+    setEnabled(uuid, value.toBool());
+    return true;
+}
+
+Qt::ItemFlags BackupChoicesModel::flags(QModelIndex const & index) const
+{
+    return QAbstractListModel::flags(index) | Qt::ItemIsEditable;
+}
+
+QHash<int, QByteArray> BackupChoicesModel::roleNames() const
+{
+    return QHash<int, QByteArray>{
+        {UuidRole, "uuid"},
+        {DisplayNameRole, "displayName"},
+        {TypeRole, "type"},
+        {EnabledRole, "enabled"},
+        {SizeEstimateRole, "sizeEstimate"},
+        {FileCountRole, "fileCount"}
+    };
+}
+
+void BackupChoicesModel::setChoices(keeper::Items const & all_choices)
+{
+    // TODO: We currently only support "folder" type backups
+    keeper::Items choices;
+    for (auto iter = all_choices.begin(); iter != all_choices.end(); ++iter)
+    {
+        if (iter.value().get_type() == keeper::Item::FOLDER_VALUE)
+            choices.insert(iter.key(), iter.value());
+    }
+
+    // remove the rows of the choices that went away
+    for (int row = uuids_.size() - 1; row >= 0; --row)
+    {
+        if (!choices.contains(uuids_[row]))
+        {
+            beginRemoveRows(QModelIndex(), row, row);
+            choices_.remove(uuids_[row]);
+            uuids_.remove(row);
+            endRemoveRows();
+        }
+    }
+
+    // update the ones still there, only with the roles that changed
+    for (int row = 0; row < uuids_.size(); ++row)
+    {
+        auto const & old_item = choices_[uuids_[row]];
+        auto const & new_item = choices[uuids_[row]];
+        if (old_item == new_item)
+            continue;
+
+        QVector<int> roles;
+        for (auto role : ALL_ROLES)
+        {
+            if (roleValue(old_item, role) != roleValue(new_item, role))
+                roles << role;
+        }
+        choices_[uuids_[row]] = new_item;
+        if (!roles.isEmpty())
+        {
+            auto const idx = index(row);
+            Q_EMIT dataChanged(idx, idx, roles);
+        }
+    }
+
+    // and append the new ones
+    QVector<QString> added;
+    for (auto iter = choices.begin(); iter != choices.end(); ++iter)
+    {
+        if (!choices_.contains(iter.key()))
+            added << iter.key();
+    }
+    if (!added.isEmpty())
+    {
+        beginInsertRows(QModelIndex(), uuids_.size(), uuids_.size() + added.size() - 1);
+        for (auto const & uuid : added)
+        {
+            uuids_ << uuid;
+            choices_.insert(uuid, choices[uuid]);
+        }
+        endInsertRows();
+    }
+}
+
+void BackupChoicesModel::setEnabled(QString const & uuid, bool enabled)
+{
+    auto const row = uuids_.indexOf(uuid);
+    if (row == -1 || choices_[uuid].value(ENABLED_KEY).toBool() == enabled)
+        return;
+
+    choices_[uuid][ENABLED_KEY] = enabled;
+    auto const idx = index(row);
+    Q_EMIT dataChanged(idx, idx, QVector<int>{EnabledRole});
+}
+
+QVariant BackupChoicesModel::roleValue(keeper::Item const & item, int role)
+{
+    switch (role)
+    {
+        case DisplayNameRole:
+            return item.get_display_name();
+        case TypeRole:
+            return item.get_type();
+        case EnabledRole:
+            return item.value(ENABLED_KEY, false).toBool();
+        case SizeEstimateRole:
+            return item.get_size_estimate();
+        case FileCountRole:
+            return item.get_file_count();
+        default:
+            return QVariant();
+    }
+}
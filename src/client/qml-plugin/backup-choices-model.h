@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#pragma once
+
+#include <client.h>
+
+#include <QAbstractListModel>
+#include <QPointer>
+#include <QVector>
+
+/**
+ * The folder backup choices of a KeeperClient as a list model.
+ *
+ * Refreshing the choices keeps the existing rows: rows are only inserted
+ * or removed for the choices that appear or go away, and the rest get
+ * dataChanged for the roles whose values changed.
+ */
+class BackupChoicesModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(BackupChoicesModel)
+
+public:
+    enum Roles
+    {
+        UuidRole = Qt::UserRole + 1,
+        DisplayNameRole,
+        TypeRole,
+        EnabledRole,
+        SizeEstimateRole,
+        FileCountRole
+    };
+    Q_ENUM(Roles)
+
+    explicit BackupChoicesModel(QObject* parent = nullptr);
+    ~BackupChoicesModel();
+
+    Q_PROPERTY(KeeperClient* client READ client WRITE setClient NOTIFY clientChanged)
+    KeeperClient* client() const;
+    void setClient(KeeperClient* client);
+
+    int rowCount(QModelIndex const & parent = QModelIndex()) const override;
+    QVariant data(QModelIndex const & index, int role = Qt::DisplayRole) const override;
+    bool setData(QModelIndex const & index, QVariant const & value, int role = Qt::EditRole) override;
+    Qt::ItemFlags flags(QModelIndex const & index) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    // updates the rows to the given choices, keeping the ones that are still there
+    void setChoices(keeper::Items const & choices);
+    void setEnabled(QString const & uuid, bool enabled);
+
+Q_SIGNALS:
+    void clientChanged();
+
+private:
+    static QVariant roleValue(keeper::Item const & item, int role);
+
+    QPointer<KeeperClient> client_;
+    QVector<QString> uuids_;
+    keeper::Items choices_;
+};
@@ -21,6 +21,8 @@
 #include <QtQml/QQmlContext>
 
 #include <plugin.h>
+#include "backup-choices-model.h"
+#include "task-model.h"
 
 #include <client.h>
 
@@ -29,6 +31,8 @@ void QmlKeeperPlugin::registerTypes(const char *uri)
     Q_ASSERT(uri == QLatin1String("Ubuntu.Keeper"));
 
     qmlRegisterType<KeeperClient>(uri, KEEPER_MAJOR, KEEPER_MINOR, "Keeper");
+    qmlRegisterType<BackupChoicesModel>(uri, KEEPER_MAJOR, KEEPER_MINOR, "BackupChoicesModel");
+    qmlRegisterType<TaskModel>(uri, KEEPER_MAJOR, KEEPER_MINOR, "TaskModel");
 }
 
 void QmlKeeperPlugin::initializeEngine(QQmlEngine *engine, const char *uri)
@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include "task-model.h"
+
+TaskModel::TaskModel(QObject* parent)
+    : QAbstractListModel(parent)
+{
+    flush_timer_.setSingleShot(true);
+    flush_timer_.setInterval(UPDATE_INTERVAL_MSEC);
+    connect(&flush_timer_, &QTimer::timeout, this, &TaskModel::flush);
+}
+
+TaskModel::~TaskModel() = default;
+
+KeeperClient* TaskModel::client() const
+{
+    return client_;
+}
+
+void TaskModel::setClient(KeeperClient* client)
+{
+    if (client_ == client)
+        return;
+
+    if (client_)
+        client_->disconnect(this);
+
+    client_ = client;
+    if (client_)
+    {
+        connect(client_.data(), &KeeperClient::taskStatesChanged, this, &TaskModel::applyChanges);
+        reset(client_->taskStates());
+    }
+    else
+    {
+        reset(keeper::Items());
+    }
+
+    Q_EMIT clientChanged();
+}
+
+int TaskModel::rowCount(QModelIndex const & parent) const
+{
+    return parent.isValid() ? 0 : uuids_.size();
+}
+
+QVariant TaskModel::data(QModelIndex const & index, int role) const
+{
+    if (!index.isValid() || index.row() >= uuids_.size())
+        return QVariant();
+
+    auto const & uuid = uuids_[index.row()];
+    auto const & item = states_[uuid];
+    switch (role)
+    {
+        case UuidRole:
+            return uuid;
+        case DisplayNameRole:
+            return item.get_display_name();
+        case StatusRole:
+            return item.get_status();
+        case PercentDoneRole:
+            return item.get_percent_done();
+        case SpeedRole:
+            return item.get_property_value(keeper::Item::SPEED_KEY).toInt();
+        case ErrorRole:
+            return int(item.get_error());
+        default:
+            return QVariant();
+    }
+}
+
+QHash<int, QByteArray> TaskModel::roleNames() const
+{
+    return QHash<int, QByteArray>{
+        {UuidRole, "uuid"},
+        {DisplayNameRole, "displayName"},
+        {StatusRole, "status"},
+        {PercentDoneRole, "percentDone"},
+        {SpeedRole, "speed"},
+        {ErrorRole, "error"}
+    };
+}
+
+void TaskModel::applyChanges(keeper::Items const & changed)
+{
+    QVector<QString> added;
+    for (auto iter = changed.begin(); iter != changed.end(); ++iter)
+    {
+        auto const & uuid = iter.key();
+        auto const row = rows_.value(uuid, -1);
+
+        if (iter->isEmpty())
+        {
+            if (row != -1)
+            {
+                beginRemoveRows(QModelIndex(), row, row);
+                uuids_.remove(row);
+                states_.remove(uuid);
+                pending_.remove(uuid);
+                rows_.remove(uuid);
+                for (int i = row; i < uuids_.size(); ++i)
+                    rows_[uuids_[i]] = i;
+                endRemoveRows();
+            }
+            continue;
+        }
+
+        if (row == -1 && !added.contains(uuid))
+            added << uuid;
+
+        // the properties the service unset are listed
+        // under a marker, like KeeperClient merges them
+        auto & item = states_[uuid];
+        QStringList properties;
+        for (auto field = iter->begin(); field != iter->end(); ++field)
+        {
+            if (field.key() == keeper::Item::REMOVED_PROPERTIES_KEY)
+            {
+                for (auto const & removed : field.value().toStringList())
+                {
+                    item.remove(removed);
+                    properties << removed;
+                }
+                continue;
+            }
+            item.insert(field.key(), field.value());
+            properties << field.key();
+        }
+
+        if (row != -1)
+        {
+            for (auto const & property : properties)
+            {
+                auto const role = propertyRole(property);
+                if (role != -1)
+                    pending_[uuid].insert(role);
+            }
+        }
+    }
+
+    if (!added.isEmpty())
+    {
+        beginInsertRows(QModelIndex(), uuids_.size(), uuids_.size() + added.size() - 1);
+        for (auto const & uuid : added)
+        {
+            rows_[uuid] = uuids_.size();
+            uuids_ << uuid;
+        }
+        endInsertRows();
+    }
+
+    if (!pending_.isEmpty() && !flush_timer_.isActive())
+        flush_timer_.start();
+}
+
+void TaskModel::flush()
+{
+    flush_timer_.stop();
+
+    auto const pending = pending_;
+    pending_.clear();
+    for (auto iter = pending.begin(); iter != pending.end(); ++iter)
+    {
+        auto const row = rows_.value(iter.key(), -1);
+        if (row == -1)
+            continue;
+
+        auto const idx = index(row);
+        Q_EMIT dataChanged(idx, idx, iter->toList().toVector());
+    }
+}
+
+int TaskModel::propertyRole(QString const & property)
+{
+    if (property == keeper::Item::DISPLAY_NAME_KEY)
+        return DisplayNameRole;
+    if (property == keeper::Item::STATUS_KEY)
+        return StatusRole;
+    if (property == keeper::Item::PERCENT_DONE_KEY)
+        return PercentDoneRole;
+    if (property == keeper::Item::SPEED_KEY)
+        return SpeedRole;
+    if (property == keeper::Item::ERROR_KEY)
+        return ErrorRole;
+    return -1;
+}
+
+void TaskModel::reset(keeper::Items const & states)
+{
+    beginResetModel();
+    flush_timer_.stop();
+    pending_.clear();
+    states_ = states;
+    uuids_.clear();
+    rows_.clear();
+    for (auto iter = states_.begin(); iter != states_.end(); ++iter)
+    {
+        rows_[iter.key()] = uuids_.size();
+        uuids_ << iter.key();
+    }
+    endResetModel();
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#pragma once
+
+#include <client.h>
+
+#include <QAbstractListModel>
+#include <QHash>
+#include <QPointer>
+#include <QSet>
+#include <QTimer>
+#include <QVector>
+
+/**
+ * The tasks of a KeeperClient as a list model.
+ *
+ * It is driven by the task properties that change, not by the whole state:
+ * a change only touches the roles it carries. Progress changes of many
+ * tasks are coalesced and emitted once per frame, so views don't redraw
+ * more often than they can show.
+ */
+class TaskModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(TaskModel)
+
+public:
+    enum Roles
+    {
+        UuidRole = Qt::UserRole + 1,
+        DisplayNameRole,
+        StatusRole,
+        PercentDoneRole,
+        SpeedRole,
+        ErrorRole
+    };
+    Q_ENUM(Roles)
+
+    explicit TaskModel(QObject* parent = nullptr);
+    ~TaskModel();
+
+    Q_PROPERTY(KeeperClient* client READ client WRITE setClient NOTIFY clientChanged)
+    KeeperClient* client() const;
+    void setClient(KeeperClient* client);
+
+    int rowCount(QModelIndex const & parent = QModelIndex()) const override;
+    QVariant data(QModelIndex const & index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    // applies the task properties that changed.
+    // Tasks mapped to an empty item are removed
+    void applyChanges(keeper::Items const & changed);
+
+    // emits the pending dataChanged right away
+    void flush();
+
+    static constexpr int UPDATE_INTERVAL_MSEC {16};
+
+Q_SIGNALS:
+    void clientChanged();
+
+private:
+    static int propertyRole(QString const & property);
+    void reset(keeper::Items const & states);
+
+    QPointer<KeeperClient> client_;
+    QVector<QString> uuids_;
+    QHash<QString, int> rows_;
+    keeper::Items states_;
+    // the roles changed per task since the last flush
+    QHash<QString, QSet<int>> pending_;
+    QTimer flush_timer_;
+};
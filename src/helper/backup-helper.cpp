@@ -19,6 +19,8 @@
  */
 
 #include "util/connection-helper.h"
+#include "util/metrics.h"
+#include "util/tracing.h"
 #include "helper/backup-helper.h"
 #include "service/app-const.h" // HELPER_TYPE
 
@@ -27,6 +29,7 @@
 #include <QLocalSocket>
 #include <QMap>
 #include <QObject>
+#include <QSharedPointer>
 #include <QString>
 #include <QTimer>
 #include <QVector>
@@ -98,6 +101,12 @@ public:
             std::bind(&BackupHelperPrivate::on_data_uploaded, this, std::placeholders::_1)
         ));
 
+        // uploaders that keep sending the data after we wrote it are not inactive
+        connections_.remember(QObject::connect(
+            uploader_.get(), &Uploader::upload_progress,
+            std::bind(&BackupHelperPrivate::on_upload_progress, this)
+        ));
+
         // TODO xavi is going to remove this line
         q_ptr->Helper::on_helper_started();
 
@@ -134,18 +143,24 @@ public:
 
             case Helper::State::DATA_COMPLETE: {
                 qDebug() << "Backup helper finished, calling uploader_.commit()";
+                QSharedPointer<util::TraceSpan> span(new util::TraceSpan(QStringLiteral("commit")));
                 connections_.connect_oneshot(
                     uploader_.get(),
                     &Uploader::commit_finished,
-                    std::function<void(bool)>{[this](bool success){
+                    std::function<void(bool)>{[this, span](bool success){
                         qDebug() << "Commit finished";
+                        span->set_arg(QStringLiteral("success"), success);
+                        span->end();
                         if (!success)
                         {
                             write_error_ = true;
                             Q_EMIT(q_ptr->error(keeper::Error::COMMITTING_DATA));
                         }
                         else
+                        {
                             uploader_committed_file_name_ = uploader_->file_name();
+                            uploader_committed_part_file_names_ = uploader_->part_file_names();
+                        }
                         uploader_.reset();
                         check_for_done();
                     }}
@@ -167,11 +182,21 @@ public:
         check_for_done();
     }
 
+    void hold()
+    {
+        stop_inactivity_timer();
+    }
+
     QString get_uploader_committed_file_name() const
     {
         return uploader_committed_file_name_;
     }
 
+    QStringList get_uploader_committed_part_file_names() const
+    {
+        return uploader_committed_part_file_names_;
+    }
+
 private:
 
     void on_inactivity_detected()
@@ -187,10 +212,18 @@ private:
         process_more();
     }
 
+    void on_upload_progress()
+    {
+        // once all the data is sent the commit reports its own errors
+        if (q_ptr->state() == Helper::State::STARTED)
+            reset_inactivity_timer();
+    }
+
     void on_data_uploaded(qint64 n)
     {
         n_uploaded_ += n;
         q_ptr->record_data_transferred(n);
+        util::Metrics::add(util::METRIC_BACKUP_BYTES, n);
         process_more();
         check_for_done();
     }
@@ -237,6 +270,7 @@ private:
             }
         }
 
+        relay_metrics_.update(upload_buffer_.size() + socket->bytesToWrite(), UPLOAD_BUFFER_MAX_);
         reset_inactivity_timer();
     }
 
@@ -297,6 +331,7 @@ private:
     QLocalSocket helper_socket_;
     QLocalSocket read_socket_;
     QByteArray upload_buffer_;
+    util::RelayMetrics relay_metrics_ {QStringLiteral("backup")};
     qint64 n_read_ = 0;
     qint64 n_uploaded_ = 0;
     bool read_error_ = false;
@@ -304,6 +339,7 @@ private:
     bool cancelled_ = false;
     ConnectionHelper connections_;
     QString uploader_committed_file_name_;
+    QStringList uploader_committed_part_file_names_;
 };
 
 /***
@@ -338,6 +374,14 @@ BackupHelper::stop()
     d->stop();
 }
 
+void
+BackupHelper::hold()
+{
+    Q_D(BackupHelper);
+
+    d->hold();
+}
+
 void
 BackupHelper::set_uploader(std::shared_ptr<Uploader> const &uploader)
 {
@@ -385,3 +429,10 @@ QString BackupHelper::get_uploader_committed_file_name() const
 
     return d->get_uploader_committed_file_name();
 }
+
+QStringList BackupHelper::get_uploader_committed_part_file_names() const
+{
+    Q_D(const BackupHelper);
+
+    return d->get_uploader_committed_part_file_names();
+}
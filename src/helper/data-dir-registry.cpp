@@ -88,13 +88,15 @@ private:
     // replace "${key}" with task.get_property("key")
     QStringList perform_url_substitution(Metadata const& task, QStringList const& urls_in)
     {
-        std::array<QString,6> keys = {
+        std::array<QString,8> keys = {
             keeper::Item::TYPE_KEY,
             keeper::Item::SUBTYPE_KEY,
             keeper::Item::NAME_KEY,
             keeper::Item::PACKAGE_KEY,
             keeper::Item::TITLE_KEY,
-            keeper::Item::VERSION_KEY
+            keeper::Item::VERSION_KEY,
+            Metadata::HELPER_BUS_PATH_KEY,
+            Metadata::TRACE_ID_KEY
         };
 
         QStringList urls {urls_in};
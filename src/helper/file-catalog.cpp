@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include "helper/file-catalog.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QFileInfo>
+#include <QRegExp>
+
+namespace
+{
+    constexpr quint32 CATALOG_MAGIC {0x6b666374}; // "kfct"
+    constexpr quint32 CATALOG_VERSION {1};
+}
+
+///
+///
+
+FileCatalog::FileCatalog() = default;
+
+FileCatalog::~FileCatalog() = default;
+
+void
+FileCatalog::add(Entry const & entry)
+{
+    entries_.push_back(entry);
+}
+
+QVector<FileCatalog::Entry>
+FileCatalog::entries() const
+{
+    return entries_;
+}
+
+bool
+FileCatalog::is_empty() const
+{
+    return entries_.isEmpty();
+}
+
+QVector<FileCatalog::Entry>
+FileCatalog::find(QString const & pattern) const
+{
+    if (pattern.isEmpty())
+        return entries_;
+
+    QVector<Entry> ret;
+    if (pattern.contains(QLatin1Char('*')) || pattern.contains(QLatin1Char('?')))
+    {
+        QRegExp wildcard(pattern, Qt::CaseInsensitive, QRegExp::WildcardUnix);
+        for (auto const & entry : entries_)
+        {
+            if (wildcard.exactMatch(entry.path) || wildcard.exactMatch(QFileInfo(entry.path).fileName()))
+                ret.push_back(entry);
+        }
+    }
+    else
+    {
+        for (auto const & entry : entries_)
+        {
+            if (entry.path.contains(pattern, Qt::CaseInsensitive))
+                ret.push_back(entry);
+        }
+    }
+    return ret;
+}
+
+QByteArray
+FileCatalog::to_data() const
+{
+    QByteArray raw;
+    QDataStream out(&raw, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << CATALOG_MAGIC << CATALOG_VERSION << quint32(entries_.size());
+    for (auto const & entry : entries_)
+        out << entry.path << entry.size << entry.mtime << entry.hash << entry.offset;
+
+    // paths share long prefixes, so they compress well
+    return qCompress(raw);
+}
+
+FileCatalog
+FileCatalog::from_data(QByteArray const & data, bool * ok)
+{
+    FileCatalog ret;
+    if (ok)
+        *ok = false;
+
+    auto const raw = qUncompress(data);
+    if (raw.isEmpty())
+    {
+        qWarning() << "Error uncompressing the file catalog";
+        return ret;
+    }
+
+    QDataStream in(raw);
+    in.setVersion(QDataStream::Qt_5_0);
+    quint32 magic {0}, version {0}, n_entries {0};
+    in >> magic >> version >> n_entries;
+    if (magic != CATALOG_MAGIC || version != CATALOG_VERSION)
+    {
+        qWarning() << "Unknown file catalog format" << magic << version;
+        return ret;
+    }
+
+    for (quint32 i = 0; i < n_entries && in.status() == QDataStream::Ok; ++i)
+    {
+        Entry entry;
+        in >> entry.path >> entry.size >> entry.mtime >> entry.hash >> entry.offset;
+        if (in.status() == QDataStream::Ok)
+            ret.entries_.push_back(entry);
+    }
+
+    if (in.status() != QDataStream::Ok)
+    {
+        qWarning() << "The file catalog ended after" << ret.entries_.size() << "of" << n_entries << "entries";
+        ret.entries_.clear();
+        return ret;
+    }
+
+    if (ok)
+        *ok = true;
+    return ret;
+}
@@ -19,14 +19,20 @@
 
 #include <helper/helper.h>
 
-#include <ubuntu-app-launch/registry.h>
 #include <service/app-const.h>
+#include <util/logging.h>
+#include <util/metrics.h>
+#include <util/tracing.h>
 #include <ubuntu-app-launch.h>
 
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QTimer>
 
 #include <cmath> // std::fabs()
+#include <memory>
+#include <string>
+#include <vector>
 #include <sys/time.h> // gettimeofday()
 
 
@@ -144,7 +150,6 @@ public:
         , sized_{}
         , expected_size_{}
         , history_{}
-        , registry_(new ubuntu::app_launch::Registry())
     {
         ual_init();
         QObject::connect(&timer_wait_ual_, &QTimer::timeout,
@@ -163,7 +168,7 @@ public:
     {
         if (state_ != state)
         {
-            qDebug() << "changing state of helper" << static_cast<void*>(this) << "from" << q_ptr->to_string(state_) << "to" << q_ptr->to_string(state);
+            qCDebug(util::logState) << "changing state of helper" << static_cast<void*>(this) << "from" << q_ptr->to_string(state_) << "to" << q_ptr->to_string(state);
             state_ = state;
             QMetaObject::invokeMethod(q_ptr,
                                       "state_changed",
@@ -240,6 +245,13 @@ public:
 
     void on_helper_started()
     {
+        launch_span_.reset();
+        if (launch_timer_.isValid())
+        {
+            util::Metrics::observe(util::METRIC_HELPER_LAUNCH, launch_timer_.nsecsElapsed() / 1e9);
+            launch_timer_.invalidate();
+        }
+        run_span_.reset(new util::TraceSpan(QStringLiteral("helper run"), {{QStringLiteral("appid"), appid_}}));
         stop_wait_for_ual_timer();
         q_ptr->set_state(Helper::State::STARTED);
         is_helper_running_ = true;
@@ -247,6 +259,7 @@ public:
 
     void on_helper_finished()
     {
+        run_span_.reset();
         is_helper_running_ = false;
     }
 
@@ -279,50 +292,62 @@ private:
     {
         qDebug() << "Starting helper for app:" << appid_;
 
-        std::vector<ubuntu::app_launch::Helper::URL> urls;
+        std::vector<std::string> urls;
         for(const auto& url_string : url_strings) {
             qDebug() << "url" << url_string;
-            urls.push_back(ubuntu::app_launch::Helper::URL::from_raw(url_string.toStdString()));
+            urls.push_back(url_string.toStdString());
         }
-
-        auto backupType = ubuntu::app_launch::Helper::Type::from_raw(HELPER_TYPE);
-
-        auto appid = ubuntu::app_launch::AppID::parse(appid_.toStdString());
-        auto helper = ubuntu::app_launch::Helper::create(backupType, appid, registry_);
+        std::vector<const gchar*> c_urls;
+        for(const auto& url : urls)
+            c_urls.push_back(url.c_str());
+        c_urls.push_back(nullptr);
 
         reset_wait_for_ual_timer();
-        helper->launch(urls);
+        launch_span_.reset(new util::TraceSpan(QStringLiteral("helper launch"), {{QStringLiteral("appid"), appid_}}));
+        launch_timer_.start();
+
+        // every launch gets its own instance id, so several helpers
+        // of the same app id can run and be stopped independently
+        auto instance = ubuntu_app_launch_start_multiple_helper(HELPER_TYPE, appid_.toUtf8().constData(), c_urls.data());
+        ual_instance_ = instance ? instance : "";
+        g_free(instance);
+        if (ual_instance_.empty())
+            qWarning() << "UAL did not start the helper for app:" << appid_;
     }
 
     void ual_stop()
     {
-        qDebug() << "Stopping helper for app:" << appid_;
-        auto backupType = ubuntu::app_launch::Helper::Type::from_raw(HELPER_TYPE);
-
-        auto appid = ubuntu::app_launch::AppID::parse(appid_.toStdString());
-        auto helper = ubuntu::app_launch::Helper::create(backupType, appid, registry_);
-
-        auto instances = helper->instances();
+        qDebug() << "Stopping helper for app:" << appid_ << "instance:" << ual_instance_.c_str();
+        if (ual_instance_.empty())
+            return;
 
-        if (instances.size() > 0 )
-        {
-            qDebug() << "We have instances";
-            instances[0]->stop();
-        }
+        if (!ubuntu_app_launch_stop_multiple_helper(HELPER_TYPE, appid_.toUtf8().constData(), ual_instance_.c_str()))
+            qWarning() << "UAL failed to stop the helper for app:" << appid_ << "instance:" << ual_instance_.c_str();
     }
 
-    static void on_helper_started(const char* appid, const char* /*instance*/, const char* /*type*/, void* vself)
+    static void on_helper_started(const char* appid, const char* instance, const char* /*type*/, void* vself)
     {
         qDebug() << "HELPER STARTED +++++++++++++++++++++++++++++++++++++" << appid;
         auto self = static_cast<HelperPrivate*>(vself);
-        self->q_ptr->on_helper_started();
+        if (self->is_own_ual_instance(appid, instance) && self->timer_wait_ual_.isActive())
+            self->q_ptr->on_helper_started();
     }
 
-    static void on_helper_stopped(const char* appid, const char* /*instance*/, const char* /*type*/, void* vself)
+    static void on_helper_stopped(const char* appid, const char* instance, const char* /*type*/, void* vself)
     {
         qDebug() << "HELPER STOPPED +++++++++++++++++++++++++++++++++++++" << appid;
         auto self = static_cast<HelperPrivate*>(vself);
-        self->q_ptr->on_helper_finished();
+        if (self->is_own_ual_instance(appid, instance) && self->is_helper_running_)
+            self->q_ptr->on_helper_finished();
+    }
+
+    // UAL notifies every observer about every helper instance,
+    // so concurrent helpers only react to the instance they launched
+    bool is_own_ual_instance(const char* appid, const char* instance) const
+    {
+        return !ual_instance_.empty()
+            && appid_ == QString::fromUtf8(appid)
+            && ual_instance_ == (instance ? instance : "");
     }
 
     void update_percent_done()
@@ -354,6 +379,10 @@ private:
     void on_max_time_waiting_for_ual_started()
     {
         qWarning() << "Maximum time reached waiting for the helper to start.";
+        if (launch_span_)
+            launch_span_->set_arg(QStringLiteral("timeout"), true);
+        launch_span_.reset();
+        launch_timer_.invalidate();
         Q_EMIT(q_ptr->error(keeper::Error::HELPER_START_TIMEOUT));
         q_ptr->set_state(Helper::State::FAILED);
         stop_wait_for_ual_timer();
@@ -369,9 +398,14 @@ private:
     RateHistory history_;
     float percent_done_ {};
     float last_notified_percent_done_ {};
-    std::shared_ptr<ubuntu::app_launch::Registry> registry_;
     QTimer timer_wait_ual_;
     bool is_helper_running_ = false;
+    std::string ual_instance_;
+    // from the launch request until UAL reports the helper started,
+    // then until it stops
+    std::unique_ptr<util::TraceSpan> launch_span_;
+    std::unique_ptr<util::TraceSpan> run_span_;
+    QElapsedTimer launch_timer_;
 };
 
 /***
@@ -35,6 +35,9 @@ namespace
 ///
 ///
 
+const QString Metadata::HELPER_BUS_PATH_KEY = QStringLiteral("bus-path");
+const QString Metadata::TRACE_ID_KEY = QStringLiteral("trace-id");
+
 Metadata::Metadata()
     : keeper::Item()
 {
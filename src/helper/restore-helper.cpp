@@ -19,6 +19,7 @@
  */
 
 #include "util/connection-helper.h"
+#include "util/metrics.h"
 #include "helper/restore-helper.h"
 #include "service/app-const.h" // HELPER_TYPE
 
@@ -180,6 +181,7 @@ private:
     {
         n_uploaded_ += n;
         q_ptr->record_data_transferred(n);
+        util::Metrics::add(util::METRIC_RESTORE_BYTES, n);
         process_more();
         check_for_done();
     }
@@ -235,6 +237,7 @@ private:
             }
         }
 
+        relay_metrics_.update(upload_buffer_.size() + write_socket_.bytesToWrite(), UPLOAD_BUFFER_MAX_);
         reset_inactivity_timer();
     }
 
@@ -295,6 +298,7 @@ private:
     int helper_socket_ = -1;
     QLocalSocket write_socket_;
     QByteArray upload_buffer_;
+    util::RelayMetrics relay_metrics_ {QStringLiteral("restore")};
     qint64 n_read_ = 0;
     qint64 n_uploaded_ = 0;
     bool read_error_ = false;
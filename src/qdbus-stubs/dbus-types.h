@@ -57,4 +57,8 @@ namespace DBusTypes
     constexpr const char KEEPER_USER_INTERFACE[] = "com.canonical.keeper.User";
 
     constexpr const char KEEPER_USER_PATH[]      = "/com/canonical/keeper/user";
+
+    constexpr const char KEEPER_METRICS_INTERFACE[] = "com.canonical.keeper.Metrics";
+
+    constexpr const char KEEPER_METRICS_PATH[]      = "/com/canonical/keeper/metrics";
 }
@@ -21,33 +21,45 @@
 
 #include <click.h>
 
-#include <uuid/uuid.h>
-
 #include <QDebug>
+#include <QDir>
+#include <QFileInfo>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonValue>
 #include <QStandardPaths>
 #include <QString>
+#include <QUuid>
 
+#include <algorithm> // std::any_of
 #include <array>
 
 namespace
 {
-    QString generate_new_uuid()
-    {
-        uuid_t keyuu;
-        uuid_generate(keyuu);
-        char keybuf[37];
-        uuid_unparse(keyuu, keybuf);
-        return QString::fromUtf8(keybuf);
-    }
+    // namespace of the name-based uuids of the backup choices
+    QUuid const CHOICES_UUID_NAMESPACE {QStringLiteral("{6c3f2a9e-4b1d-5e8a-9f07-2d6b1c4e8a35}")};
+
+    constexpr const char USER_DIRS_FILE_NAME[] = "user-dirs.dirs";
 }
 
 BackupChoices::BackupChoices(QObject *parent)
     : MetadataProvider(parent)
 {
+    QObject::connect(&watcher_, &QFileSystemWatcher::fileChanged,
+        std::bind(&BackupChoices::on_path_changed, this, std::placeholders::_1)
+    );
+    QObject::connect(&watcher_, &QFileSystemWatcher::directoryChanged,
+        std::bind(&BackupChoices::on_path_changed, this, std::placeholders::_1)
+    );
+
+    // the listed choices don't have the new estimate yet
+    QObject::connect(&size_estimator_, &SizeEstimator::estimate_changed,
+        this, &MetadataProvider::choices_changed
+    );
+
+    // start estimating the folder sizes before anyone asks for them
+    read_folder_choices();
 }
 
 BackupChoices::~BackupChoices() =default;
@@ -58,22 +70,79 @@ BackupChoices::get_backups() const
     return backups_;
 }
 
+QString
+BackupChoices::choice_uuid(QString const & type, QString const & path, QString const & package)
+{
+    auto const name = QStringLiteral("%1\n%2\n%3").arg(type).arg(path).arg(package);
+    return QUuid::createUuidV5(CHOICES_UUID_NAMESPACE, name).toString().mid(1, 36);
+}
+
 void
 BackupChoices::get_backups_async(QString const & /*storage*/)
 {
+    if (click_choices_dirty_)
+        read_click_choices();
+    if (folder_choices_dirty_)
+        read_folder_choices();
+
     backups_.clear();
     //
     //  System Data
     //
     {
-        Metadata m(generate_new_uuid(), "System Data"); // FIXME: how to i18n in a Qt DBus service?
+        Metadata m(choice_uuid(Metadata::SYSTEM_DATA_VALUE, QString()), "System Data"); // FIXME: how to i18n in a Qt DBus service?
         m.set_property_value(Metadata::TYPE_KEY, Metadata::SYSTEM_DATA_VALUE);
         backups_.push_back(m);
     }
+    backups_ += click_choices_;
+    for (auto choice : folder_choices_)
+    {
+        auto const estimate = size_estimator_.estimate(choice.get_property_value(Metadata::SUBTYPE_KEY).toString());
+        if (estimate.complete)
+        {
+            choice.set_property_value(Metadata::SIZE_ESTIMATE_KEY, estimate.n_bytes);
+            choice.set_property_value(Metadata::FILE_COUNT_KEY, estimate.n_files);
+        }
+        backups_.push_back(choice);
+    }
 
-    //
-    //  Click Packages
-    //
+    Q_EMIT(finished(keeper::Error::OK));
+}
+
+void
+BackupChoices::on_path_changed(QString const & path)
+{
+    if (click_paths_.contains(path))
+    {
+        qDebug() << "Click packages changed in" << path;
+        click_choices_dirty_ = true;
+    }
+    if (folder_paths_.contains(path))
+    {
+        qDebug() << "XDG user dirs changed in" << path;
+        folder_choices_dirty_ = true;
+    }
+    Q_EMIT(choices_changed());
+}
+
+bool
+BackupChoices::watch(QStringList const & paths)
+{
+    // files replaced by a rename are no longer watched, so they are added again
+    auto watched = watcher_.files() + watcher_.directories();
+    for (auto const & path : paths)
+    {
+        if (!watched.contains(path) && QFileInfo::exists(path) && watcher_.addPath(path))
+            watched << path;
+    }
+    return std::any_of(paths.begin(), paths.end(), [&watched](QString const & path){return watched.contains(path);});
+}
+
+void
+BackupChoices::read_click_choices()
+{
+    click_choices_.clear();
+    click_paths_.clear();
 
     QString manifests_str;
     GError* error {};
@@ -83,6 +152,15 @@ BackupChoices::get_backups_async(QString const & /*storage*/)
         auto tmp = click_user_get_manifests_as_string (user, &error);
         manifests_str = QString::fromUtf8(tmp);
         g_clear_pointer(&tmp, g_free);
+
+        // packages are registered for the user, or for all of them,
+        // as links in the users directory of the overlay database
+        auto overlay_db = click_user_get_overlay_db(user);
+        auto const users_dir = QDir(QString::fromUtf8(overlay_db)).filePath(QStringLiteral(".click/users"));
+        g_clear_pointer(&overlay_db, g_free);
+        click_paths_ << QDir(users_dir).filePath(QString::fromUtf8(g_get_user_name()))
+                     << QDir(users_dir).filePath(QStringLiteral("@all"));
+
         g_clear_object(&user);
     }
     if (error != nullptr)
@@ -92,7 +170,6 @@ BackupChoices::get_backups_async(QString const & /*storage*/)
     }
 
     auto loadDoc = QJsonDocument::fromJson(manifests_str.toUtf8());
-    auto tmp = loadDoc.toJson();
     if (loadDoc.isArray())
     {
         auto manifests = loadDoc.array();
@@ -119,18 +196,28 @@ BackupChoices::get_backups_async(QString const & /*storage*/)
                 if (version != QJsonValue::Undefined)
                     display_name = QStringLiteral("%1 (%2)").arg(display_name).arg(version.toString());
 
-                Metadata m(generate_new_uuid(), display_name);
+                Metadata m(choice_uuid(Metadata::APPLICATION_VALUE, QString(), name.toString()), display_name);
                 m.set_property_value(Metadata::PACKAGE_KEY, name.toString());
                 m.set_property_value(Metadata::TYPE_KEY, Metadata::APPLICATION_VALUE);
 
                 if (version != QJsonValue::Undefined)
                     m.set_property_value(Metadata::VERSION_KEY, version.toString());
 
-                backups_.push_back(m);
+                click_choices_.push_back(m);
             }
         }
     }
 
+    // without anything to watch the packages are read every time
+    click_choices_dirty_ = !watch(click_paths_);
+}
+
+void
+BackupChoices::read_folder_choices()
+{
+    folder_choices_.clear();
+    QStringList folder_locations;
+
     //
     //  XDG User Directories
     //
@@ -152,13 +239,18 @@ BackupChoices::get_backups_async(QString const & /*storage*/)
         }
         else
         {
-            const auto keystr = generate_new_uuid();
-            Metadata m(keystr, name);
+            Metadata m(choice_uuid(Metadata::FOLDER_VALUE, locations.front()), name);
             m.set_property_value(Metadata::TYPE_KEY, Metadata::FOLDER_VALUE);
             m.set_property_value(Metadata::SUBTYPE_KEY, locations.front());
-            backups_.push_back(m);
+            folder_choices_.push_back(m);
+            folder_locations << locations.front();
         }
     }
+    size_estimator_.set_paths(folder_locations);
 
-    Q_EMIT(finished(keeper::Error::OK));
+    // the user dirs are set in user-dirs.dirs.
+    // Without it the folders are read every time
+    auto const config_dir = QStandardPaths::writableLocation(QStandardPaths::GenericConfigLocation);
+    folder_paths_ = QStringList{QDir(config_dir).filePath(USER_DIRS_FILE_NAME)};
+    folder_choices_dirty_ = !watch(folder_paths_);
 }
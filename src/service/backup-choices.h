@@ -20,9 +20,18 @@
 #pragma once
 
 #include "service/metadata-provider.h"
+#include "service/size-estimator.h"
+
+#include <QFileSystemWatcher>
 
 /**
  * A MetadataProvider that lists the backups that can be created
+ *
+ * The uuid of every choice is derived from its type, path and package,
+ * so it is the same every time the choices are listed.
+ * The click database and the XDG user dirs configuration are watched,
+ * and only the choices read from the ones that changed are read again.
+ * Folder choices carry the size estimated in the background, once known.
  */
 class BackupChoices: public MetadataProvider
 {
@@ -31,4 +40,22 @@ public:
     virtual ~BackupChoices();
     QVector<Metadata> get_backups() const override;
     void get_backups_async(QString const & storage = "") override;
+
+    static QString choice_uuid(QString const & type, QString const & path, QString const & package = QString());
+
+private:
+    void on_path_changed(QString const & path);
+    void read_click_choices();
+    void read_folder_choices();
+    // returns true if any of the paths is watched
+    bool watch(QStringList const & paths);
+
+    QFileSystemWatcher watcher_;
+    QStringList click_paths_;
+    QStringList folder_paths_;
+    bool click_choices_dirty_ {true};
+    bool folder_choices_dirty_ {true};
+    QVector<Metadata> click_choices_;
+    QVector<Metadata> folder_choices_;
+    SizeEstimator size_estimator_;
 };
@@ -0,0 +1,273 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include "binary-manifest.h"
+
+#include <QDebug>
+#include <QHash>
+#include <QPair>
+#include <QtEndian>
+
+#include <cstring> // memcmp()
+
+namespace
+{
+    constexpr const char MAGIC[] = "KMAN";
+    constexpr int MAGIC_SIZE {4};
+
+    // magic, version, header size and the three counters
+    constexpr int HEADER_SIZE {MAGIC_SIZE + 2 + 2 + 3 * 4};
+
+    // {offset, size}, {first, count} and {key, value} pairs
+    constexpr int RECORD_SIZE {8};
+
+    void append_u16(QByteArray & data, quint16 value)
+    {
+        uchar buf[2];
+        qToLittleEndian(value, buf);
+        data.append(reinterpret_cast<char const *>(buf), sizeof(buf));
+    }
+
+    void append_u32(QByteArray & data, quint32 value)
+    {
+        uchar buf[4];
+        qToLittleEndian(value, buf);
+        data.append(reinterpret_cast<char const *>(buf), sizeof(buf));
+    }
+}
+
+BinaryManifest::BinaryManifest() = default;
+
+BinaryManifest::~BinaryManifest() = default;
+
+bool
+BinaryManifest::is_binary(QByteArray const & data)
+{
+    return data.size() >= MAGIC_SIZE && !memcmp(data.constData(), MAGIC, MAGIC_SIZE);
+}
+
+bool
+BinaryManifest::load(QByteArray const & data)
+{
+    clear();
+
+    if (!is_binary(data) || data.size() < HEADER_SIZE)
+        return false;
+
+    auto const raw = reinterpret_cast<uchar const *>(data.constData());
+    auto const version = qFromLittleEndian<quint16>(raw + MAGIC_SIZE);
+    auto const header_size = qFromLittleEndian<quint16>(raw + MAGIC_SIZE + 2);
+    if (version > VERSION || header_size < HEADER_SIZE)
+    {
+        qWarning() << "Unsupported binary manifest version" << version << "with a header of" << header_size << "bytes";
+        return false;
+    }
+
+    auto const n_strings = qFromLittleEndian<quint32>(raw + MAGIC_SIZE + 4);
+    auto const n_entries = qFromLittleEndian<quint32>(raw + MAGIC_SIZE + 8);
+    auto const n_properties = qFromLittleEndian<quint32>(raw + MAGIC_SIZE + 12);
+
+    // 64 bits, so corrupt counters can't overflow
+    auto const tables_size = (quint64(n_strings) + n_entries + n_properties) * RECORD_SIZE;
+    if (header_size + tables_size > quint64(data.size()))
+    {
+        qWarning() << "The binary manifest tables don't fit in" << data.size() << "bytes";
+        return false;
+    }
+
+    data_ = data;
+    n_strings_ = n_strings;
+    n_entries_ = n_entries;
+    n_properties_ = n_properties;
+    strings_offset_ = header_size;
+    entries_offset_ = strings_offset_ + int(n_strings) * RECORD_SIZE;
+    properties_offset_ = entries_offset_ + int(n_entries) * RECORD_SIZE;
+    string_data_offset_ = properties_offset_ + int(n_properties) * RECORD_SIZE;
+
+    // check the references once, so accessing the data needs no checks
+    auto const string_data_size = quint64(data_.size() - string_data_offset_);
+    bool valid = true;
+    for (quint32 i = 0; valid && i < n_strings_; ++i)
+    {
+        auto const record = strings_offset_ + int(i) * RECORD_SIZE;
+        valid = quint64(read_u32(record)) + read_u32(record + 4) <= string_data_size;
+    }
+    for (quint32 i = 0; valid && i < n_entries_; ++i)
+    {
+        auto const record = entries_offset_ + int(i) * RECORD_SIZE;
+        valid = quint64(read_u32(record)) + read_u32(record + 4) <= n_properties_;
+    }
+    for (quint32 i = 0; valid && i < n_properties_; ++i)
+    {
+        auto const record = properties_offset_ + int(i) * RECORD_SIZE;
+        valid = read_u32(record) < n_strings_ && read_u32(record + 4) < n_strings_;
+    }
+
+    if (!valid)
+    {
+        qWarning() << "The binary manifest has references out of its tables";
+        clear();
+    }
+
+    return valid;
+}
+
+bool
+BinaryManifest::is_empty() const
+{
+    return data_.isEmpty();
+}
+
+void
+BinaryManifest::clear()
+{
+    data_.clear();
+    n_strings_ = n_entries_ = n_properties_ = 0;
+    strings_offset_ = entries_offset_ = properties_offset_ = string_data_offset_ = 0;
+}
+
+int
+BinaryManifest::size() const
+{
+    return int(n_entries_);
+}
+
+QString
+BinaryManifest::value(int entry, QString const & key) const
+{
+    if (entry < 0 || quint32(entry) >= n_entries_)
+        return QString();
+
+    // keys are compared as UTF-8, so only the value found is decoded
+    auto const key_utf8 = key.toUtf8();
+    auto const record = entries_offset_ + entry * RECORD_SIZE;
+    auto const first = read_u32(record);
+    auto const count = read_u32(record + 4);
+    for (auto property = first; property < first + count; ++property)
+    {
+        auto const property_record = properties_offset_ + int(property) * RECORD_SIZE;
+        auto const key_record = strings_offset_ + int(read_u32(property_record)) * RECORD_SIZE;
+        auto const key_size = read_u32(key_record + 4);
+        if (key_size == quint32(key_utf8.size())
+            && !memcmp(data_.constData() + string_data_offset_ + read_u32(key_record), key_utf8.constData(), key_size))
+        {
+            return string_at(read_u32(property_record + 4));
+        }
+    }
+
+    return QString();
+}
+
+Metadata
+BinaryManifest::entry(int entry) const
+{
+    Metadata ret;
+    if (entry < 0 || quint32(entry) >= n_entries_)
+        return ret;
+
+    auto const record = entries_offset_ + entry * RECORD_SIZE;
+    auto const first = read_u32(record);
+    auto const count = read_u32(record + 4);
+    for (auto property = first; property < first + count; ++property)
+    {
+        auto const property_record = properties_offset_ + int(property) * RECORD_SIZE;
+        ret.insert(string_at(read_u32(property_record)), string_at(read_u32(property_record + 4)));
+    }
+
+    return ret;
+}
+
+QVector<Metadata>
+BinaryManifest::entries() const
+{
+    QVector<Metadata> ret;
+    ret.reserve(size());
+    for (int i = 0; i < size(); ++i)
+        ret.push_back(entry(i));
+    return ret;
+}
+
+QByteArray
+BinaryManifest::encode(QVector<Metadata> const & entries)
+{
+    // intern the strings
+    QHash<QString, quint32> string_index;
+    QVector<QByteArray> strings;
+    auto intern = [&string_index, &strings](QString const & str) {
+        auto it = string_index.constFind(str);
+        if (it != string_index.constEnd())
+            return it.value();
+        auto const index = quint32(strings.size());
+        string_index.insert(str, index);
+        strings.push_back(str.toUtf8());
+        return index;
+    };
+
+    QVector<QPair<quint32, quint32>> properties;
+    QVector<QPair<quint32, quint32>> entry_records;
+    for (auto const & entry : entries)
+    {
+        entry_records.push_back(qMakePair(quint32(properties.size()), quint32(entry.size())));
+        for (auto it = entry.begin(); it != entry.end(); ++it)
+            properties.push_back(qMakePair(intern(it.key()), intern(it.value().toString())));
+    }
+
+    QByteArray ret;
+    ret.append(MAGIC, MAGIC_SIZE);
+    append_u16(ret, VERSION);
+    append_u16(ret, HEADER_SIZE);
+    append_u32(ret, quint32(strings.size()));
+    append_u32(ret, quint32(entry_records.size()));
+    append_u32(ret, quint32(properties.size()));
+
+    quint32 offset {0};
+    for (auto const & str : strings)
+    {
+        append_u32(ret, offset);
+        append_u32(ret, quint32(str.size()));
+        offset += quint32(str.size());
+    }
+    for (auto const & record : entry_records)
+    {
+        append_u32(ret, record.first);
+        append_u32(ret, record.second);
+    }
+    for (auto const & property : properties)
+    {
+        append_u32(ret, property.first);
+        append_u32(ret, property.second);
+    }
+    for (auto const & str : strings)
+        ret.append(str);
+
+    return ret;
+}
+
+QString
+BinaryManifest::string_at(quint32 index) const
+{
+    auto const record = strings_offset_ + int(index) * RECORD_SIZE;
+    return QString::fromUtf8(data_.constData() + string_data_offset_ + read_u32(record), int(read_u32(record + 4)));
+}
+
+quint32
+BinaryManifest::read_u32(int offset) const
+{
+    return qFromLittleEndian<quint32>(reinterpret_cast<uchar const *>(data_.constData()) + offset);
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#pragma once
+
+#include <helper/metadata.h>
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+/**
+ * Versioned binary encoding of the manifest entries.
+ *
+ * All the integers are little endian and every string is stored once,
+ * so the keys and values shared by the entries don't repeat.
+ * The data is read in place: loading only checks that the tables are
+ * consistent, and strings are decoded when they are accessed.
+ *
+ * Layout:
+ *   header:     magic "KMAN", quint16 version, quint16 header size,
+ *               quint32 number of strings, entries and properties
+ *   strings:    {quint32 offset, quint32 size} per string
+ *   entries:    {quint32 first property, quint32 number of properties} per entry
+ *   properties: {quint32 key string, quint32 value string} per property
+ *   string data (UTF-8)
+ *
+ * Fields added to the header by later versions go after the known ones,
+ * so readers use the header size to find the tables.
+ */
+class BinaryManifest
+{
+public:
+    BinaryManifest();
+    ~BinaryManifest();
+
+    // returns false if data is not a binary manifest this version can read
+    bool load(QByteArray const & data);
+    bool is_empty() const;
+    void clear();
+
+    int size() const;
+
+    // decodes a single property of an entry.
+    // Returns a null string if the entry has no such property
+    QString value(int entry, QString const & key) const;
+
+    // decodes a whole entry
+    Metadata entry(int entry) const;
+    QVector<Metadata> entries() const;
+
+    static bool is_binary(QByteArray const & data);
+    static QByteArray encode(QVector<Metadata> const & entries);
+
+    static constexpr quint16 VERSION {1};
+
+private:
+    QString string_at(quint32 index) const;
+    quint32 read_u32(int offset) const;
+
+    QByteArray data_;
+    quint32 n_strings_ {0};
+    quint32 n_entries_ {0};
+    quint32 n_properties_ {0};
+    int strings_offset_ {0};
+    int entries_offset_ {0};
+    int properties_offset_ {0};
+    int string_data_offset_ {0};
+};
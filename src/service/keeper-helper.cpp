@@ -29,6 +29,10 @@ KeeperHelper::KeeperHelper(Keeper* parent)
     : QObject(parent)
     , keeper_(*parent)
 {
+    // every task has its own helper path so concurrent helpers
+    // can be told apart. They are served by this same object.
+    connect(parent, &Keeper::helper_path_added, this, &KeeperHelper::on_helper_path_added);
+    connect(parent, &Keeper::helper_path_removed, this, &KeeperHelper::on_helper_path_removed);
 }
 
 KeeperHelper::~KeeperHelper() = default;
@@ -51,7 +55,29 @@ QDBusUnixFileDescriptor KeeperHelper::StartRestore()
     return keeper_.StartRestore(bus, msg);
 }
 
+void KeeperHelper::SetFileCatalog(const QDBusUnixFileDescriptor &catalog)
+{
+    Q_ASSERT(calledFromDBus());
+    auto bus = connection();
+    auto& msg = message();
+    keeper_.set_file_catalog(msg.path(), catalog.fileDescriptor(), bus, msg);
+}
+
 void KeeperHelper::UpdateStatus(const QString &app_id, const QString &status, double percentage)
 {
     qDebug() << "KeeperHelper::UpdateStatus(" << app_id << "," << status << "," << percentage << ")";
 }
+
+void KeeperHelper::on_helper_path_added(QString const & helper_path)
+{
+    if (!QDBusConnection::sessionBus().registerObject(helper_path, this))
+    {
+        qWarning() << "Could not register keeper dbus helper object at" << helper_path << ":"
+                   << QDBusConnection::sessionBus().lastError().message();
+    }
+}
+
+void KeeperHelper::on_helper_path_removed(QString const & helper_path)
+{
+    QDBusConnection::sessionBus().unregisterObject(helper_path);
+}
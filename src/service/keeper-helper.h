@@ -35,9 +35,13 @@ public:
 public Q_SLOTS:
     QDBusUnixFileDescriptor StartBackup(quint64 nbytes);
     QDBusUnixFileDescriptor StartRestore();
+    void SetFileCatalog(const QDBusUnixFileDescriptor &catalog);
 
     void UpdateStatus(const QString &app_id, const QString &status, double percentage);
 
 private:
+    void on_helper_path_added(QString const & helper_path);
+    void on_helper_path_removed(QString const & helper_path);
+
     Keeper& keeper_;
 };
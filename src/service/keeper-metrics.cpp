@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include "service/keeper.h"
+#include "service/keeper-metrics.h"
+#include "util/metrics.h"
+
+#include <QDebug>
+
+KeeperMetrics::KeeperMetrics(Keeper* keeper)
+  : QObject(keeper)
+{
+}
+
+KeeperMetrics::~KeeperMetrics() =default;
+
+QVariantDictMap
+KeeperMetrics::GetMetrics()
+{
+    return util::Metrics::snapshot();
+}
+
+QString
+KeeperMetrics::GetPrometheusText()
+{
+    return util::Metrics::to_prometheus();
+}
+
+bool
+KeeperMetrics::WritePrometheusFile()
+{
+    // only the file chosen by whoever started the service can be replaced
+    auto const path = util::Metrics::configured_file();
+    if (path.isEmpty())
+    {
+        qWarning() << "KEEPER_METRICS_FILE is not set, there is no file to write the metrics to";
+        return false;
+    }
+    return util::Metrics::write_prometheus(path);
+}
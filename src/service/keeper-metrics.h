@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#pragma once
+
+#include "qdbus-stubs/dbus-types.h"
+
+#include <QDBusContext>
+#include <QObject>
+#include <QString>
+
+class Keeper;
+
+class KeeperMetrics : public QObject, protected QDBusContext
+{
+    Q_OBJECT
+
+public:
+
+    explicit KeeperMetrics(Keeper* parent);
+    virtual ~KeeperMetrics();
+    Q_DISABLE_COPY(KeeperMetrics)
+
+public Q_SLOTS:
+
+    QVariantDictMap GetMetrics();
+
+    QString GetPrometheusText();
+
+    bool WritePrometheusFile();
+};
@@ -19,6 +19,8 @@
  */
 
 #include "util/connection-helper.h"
+#include "util/tracing.h"
+#include "storage-framework/chunked-uploader.h"
 #include "storage-framework/storage_framework_client.h"
 #include "helper/backup-helper.h"
 #include "service/app-const.h" // DEKKO_APP_ID
@@ -42,7 +44,7 @@ public:
 
     QStringList get_helper_urls() const
     {
-        return helper_registry_->get_backup_helper_urls(task_data_.metadata);
+        return helper_registry_->get_backup_helper_urls(get_helper_metadata());
     }
 
     void init_helper()
@@ -53,7 +55,10 @@ public:
         QObject::connect(helper_.data(), &Helper::error, [this](keeper::Error error){ error_ = error;});
     }
 
-    void ask_for_uploader(quint64 n_bytes, QString const & dir_name)
+    void ask_for_uploader(quint64 n_bytes,
+                          QString const & dir_name,
+                          QStringList const & committed_part_file_names,
+                          QStringList const & committed_part_hashes)
     {
         qDebug() << "asking storage framework for a socket";
 
@@ -61,12 +66,29 @@ public:
 
         const auto file_name = QString("%1.keeper").arg(task_data_.metadata.get_display_name());
 
+        QSharedPointer<util::TraceSpan> span(new util::TraceSpan(QStringLiteral("storage uploader"), {
+            {QStringLiteral("uuid"), task_data_.metadata.get_uuid()},
+            {QStringLiteral("bytes"), n_bytes}
+        }));
         connections_.connect_future(
-            storage_->get_new_uploader(n_bytes, dir_name, file_name),
-            std::function<void(std::shared_ptr<Uploader> const&)>{
-                [this](std::shared_ptr<Uploader> const& uploader){
+            storage_->get_new_chunked_uploader(n_bytes, dir_name, file_name, committed_part_file_names, committed_part_hashes),
+            std::function<void(StorageFrameworkClient::UploaderResult const&)>{
+                [this, span, n_bytes](StorageFrameworkClient::UploaderResult const& result){
+                    span->end();
+                    auto const uploader = result.uploader;
                     auto fd {-1};
                     if (uploader) {
+                        // the journal keeps the stored parts, so an interrupted run doesn't send them again
+                        auto chunked = qobject_cast<ChunkedUploader*>(uploader.get());
+                        if (chunked)
+                        {
+                            QObject::connect(chunked, &ChunkedUploader::part_committed, q_ptr, [this, chunked, n_bytes](){
+                                Q_Q(KeeperTaskBackup);
+                                Q_EMIT(q->task_parts_committed(n_bytes,
+                                                               chunked->committed_part_file_names(),
+                                                               chunked->committed_part_hashes()));
+                            });
+                        }
                         auto backup_helper = qSharedPointerDynamicCast<BackupHelper>(helper_);
                         backup_helper->set_uploader(uploader);
                         fd = backup_helper->get_helper_socket();
@@ -75,7 +97,7 @@ public:
                     }
                     else
                     {
-                        error_ = storage_->get_last_error();
+                        error_ = result.error;
                         qDebug("Emitting task_socket_error(error=%d)", static_cast<int>(error_));
                         Q_EMIT(q_ptr->task_socket_error(error_));
                     }
@@ -84,12 +106,26 @@ public:
         );
     }
 
+    void hold_uploader()
+    {
+        qDebug() << "holding the uploader of" << task_data_.metadata.get_uuid();
+        auto backup_helper = qSharedPointerDynamicCast<BackupHelper>(helper_);
+        if (backup_helper)
+            backup_helper->hold();
+    }
+
     QString get_file_name() const
     {
         auto backup_helper = qSharedPointerDynamicCast<BackupHelper>(helper_);
         return backup_helper->get_uploader_committed_file_name();
     }
 
+    QStringList get_part_file_names() const
+    {
+        auto backup_helper = qSharedPointerDynamicCast<BackupHelper>(helper_);
+        return backup_helper->get_uploader_committed_part_file_names();
+    }
+
 private:
     ConnectionHelper connections_;
     QString file_name_;
@@ -119,11 +155,21 @@ void KeeperTaskBackup::init_helper()
     d->init_helper();
 }
 
-void KeeperTaskBackup::ask_for_uploader(quint64 n_bytes, QString const & dir_name)
+void KeeperTaskBackup::ask_for_uploader(quint64 n_bytes,
+                                        QString const & dir_name,
+                                        QStringList const & committed_part_file_names,
+                                        QStringList const & committed_part_hashes)
+{
+    Q_D(KeeperTaskBackup);
+
+    d->ask_for_uploader(n_bytes, dir_name, committed_part_file_names, committed_part_hashes);
+}
+
+void KeeperTaskBackup::hold_uploader()
 {
     Q_D(KeeperTaskBackup);
 
-    d->ask_for_uploader(n_bytes, dir_name);
+    d->hold_uploader();
 }
 
 QString KeeperTaskBackup::get_file_name() const
@@ -132,3 +178,10 @@ QString KeeperTaskBackup::get_file_name() const
 
     return d->get_file_name();
 }
+
+QStringList KeeperTaskBackup::get_part_file_names() const
+{
+    Q_D(const KeeperTaskBackup);
+
+    return d->get_part_file_names();
+}
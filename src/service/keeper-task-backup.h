@@ -37,10 +37,26 @@ public:
 
     Q_DISABLE_COPY(KeeperTaskBackup)
 
-    void ask_for_uploader(quint64 n_bytes, QString const & dir_name);
+    // the parts of the archive committed by an interrupted attempt
+    // of this task are not uploaded again if their hashes still match
+    void ask_for_uploader(quint64 n_bytes,
+                          QString const & dir_name,
+                          QStringList const & committed_part_file_names = QStringList(),
+                          QStringList const & committed_part_hashes = QStringList());
+
+    // the helper is ready to stream, but has to wait
+    // until the task gets its slot to ask for the uploader
+    void hold_uploader();
 
     QString get_file_name() const;
 
+    // the remote files of the backup, in order
+    QStringList get_part_file_names() const;
+
+Q_SIGNALS:
+    // the first parts of the archive, of n_bytes in total, are stored
+    void task_parts_committed(quint64 n_bytes, QStringList const & part_file_names, QStringList const & part_hashes);
+
 protected:
     QStringList get_helper_urls() const override;
     void init_helper() override;
@@ -19,6 +19,7 @@
  */
 
 #include "util/connection-helper.h"
+#include "util/tracing.h"
 #include "storage-framework/storage_framework_client.h"
 #include "helper/restore-helper.h"
 #include "service/app-const.h" // DEKKO_APP_ID
@@ -44,7 +45,7 @@ public:
 
     QStringList get_helper_urls() const
     {
-        return helper_registry_->get_restore_helper_urls(task_data_.metadata);
+        return helper_registry_->get_restore_helper_urls(get_helper_metadata());
     }
 
     void init_helper()
@@ -71,11 +72,21 @@ public:
             return;
         }
 
+        // backups stored in parts are read back as a single file
+        auto file_names = task_data_.metadata.get_part_file_names();
+        if (file_names.isEmpty())
+            file_names << file_name;
+
+        QSharedPointer<util::TraceSpan> span(new util::TraceSpan(QStringLiteral("storage downloader"), {
+            {QStringLiteral("uuid"), task_data_.metadata.get_uuid()}
+        }));
         // extract the dir_name.
         connections_.connect_future(
-            storage_->get_new_downloader(dir_name, file_name),
-            std::function<void(std::shared_ptr<Downloader> const&)>{
-                [this](std::shared_ptr<Downloader> const& downloader){
+            storage_->get_new_downloader(dir_name, file_names),
+            std::function<void(StorageFrameworkClient::DownloaderResult const&)>{
+                [this, span](StorageFrameworkClient::DownloaderResult const& result){
+                    span->end();
+                    auto const downloader = result.downloader;
                     auto fd {-1};
                     if (downloader) {
                         auto restore_helper = qSharedPointerDynamicCast<RestoreHelper>(helper_);
@@ -85,7 +96,7 @@ public:
                     }
                     else
                     {
-                        error_ = storage_->get_last_error();
+                        error_ = result.error;
                         qDebug("Emitting task_socket_error(error=%d)", static_cast<int>(error_));
                         Q_EMIT(q_ptr->task_socket_error(error_));
                     }
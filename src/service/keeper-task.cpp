@@ -20,11 +20,11 @@
 
 #include "helper/metadata.h"
 #include "keeper-task.h"
+#include "util/logging.h"
+#include "util/tracing.h"
 
 #include "private/keeper-task_p.h"
 
-#include <QJsonDocument>
-#include <QJsonObject>
 #include <QString>
 
 KeeperTaskPrivate::KeeperTaskPrivate(KeeperTask * keeper_task,
@@ -74,7 +74,7 @@ bool KeeperTaskPrivate::start()
     return true;
 }
 
-QVariantMap KeeperTaskPrivate::state() const
+KeeperTask::TaskState KeeperTaskPrivate::state() const
 {
     return state_;
 }
@@ -93,23 +93,23 @@ void KeeperTaskPrivate::on_helper_state_changed(Helper::State state)
             break;
 
         case Helper::State::STARTED:
-            qDebug() << "Helper started";
+            qCDebug(util::logState) << "Helper started";
             break;
 
         case Helper::State::CANCELLED:
-            qDebug() << "Helper cancelled";
+            qCDebug(util::logState) << "Helper cancelled";
             break;
 
         case Helper::State::FAILED:
-            qDebug() << "Helper failed";
+            qCDebug(util::logState) << "Helper failed";
             break;
 
         case Helper::State::DATA_COMPLETE:
-            qDebug() << "Helper data complete";
+            qCDebug(util::logState) << "Helper data complete";
             break;
 
         case Helper::State::COMPLETE:
-            qDebug() << "Helper complete.";
+            qCDebug(util::logState) << "Helper complete.";
             break;
     }
     set_current_task_action(helper_->to_string(state));
@@ -121,37 +121,9 @@ void KeeperTaskPrivate::on_helper_percent_done_changed(float /*percent_done*/)
     calculate_and_notify_state(helper_->state());
 }
 
-QVariantMap KeeperTaskPrivate::calculate_task_state()
+KeeperTask::TaskState KeeperTaskPrivate::calculate_task_state()
 {
-    QVariantMap ret;
-
-    auto const uuid = task_data_.metadata.get_uuid();
-
-    ret.insert(keeper::Item::STATUS_KEY, task_data_.action);
-    ret.insert(keeper::Item::DISPLAY_NAME_KEY, task_data_.metadata.get_display_name());
-
-    auto const speed = helper_->speed();
-    ret.insert(keeper::Item::SPEED_KEY, int32_t(speed));
-
-    auto const percent_done = helper_->percent_done();
-    ret.insert(keeper::Item::PERCENT_DONE_KEY, double(percent_done));
-
-    if (task_data_.action == "failed" || task_data_.action == "cancelled")
-    {
-        auto error = error_;
-        if (task_data_.error != keeper::Error::OK)
-        {
-            error = task_data_.error;
-        }
-        ret.insert(keeper::Item::ERROR_KEY, QVariant::fromValue(error));
-    }
-
-    ret.insert(keeper::Item::UUID_KEY, uuid);
-
-    QJsonDocument doc(QJsonObject::fromVariantMap(ret));
-    qDebug() << QString(doc.toJson(QJsonDocument::Compact));
-
-    return ret;
+    return KeeperTask::calculate_state(task_data_, helper_->percent_done(), qint32(helper_->speed()), error_);
 }
 
 void KeeperTaskPrivate::calculate_and_notify_state(Helper::State state)
@@ -173,20 +145,15 @@ void KeeperTaskPrivate::cancel()
     }
 }
 
-QVariantMap KeeperTaskPrivate::get_initial_state(KeeperTask::TaskData const &td)
+KeeperTask::TaskState KeeperTaskPrivate::get_initial_state(KeeperTask::TaskData const &td)
 {
-    QVariantMap ret;
-
-    auto const uuid = td.metadata.get_uuid();
-
-    ret.insert(keeper::Item::STATUS_KEY, td.action);
+    KeeperTask::TaskState ret;
 
     // TODO review this when we add the restore tasks.
     // TODO we maybe have different fields
-    ret.insert(keeper::Item::DISPLAY_NAME_KEY, td.metadata.get_display_name());
-    ret.insert(keeper::Item::SPEED_KEY, 0);
-    ret.insert(keeper::Item::PERCENT_DONE_KEY, double(0.0));
-    ret.insert(keeper::Item::UUID_KEY, uuid);
+    ret.uuid = td.metadata.get_uuid();
+    ret.display_name = td.metadata.get_display_name();
+    ret.status = td.action;
 
     return ret;
 }
@@ -209,6 +176,26 @@ keeper::Error KeeperTaskPrivate::error() const
     return error_;
 }
 
+void KeeperTaskPrivate::set_helper_bus_path(QString const & bus_path)
+{
+    helper_bus_path_ = bus_path;
+}
+
+QString KeeperTaskPrivate::helper_bus_path() const
+{
+    return helper_bus_path_;
+}
+
+Metadata KeeperTaskPrivate::get_helper_metadata() const
+{
+    // the bus path and trace are only needed to build the helper urls,
+    // so we don't add them to the task metadata stored in the manifest
+    auto metadata = task_data_.metadata;
+    metadata.set_property_value(Metadata::HELPER_BUS_PATH_KEY, helper_bus_path_);
+    metadata.set_property_value(Metadata::TRACE_ID_KEY, util::Tracing::trace_id());
+    return metadata;
+}
+
 KeeperTask::KeeperTask(TaskData & task_data,
                        QSharedPointer<HelperRegistry> const & helper_registry,
                        QSharedPointer<StorageFrameworkClient> const & storage,
@@ -234,7 +221,7 @@ bool KeeperTask::start()
     return d->start();
 }
 
-QVariantMap KeeperTask::state() const
+KeeperTask::TaskState KeeperTask::state() const
 {
     Q_D(const KeeperTask);
 
@@ -249,11 +236,29 @@ void KeeperTask::recalculate_task_state()
 }
 
 
-QVariantMap KeeperTask::get_initial_state(KeeperTask::TaskData const &td)
+KeeperTask::TaskState KeeperTask::get_initial_state(KeeperTask::TaskData const &td)
 {
     return KeeperTaskPrivate::get_initial_state(td);
 }
 
+KeeperTask::TaskState KeeperTask::calculate_state(KeeperTask::TaskData const &td,
+                                                  double percent_done,
+                                                  qint32 speed,
+                                                  keeper::Error helper_error)
+{
+    auto ret = KeeperTaskPrivate::get_initial_state(td);
+    ret.percent_done = percent_done;
+    ret.speed = speed;
+
+    if (td.action == "failed" || td.action == "cancelled")
+    {
+        ret.has_error = true;
+        ret.error = td.error != keeper::Error::OK ? td.error : helper_error;
+    }
+
+    return ret;
+}
+
 void KeeperTask::cancel()
 {
     Q_D(KeeperTask);
@@ -274,3 +279,70 @@ keeper::Error KeeperTask::error() const
 
     return d->error();
 }
+
+void KeeperTask::set_helper_bus_path(QString const & bus_path)
+{
+    Q_D(KeeperTask);
+
+    d->set_helper_bus_path(bus_path);
+}
+
+QString KeeperTask::helper_bus_path() const
+{
+    Q_D(const KeeperTask);
+
+    return d->helper_bus_path();
+}
+
+/***
+****  TaskState
+***/
+
+bool KeeperTask::TaskState::is_empty() const
+{
+    return uuid.isEmpty();
+}
+
+keeper::Item KeeperTask::TaskState::to_item() const
+{
+    keeper::Item ret;
+
+    ret.insert(keeper::Item::UUID_KEY, uuid);
+    ret.insert(keeper::Item::DISPLAY_NAME_KEY, display_name);
+    ret.insert(keeper::Item::STATUS_KEY, status);
+    ret.insert(keeper::Item::PERCENT_DONE_KEY, percent_done);
+    ret.insert(keeper::Item::SPEED_KEY, speed);
+    if (has_error)
+    {
+        ret.insert(keeper::Item::ERROR_KEY, QVariant::fromValue(error));
+    }
+
+    return ret;
+}
+
+bool KeeperTask::TaskState::is_published_in(QVariantMap const & item) const
+{
+    return item.size() == (has_error ? 6 : 5)
+        && item.value(keeper::Item::UUID_KEY).toString() == uuid
+        && item.value(keeper::Item::DISPLAY_NAME_KEY).toString() == display_name
+        && item.value(keeper::Item::STATUS_KEY).toString() == status
+        && item.value(keeper::Item::PERCENT_DONE_KEY).toDouble() == percent_done
+        && item.value(keeper::Item::SPEED_KEY).toInt() == speed
+        && (!has_error || item.value(keeper::Item::ERROR_KEY).value<keeper::Error>() == error);
+}
+
+bool KeeperTask::TaskState::operator==(TaskState const & that) const
+{
+    return uuid == that.uuid
+        && display_name == that.display_name
+        && status == that.status
+        && percent_done == that.percent_done
+        && speed == that.speed
+        && has_error == that.has_error
+        && error == that.error;
+}
+
+bool KeeperTask::TaskState::operator!=(TaskState const & that) const
+{
+    return !(*this == that);
+}
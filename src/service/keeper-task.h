@@ -21,6 +21,7 @@
 #pragma once
 
 #include "client/keeper-errors.h"
+#include "client/keeper-items.h"
 #include "helper/metadata.h"
 #include "helper/backup-helper.h"
 #include "helper/helper.h"
@@ -45,6 +46,29 @@ public:
         Metadata metadata;
     };
 
+    // the state of a task, recalculated every time its helper progresses.
+    // It is only converted to a keeper::Item when it's published on the bus
+    struct TaskState
+    {
+        QString uuid;
+        QString display_name;
+        QString status;
+        double percent_done {0.0};
+        qint32 speed {0};
+        // only published for failed or cancelled tasks
+        bool has_error {false};
+        keeper::Error error {keeper::Error::OK};
+
+        bool is_empty() const;
+        keeper::Item to_item() const;
+
+        // whether item is what to_item() returns, without building it
+        bool is_published_in(QVariantMap const & item) const;
+
+        bool operator==(TaskState const & that) const;
+        bool operator!=(TaskState const & that) const;
+    };
+
     KeeperTask(TaskData & task_data,
                QSharedPointer<HelperRegistry> const & helper_registry,
                QSharedPointer<StorageFrameworkClient> const & storage,
@@ -54,16 +78,24 @@ public:
     Q_DISABLE_COPY(KeeperTask)
 
     bool start();
-    QVariantMap state() const;
+    TaskState state() const;
     void recalculate_task_state();
 
-    static QVariantMap get_initial_state(KeeperTask::TaskData const &td);
+    static TaskState get_initial_state(KeeperTask::TaskData const &td);
+    static TaskState calculate_state(KeeperTask::TaskData const &td,
+                                     double percent_done,
+                                     qint32 speed,
+                                     keeper::Error helper_error);
 
     void cancel();
 
     QString to_string(Helper::State state);
 
     keeper::Error error() const;
+
+    // the D-Bus path the task helper uses to ask for its socket
+    void set_helper_bus_path(QString const & bus_path);
+    QString helper_bus_path() const;
 Q_SIGNALS:
     void task_state_changed(Helper::State state);
     void task_socket_ready(int socket_descriptor);
@@ -29,6 +29,8 @@ KeeperUser::KeeperUser(Keeper* keeper)
   : QObject(keeper)
   , keeper_(*keeper)
 {
+    connect(keeper, &Keeper::state_delta, this, &KeeperUser::StateChanged);
+    connect(keeper, &Keeper::backup_choices_changed, this, &KeeperUser::BackupChoicesChanged);
 }
 
 KeeperUser::~KeeperUser() =default;
@@ -48,7 +50,7 @@ KeeperUser::StartBackup (const QStringList& keys, QString const & storage)
 
     auto bus = connection();
     auto& msg = message();
-    keeper_.start_tasks(keys, storage, bus, msg);
+    keeper_.start_backup_tasks(keys, storage, bus, msg);
 }
 
 void
@@ -57,6 +59,12 @@ KeeperUser::Cancel()
     keeper_.cancel();
 }
 
+QString
+KeeperUser::Resume()
+{
+    return keeper_.resume();
+}
+
 keeper::Items
 KeeperUser::GetRestoreChoices(QString const & storage)
 {
@@ -67,6 +75,16 @@ KeeperUser::GetRestoreChoices(QString const & storage)
     return keeper_.get_restore_choices(storage, bus, msg);
 }
 
+keeper::Items
+KeeperUser::GetBackupContents(QString const & backup, QString const & storage, QString const & pattern)
+{
+    Q_ASSERT(calledFromDBus());
+
+    auto bus = connection();
+    auto& msg = message();
+    return keeper_.get_backup_contents(backup, storage, pattern, bus, msg);
+}
+
 void
 KeeperUser::StartRestore (const QStringList& keys, QString const & storage)
 {
@@ -74,11 +92,13 @@ KeeperUser::StartRestore (const QStringList& keys, QString const & storage)
 
     auto bus = connection();
     auto& msg = message();
-    // if we start a restore right after a backup the uuid
-    // will be found as a backup uuid.
-    // Just clear the backup cache to avoid that.
-    keeper_.invalidate_choices_cache();
-    keeper_.start_tasks(keys, storage, bus, msg);
+    keeper_.start_restore_tasks(keys, storage, bus, msg);
+}
+
+keeper::Items
+KeeperUser::GetStateSince(quint64 since, quint64 & version, bool & full)
+{
+    return keeper_.get_state_since(since, version, full);
 }
 
 keeper::Items
@@ -47,16 +47,25 @@ Q_SIGNALS:
 
     void state_changed();
 
+    void StateChanged(quint64 version, keeper::Items const & changed);
+
+    void BackupChoicesChanged();
+
 public Q_SLOTS:
 
     keeper::Items GetBackupChoices();
     void StartBackup(const QStringList&, QString const & storage);
 
     keeper::Items GetRestoreChoices(QString const & storage);
+    keeper::Items GetBackupContents(QString const & backup, QString const & storage, QString const & pattern);
     void StartRestore(const QStringList&, QString const & storage);
 
     void Cancel();
 
+    QString Resume();
+
+    keeper::Items GetStateSince(quint64 since, quint64 & version, bool & full);
+
     QStringList GetStorageAccounts();
 
 private:
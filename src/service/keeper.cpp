@@ -20,12 +20,16 @@
 
 #include "util/connection-helper.h"
 #include "storage-framework/storage_framework_client.h"
+#include "storage-framework/storage-session.h"
+#include "helper/file-catalog.h"
 #include "helper/metadata.h"
+#include "service/manifest.h"
 #include "service/metadata-provider.h"
 #include "service/keeper.h"
 #include "service/task-manager.h"
 
 #include <QDebug>
+#include <QDBusError>
 #include <QDBusMessage>
 #include <QDBusConnection>
 #include <QSharedPointer>
@@ -58,6 +62,24 @@ namespace
 
         return ret;
     }
+
+    keeper::Items file_catalog_to_variant_dict_map(QVector<FileCatalog::Entry> const & entries)
+    {
+        keeper::Items ret;
+
+        for (auto const& entry : entries)
+        {
+            keeper::Item value;
+            value.insert(QStringLiteral("size"), entry.size);
+            value.insert(QStringLiteral("mtime"), entry.mtime);
+            value.insert(QStringLiteral("hash"), QString::fromLatin1(entry.hash.toHex()));
+            if (entry.offset >= 0)
+                value.insert(QStringLiteral("offset"), entry.offset);
+            ret.insert(entry.path, value);
+        }
+
+        return ret;
+    }
 }
 
 class KeeperPrivate : public QObject
@@ -69,17 +91,39 @@ public:
                   const QSharedPointer<HelperRegistry>& helper_registry,
                   const QSharedPointer<MetadataProvider>& backup_choices,
                   const QSharedPointer<MetadataProvider>& restore_choices,
+                  const QSharedPointer<StorageSession>& storage_session,
                   QObject *parent = nullptr)
         : QObject(parent)
         , q_ptr(keeper)
-        , storage_(new StorageFrameworkClient())
+        , storage_session_(storage_session)
+        , storage_(new StorageFrameworkClient(storage_session))
+        , browse_storage_(new StorageFrameworkClient(storage_session))
         , helper_registry_(helper_registry)
         , backup_choices_(backup_choices)
         , restore_choices_(restore_choices)
         , task_manager_{helper_registry, storage_}
     {
-        QObject::connect(&task_manager_, &TaskManager::finished,
-            std::bind(&KeeperPrivate::on_task_manager_finished, this)
+        // the backup choices only change when what they are read from does
+        QObject::connect(backup_choices_.data(), &MetadataProvider::choices_changed,
+            std::bind(&KeeperPrivate::invalidate_choices_cache, this)
+        );
+        QObject::connect(backup_choices_.data(), &MetadataProvider::choices_changed,
+            q_ptr, &Keeper::backup_choices_changed
+        );
+        QObject::connect(&task_manager_, &TaskManager::state_delta,
+            q_ptr, &Keeper::state_delta
+        );
+        QObject::connect(&task_manager_, &TaskManager::helper_path_added,
+            q_ptr, &Keeper::helper_path_added
+        );
+        QObject::connect(&task_manager_, &TaskManager::helper_path_removed,
+            q_ptr, &Keeper::helper_path_removed
+        );
+        QObject::connect(&task_manager_, &TaskManager::socket_ready,
+            std::bind(&KeeperPrivate::on_socket_ready, this, std::placeholders::_1, std::placeholders::_2)
+        );
+        QObject::connect(&task_manager_, &TaskManager::socket_error,
+            std::bind(&KeeperPrivate::on_socket_error, this, std::placeholders::_1, std::placeholders::_2)
         );
     }
 
@@ -89,61 +133,56 @@ public:
 
     Q_DISABLE_COPY(KeeperPrivate)
 
-    void start_tasks(QStringList const & uuids,
-                     QString const & storage,
-                     QDBusConnection bus,
-                     QDBusMessage const & msg)
+    void start_backup_tasks(QStringList const & uuids,
+                            QString const & storage,
+                            QDBusConnection bus,
+                            QDBusMessage const & msg)
     {
-        auto get_tasks = [](const QVector<Metadata>& pool, QStringList const& keys){
-            QMap<QString,Metadata> tasks;
-            for (auto const& key : keys) {
-                auto it = std::find_if(pool.begin(), pool.end(), [key](Metadata const & m){return m.get_uuid()==key;});
-                if (it != pool.end())
-                    tasks[key] = *it;
-            }
-            return tasks;
-        };
-
-        // async part
         qDebug() << "Looking for backup options....";
         connections_.connect_oneshot(
             this,
             &KeeperPrivate::backup_choices_ready,
-            std::function<void()>{[this, uuids, msg, bus, get_tasks, storage](){
-                auto tasks = get_tasks(cached_backup_choices_, uuids);
-                if (!tasks.empty())
+            std::function<void(keeper::Error)>{[this, uuids, msg, bus, storage](keeper::Error error){
+                auto unhandled = QSet<QString>::fromList(uuids);
+                if (error == keeper::Error::OK)
                 {
-                    auto unhandled = QSet<QString>::fromList(uuids);
-                    if (task_manager_.start_backup(tasks.values(), storage))
+                    auto tasks = get_tasks(cached_backup_choices_, uuids);
+                    if (!tasks.empty() && task_manager_.start_backup(tasks.values(), storage))
                         unhandled.subtract(QSet<QString>::fromList(tasks.keys()));
-
-                    check_for_unhandled_tasks_and_reply(unhandled, bus, msg);
                 }
-                else // restore
+                check_for_unhandled_tasks_and_reply(unhandled, bus, msg);
+            }}
+        );
+
+        get_choices(backup_choices_, KeeperPrivate::ChoicesType::BACKUP_CHOICES);
+        msg.setDelayedReply(true);
+    }
+
+    // every backup is listed with its own uuid, derived from the one of its
+    // choice, so restores are only looked for in the restore choices
+    void start_restore_tasks(QStringList const & uuids,
+                             QString const & storage,
+                             QDBusConnection bus,
+                             QDBusMessage const & msg)
+    {
+        qDebug() << "Looking for restore options....";
+        connections_.connect_oneshot(
+            this,
+            &KeeperPrivate::restore_choices_ready,
+            std::function<void(keeper::Error)>{[this, uuids, msg, bus, storage](keeper::Error error){
+                qDebug() << "Choices ready";
+                auto unhandled = QSet<QString>::fromList(uuids);
+                if (error == keeper::Error::OK)
                 {
-                    qDebug() << "Looking for restore options....";
-                    connections_.connect_oneshot(
-                        this,
-                        &KeeperPrivate::restore_choices_ready,
-                        std::function<void(keeper::Error)>{[this, uuids, msg, bus, get_tasks, storage](keeper::Error error){
-                            qDebug() << "Choices ready";
-                            auto unhandled = QSet<QString>::fromList(uuids);
-                            if (error == keeper::Error::OK)
-                            {
-                                auto restore_tasks = get_tasks(cached_restore_choices_, uuids);
-                                qDebug() << "After getting tasks...";
-                                if (!restore_tasks.empty() && task_manager_.start_restore(restore_tasks.values(), storage))
-                                    unhandled.subtract(QSet<QString>::fromList(restore_tasks.keys()));
-                            }
-                            check_for_unhandled_tasks_and_reply(unhandled, bus, msg);
-                        }}
-                    );
-                    get_choices(restore_choices_, KeeperPrivate::ChoicesType::RESTORES_CHOICES);
+                    auto restore_tasks = get_tasks(cached_restore_choices_, uuids);
+                    if (!restore_tasks.empty() && task_manager_.start_restore(restore_tasks.values(), storage))
+                        unhandled.subtract(QSet<QString>::fromList(restore_tasks.keys()));
                 }
+                check_for_unhandled_tasks_and_reply(unhandled, bus, msg);
             }}
         );
 
-        get_choices(backup_choices_, KeeperPrivate::ChoicesType::BACKUP_CHOICES);
+        get_choices(restore_choices_, KeeperPrivate::ChoicesType::RESTORES_CHOICES);
         msg.setDelayedReply(true);
     }
 
@@ -177,6 +216,7 @@ public:
                         {
                         case KeeperPrivate::ChoicesType::BACKUP_CHOICES:
                             cached_backup_choices_ = provider->get_backups();
+                            cached_backup_choices_items_ = choices_to_variant_dict_map(cached_backup_choices_);
                             break;
                         case KeeperPrivate::ChoicesType::RESTORES_CHOICES:
                             cached_restore_choices_ = provider->get_backups();
@@ -206,7 +246,7 @@ public:
                 {
                     // reply now to the dbus call
                     auto reply = msg.createReply();
-                    reply << QVariant::fromValue(choices_to_variant_dict_map(cached_backup_choices_));
+                    reply << QVariant::fromValue(cached_backup_choices_items_);
                     bus.send(reply);
                 }
                 else
@@ -257,46 +297,93 @@ public:
         return keeper::Items();
     }
 
+    keeper::Items get_backup_contents(QString const & uuid,
+                                      QString const & storage,
+                                      QString const & pattern,
+                                      QDBusConnection bus,
+                                      QDBusMessage const & msg)
+    {
+        qDebug() << "Getting the contents of backup" << uuid << "in storage" << storage;
+        connections_.connect_oneshot(
+            this,
+            &KeeperPrivate::restore_choices_ready,
+            std::function<void(keeper::Error)>{[this, uuid, storage, pattern, msg, bus](keeper::Error error){
+                if (error != keeper::Error::OK)
+                {
+                    auto message = QStringLiteral("Error obtaining restore choices, keeper returned error: %1").arg(static_cast<int>(error));
+                    qWarning() << message;
+                    auto reply = msg.createErrorReply(QDBusError::Failed, message);
+                    reply << QVariant::fromValue(error);
+                    bus.send(reply);
+                    return;
+                }
+
+                auto it = std::find_if(cached_restore_choices_.begin(), cached_restore_choices_.end(),
+                                       [uuid](Metadata const & m){return m.get_uuid()==uuid;});
+                if (it == cached_restore_choices_.end())
+                {
+                    bus.send(msg.createErrorReply(QDBusError::InvalidArgs, QStringLiteral("unknown backup: %1").arg(uuid)));
+                    return;
+                }
+                auto const catalog_file_name = it->get_catalog_file_name();
+                if (catalog_file_name.isEmpty())
+                {
+                    bus.send(msg.createErrorReply(QDBusError::Failed, QStringLiteral("backup %1 has no file catalog").arg(uuid)));
+                    return;
+                }
+
+                // browsing has a client of its own, so it doesn't
+                // change the storage of a running backup or restore
+                browse_storage_->set_storage(storage);
+                QSharedPointer<Manifest> manifest(new Manifest(browse_storage_, it->get_dir_name()), [](Manifest *m){m->deleteLater();});
+                connections_.connect_oneshot(
+                    manifest.data(),
+                    &Manifest::finished,
+                    std::function<void(bool)>{[manifest, pattern, msg, bus](bool success){
+                        if (success)
+                        {
+                            auto reply = msg.createReply();
+                            reply << QVariant::fromValue(file_catalog_to_variant_dict_map(manifest->get_file_catalog().find(pattern)));
+                            bus.send(reply);
+                        }
+                        else
+                        {
+                            qWarning() << manifest->error();
+                            bus.send(msg.createErrorReply(QDBusError::Failed, manifest->error()));
+                        }
+                    }}
+                );
+                manifest->read_file_catalog(catalog_file_name);
+            }}
+        );
+        get_choices(restore_choices_, KeeperPrivate::ChoicesType::RESTORES_CHOICES, storage);
+        msg.setDelayedReply(true);
+        return keeper::Items();
+    }
+
     keeper::Items get_state() const
     {
         return task_manager_.get_state();
     }
 
+    keeper::Items get_state_since(quint64 since, quint64 & version, bool & full) const
+    {
+        return task_manager_.get_state_since(since, version, full);
+    }
+
     QDBusUnixFileDescriptor start_backup(QDBusConnection bus,
                                          QDBusMessage const & msg,
                                          quint64 n_bytes)
     {
         qDebug("Keeper::StartBackup(n_bytes=%zu)", size_t(n_bytes));
 
-        connections_.connect_oneshot(
-            &task_manager_,
-            &TaskManager::socket_ready,
-            std::function<void(int)>{
-                [bus,msg](int fd){
-                    qDebug("BackupManager returned socket %d", fd);
-                    auto reply = msg.createReply();
-                    reply << QVariant::fromValue(QDBusUnixFileDescriptor(fd));
-                    bus.send(reply);
-                }
-            }
-        );
-
-        connections_.connect_oneshot(
-            &task_manager_,
-            &TaskManager::socket_error,
-            std::function<void(keeper::Error)>{
-                [bus,msg](keeper::Error error){
-                    qDebug("BackupManager returned socket error: %d", static_cast<int>(error));
-                    bus.send(msg.createErrorReply(QDBusError::InvalidArgs, "Error obtaining remote backup socket"));
-                }
-            }
-        );
+        // tell the caller that we'll be responding async
+        msg.setDelayedReply(true);
+        add_socket_request(msg.path(), SocketRequest{bus, msg, false, QStringLiteral("Error obtaining remote backup socket")});
 
         qDebug() << "Asking for a storage framework socket from the task manager";
-        task_manager_.ask_for_uploader(n_bytes);
+        task_manager_.ask_for_uploader(n_bytes, msg.path());
 
-        // tell the caller that we'll be responding async
-        msg.setDelayedReply(true);
         return QDBusUnixFileDescriptor(0);
     }
 
@@ -306,37 +393,32 @@ public:
     {
         qDebug() << "Keeper::StartRestore()";
 
-        connections_.connect_oneshot(
-            &task_manager_,
-            &TaskManager::socket_ready,
-            std::function<void(int)>{
-                [bus,msg](int fd){
-                    qDebug("RestoreManager returned socket %d", fd);
-                    auto reply = msg.createReply();
-                    reply << QVariant::fromValue(QDBusUnixFileDescriptor(fd));
-                    close(fd);
-                    bus.send(reply);
-                }
-            }
-        );
+        // tell the caller that we'll be responding async
+        msg.setDelayedReply(true);
+        add_socket_request(msg.path(), SocketRequest{bus, msg, true, QStringLiteral("Error obtaining remote restore socket")});
 
-        connections_.connect_oneshot(
-            &task_manager_,
-            &TaskManager::socket_error,
-            std::function<void(keeper::Error)>{
-                [bus,msg](keeper::Error error){
-                    qDebug("RestoreManager returned socket error: %d", static_cast<int>(error));
-                    bus.send(msg.createErrorReply(QDBusError::InvalidArgs, "Error obtaining remote restore socket"));
+        qDebug() << "Asking for a storage framework socket from the task manager";
+        task_manager_.ask_for_downloader(msg.path());
+
+        return QDBusUnixFileDescriptor(0);
+    }
+
+    void set_file_catalog(QString const & helper_path,
+                          int catalog_fd,
+                          QDBusConnection bus,
+                          QDBusMessage const & msg)
+    {
+        connections_.connect_future(
+            task_manager_.set_file_catalog(helper_path, catalog_fd),
+            std::function<void(bool)>{
+                [msg, bus](bool kept){
+                    // the helper waits for the reply before exiting
+                    bus.send(kept ? msg.createReply()
+                                  : msg.createErrorReply(QDBusError::Failed, QStringLiteral("The file catalog could not be kept")));
                 }
             }
         );
-
-        qDebug() << "Asking for a storage framework socket from the task manager";
-        task_manager_.ask_for_downloader();
-
-        // tell the caller that we'll be responding async
         msg.setDelayedReply(true);
-        return QDBusUnixFileDescriptor(0);
     }
 
     void cancel()
@@ -344,9 +426,15 @@ public:
         task_manager_.cancel();
     }
 
+    QString resume()
+    {
+        return task_manager_.resume();
+    }
+
     void invalidate_choices_cache()
     {
         cached_backup_choices_.clear();
+        cached_backup_choices_items_.clear();
     }
 
     QStringList get_storage_accounts(QDBusConnection bus,
@@ -373,11 +461,68 @@ Q_SIGNALS:
     void restore_choices_ready(keeper::Error error);
 
 private:
-    void on_task_manager_finished()
+    static QMap<QString,Metadata> get_tasks(QVector<Metadata> const & pool, QStringList const & keys)
+    {
+        QMap<QString,Metadata> tasks;
+        for (auto const& key : keys) {
+            auto it = std::find_if(pool.begin(), pool.end(), [key](Metadata const & m){return m.get_uuid()==key;});
+            if (it != pool.end())
+                tasks[key] = *it;
+        }
+        return tasks;
+    }
+
+    // a helper's pending request for its socket
+    struct SocketRequest
+    {
+        QDBusConnection bus;
+        QDBusMessage msg;
+        bool close_fd;
+        QString error_text;
+    };
+
+    void add_socket_request(QString const & helper_path, SocketRequest const & request)
+    {
+        if (socket_requests_.contains(helper_path))
+        {
+            qWarning() << "Helper" << helper_path << "asked for a socket while the previous request is pending";
+            socket_requests_.remove(helper_path);
+        }
+        socket_requests_.insert(helper_path, request);
+    }
+
+    void on_socket_ready(QString const & helper_path, int fd)
+    {
+        auto it = socket_requests_.find(helper_path);
+        if (it == socket_requests_.end())
+        {
+            qWarning() << "No pending socket request for helper" << helper_path;
+            return;
+        }
+        auto const request = it.value();
+        socket_requests_.erase(it);
+
+        qDebug("TaskManager returned socket %d", fd);
+        auto reply = request.msg.createReply();
+        reply << QVariant::fromValue(QDBusUnixFileDescriptor(fd));
+        if (request.close_fd)
+            close(fd);
+        request.bus.send(reply);
+    }
+
+    void on_socket_error(QString const & helper_path, keeper::Error error)
     {
-        // force a backup choices regeneration to avoid repeating uuids
-        // between backups
-        invalidate_choices_cache();
+        auto it = socket_requests_.find(helper_path);
+        if (it == socket_requests_.end())
+        {
+            qWarning() << "No pending socket request for helper" << helper_path;
+            return;
+        }
+        auto const request = it.value();
+        socket_requests_.erase(it);
+
+        qDebug("TaskManager returned socket error: %d", static_cast<int>(error));
+        request.bus.send(request.msg.createErrorReply(QDBusError::InvalidArgs, request.error_text));
     }
 
     void check_for_unhandled_tasks_and_reply(QSet<QString> const & unhandled,
@@ -398,37 +543,53 @@ private:
     }
 
     Keeper * const q_ptr;
+    QSharedPointer<StorageSession> storage_session_;
     QSharedPointer<StorageFrameworkClient> storage_;
+    QSharedPointer<StorageFrameworkClient> browse_storage_;
     QSharedPointer<HelperRegistry> helper_registry_;
     QSharedPointer<MetadataProvider> backup_choices_;
     QSharedPointer<MetadataProvider> restore_choices_;
     mutable QVector<Metadata> cached_backup_choices_;
+    keeper::Items cached_backup_choices_items_;
     mutable QVector<Metadata> cached_restore_choices_;
     TaskManager task_manager_;
     ConnectionHelper connections_;
+    QMap<QString, SocketRequest> socket_requests_;
 };
 
 
 Keeper::Keeper(const QSharedPointer<HelperRegistry>& helper_registry,
                const QSharedPointer<MetadataProvider>& backup_choices,
                const QSharedPointer<MetadataProvider>& restore_choices,
+               const QSharedPointer<StorageSession>& storage_session,
                QObject* parent)
     : QObject(parent)
-    , d_ptr(new KeeperPrivate(this, helper_registry, backup_choices, restore_choices))
+    , d_ptr(new KeeperPrivate(this, helper_registry, backup_choices, restore_choices, storage_session))
 {
 }
 
 Keeper::~Keeper() = default;
 
 void
-Keeper::start_tasks(QStringList const & uuids,
-                    QString const & storage,
-                    QDBusConnection bus,
-                    QDBusMessage const & msg)
+Keeper::start_backup_tasks(QStringList const & uuids,
+                           QString const & storage,
+                           QDBusConnection bus,
+                           QDBusMessage const & msg)
+{
+    Q_D(Keeper);
+
+    d->start_backup_tasks(uuids, storage, bus, msg);
+}
+
+void
+Keeper::start_restore_tasks(QStringList const & uuids,
+                            QString const & storage,
+                            QDBusConnection bus,
+                            QDBusMessage const & msg)
 {
     Q_D(Keeper);
 
-    d->start_tasks(uuids, storage, bus, msg);
+    d->start_restore_tasks(uuids, storage, bus, msg);
 }
 
 QDBusUnixFileDescriptor
@@ -469,6 +630,29 @@ Keeper::get_restore_choices(QString const & storage,
     return d->get_restore_choices_var_dict_map(storage, bus, msg);
 }
 
+keeper::Items
+Keeper::get_backup_contents(QString const & uuid,
+                            QString const & storage,
+                            QString const & pattern,
+                            QDBusConnection bus,
+                            QDBusMessage const & msg)
+{
+    Q_D(Keeper);
+
+    return d->get_backup_contents(uuid, storage, pattern, bus, msg);
+}
+
+void
+Keeper::set_file_catalog(QString const & helper_path,
+                         int catalog_fd,
+                         QDBusConnection bus,
+                         QDBusMessage const & msg)
+{
+    Q_D(Keeper);
+
+    d->set_file_catalog(helper_path, catalog_fd, bus, msg);
+}
+
 keeper::Items
 Keeper::get_state() const
 {
@@ -477,6 +661,14 @@ Keeper::get_state() const
     return d->get_state();
 }
 
+keeper::Items
+Keeper::get_state_since(quint64 since, quint64 & version, bool & full) const
+{
+    Q_D(const Keeper);
+
+    return d->get_state_since(since, version, full);
+}
+
 void
 Keeper::cancel()
 {
@@ -485,6 +677,14 @@ Keeper::cancel()
     return d->cancel();
 }
 
+QString
+Keeper::resume()
+{
+    Q_D(Keeper);
+
+    return d->resume();
+}
+
 void
 Keeper::invalidate_choices_cache()
 {
@@ -35,6 +35,7 @@
 class HelperRegistry;
 class Metadata;
 class MetadataProvider;
+class StorageSession;
 
 class KeeperPrivate;
 class Keeper : public QObject
@@ -48,12 +49,18 @@ public:
     Keeper(const QSharedPointer<HelperRegistry>& helper_registry,
            const QSharedPointer<MetadataProvider>& possible,
            const QSharedPointer<MetadataProvider>& available,
+           const QSharedPointer<StorageSession>& storage_session,
            QObject* parent = nullptr);
 
     virtual ~Keeper();
 
     keeper::Items get_backup_choices_var_dict_map(QDBusConnection bus, QDBusMessage const & msg);
     keeper::Items get_restore_choices(QString const & storage, QDBusConnection bus, QDBusMessage const & msg);
+    keeper::Items get_backup_contents(QString const & uuid,
+                                      QString const & storage,
+                                      QString const & pattern,
+                                      QDBusConnection bus,
+                                      QDBusMessage const & msg);
 
     QDBusUnixFileDescriptor StartBackup(QDBusConnection,
                                         QDBusMessage const & message,
@@ -63,20 +70,45 @@ public:
     QDBusUnixFileDescriptor StartRestore(QDBusConnection,
                                         QDBusMessage const & message);
 
-    void start_tasks(QStringList const & uuids,
-                     QString const & storage,
-                     QDBusConnection bus,
-                     QDBusMessage const & msg);
+    // the catalog is read from the descriptor in a worker thread,
+    // the D-Bus call is replied once it is kept
+    void set_file_catalog(QString const & helper_path,
+                          int catalog_fd,
+                          QDBusConnection bus,
+                          QDBusMessage const & msg);
+
+    void start_backup_tasks(QStringList const & uuids,
+                            QString const & storage,
+                            QDBusConnection bus,
+                            QDBusMessage const & msg);
+
+    void start_restore_tasks(QStringList const & uuids,
+                             QString const & storage,
+                             QDBusConnection bus,
+                             QDBusMessage const & msg);
 
     keeper::Items get_state() const;
 
+    keeper::Items get_state_since(quint64 since, quint64 & version, bool & full) const;
+
     void cancel();
 
+    // resumes the run interrupted by the last service shutdown, if any.
+    // Returns its mode, or an empty string if nothing was resumed
+    QString resume();
+
     void invalidate_choices_cache();
 
     QStringList get_storage_accounts(QDBusConnection,
                                      QDBusMessage const & message);
 
+Q_SIGNALS:
+    void state_delta(quint64 version, keeper::Items const & changed);
+    // GetBackupChoices would return something different, e.g. a size estimate is known
+    void backup_choices_changed();
+    void helper_path_added(QString const & helper_path);
+    void helper_path_removed(QString const & helper_path);
+
 private:
     QScopedPointer<KeeperPrivate> const d_ptr;
 };
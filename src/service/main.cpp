@@ -24,10 +24,13 @@
 #include "service/backup-choices.h"
 #include "service/restore-choices.h"
 #include "service/keeper.h"
+#include "service/keeper-metrics.h"
 #include "service/keeper-user.h"
-#include "util/logging.h"
+#include "storage-framework/storage-session.h"
+#include "util/async-logger.h"
 #include "util/unix-signal-handler.h"
 
+#include "KeeperMetricsAdaptor.h"
 #include "KeeperUserAdaptor.h"
 #include "KeeperHelperAdaptor.h"
 
@@ -42,7 +45,8 @@
 int
 main(int argc, char **argv)
 {
-    qInstallMessageHandler(util::loggingFunction);
+    // keeps the formatting and writing of the log off the hot paths
+    util::AsyncLogger logger;
 
     QCoreApplication app(argc, argv);
     DBusTypes::registerMetaTypes();
@@ -81,10 +85,12 @@ main(int argc, char **argv)
             return EXIT_FAILURE;
         }
 
+        // listing restore choices and running tasks share the same storage connection
+        QSharedPointer<StorageSession> storage_session (new StorageSession());
         QSharedPointer<HelperRegistry> registry (new DataDirRegistry());
         QSharedPointer<MetadataProvider> possible (new BackupChoices());
-        QSharedPointer<MetadataProvider> available (new RestoreChoices());
-        auto service = new Keeper(registry, possible, available, &app);
+        QSharedPointer<MetadataProvider> available (new RestoreChoices(storage_session));
+        auto service = new Keeper(registry, possible, available, storage_session, &app);
 
         // register the helper object
         auto helper  = new KeeperHelper(service);
@@ -103,6 +109,15 @@ main(int argc, char **argv)
             qCritical("Could not register keeper dbus user object: [%s]", connection.lastError().message().toStdString().c_str());
             return EXIT_FAILURE;
         }
+
+        // register the metrics object
+        auto metrics  = new KeeperMetrics(service);
+        new KeeperMetricsAdaptor(metrics);
+        if (!connection.registerObject(DBusTypes::KEEPER_METRICS_PATH, metrics))
+        {
+            qCritical("Could not register keeper dbus metrics object: [%s]", connection.lastError().message().toStdString().c_str());
+            return EXIT_FAILURE;
+        }
     }
 
 
@@ -17,21 +17,28 @@
  *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
  */
 
+#include "binary-manifest.h"
 #include "manifest.h"
 
 #include "storage-framework/storage_framework_client.h"
 #include "util/connection-helper.h"
 
+#include <QBuffer>
+#include <QFile>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QMap>
 #include <QSharedPointer>
+#include <QTimer>
 #include <QVector>
 
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 
+#include <functional> // std::bind()
+
 namespace sf = unity::storage::qt::client;
 
 // JSON Keys
@@ -39,6 +46,8 @@ namespace
 {
     constexpr const char ENTRIES_KEY[] = "entries";
     constexpr const char MANIFEST_FILE_NAME[] = "manifest.json";
+    constexpr const char BINARY_MANIFEST_FILE_NAME[] = "manifest.bin";
+    constexpr const char CATALOG_FILE_SUFFIX[] = ".catalog";
 }
 
 /***
@@ -52,95 +61,111 @@ public:
         : q_ptr{manifest}
         , storage_{storage}
         , dir_{dir}
+        , format_{default_format()}
     {
+        read_timer_.setSingleShot(true);
+        read_timer_.setInterval(READ_TIMEOUT);
+        QObject::connect(&read_timer_, &QTimer::timeout, [this](){
+            finish_reading(QStringLiteral("Timeout reading %1 from storage-framework").arg(reading_file_name_));
+        });
     }
 
-    ~ManifestPrivate() = default;
+    ~ManifestPrivate()
+    {
+        QObject::disconnect(read_connection_);
+        QObject::disconnect(disconnected_connection_);
+        QObject::disconnect(write_connection_);
+    }
 
     Q_DISABLE_COPY(ManifestPrivate)
 
+    // the entries of a binary manifest that was read come first,
+    // so they don't need to be decoded to add new ones
     void add_entry(Metadata const & entry)
     {
         entries_.push_back(entry);
     }
 
-    void store()
+    void set_format(Manifest::Format format)
     {
-        qDebug() << "Metadata asking storage framework for a socket";
-        auto json_data = to_json();
-        auto n_bytes = json_data.size();
+        format_ = format;
+    }
 
-        connections_.connect_future(
-            storage_->get_new_uploader(n_bytes, dir_, MANIFEST_FILE_NAME),
-            std::function<void(std::shared_ptr<Uploader> const&)>{
-                [this, json_data](std::shared_ptr<Uploader> const& uploader){
-                    qDebug() << "Manifest uploader is" << static_cast<void*>(uploader.get());
-                    if (uploader)
-                    {
-                        auto socket = uploader->socket();
-                        socket->write(json_data);
-                        connections_.connect_oneshot(
-                            uploader.get(),
-                            &Uploader::commit_finished,
-                            std::function<void(bool)>{[this, uploader](bool success){
-                                qDebug() << "Metadata commit finished";
-                                if (!success)
-                                {
-                                    finish_with_error(QStringLiteral("Error committing manifest file to storage-framework"));
-                                }
-                                else
-                                {
-                                    uploader_committed_file_name_ = uploader->file_name();
-                                    finish();
-                                }
-                            }}
-                        );
-                        uploader->commit();
-                    }
-                    else
-                    {
-                        finish_with_error(QStringLiteral("Error retrieving uploader for manifest file from storage-framework"));
-                    }
-                }
-            }
-        );
+    Manifest::Format format() const
+    {
+        return format_;
     }
 
+    void add_file_catalog(QString const & uuid, QString const & path)
+    {
+        file_catalogs_[uuid] = path;
+    }
+
+    // the file catalogs are stored first, so the manifest
+    // entries can point to the files they were stored in
+    void store()
+    {
+        decode_entries();
+        pending_catalogs_ = file_catalogs_;
+        store_next_file_catalog();
+    }
+
+    // backups made before the binary manifest existed only have the JSON one
     void read()
     {
-        connections_.connect_future(
-            storage_->get_new_downloader(dir_, MANIFEST_FILE_NAME),
-            std::function<void(std::shared_ptr<Downloader> const&)>{
-                [this](std::shared_ptr<Downloader> const& downloader){
-                    if (downloader)
-                    {
-                        auto socket = downloader->socket();
-                        if (socket->atEnd())
-                        {
-                            if (!socket->waitForReadyRead(5000))
-                            {
-                                qWarning() << "Manifest socket was not ready to read after timeout";
-                            }
-                        }
-                        auto json_content = socket->readAll();
-                        from_json(json_content);
-                        downloader->finish();
-                        finish();
-                    }
-                    else
+        read_file(BINARY_MANIFEST_FILE_NAME, std::bind(&ManifestPrivate::parse, this, std::placeholders::_1), [this](){
+            // a binary manifest that is there but can't be downloaded is an error,
+            // reading the JSON one instead could hide it
+            connections_.connect_future(
+                storage_->file_exists(dir_, BINARY_MANIFEST_FILE_NAME),
+                std::function<void(bool)>{[this](bool exists){
+                    if (exists)
                     {
-                        finish_with_error(QStringLiteral("Error retrieving downloader for manifest file from storage-framework"));
+                        finish_with_error(QStringLiteral("Error retrieving downloader for %1 from storage-framework").arg(BINARY_MANIFEST_FILE_NAME));
+                        return;
                     }
-                }
-            }
-        );
+                    qDebug() << "No binary manifest in" << dir_ << ", reading the JSON one";
+                    read_file(MANIFEST_FILE_NAME, std::bind(&ManifestPrivate::parse, this, std::placeholders::_1));
+                }}
+            );
+        });
     }
 
+    void read_file_catalog(QString const & file_name)
+    {
+        file_catalog_ = FileCatalog();
+        read_file(file_name, [this](QByteArray const & content){
+            bool ok {false};
+            file_catalog_ = FileCatalog::from_data(content, &ok);
+            return ok ? QString() : QStringLiteral("The file catalog %1 is not valid").arg(reading_file_name_);
+        });
+    }
+
+    FileCatalog get_file_catalog() const
+    {
+        return file_catalog_;
+    }
+
+    // decodes the entries of a binary manifest the first time they are all asked for
     QVector<Metadata> get_entries()
     {
+        decode_entries();
         return entries_;
     }
 
+    int size() const
+    {
+        return binary_.size() + entries_.size();
+    }
+
+    // a single entry, read in place if it comes from a binary manifest
+    Metadata entry(int i) const
+    {
+        if (i < binary_.size())
+            return binary_.entry(i);
+        return entries_.at(i - binary_.size());
+    }
+
     QString error() const
     {
         return error_string_;
@@ -176,6 +201,288 @@ public:
 
 private:
 
+    // the content of either file is told apart by its magic
+    QString parse(QByteArray const & content)
+    {
+        if (BinaryManifest::is_binary(content))
+        {
+            // the entries are only decoded when they are asked for
+            if (!binary_.load(content))
+                return QStringLiteral("%1 is not a valid binary manifest").arg(reading_file_name_);
+            return QString();
+        }
+
+        from_json(content);
+        return QString();
+    }
+
+    void decode_entries()
+    {
+        if (!binary_.is_empty())
+        {
+            entries_ = binary_.entries() + entries_;
+            binary_.clear();
+        }
+    }
+
+    void store_next_file_catalog()
+    {
+        if (pending_catalogs_.isEmpty())
+        {
+            store_manifest();
+            return;
+        }
+
+        auto const uuid = pending_catalogs_.firstKey();
+        QSharedPointer<QFile> catalog(new QFile(pending_catalogs_.take(uuid)));
+        auto file_name = entry_file_name(uuid);
+        if (file_name.isEmpty())
+            file_name = uuid;
+
+        // a backup without its catalog can still be restored,
+        // so failing to store it is not an error
+        if (!catalog->open(QIODevice::ReadOnly))
+        {
+            qWarning() << "Error opening the file catalog of" << uuid << ":" << catalog->errorString();
+            store_next_file_catalog();
+            return;
+        }
+        upload_file(file_name + CATALOG_FILE_SUFFIX, catalog, [this, uuid](QString const & committed_file_name){
+            if (committed_file_name.isEmpty())
+                qWarning() << "Error storing the file catalog of" << uuid << ":" << error_string_;
+            else
+                set_entry_property(uuid, keeper::Item::CATALOG_FILE_NAME_KEY, committed_file_name);
+            store_next_file_catalog();
+        });
+    }
+
+    // the JSON manifest is always stored, so the versions that can't read
+    // the binary one still list the backup. The binary one goes last, so
+    // it is only there when the JSON one was stored too
+    void store_manifest()
+    {
+        upload_manifest(MANIFEST_FILE_NAME, to_json(), [this](){
+            if (format_ == Manifest::Format::BINARY)
+                upload_manifest(BINARY_MANIFEST_FILE_NAME, BinaryManifest::encode(entries_), std::bind(&ManifestPrivate::finish, this));
+            else
+                finish();
+        });
+    }
+
+    void upload_manifest(QString const & file_name, QByteArray const & content, std::function<void()> const & on_stored)
+    {
+        QSharedPointer<QBuffer> data(new QBuffer());
+        data->setData(content);
+        data->open(QIODevice::ReadOnly);
+        upload_file(file_name, data, [this, on_stored](QString const & committed_file_name){
+            if (committed_file_name.isEmpty())
+            {
+                finish_with_error(error_string_);
+            }
+            else
+            {
+                uploader_committed_file_name_ = committed_file_name;
+                on_stored();
+            }
+        });
+    }
+
+    // calls on_committed with the name of the committed file,
+    // or with an empty string and error_string_ set if it fails.
+    // The source is written as the socket drains, so a large
+    // file catalog is never held in memory as a whole
+    void upload_file(QString const & file_name,
+                     QSharedPointer<QIODevice> const & source,
+                     std::function<void(QString const &)> const & on_committed)
+    {
+        qDebug() << "Manifest asking storage framework for a socket to store" << file_name;
+        connections_.connect_future(
+            storage_->get_new_uploader(source->size(), dir_, file_name),
+            std::function<void(std::shared_ptr<Uploader> const&)>{
+                [this, file_name, source, on_committed](std::shared_ptr<Uploader> const& uploader){
+                    qDebug() << "Uploader for" << file_name << "is" << static_cast<void*>(uploader.get());
+                    if (uploader)
+                    {
+                        uploader_ = uploader;
+                        upload_source_ = source;
+                        upload_file_name_ = file_name;
+                        on_committed_ = on_committed;
+                        write_connection_ = QObject::connect(uploader->socket().get(), &QLocalSocket::bytesWritten,
+                            std::bind(&ManifestPrivate::write_more, this)
+                        );
+                        write_more();
+                    }
+                    else
+                    {
+                        error_string_ = QStringLiteral("Error retrieving uploader for %1 from storage-framework").arg(file_name);
+                        on_committed(QString());
+                    }
+                }
+            }
+        );
+    }
+
+    void write_more()
+    {
+        if (!uploader_)
+            return;
+
+        auto socket = uploader_->socket();
+        bool read_error {false};
+        while (socket->bytesToWrite() < UPLOAD_BUFFER_MAX && !upload_source_->atEnd())
+        {
+            auto const chunk = upload_source_->read(UPLOAD_BUFFER_MAX);
+            if (chunk.isEmpty())
+            {
+                read_error = true;
+                break;
+            }
+            socket->write(chunk);
+        }
+        if (!upload_source_->atEnd() && !read_error)
+            return;
+
+        // everything is in the socket, or the source can't be read
+        QObject::disconnect(write_connection_);
+        auto const uploader = uploader_;
+        auto const file_name = upload_file_name_;
+        auto const on_committed = on_committed_;
+        uploader_.reset();
+        upload_source_.reset();
+        on_committed_ = nullptr;
+
+        if (read_error)
+        {
+            error_string_ = QStringLiteral("Error reading %1 to store it").arg(file_name);
+            on_committed(QString());
+            return;
+        }
+
+        connections_.connect_oneshot(
+            uploader.get(),
+            &Uploader::commit_finished,
+            std::function<void(bool)>{[this, uploader, file_name, on_committed](bool success){
+                qDebug() << "Commit of" << file_name << "finished";
+                if (!success)
+                {
+                    error_string_ = QStringLiteral("Error committing %1 to storage-framework").arg(file_name);
+                    on_committed(QString());
+                }
+                else
+                {
+                    on_committed(uploader->file_name());
+                }
+            }}
+        );
+        uploader->commit();
+    }
+
+    QString entry_file_name(QString const & uuid) const
+    {
+        for (auto const & entry : entries_)
+        {
+            if (entry.get_uuid() == uuid)
+                return entry.get_file_name();
+        }
+        return QString();
+    }
+
+    void set_entry_property(QString const & uuid, QString const & property, QVariant const & value)
+    {
+        for (auto & entry : entries_)
+        {
+            if (entry.get_uuid() == uuid)
+                entry.set_property_value(property, value);
+        }
+    }
+
+    // on_content parses the whole file and returns an error message if it is not valid.
+    // on_missing, if set, is called instead of failing when the file can't be downloaded
+    void read_file(QString const & file_name,
+                   std::function<QString(QByteArray const &)> const & on_content,
+                   std::function<void()> const & on_missing = nullptr)
+    {
+        reading_file_name_ = file_name;
+        connections_.connect_future(
+            storage_->get_new_downloader(dir_, file_name),
+            std::function<void(std::shared_ptr<Downloader> const&)>{
+                [this, on_content, on_missing](std::shared_ptr<Downloader> const& downloader){
+                    if (downloader)
+                    {
+                        // the data is collected as it arrives, so the service
+                        // keeps serving other requests while manifests download
+                        downloader_ = downloader;
+                        on_content_ = on_content;
+                        read_content_.clear();
+                        auto socket = downloader_->socket();
+                        read_connection_ = QObject::connect(socket.get(), &QLocalSocket::readyRead,
+                            std::bind(&ManifestPrivate::read_more, this)
+                        );
+                        disconnected_connection_ = QObject::connect(socket.get(), &QLocalSocket::disconnected,
+                            std::bind(&ManifestPrivate::read_more, this)
+                        );
+                        read_timer_.start();
+
+                        // maybe there's data already to be read
+                        read_more();
+                    }
+                    else if (on_missing)
+                    {
+                        on_missing();
+                    }
+                    else
+                    {
+                        finish_with_error(QStringLiteral("Error retrieving downloader for %1 from storage-framework").arg(reading_file_name_));
+                    }
+                }
+            }
+        );
+    }
+
+    void read_more()
+    {
+        if (!downloader_)
+            return;
+
+        auto socket = downloader_->socket();
+        read_content_ += socket->readAll();
+        read_timer_.start();
+
+        if (read_content_.size() >= downloader_->file_size())
+        {
+            finish_reading(on_content_(read_content_));
+        }
+        else if (socket->state() != QLocalSocket::ConnectedState)
+        {
+            finish_reading(QStringLiteral("%1 from storage-framework ended after %2 of %3 bytes")
+                .arg(reading_file_name_).arg(read_content_.size()).arg(downloader_->file_size()));
+        }
+    }
+
+    void finish_reading(QString const & error)
+    {
+        read_timer_.stop();
+        QObject::disconnect(read_connection_);
+        QObject::disconnect(disconnected_connection_);
+        read_content_.clear();
+        on_content_ = nullptr;
+
+        auto downloader = downloader_;
+        downloader_.reset();
+        if (downloader)
+            downloader->finish();
+
+        if (error.isEmpty())
+        {
+            finish();
+        }
+        else
+        {
+            qWarning() << error;
+            finish_with_error(error);
+        }
+    }
+
     void finish_with_error(QString const & message)
     {
         error_string_ = message;
@@ -188,15 +495,48 @@ private:
         Q_EMIT(q_ptr->finished(true));
     }
 
+    // the manifests are stored in binary, next to the JSON one, unless
+    // the KEEPER_MANIFEST_FORMAT environment variable is set to "json"
+    static Manifest::Format default_format()
+    {
+        if (qgetenv("KEEPER_MANIFEST_FORMAT") == "json")
+            return Manifest::Format::JSON;
+        return Manifest::Format::BINARY;
+    }
+
     Manifest * const q_ptr;
     QSharedPointer<StorageFrameworkClient> storage_;
     QString dir_;
+    Manifest::Format format_;
 
     QVector<Metadata> entries_;
+    BinaryManifest binary_;
     QString error_string_;
     QString uploader_committed_file_name_;
 
+    // paths of the file catalogs by task uuid
+    QMap<QString, QString> file_catalogs_;
+    QMap<QString, QString> pending_catalogs_;
+    FileCatalog file_catalog_;
+
+    std::shared_ptr<Uploader> uploader_;
+    QSharedPointer<QIODevice> upload_source_;
+    QString upload_file_name_;
+    std::function<void(QString const &)> on_committed_;
+    QMetaObject::Connection write_connection_;
+
+    std::shared_ptr<Downloader> downloader_;
+    std::function<QString(QByteArray const &)> on_content_;
+    QString reading_file_name_;
+    QByteArray read_content_;
+    QMetaObject::Connection read_connection_;
+    QMetaObject::Connection disconnected_connection_;
+    QTimer read_timer_;
+
     ConnectionHelper connections_;
+
+    static constexpr int READ_TIMEOUT {30 * 1000};
+    static constexpr qint64 UPLOAD_BUFFER_MAX {64 * 1024};
 };
 
 /***
@@ -219,6 +559,27 @@ void Manifest::add_entry(Metadata const & entry)
     d->add_entry(entry);
 }
 
+void Manifest::set_format(Format format)
+{
+    Q_D(Manifest);
+
+    d->set_format(format);
+}
+
+Manifest::Format Manifest::format() const
+{
+    Q_D(const Manifest);
+
+    return d->format();
+}
+
+void Manifest::add_file_catalog(QString const & uuid, QString const & path)
+{
+    Q_D(Manifest);
+
+    d->add_file_catalog(uuid, path);
+}
+
 void Manifest::store()
 {
     Q_D(Manifest);
@@ -233,6 +594,20 @@ void Manifest::read()
     d->read();
 }
 
+void Manifest::read_file_catalog(QString const & file_name)
+{
+    Q_D(Manifest);
+
+    d->read_file_catalog(file_name);
+}
+
+FileCatalog Manifest::get_file_catalog() const
+{
+    Q_D(const Manifest);
+
+    return d->get_file_catalog();
+}
+
 QVector<Metadata> Manifest::get_entries()
 {
     Q_D(Manifest);
@@ -240,6 +615,20 @@ QVector<Metadata> Manifest::get_entries()
     return d->get_entries();
 }
 
+int Manifest::size() const
+{
+    Q_D(const Manifest);
+
+    return d->size();
+}
+
+Metadata Manifest::entry(int i) const
+{
+    Q_D(const Manifest);
+
+    return d->entry(i);
+}
+
 QString Manifest::error() const
 {
     Q_D(const Manifest);
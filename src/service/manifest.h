@@ -19,6 +19,7 @@
 
 #pragma once
 
+#include <helper/file-catalog.h>
 #include <helper/metadata.h>
 
 #include <QObject>
@@ -36,11 +37,31 @@ public:
     Q_DISABLE_COPY(Manifest)
 
     void add_entry(Metadata const & entry);
+
+    // the format used to store the manifest. A binary manifest is stored
+    // next to a JSON one, which older versions read.
+    // Both formats are always understood when reading
+    enum class Format { JSON, BINARY };
+    void set_format(Format format);
+    Format format() const;
+
+    // the catalog in the local file at path is stored next to the manifest
+    // when it is stored, and the entry with the same uuid points to it
+    void add_file_catalog(QString const & uuid, QString const & path);
     void store();
 
     void read();
     QVector<Metadata> get_entries();
 
+    // the entries can also be read one by one, so the ones of a
+    // binary manifest are decoded only when they are needed
+    int size() const;
+    Metadata entry(int i) const;
+
+    // reads the catalog stored with the given file name in the manifest's directory
+    void read_file_catalog(QString const & file_name);
+    FileCatalog get_file_catalog() const;
+
     QString error() const;
 
 Q_SIGNALS:
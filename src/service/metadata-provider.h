@@ -36,6 +36,9 @@ public:
 Q_SIGNALS:
     void finished(keeper::Error error);
 
+    // the choices listed by get_backups_async() are no longer up to date
+    void choices_changed();
+
 protected:
     explicit MetadataProvider(QObject *parent = nullptr) : QObject(parent){};
     QVector<Metadata> backups_;
@@ -33,21 +33,25 @@ public:
     virtual ~KeeperTaskPrivate();
 
     bool start();
-    QVariantMap state() const;
+    KeeperTask::TaskState state() const;
     void ask_for_storage_framework_socket(quint64 n_bytes);
 
     void cancel();
 
-    static QVariantMap get_initial_state(KeeperTask::TaskData const &td);
+    static KeeperTask::TaskState get_initial_state(KeeperTask::TaskData const &td);
 
     QString to_string(Helper::State state);
 
     keeper::Error error() const;
 
+    void set_helper_bus_path(QString const & bus_path);
+    QString helper_bus_path() const;
+
 protected:
+    Metadata get_helper_metadata() const;
     void set_current_task_action(QString const& action);
     void on_helper_percent_done_changed(float percent_done);
-    QVariantMap calculate_task_state();
+    KeeperTask::TaskState calculate_task_state();
     void calculate_and_notify_state(Helper::State state);
     void recalculate_task_state();
     void on_backup_socket_ready(std::shared_ptr<QLocalSocket> const &  sf_socket);
@@ -59,6 +63,7 @@ protected:
     QSharedPointer<HelperRegistry> helper_registry_;
     QSharedPointer<StorageFrameworkClient> storage_;
     QSharedPointer<Helper> helper_;
-    QVariantMap state_;
+    KeeperTask::TaskState state_;
     keeper::Error error_;
+    QString helper_bus_path_;
 };
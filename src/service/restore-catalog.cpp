@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include "restore-catalog.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+// JSON Keys
+namespace
+{
+    constexpr const char STORAGES_KEY[] = "storages";
+}
+
+/***
+****
+***/
+
+RestoreCatalog::RestoreCatalog(QString const & path)
+    : path_(path)
+{
+}
+
+QString RestoreCatalog::default_path()
+{
+    return QStringLiteral("%1/keeper/restore-catalog.json")
+        .arg(QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation));
+}
+
+QString RestoreCatalog::path() const
+{
+    return path_;
+}
+
+bool RestoreCatalog::contains(QString const & storage, QString const & dir_name) const
+{
+    return backups_.value(storage).contains(dir_name);
+}
+
+QStringList RestoreCatalog::dir_names(QString const & storage) const
+{
+    return backups_.value(storage).keys();
+}
+
+QVector<Metadata> RestoreCatalog::entries(QString const & storage, QString const & dir_name) const
+{
+    return backups_.value(storage).value(dir_name);
+}
+
+void RestoreCatalog::set_entries(QString const & storage, QString const & dir_name, QVector<Metadata> const & entries)
+{
+    backups_[storage][dir_name] = entries;
+}
+
+void RestoreCatalog::retain(QString const & storage, QVector<QString> const & dir_names)
+{
+    auto it = backups_.find(storage);
+    if (it == backups_.end())
+        return;
+
+    for (auto const & dir_name : it->keys())
+    {
+        if (!dir_names.contains(dir_name))
+        {
+            qDebug() << "Backup" << dir_name << "is gone from the storage, removing it from the catalog";
+            it->remove(dir_name);
+        }
+    }
+}
+
+void RestoreCatalog::clear()
+{
+    backups_.clear();
+
+    if (QFile::exists(path_) && !QFile::remove(path_))
+        qWarning() << "Error removing the restore catalog" << path_;
+}
+
+bool RestoreCatalog::load()
+{
+    backups_.clear();
+
+    QFile file(path_);
+    if (!file.exists())
+        return false;
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        qWarning() << "Error opening the restore catalog" << path_ << ":" << file.errorString();
+        return false;
+    }
+
+    QJsonParseError error;
+    auto const doc = QJsonDocument::fromJson(file.readAll(), &error);
+    if (error.error != QJsonParseError::NoError)
+    {
+        qWarning() << path_ << "parse error at offset" << error.offset << error.errorString();
+        return false;
+    }
+
+    auto const json_storages = doc.object()[STORAGES_KEY].toObject();
+    for (auto storage_it = json_storages.begin(); storage_it != json_storages.end(); ++storage_it)
+    {
+        auto const json_dirs = storage_it.value().toObject();
+        for (auto dir_it = json_dirs.begin(); dir_it != json_dirs.end(); ++dir_it)
+        {
+            QVector<Metadata> entries;
+            for (auto const & value : dir_it.value().toArray())
+                entries.push_back(Metadata(value.toObject()));
+            backups_[storage_it.key()][dir_it.key()] = entries;
+        }
+    }
+
+    return true;
+}
+
+bool RestoreCatalog::save() const
+{
+    QJsonObject json_storages;
+    for (auto storage_it = backups_.begin(); storage_it != backups_.end(); ++storage_it)
+    {
+        QJsonObject json_dirs;
+        for (auto dir_it = storage_it->begin(); dir_it != storage_it->end(); ++dir_it)
+        {
+            QJsonArray json_entries;
+            for (auto const & metadata : dir_it.value())
+                json_entries.append(metadata.json());
+            json_dirs[dir_it.key()] = json_entries;
+        }
+        json_storages[storage_it.key()] = json_dirs;
+    }
+
+    QJsonObject root;
+    root[STORAGES_KEY] = json_storages;
+
+    QDir().mkpath(QFileInfo(path_).absolutePath());
+
+    QSaveFile file(path_);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qWarning() << "Error opening the restore catalog" << path_ << ":" << file.errorString();
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    if (!file.commit())
+    {
+        qWarning() << "Error writing the restore catalog" << path_ << ":" << file.errorString();
+        return false;
+    }
+
+    return true;
+}
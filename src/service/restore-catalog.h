@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#pragma once
+
+#include "helper/metadata.h"
+
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/**
+ * On-disk catalog of the backups found in each storage account.
+ *
+ * It remembers the manifest entries of every backup directory already
+ * read, so listing the restore choices only needs to download the
+ * manifests of the directories that are new since the last listing.
+ * Backups are kept by the id of the account they were listed from.
+ */
+class RestoreCatalog
+{
+public:
+    explicit RestoreCatalog(QString const & path = default_path());
+
+    // returns true if a catalog was found
+    bool load();
+    bool save() const;
+
+    bool contains(QString const & storage, QString const & dir_name) const;
+    QStringList dir_names(QString const & storage) const;
+    QVector<Metadata> entries(QString const & storage, QString const & dir_name) const;
+    void set_entries(QString const & storage, QString const & dir_name, QVector<Metadata> const & entries);
+
+    // forgets the directories of the storage that are not in dir_names
+    void retain(QString const & storage, QVector<QString> const & dir_names);
+
+    void clear();
+
+    QString path() const;
+
+    static QString default_path();
+
+private:
+    QString path_;
+    // entries by account id and backup directory
+    QMap<QString, QMap<QString, QVector<Metadata>>> backups_;
+};
@@ -23,14 +23,27 @@
 #include "storage-framework/storage_framework_client.h"
 
 #include <QDebug>
+#include <QUuid>
+
+#include <algorithm> // std::stable_sort
 
 using namespace unity::storage::qt::client;
 
+namespace
+{
+    // namespace of the uuids of the restore choices of older backups
+    QUuid const RESTORE_UUID_NAMESPACE {QStringLiteral("{0b8e5d71-93c4-5a2f-8e16-7f4a2c9d3b60}")};
+}
+
 
-RestoreChoices::RestoreChoices(QObject *parent)
+RestoreChoices::RestoreChoices(QSharedPointer<StorageSession> const & storage_session,
+                               QString const & catalog_path,
+                               QObject *parent)
     : MetadataProvider(parent)
-    , storage_(new StorageFrameworkClient)
+    , storage_(new StorageFrameworkClient(storage_session))
+    , catalog_(catalog_path)
 {
+    catalog_.load();
 }
 
 RestoreChoices::~RestoreChoices() = default;
@@ -47,28 +60,65 @@ RestoreChoices::get_backups_async(QString const & storage)
     backups_.clear();
     storage_->set_storage(storage);
     connections_.connect_future(
-        storage_->get_keeper_dirs(),
-        std::function<void(QVector<QString> const &)>{
-            [this](QVector<QString> const & dirs){
+        storage_->get_account_keeper_dirs(),
+        std::function<void(StorageFrameworkClient::KeeperDirs const &)>{
+            [this](StorageFrameworkClient::KeeperDirs const & keeper_dirs){
+                // the catalog is kept by the account that was listed,
+                // whatever name the caller used for it
+                auto const account = keeper_dirs.account_id;
+                auto const dirs = keeper_dirs.dirs;
+                auto const error = keeper_dirs.error;
+
+                // the account has no backups left, so neither has the catalog
+                if (!account.isEmpty() && dirs.isEmpty()
+                    && (error == keeper::Error::OK || error == keeper::Error::REMOTE_DIR_NOT_EXISTS))
+                {
+                    catalog_.retain(account, dirs);
+                    catalog_.save();
+                }
+
                 if (dirs.size() > 0)
                 {
-                    manifests_to_read_ = dirs.size();
-                    for (auto i = 0; i < dirs.size(); ++i)
+                    // the backups already in the catalog are not read again
+                    catalog_.retain(account, dirs);
+                    QVector<QString> new_dirs;
+                    for (auto const & dir : dirs)
+                    {
+                        if (catalog_.contains(account, dir))
+                            backups_ += catalog_.entries(account, dir);
+                        else
+                            new_dirs.push_back(dir);
+                    }
+                    qDebug() << "Reading" << new_dirs.size() << "new manifests of" << dirs.size() << "backups";
+
+                    manifests_to_read_ = new_dirs.size();
+                    if (!manifests_to_read_)
+                    {
+                        finish_listing();
+                        return;
+                    }
+                    for (auto i = 0; i < new_dirs.size(); ++i)
                     {
-                        QSharedPointer<Manifest> manifest(new Manifest(storage_, dirs.at(i)), [](Manifest *m){m->deleteLater();});
+                        QSharedPointer<Manifest> manifest(new Manifest(storage_, new_dirs.at(i)), [](Manifest *m){m->deleteLater();});
                         connections_.connect_oneshot(
                             manifest.data(),
                             &Manifest::finished,
-                            std::function<void(bool)>{[this, dirs, manifest, i](bool success){
-                                qDebug() << "Finished reading manifest in dir: " << dirs.at(i) << " success =" << success;
-                                if (success)
+                            std::function<void(bool)>{[this, account, new_dirs, manifest, i](bool success){
+                                qDebug() << "Finished reading manifest in dir: " << new_dirs.at(i) << " success =" << success;
+                                // the entries are only decoded for the manifests that were read,
+                                // and only once: the catalog keeps them for the next listings.
+                                // A backup still in progress has no manifest yet,
+                                // so it is looked for again next time
+                                if (success && manifest->size())
                                 {
-                                    this->backups_ += manifest->get_entries();
+                                    auto const entries = manifest->get_entries();
+                                    this->backups_ += entries;
+                                    catalog_.set_entries(account, new_dirs.at(i), entries);
                                 }
                                 manifests_to_read_--;
                                 if (!manifests_to_read_)
                                 {
-                                     Q_EMIT(finished(keeper::Error::OK));
+                                    finish_listing();
                                 }
                             }}
                         );
@@ -78,9 +128,39 @@ RestoreChoices::get_backups_async(QString const & storage)
                 else
                 {
                     qWarning() << "We could not find and keeper backups directory when retrieving restore options.";
-                    Q_EMIT(finished(storage_->get_last_error()));
+                    Q_EMIT(finished(error));
                 }
             }
         }
     );
 }
+
+void
+RestoreChoices::finish_listing()
+{
+    catalog_.save();
+    set_restore_uuids();
+    Q_EMIT(finished(keeper::Error::OK));
+}
+
+// backup choices keep their uuid, so every backup of a choice has the same one.
+// Every backup gets a uuid derived from its directory, so it doesn't change when
+// newer backups of the same choice are made. Directory names are timestamps,
+// so the newest backups are listed first
+void
+RestoreChoices::set_restore_uuids()
+{
+    std::stable_sort(backups_.begin(), backups_.end(), [](Metadata const & a, Metadata const & b){
+        return a.get_dir_name() > b.get_dir_name();
+    });
+
+    for (auto & backup : backups_)
+        backup.set_property_value(keeper::Item::UUID_KEY, restore_uuid(backup));
+}
+
+QString
+RestoreChoices::restore_uuid(Metadata const & backup)
+{
+    auto const name = QStringLiteral("%1/%2").arg(backup.get_dir_name()).arg(backup.get_uuid());
+    return QUuid::createUuidV5(RESTORE_UUID_NAMESPACE, name).toString().mid(1, 36);
+}
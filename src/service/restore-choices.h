@@ -20,26 +20,40 @@
 #pragma once
 
 #include "service/metadata-provider.h"
+#include "service/restore-catalog.h"
 #include "util/connection-helper.h"
 
 #include <QSharedPointer>
 #include <QVector>
 
 class StorageFrameworkClient;
+class StorageSession;
 
 /**
- * A MetadataProvider that lists the backups that can be restored
+ * A MetadataProvider that lists the backups that can be restored.
+ *
+ * Backups already listed are served from a local catalog, so only
+ * the manifests of new backup directories are downloaded.
  */
 class RestoreChoices: public MetadataProvider
 {
 public:
-    explicit RestoreChoices(QObject *parent = nullptr);
+    explicit RestoreChoices(QSharedPointer<StorageSession> const & storage_session,
+                            QString const & catalog_path = RestoreCatalog::default_path(),
+                            QObject *parent = nullptr);
     virtual ~RestoreChoices();
     QVector<Metadata> get_backups() const override;
     void get_backups_async(QString const & storage) override;
 
+    // the uuid a backup is listed with, derived from its directory and its choice uuid
+    static QString restore_uuid(Metadata const & backup);
+
 private:
+    void finish_listing();
+    void set_restore_uuids();
+
     QSharedPointer<StorageFrameworkClient> storage_;
+    RestoreCatalog catalog_;
     ConnectionHelper connections_;
     int manifests_to_read_ = 0;
 };
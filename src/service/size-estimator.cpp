@@ -0,0 +1,346 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include "service/size-estimator.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QFutureInterface>
+#include <QRunnable>
+
+#include <cerrno>
+#include <cstring> // strerror()
+
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+    // ioprio_set() has no glibc wrapper, so these come from linux/ioprio.h
+    constexpr int IOPRIO_WHO_PROCESS {1};
+    constexpr int IOPRIO_CLASS_IDLE {3};
+    constexpr int IOPRIO_CLASS_SHIFT {13};
+
+    // the highest nice value
+    constexpr int LOWEST_CPU_PRIORITY {19};
+
+    // QThread priorities are ignored by the default scheduling policy,
+    // so the nice value is set instead. On Linux both the I/O priority
+    // and the nice value of a thread id only affect that thread,
+    // so only the pool threads are affected
+    void lower_thread_priority()
+    {
+        if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT) == -1)
+            qDebug() << "Unable to set the idle I/O priority:" << strerror(errno);
+        if (setpriority(PRIO_PROCESS, id_t(syscall(SYS_gettid)), LOWEST_CPU_PRIORITY) == -1)
+            qDebug() << "Unable to set the lowest CPU priority:" << strerror(errno);
+    }
+
+    template<typename T>
+    class FunctionJob : public QRunnable
+    {
+    public:
+        FunctionJob(std::function<T()> const & function, QFutureInterface<T> const & fi)
+            : function_(function)
+            , fi_(fi)
+        {
+        }
+
+        void run() override
+        {
+            lower_thread_priority();
+            fi_.reportResult(function_());
+            fi_.reportFinished();
+        }
+
+    private:
+        std::function<T()> function_;
+        QFutureInterface<T> fi_;
+    };
+}
+
+SizeEstimator::SizeEstimator(QObject * parent)
+    : QObject(parent)
+    , stopping_(new std::atomic<bool>(false))
+{
+    pool_.setMaxThreadCount(default_max_threads());
+
+    QObject::connect(&watcher_, &QFileSystemWatcher::directoryChanged,
+        std::bind(&SizeEstimator::on_dir_changed, this, std::placeholders::_1)
+    );
+}
+
+SizeEstimator::~SizeEstimator()
+{
+    // the jobs already queued return without reading anything
+    *stopping_ = true;
+    pool_.clear();
+    pool_.waitForDone();
+}
+
+void
+SizeEstimator::set_paths(QStringList const & paths)
+{
+    auto const old_roots = roots_;
+    for (auto const & root : old_roots)
+    {
+        if (!paths.contains(root))
+        {
+            roots_.removeAll(root);
+            estimates_.remove(root);
+            pending_scans_.remove(root);
+            forget_scans(root);
+            forget(root);
+        }
+    }
+
+    for (auto const & path : paths)
+    {
+        if (!roots_.contains(path))
+        {
+            roots_ << path;
+            estimates_[path] = Estimate();
+            scan(path);
+        }
+    }
+}
+
+QStringList
+SizeEstimator::paths() const
+{
+    return roots_;
+}
+
+SizeEstimator::Estimate
+SizeEstimator::estimate(QString const & path) const
+{
+    return estimates_.value(path);
+}
+
+int
+SizeEstimator::max_threads() const
+{
+    return pool_.maxThreadCount();
+}
+
+// the number of threads walking the folders can be set with
+// the KEEPER_SIZE_ESTIMATOR_THREADS environment variable
+int
+SizeEstimator::default_max_threads()
+{
+    bool ok {false};
+    auto const n_threads = qgetenv("KEEPER_SIZE_ESTIMATOR_THREADS").toInt(&ok);
+    if (ok && n_threads > 0)
+        return n_threads;
+    return 2;
+}
+
+SizeEstimator::DirTotals
+SizeEstimator::scan_dir(QString const & dir)
+{
+    DirTotals ret;
+
+    // links are archived as links, so they are not followed
+    QDirIterator it(dir, QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System);
+    while (it.hasNext())
+    {
+        it.next();
+        auto const info = it.fileInfo();
+        if (info.isDir() && !info.isSymLink())
+        {
+            ret.subdirs << info.absoluteFilePath();
+        }
+        else
+        {
+            ++ret.n_files;
+            if (!info.isSymLink())
+                ret.n_bytes += info.size();
+        }
+    }
+
+    return ret;
+}
+
+void
+SizeEstimator::scan(QString const & dir)
+{
+    auto const root = root_of(dir);
+    if (root.isEmpty())
+        return;
+
+    // what the running scan read may be outdated already
+    if (scanning_.contains(dir))
+    {
+        rescan_ << dir;
+        return;
+    }
+
+    auto const scan_id = ++next_scan_id_;
+    scanning_[dir] = scan_id;
+    ++pending_scans_[root];
+
+    QFutureInterface<DirTotals> fi;
+    fi.reportStarted();
+    auto stopping = stopping_;
+    pool_.start(new FunctionJob<DirTotals>([dir, stopping](){
+        return *stopping ? DirTotals() : scan_dir(dir);
+    }, fi));
+
+    connections_.connect_future(
+        fi.future(),
+        std::function<void(DirTotals const &)>{[this, dir, scan_id](DirTotals const & totals){
+            on_dir_scanned(dir, scan_id, totals);
+        }}
+    );
+}
+
+void
+SizeEstimator::on_dir_scanned(QString const & dir, quint64 scan_id, DirTotals const & totals)
+{
+    // the scan of a folder that was removed, even if it was added again since
+    if (scanning_.value(dir) != scan_id)
+        return;
+    scanning_.remove(dir);
+
+    auto const root = root_of(dir);
+    if (root.isEmpty())
+        return;
+
+    auto const old_subdirs = dirs_.value(dir).subdirs;
+    dirs_[dir] = totals;
+
+    // the subdirectories that are gone are forgotten, and the new ones are walked
+    for (auto const & subdir : old_subdirs)
+    {
+        if (!totals.subdirs.contains(subdir))
+            forget(subdir);
+    }
+    for (auto const & subdir : totals.subdirs)
+    {
+        if (!dirs_.contains(subdir))
+            scan(subdir);
+    }
+
+    if (!watched_dirs_.contains(dir))
+    {
+        if (watched_dirs_.size() >= MAX_WATCHED_DIRS)
+            qDebug() << "Not watching" << dir << ": too many directories watched already";
+        else if (watcher_.addPath(dir))
+            watched_dirs_ << dir;
+    }
+
+    // the estimate waits for the scan of the changes, if there were any
+    if (rescan_.remove(dir))
+        scan(dir);
+
+    if (--pending_scans_[root] == 0)
+        update_estimate(root);
+}
+
+void
+SizeEstimator::on_dir_changed(QString const & dir)
+{
+    if (QFileInfo(dir).isDir())
+    {
+        scan(dir);
+    }
+    else
+    {
+        // its parent changed too, and forgets it when it's read again
+        qDebug() << "Directory" << dir << "was removed";
+    }
+}
+
+void
+SizeEstimator::forget(QString const & dir)
+{
+    auto const prefix = dir + QLatin1Char('/');
+    QStringList forgotten;
+    for (auto it = dirs_.begin(); it != dirs_.end(); )
+    {
+        if (it.key() == dir || it.key().startsWith(prefix))
+        {
+            forgotten << it.key();
+            it = dirs_.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    for (auto const & path : forgotten)
+    {
+        if (watched_dirs_.remove(path))
+            watcher_.removePath(path);
+    }
+}
+
+// the scans of a removed root that are still running are ignored when they finish
+void
+SizeEstimator::forget_scans(QString const & root)
+{
+    auto const prefix = root + QLatin1Char('/');
+    for (auto it = scanning_.begin(); it != scanning_.end(); )
+    {
+        if (it.key() == root || it.key().startsWith(prefix))
+        {
+            rescan_.remove(it.key());
+            it = scanning_.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+QString
+SizeEstimator::root_of(QString const & dir) const
+{
+    for (auto const & root : roots_)
+    {
+        if (dir == root || dir.startsWith(root + QLatin1Char('/')))
+            return root;
+    }
+    return QString();
+}
+
+void
+SizeEstimator::update_estimate(QString const & root)
+{
+    Estimate estimate;
+    auto const prefix = root + QLatin1Char('/');
+    for (auto it = dirs_.constBegin(); it != dirs_.constEnd(); ++it)
+    {
+        if (it.key() == root || it.key().startsWith(prefix))
+        {
+            estimate.n_bytes += it->n_bytes;
+            estimate.n_files += it->n_files;
+        }
+    }
+    estimate.complete = true;
+
+    estimates_[root] = estimate;
+    qDebug() << "Estimated" << estimate.n_bytes << "bytes in" << estimate.n_files << "files for" << root;
+    Q_EMIT(estimate_changed(root));
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#pragma once
+
+#include "util/connection-helper.h"
+
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+
+#include <atomic>
+
+/**
+ * Estimates in the background how many bytes and files a backup of each
+ * folder would hold, and keeps the estimates up to date.
+ *
+ * Every directory is read by its own job, so the trees are walked by
+ * several threads at once, at idle I/O priority. The totals of each
+ * directory are kept, and the directories are watched: when one of
+ * them changes only that directory is read again.
+ */
+class SizeEstimator : public QObject
+{
+    Q_OBJECT
+public:
+    struct Estimate
+    {
+        qint64 n_bytes {0};
+        qint64 n_files {0};
+        // false while the folder is being walked
+        bool complete {false};
+    };
+
+    explicit SizeEstimator(QObject * parent = nullptr);
+    virtual ~SizeEstimator();
+
+    Q_DISABLE_COPY(SizeEstimator)
+
+    // starts estimating the paths that are new,
+    // and forgets the ones that are not in paths
+    void set_paths(QStringList const & paths);
+    QStringList paths() const;
+
+    Estimate estimate(QString const & path) const;
+
+    int max_threads() const;
+
+Q_SIGNALS:
+    // a folder finished being walked, or it changed and was updated
+    void estimate_changed(QString const & path);
+
+private:
+    // the files directly in a directory
+    struct DirTotals
+    {
+        qint64 n_bytes {0};
+        qint64 n_files {0};
+        QStringList subdirs;
+    };
+
+    static DirTotals scan_dir(QString const & dir);
+    static int default_max_threads();
+
+    void scan(QString const & dir);
+    void on_dir_scanned(QString const & dir, quint64 scan_id, DirTotals const & totals);
+    void on_dir_changed(QString const & dir);
+    void forget(QString const & dir);
+    void forget_scans(QString const & root);
+    QString root_of(QString const & dir) const;
+    void update_estimate(QString const & root);
+
+    QStringList roots_;
+    QHash<QString, DirTotals> dirs_;
+    QHash<QString, Estimate> estimates_;
+    QHash<QString, int> pending_scans_;
+    // the directories being read, with the id of their scan, and the ones
+    // that changed meanwhile, which are read again once it finishes
+    QHash<QString, quint64> scanning_;
+    QSet<QString> rescan_;
+    quint64 next_scan_id_ {0};
+    QFileSystemWatcher watcher_;
+    QSet<QString> watched_dirs_;
+    QThreadPool pool_;
+    QSharedPointer<std::atomic<bool>> stopping_;
+    ConnectionHelper connections_;
+
+    // inotify watches are a limited resource shared with the rest of
+    // the session. Directories past this limit are not updated
+    static constexpr int MAX_WATCHED_DIRS {4096};
+};
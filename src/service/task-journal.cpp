@@ -0,0 +1,297 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include "task-journal.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+// JSON Keys
+namespace
+{
+    constexpr const char MODE_KEY[]     = "mode";
+    constexpr const char STORAGE_KEY[]  = "storage";
+    constexpr const char DIR_NAME_KEY[] = "dir-name";
+    constexpr const char TASKS_KEY[]    = "tasks";
+    constexpr const char STATUS_KEY[]   = "status";
+    constexpr const char METADATA_KEY[] = "metadata";
+    constexpr const char SIZE_KEY[]     = "size";
+    constexpr const char PARTS_KEY[]    = "committed-parts";
+    constexpr const char HASHES_KEY[]   = "part-hashes";
+
+    constexpr const char STATUS_QUEUED[]   = "queued";
+    constexpr const char STATUS_COMPLETE[] = "complete";
+    constexpr const char STATUS_FAILED[]   = "failed";
+
+    QString status_to_string(TaskJournal::TaskStatus status)
+    {
+        switch (status)
+        {
+            case TaskJournal::TaskStatus::COMPLETE: return QLatin1String(STATUS_COMPLETE);
+            case TaskJournal::TaskStatus::FAILED:   return QLatin1String(STATUS_FAILED);
+            case TaskJournal::TaskStatus::QUEUED:   break;
+        }
+        return QLatin1String(STATUS_QUEUED);
+    }
+
+    TaskJournal::TaskStatus status_from_string(QString const & status)
+    {
+        if (status == QLatin1String(STATUS_COMPLETE))
+            return TaskJournal::TaskStatus::COMPLETE;
+        if (status == QLatin1String(STATUS_FAILED))
+            return TaskJournal::TaskStatus::FAILED;
+        return TaskJournal::TaskStatus::QUEUED;
+    }
+}
+
+/***
+****
+***/
+
+TaskJournal::TaskJournal(QString const & path)
+    : path_(path)
+{
+}
+
+QString TaskJournal::default_path()
+{
+    return QStringLiteral("%1/keeper/task-journal.json")
+        .arg(QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation));
+}
+
+void TaskJournal::begin(QString const & mode,
+                        QString const & storage,
+                        QString const & dir_name,
+                        QList<Metadata> const & tasks)
+{
+    mode_ = mode;
+    storage_ = storage;
+    dir_name_ = dir_name;
+    tasks_.clear();
+    for (auto const & metadata : tasks)
+        tasks_.push_back(Task{metadata, TaskStatus::QUEUED});
+
+    remove_catalogs();
+    save();
+}
+
+void TaskJournal::set_task_finished(Metadata const & metadata, bool success)
+{
+    auto const uuid = metadata.get_uuid();
+    for (auto & task : tasks_)
+    {
+        if (task.metadata.get_uuid() == uuid)
+        {
+            task.metadata = metadata;
+            task.status = success ? TaskStatus::COMPLETE : TaskStatus::FAILED;
+            task.size = 0;
+            task.committed_parts.clear();
+            task.part_hashes.clear();
+            save();
+            return;
+        }
+    }
+    qWarning() << "Task" << uuid << "is not in the task journal";
+}
+
+void TaskJournal::set_task_parts(QString const & uuid,
+                                 qint64 size,
+                                 QStringList const & committed_parts,
+                                 QStringList const & part_hashes)
+{
+    for (auto & task : tasks_)
+    {
+        if (task.metadata.get_uuid() == uuid)
+        {
+            if (task.status != TaskStatus::QUEUED)
+                return;
+            task.size = size;
+            task.committed_parts = committed_parts;
+            task.part_hashes = part_hashes;
+            save();
+            return;
+        }
+    }
+    qWarning() << "Task" << uuid << "is not in the task journal";
+}
+
+void TaskJournal::clear()
+{
+    mode_.clear();
+    storage_.clear();
+    dir_name_.clear();
+    tasks_.clear();
+
+    if (QFile::exists(path_) && !QFile::remove(path_))
+        qWarning() << "Error removing the task journal" << path_;
+    remove_catalogs();
+}
+
+QString TaskJournal::catalog_path(QString const & uuid) const
+{
+    return QStringLiteral("%1/%2.catalog").arg(catalogs_dir()).arg(uuid);
+}
+
+bool TaskJournal::load()
+{
+    mode_.clear();
+    storage_.clear();
+    dir_name_.clear();
+    tasks_.clear();
+
+    QFile file(path_);
+    if (!file.exists())
+        return false;
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        qWarning() << "Error opening the task journal" << path_ << ":" << file.errorString();
+        return false;
+    }
+
+    QJsonParseError error;
+    auto const doc = QJsonDocument::fromJson(file.readAll(), &error);
+    if (error.error != QJsonParseError::NoError)
+    {
+        qWarning() << path_ << "parse error at offset" << error.offset << error.errorString();
+        return false;
+    }
+
+    auto const root = doc.object();
+    mode_ = root[MODE_KEY].toString();
+    storage_ = root[STORAGE_KEY].toString();
+    dir_name_ = root[DIR_NAME_KEY].toString();
+    for (auto const & value : root[TASKS_KEY].toArray())
+    {
+        auto const task = value.toObject();
+        QStringList committed_parts;
+        for (auto const & part : task[PARTS_KEY].toArray())
+            committed_parts << part.toString();
+        QStringList part_hashes;
+        for (auto const & hash : task[HASHES_KEY].toArray())
+            part_hashes << hash.toString();
+        tasks_.push_back(Task{
+            Metadata(task[METADATA_KEY].toObject()),
+            status_from_string(task[STATUS_KEY].toString()),
+            qint64(task[SIZE_KEY].toDouble()),
+            committed_parts,
+            part_hashes
+        });
+    }
+
+    return !mode_.isEmpty() && !tasks_.isEmpty();
+}
+
+QString TaskJournal::mode() const
+{
+    return mode_;
+}
+
+QString TaskJournal::storage() const
+{
+    return storage_;
+}
+
+QString TaskJournal::dir_name() const
+{
+    return dir_name_;
+}
+
+QList<TaskJournal::Task> TaskJournal::tasks() const
+{
+    return tasks_;
+}
+
+QList<TaskJournal::Task> TaskJournal::tasks(TaskStatus status) const
+{
+    QList<Task> ret;
+    for (auto const & task : tasks_)
+    {
+        if (task.status == status)
+            ret.push_back(task);
+    }
+    return ret;
+}
+
+QString TaskJournal::path() const
+{
+    return path_;
+}
+
+QString TaskJournal::catalogs_dir() const
+{
+    QFileInfo const info(path_);
+    return QStringLiteral("%1/%2-catalogs").arg(info.absolutePath()).arg(info.completeBaseName());
+}
+
+void TaskJournal::remove_catalogs() const
+{
+    QDir dir(catalogs_dir());
+    if (dir.exists() && !dir.removeRecursively())
+        qWarning() << "Error removing the file catalogs of the task journal" << dir.path();
+}
+
+bool TaskJournal::save() const
+{
+    QJsonArray json_tasks;
+    for (auto const & task : tasks_)
+    {
+        QJsonObject json_task;
+        json_task[STATUS_KEY] = status_to_string(task.status);
+        json_task[METADATA_KEY] = task.metadata.json();
+        if (!task.committed_parts.isEmpty())
+        {
+            json_task[SIZE_KEY] = double(task.size);
+            json_task[PARTS_KEY] = QJsonArray::fromStringList(task.committed_parts);
+            json_task[HASHES_KEY] = QJsonArray::fromStringList(task.part_hashes);
+        }
+        json_tasks.append(json_task);
+    }
+
+    QJsonObject root;
+    root[MODE_KEY] = mode_;
+    root[STORAGE_KEY] = storage_;
+    root[DIR_NAME_KEY] = dir_name_;
+    root[TASKS_KEY] = json_tasks;
+
+    QDir().mkpath(QFileInfo(path_).absolutePath());
+
+    // write a new file and rename it, so an interrupted write
+    // never leaves a truncated journal behind
+    QSaveFile file(path_);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qWarning() << "Error opening the task journal" << path_ << ":" << file.errorString();
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    if (!file.commit())
+    {
+        qWarning() << "Error writing the task journal" << path_ << ":" << file.errorString();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#pragma once
+
+#include "helper/metadata.h"
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+/**
+ * On-disk journal of the backup or restore run in progress.
+ *
+ * It is rewritten every time a task finishes or stores a part of its
+ * archive, and removed when the run is over, so a run interrupted by a
+ * service restart can be resumed without redoing the tasks that already
+ * finished nor sending again the parts that were already stored.
+ *
+ * The file catalogs sent by the backup helpers are kept in a directory
+ * next to it until the manifest is stored, as they are stored with it.
+ */
+class TaskJournal
+{
+public:
+    enum class TaskStatus { QUEUED, COMPLETE, FAILED };
+
+    struct Task
+    {
+        Metadata metadata;
+        TaskStatus status;
+
+        // the size of the archive of an unfinished backup task, the remote
+        // files of its first parts, which are stored already, and the hashes
+        // of their data, to check them against the archive of the next run
+        qint64 size {0};
+        QStringList committed_parts {};
+        QStringList part_hashes {};
+    };
+
+    explicit TaskJournal(QString const & path = default_path());
+
+    // starts journaling a new run, replacing any previous one
+    void begin(QString const & mode,
+               QString const & storage,
+               QString const & dir_name,
+               QList<Metadata> const & tasks);
+
+    // the metadata of a completed backup task includes the
+    // file it was stored in, so it is also its manifest entry
+    void set_task_finished(Metadata const & metadata, bool success);
+
+    // the first parts of the archive of the task are stored
+    void set_task_parts(QString const & uuid,
+                        qint64 size,
+                        QStringList const & committed_parts,
+                        QStringList const & part_hashes);
+
+    // the run is over, nothing is left to resume
+    void clear();
+
+    // where the file catalog of the task is kept during the run
+    QString catalog_path(QString const & uuid) const;
+
+    // returns true if an unfinished run was found
+    bool load();
+
+    QString mode() const;
+    QString storage() const;
+    QString dir_name() const;
+    QList<Task> tasks() const;
+    QList<Task> tasks(TaskStatus status) const;
+
+    QString path() const;
+
+    static QString default_path();
+
+private:
+    bool save() const;
+    void remove_catalogs() const;
+    QString catalogs_dir() const;
+
+    QString path_;
+    QString mode_;
+    QString storage_;
+    QString dir_name_;
+    QList<Task> tasks_;
+};
@@ -23,9 +23,118 @@
 #include "keeper-task-restore.h"
 #include "manifest.h"
 #include "storage-framework/storage_framework_client.h"
+#include "task-journal.h"
 #include "task-manager.h"
+#include "task-scheduler.h"
 #include "util/connection-helper.h"
 #include "util/dbus-utils.h"
+#include "util/logging.h"
+#include "util/metrics.h"
+#include "util/tracing.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QFutureInterface>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QThreadPool>
+
+#include <cerrno>
+#include <cstring> // strerror()
+
+#include <unistd.h> // dup(), close()
+
+// task journal modes
+namespace
+{
+    constexpr const char BACKUP_MODE[]  = "backup";
+    constexpr const char RESTORE_MODE[] = "restore";
+
+    // the file catalogs are copied from the helpers by pieces of this size
+    constexpr qint64 CATALOG_COPY_CHUNK {64 * 1024};
+
+    // copies the file catalog sent by a helper to path, out of the main
+    // thread, and closes the descriptor. Reports whether it was kept
+    class CatalogCopy : public QRunnable
+    {
+    public:
+        CatalogCopy(int catalog_fd, QString const & path, QFutureInterface<bool> const & fi)
+            : catalog_fd_(catalog_fd)
+            , path_(path)
+            , fi_(fi)
+        {
+        }
+
+        void run() override
+        {
+            fi_.reportResult(copy());
+            fi_.reportFinished();
+        }
+
+    private:
+        bool copy() const
+        {
+            QFile in;
+            if (!in.open(catalog_fd_, QIODevice::ReadOnly, QFileDevice::AutoCloseHandle))
+            {
+                qWarning() << "Unable to read the file catalog" << path_ << ":" << in.errorString();
+                ::close(catalog_fd_);
+                return false;
+            }
+            QSaveFile out(path_);
+            if (!out.open(QIODevice::WriteOnly))
+            {
+                qWarning() << "Unable to keep the file catalog" << path_ << ":" << out.errorString();
+                return false;
+            }
+            while (!in.atEnd())
+            {
+                auto const chunk = in.read(CATALOG_COPY_CHUNK);
+                if (chunk.isEmpty() || out.write(chunk) != chunk.size())
+                {
+                    qWarning() << "Unable to keep the file catalog" << path_ << ":" << in.errorString() << out.errorString();
+                    out.cancelWriting();
+                    break;
+                }
+            }
+            if (!out.commit())
+                return false;
+            qDebug() << "Got a file catalog of" << QFileInfo(path_).size() << "bytes in" << path_;
+            return true;
+        }
+
+        int const catalog_fd_;
+        QString const path_;
+        QFutureInterface<bool> fi_;
+    };
+
+    QString error_label(keeper::Error error)
+    {
+        switch (error)
+        {
+            case keeper::Error::OK:
+            case keeper::Error::UNKNOWN:                           return QStringLiteral("unknown");
+            case keeper::Error::HELPER_READ:                       return QStringLiteral("helper_read");
+            case keeper::Error::HELPER_WRITE:                      return QStringLiteral("helper_write");
+            case keeper::Error::HELPER_INACTIVITY_DETECTED:        return QStringLiteral("helper_inactivity_detected");
+            case keeper::Error::HELPER_SOCKET:                     return QStringLiteral("helper_socket");
+            case keeper::Error::HELPER_START_TIMEOUT:              return QStringLiteral("helper_start_timeout");
+            case keeper::Error::NO_HELPER_INFORMATION_IN_REGISTRY: return QStringLiteral("no_helper_information_in_registry");
+            case keeper::Error::HELPER_BAD_URL:                    return QStringLiteral("helper_bad_url");
+            case keeper::Error::MANIFEST_STORAGE:                  return QStringLiteral("manifest_storage");
+            case keeper::Error::COMMITTING_DATA:                   return QStringLiteral("committing_data");
+            case keeper::Error::CREATING_REMOTE_DIR:               return QStringLiteral("creating_remote_dir");
+            case keeper::Error::CREATING_REMOTE_FILE:              return QStringLiteral("creating_remote_file");
+            case keeper::Error::READING_REMOTE_FILE:               return QStringLiteral("reading_remote_file");
+            case keeper::Error::REMOTE_DIR_NOT_EXISTS:             return QStringLiteral("remote_dir_not_exists");
+            case keeper::Error::NO_REMOTE_ACCOUNTS:                return QStringLiteral("no_remote_accounts");
+            case keeper::Error::NO_REMOTE_ROOTS:                   return QStringLiteral("no_remote_roots");
+            case keeper::Error::ACCOUNT_NOT_FOUND:                 return QStringLiteral("account_not_found");
+        }
+        return QStringLiteral("unknown");
+    }
+}
 
 class TaskManagerPrivate
 {
@@ -36,7 +145,21 @@ public:
         : q_ptr(manager)
         , helper_registry_(helper_registry)
         , storage_(storage)
+        , scheduler_(std::bind(&TaskManagerPrivate::start_task, this, std::placeholders::_1))
     {
+        scheduler_.set_max_running(default_max_concurrent_tasks());
+
+        QObject::connect(&scheduler_, &TaskScheduler::task_promoted,
+            std::bind(&TaskManagerPrivate::on_task_promoted, this, std::placeholders::_1)
+        );
+
+        QObject::connect(&scheduler_, &TaskScheduler::task_deactivated,
+            std::bind(&TaskManagerPrivate::deactivate_task, this, std::placeholders::_1)
+        );
+
+        QObject::connect(&scheduler_, &TaskScheduler::all_finished,
+            std::bind(&TaskManagerPrivate::on_all_tasks_finished, this)
+        );
     }
 
     ~TaskManagerPrivate() = default;
@@ -46,7 +169,16 @@ public:
         auto const now = QDateTime::currentDateTime();
         backup_dir_name_ = now.toString("yyyy-MM-ddTHH-mm-ss");
         active_manifest_.reset(new Manifest(storage_, backup_dir_name_), [](Manifest *m){m->deleteLater();});
-        return start_tasks(tasks, storage, Mode::BACKUP);
+
+        // the size estimates only describe the choices,
+        // they are not part of the tasks or the manifest
+        auto backup_tasks = tasks;
+        for (auto& task : backup_tasks)
+        {
+            task.remove(keeper::Item::SIZE_ESTIMATE_KEY);
+            task.remove(keeper::Item::FILE_COUNT_KEY);
+        }
+        return start_tasks(backup_tasks, storage, Mode::BACKUP);
     }
 
     bool start_restore(QList<Metadata> const& tasks, QString const & storage)
@@ -76,46 +208,141 @@ public:
 //        return state_;
     }
 
-    void ask_for_uploader(quint64 n_bytes)
+    keeper::Items get_state_since(quint64 since, quint64 & version, bool & full) const
     {
-        qDebug() << "Starting backup";
-        if (task_)
+        version = state_version_;
+
+        // the removals older than the current run are forgotten,
+        // so callers that are further behind get the whole state
+        full = since == 0 || since < history_start_;
+        if (full)
+            return get_state();
+
+        keeper::Items ret;
+        for (auto iter = state_.begin(); iter != state_.end(); ++iter)
         {
-            auto backup_task_ = qSharedPointerDynamicCast<KeeperTaskBackup>(task_);
-            if (!backup_task_)
+            auto const versions = field_versions_.value(iter.key());
+            keeper::Item item;
+            for (auto field = iter->begin(); field != iter->end(); ++field)
+            {
+                if (versions.value(field.key()) > since)
+                    item.insert(field.key(), field.value());
+            }
+
+            QStringList removed_fields;
+            auto const removed = removed_field_versions_.value(iter.key());
+            for (auto field = removed.begin(); field != removed.end(); ++field)
             {
-                qWarning() << "Only backup tasks are allowed to ask for storage framework sockets";
-                // TODO Mark this as an error at the current task and move to the next task
-                return;
+                if (field.value() > since)
+                    removed_fields << field.key();
             }
-            backup_task_->ask_for_uploader(n_bytes, backup_dir_name_);
+            if (!removed_fields.isEmpty())
+                item.insert(keeper::Item::REMOVED_PROPERTIES_KEY, removed_fields);
+
+            if (!item.isEmpty())
+                ret[iter.key()] = item;
         }
+
+        for (auto iter = removed_versions_.begin(); iter != removed_versions_.end(); ++iter)
+        {
+            if (iter.value() > since)
+                ret[iter.key()] = keeper::Item();
+        }
+
+        return ret;
     }
 
-    void ask_for_downloader()
+    quint64 get_state_version() const
     {
-        qDebug() << "Starting restore";
-        if (task_)
+        return state_version_;
+    }
+
+    void ask_for_uploader(quint64 n_bytes, QString const & helper_path)
+    {
+        qDebug() << "Starting backup for helper" << helper_path;
+        auto const uuid = find_task_for_helper(helper_path);
+        auto backup_task = qSharedPointerDynamicCast<KeeperTaskBackup>(tasks_.value(uuid));
+        if (!backup_task)
         {
-            auto restore_task_ = qSharedPointerDynamicCast<KeeperTaskRestore>(task_);
-            if (!restore_task_)
-            {
-                qWarning() << "Only restore tasks are allowed to ask for storage framework downloaders";
-                // TODO Mark this as an error at the current task and move to the next task
-                return;
-            }
-            restore_task_->ask_for_downloader();
+            qWarning() << "Only backup tasks are allowed to ask for storage framework sockets";
+            Q_EMIT(q_ptr->socket_error(helper_path, keeper::Error::UNKNOWN));
+            return;
+        }
+        socket_requests_[uuid] = helper_path;
+
+        // a prepared task doesn't stream until it gets its slot
+        if (scheduler_.is_preparing(uuid))
+        {
+            held_uploads_[uuid] = n_bytes;
+            backup_task->hold_uploader();
+            return;
         }
+        ask_task_for_uploader(uuid, backup_task, n_bytes);
+    }
+
+    void ask_for_downloader(QString const & helper_path)
+    {
+        qDebug() << "Starting restore for helper" << helper_path;
+        auto const uuid = find_task_for_helper(helper_path);
+        auto restore_task = qSharedPointerDynamicCast<KeeperTaskRestore>(tasks_.value(uuid));
+        if (!restore_task)
+        {
+            qWarning() << "Only restore tasks are allowed to ask for storage framework downloaders";
+            Q_EMIT(q_ptr->socket_error(helper_path, keeper::Error::UNKNOWN));
+            return;
+        }
+        socket_requests_[uuid] = helper_path;
+        restore_task->ask_for_downloader();
+    }
+
+    QFuture<bool> set_file_catalog(QString const & helper_path, int catalog_fd)
+    {
+        QFutureInterface<bool> fi;
+        fi.reportStarted();
+
+        // the helper already has its socket, so its task is
+        // the one whose socket request came from the same path
+        auto uuid = find_task_for_helper(helper_path);
+        if (socket_requests_.value(uuid) != helper_path)
+            uuid = socket_requests_.key(helper_path);
+        if (uuid.isEmpty() || !qSharedPointerDynamicCast<KeeperTaskBackup>(tasks_.value(uuid)))
+        {
+            qWarning() << "Only running backup tasks can set their file catalog";
+            fi.reportResult(false);
+            fi.reportFinished();
+            return fi.future();
+        }
+
+        // the caller's descriptor is closed once it returns
+        auto const fd = ::dup(catalog_fd);
+        if (fd == -1)
+        {
+            qWarning() << "Unable to keep the file catalog of" << uuid << ":" << strerror(errno);
+            fi.reportResult(false);
+            fi.reportFinished();
+            return fi.future();
+        }
+
+        // it is journaled, so a resumed run still stores it
+        auto const path = journal_.catalog_path(uuid);
+        QDir().mkpath(QFileInfo(path).absolutePath());
+        QThreadPool::globalInstance()->start(new CatalogCopy(fd, path, fi));
+        return fi.future();
     }
 
     void cancel()
     {
         qDebug() << "=============== CANCELING =======================";
-        if (task_)
+        // the cancelled tasks keep reporting their state,
+        // but they no longer count as running tasks
+        auto const queued = scheduler_.queued();
+        auto const running = scheduler_.clear();
+        for (auto const & uuid : running)
         {
-            task_->cancel();
+            tasks_[uuid]->cancel();
+            record_task_finished(uuid, QStringLiteral("cancelled"));
         }
-        for (auto const & task: remaining_tasks_)
+        for (auto const & task: queued)
         {
             auto& td = task_data_[task];
             td.action = QStringLiteral("cancelled"); // TODO i18n
@@ -123,20 +350,106 @@ public:
         }
         // notify the initial state once for all tasks
         notify_state_changed();
-        remaining_tasks_.clear();
+        journal_.clear();
+        if (run_span_)
+            run_span_->set_arg(QStringLiteral("cancelled"), true);
+        run_span_.reset();
+        write_metrics();
         Q_EMIT(q_ptr->finished());
     }
 
+    QString resume()
+    {
+        if (is_busy() || !journal_.load())
+            return QString();
+
+        Mode mode;
+        if (journal_.mode() == QLatin1String(BACKUP_MODE))
+            mode = Mode::BACKUP;
+        else if (journal_.mode() == QLatin1String(RESTORE_MODE))
+            mode = Mode::RESTORE;
+        else
+        {
+            qWarning() << "Unknown mode" << journal_.mode() << "in the task journal, it is discarded";
+            journal_.clear();
+            return QString();
+        }
+        qDebug() << "Resuming the interrupted" << journal_.mode() << "with"
+                 << journal_.tasks(TaskJournal::TaskStatus::QUEUED).size() << "unfinished tasks";
+
+        if (mode == Mode::BACKUP)
+        {
+            backup_dir_name_ = journal_.dir_name();
+            active_manifest_.reset(new Manifest(storage_, backup_dir_name_), [](Manifest *m){m->deleteLater();});
+            for (auto const& task : journal_.tasks(TaskJournal::TaskStatus::COMPLETE))
+            {
+                auto const uuid = task.metadata.get_uuid();
+                active_manifest_->add_entry(task.metadata);
+                if (QFile::exists(journal_.catalog_path(uuid)))
+                    active_manifest_->add_file_catalog(uuid, journal_.catalog_path(uuid));
+            }
+        }
+
+        reset_run(journal_.storage(), mode);
+
+        // the tasks that finished before the service stopped are not redone
+        QStringList queued;
+        for (auto const& task : journal_.tasks())
+        {
+            auto const uuid = task.metadata.get_uuid();
+            auto& td = task_data_[uuid];
+            td.metadata = task.metadata;
+            td.error = keeper::Error::OK;
+
+            switch (task.status)
+            {
+                case TaskJournal::TaskStatus::QUEUED:
+                    queued << uuid;
+                    if (!task.committed_parts.isEmpty())
+                        resumed_uploads_[uuid] = task;
+                    td.action = QStringLiteral("queued"); // TODO i18n
+                    set_initial_task_state(td);
+                    break;
+
+                case TaskJournal::TaskStatus::COMPLETE:
+                    td.action = QStringLiteral("complete"); // TODO i18n
+                    set_finished_task_state(td, true);
+                    break;
+
+                case TaskJournal::TaskStatus::FAILED:
+                    td.action = QStringLiteral("failed"); // TODO i18n
+                    set_finished_task_state(td, false);
+                    break;
+            }
+        }
+
+        // notify the initial state once for all tasks
+        notify_state_changed();
+
+        scheduler_.start(queued);
+
+        return QLatin1String(mode == Mode::BACKUP ? BACKUP_MODE : RESTORE_MODE);
+    }
+
+    void set_max_concurrent_tasks(int max_tasks)
+    {
+        scheduler_.set_max_running(max_tasks);
+    }
+
+    int max_concurrent_tasks() const
+    {
+        return scheduler_.max_running();
+    }
+
 private:
 
     enum class Mode { IDLE, BACKUP, RESTORE };
 
     bool start_tasks(QList<Metadata> const& tasks, QString const & storage, Mode mode)
     {
-        storage_->set_storage(storage);
         bool success = true;
 
-        if (!remaining_tasks_.isEmpty())
+        if (is_busy())
         {
             // FIXME: return a dbus error here
             qWarning() << "keeper is already active";
@@ -144,19 +457,14 @@ private:
         }
         else
         {
-            // rebuild the state variables
-            state_.clear();
-            task_data_.clear();
-            current_task_.clear();
-            remaining_tasks_.clear();
-
-            mode_ = mode;
+            reset_run(storage, mode);
 
+            QStringList uuids;
             for(auto const& metadata : tasks)
             {
                 auto const uuid = metadata.get_uuid();
 
-                remaining_tasks_ << uuid;
+                uuids << uuid;
 
                 auto& td = task_data_[uuid];
                 td.metadata = metadata;
@@ -165,77 +473,206 @@ private:
                 set_initial_task_state(td);
             }
 
+            journal_.begin(QLatin1String(mode == Mode::BACKUP ? BACKUP_MODE : RESTORE_MODE),
+                           storage,
+                           backup_dir_name_,
+                           tasks);
+
             // notify the initial state once for all tasks
             notify_state_changed();
 
-            start_next_task();
+            scheduler_.start(uuids);
         }
 
         return success;
     }
 
+    bool is_busy() const
+    {
+        return scheduler_.is_busy();
+    }
+
+    // rebuild the state variables.
+    // Tasks from the previous run are reported as removed in the next delta
+    void reset_run(QString const & storage, Mode mode)
+    {
+        storage_->set_storage(storage);
+        scheduler_.clear();
+
+        // clients that missed the removals of the previous runs get the whole state
+        history_start_ = state_version_;
+        removed_versions_.clear();
+        removed_field_versions_.clear();
+        for (auto const& uuid : state_.keys())
+            remove_task_state(uuid);
+        state_.clear();
+        for (auto const& task : tasks_)
+            task->disconnect();
+        tasks_.clear();
+        task_data_.clear();
+        socket_requests_.clear();
+        held_uploads_.clear();
+        resumed_uploads_.clear();
+        last_task_.clear();
+
+        mode_ = mode;
+
+        // backup helpers enumerate and size their files before they stream,
+        // so the next one does it while the current ones upload
+        scheduler_.set_max_preparing(mode == Mode::BACKUP ? DEFAULT_MAX_PREPARING_TASKS : 0);
+
+        // every run gets its own trace, which the helpers of its tasks join
+        task_spans_.clear();
+        task_timers_.clear();
+        manifest_span_.reset();
+        run_span_.reset();
+        util::Tracing::start_trace();
+        run_span_.reset(new util::TraceSpan(QLatin1String(mode == Mode::BACKUP ? BACKUP_MODE : RESTORE_MODE)));
+    }
+
     void manifest_stored(bool success)
     {
-        qDebug() << "Manifest upload finished success = " << success << " current task=" << current_task_;
-        auto& td = task_data_[current_task_];
-        if (success)
+        qDebug() << "Manifest upload finished success = " << success << " last task=" << last_task_;
+        // a resumed run may have no task of its own left to report
+        if (tasks_.contains(last_task_))
         {
-            update_task_state(td);
-        }
-        else
-        {
-            td.error = keeper::Error::MANIFEST_STORAGE;
-            set_current_task_action(task_->to_string(Helper::State::FAILED));
+            auto& td = task_data_[last_task_];
+            if (success)
+            {
+                update_task_state(last_task_);
+            }
+            else
+            {
+                td.error = keeper::Error::MANIFEST_STORAGE;
+                set_task_action(last_task_, tasks_[last_task_]->to_string(Helper::State::FAILED));
+            }
         }
+        if (!success)
+            util::Metrics::add(util::METRIC_TASK_FAILURES, 1, {{QStringLiteral("error"), error_label(keeper::Error::MANIFEST_STORAGE)}});
         active_manifest_.reset();
+        journal_.clear();
+
+        if (manifest_span_)
+            manifest_span_->set_arg(QStringLiteral("success"), success);
+        manifest_span_.reset();
+        run_span_.reset();
+        write_metrics();
 
         Q_EMIT(q_ptr->finished());
     }
 
-    void on_helper_state_changed(Helper::State state)
+    void on_helper_state_changed(QString const& uuid, Helper::State state)
     {
-        auto backup_task_ = qSharedPointerDynamicCast<KeeperTaskBackup>(task_);
-        auto& td = task_data_[current_task_];
+        if (!tasks_.contains(uuid))
+            return;
+
+        auto const finished = scheduler_.is_running(uuid)
+                           && (state == Helper::State::COMPLETE || state == Helper::State::FAILED);
+        auto const is_last = finished && scheduler_.is_last(uuid);
 
-        // for the last completed backup task we delay updating the
+        // for the last completed task we delay updating the
         // state until the manifest file is stored
-        if (remaining_tasks_.size() || (state != Helper::State::COMPLETE && state != Helper::State::FAILED))
-            update_task_state(td);
+        if (!is_last)
+            update_task_state(uuid);
 
-        if (state == Helper::State::COMPLETE || state == Helper::State::FAILED)
+        // a helper cancelled on its own leaves its place to the next task
+        if (state == Helper::State::CANCELLED)
         {
-            if (backup_task_ && state == Helper::State::COMPLETE && active_manifest_)
-            {
-                qDebug() << "Backup task finished. The file created in storage framework is: [" << backup_task_->get_file_name() << "]";
-                td.metadata.set_property_value(keeper::Item::FILE_NAME_KEY, backup_task_->get_file_name());
-                td.metadata.set_property_value(keeper::Item::DIR_NAME_KEY, backup_dir_name_);
-                active_manifest_->add_entry(td.metadata);
-            }
-            if (remaining_tasks_.size())
-            {
-                qDebug() << "STARTING NEXT TASK ---------------------------------------";
-                start_next_task();
-            }
-            else
-            {
-                if (active_manifest_ && active_manifest_->get_entries().size())
-                {
-                    qDebug() << "STORING MANIFEST------------";
-                    connections_.connect_oneshot(
-                        active_manifest_.data(),
-                        &Manifest::finished,
-                        std::function<void(bool)>{[this](bool success){
-                            manifest_stored(success);
-                        }}
-                    );
-                    active_manifest_->store();
-                }
-                else
-                {
-                    update_task_state(td);
-                }
-            }
+            task_spans_.remove(uuid);
+            record_task_finished(uuid, QStringLiteral("cancelled"));
+            scheduler_.set_finished(uuid);
+            return;
+        }
+
+        // once a backup helper exits with all its data sent only the commit
+        // of the remote file is left, so the next task can launch its helper
+        // and prepare its archive and uploader meanwhile
+        if (state == Helper::State::DATA_COMPLETE && mode_ == Mode::BACKUP)
+        {
+            scheduler_.set_committing(uuid);
+            return;
+        }
+
+        if (!finished)
+            return;
+
+        auto backup_task = qSharedPointerDynamicCast<KeeperTaskBackup>(tasks_[uuid]);
+        if (backup_task && state == Helper::State::COMPLETE && active_manifest_)
+        {
+            auto& td = task_data_[uuid];
+            qDebug() << "Backup task finished. The file created in storage framework is: [" << backup_task->get_file_name() << "]";
+            td.metadata.set_property_value(keeper::Item::FILE_NAME_KEY, backup_task->get_file_name());
+            td.metadata.set_property_value(keeper::Item::DIR_NAME_KEY, backup_dir_name_);
+            auto const part_file_names = backup_task->get_part_file_names();
+            if (part_file_names.size() > 1)
+                td.metadata.set_part_file_names(part_file_names);
+            active_manifest_->add_entry(td.metadata);
+            if (QFile::exists(journal_.catalog_path(uuid)))
+                active_manifest_->add_file_catalog(uuid, journal_.catalog_path(uuid));
         }
+        journal_.set_task_finished(task_data_[uuid].metadata, state == Helper::State::COMPLETE);
+        if (task_spans_.contains(uuid))
+            task_spans_[uuid]->set_arg(QStringLiteral("success"), state == Helper::State::COMPLETE);
+        task_spans_.remove(uuid);
+        record_task_finished(uuid, state == Helper::State::COMPLETE ? QStringLiteral("complete") : QStringLiteral("failed"));
+
+        last_task_ = uuid;
+
+        // starts the next tasks, or ends the run if this was the last one
+        scheduler_.set_finished(uuid);
+    }
+
+    // the manifest is only stored once every task of the run is finished,
+    // so it contains all the tasks that completed
+    void on_all_tasks_finished()
+    {
+        if (active_manifest_ && active_manifest_->size())
+        {
+            qDebug() << "STORING MANIFEST------------";
+            manifest_span_.reset(new util::TraceSpan(QStringLiteral("manifest store"), {
+                {QStringLiteral("entries"), active_manifest_->size()}
+            }));
+            connections_.connect_oneshot(
+                active_manifest_.data(),
+                &Manifest::finished,
+                std::function<void(bool)>{[this](bool success){
+                    manifest_stored(success);
+                }}
+            );
+            active_manifest_->store();
+        }
+        else
+        {
+            if (tasks_.contains(last_task_))
+                update_task_state(last_task_);
+            journal_.clear();
+            run_span_.reset();
+            write_metrics();
+            Q_EMIT(q_ptr->finished());
+        }
+    }
+
+    // a task is only recorded once, whatever reports its end first
+    void record_task_finished(QString const & uuid, QString const & result)
+    {
+        if (!task_timers_.contains(uuid))
+            return;
+
+        auto const mode = QString::fromLatin1(mode_ == Mode::BACKUP ? BACKUP_MODE : RESTORE_MODE);
+        util::Metrics::observe(util::METRIC_TASK_DURATION, task_timers_.take(uuid).nsecsElapsed() / 1e9, {
+            {QStringLiteral("mode"), mode},
+            {QStringLiteral("result"), result}
+        });
+        if (result == QStringLiteral("failed"))
+            util::Metrics::add(util::METRIC_TASK_FAILURES, 1, {{QStringLiteral("error"), error_label(task_data_[uuid].error)}});
+    }
+
+    void write_metrics()
+    {
+        // written in the Prometheus format after every run, when set
+        auto const path = util::Metrics::configured_file();
+        if (!path.isEmpty())
+            util::Metrics::write_prometheus(path);
     }
 
     /***
@@ -256,99 +693,238 @@ private:
         qDebug() << "Creating task for uuid = " << uuid;
         // initialize a new task
 
-        if (task_)
-            task_.data()->disconnect();
-
+        QSharedPointer<KeeperTask> task;
         if (mode_ == Mode::BACKUP)
         {
-            task_.reset(new KeeperTaskBackup(td, helper_registry_, storage_));
+            task.reset(new KeeperTaskBackup(td, helper_registry_, storage_));
         }
         else
         {
-            task_.reset(new KeeperTaskRestore(td, helper_registry_, storage_));
+            task.reset(new KeeperTaskRestore(td, helper_registry_, storage_));
         }
 
-        qDebug() << "task created: " << state_;
+        // every task gets its own helper path, so concurrent helpers
+        // are given the socket of their own task
+        task->set_helper_bus_path(QStringLiteral("%1/task%2").arg(DBusTypes::KEEPER_HELPER_PATH).arg(++n_started_tasks_));
+
+        tasks_[uuid] = task;
+        Q_EMIT(q_ptr->helper_path_added(task->helper_bus_path()));
+
+        qCDebug(util::logState) << "task created: " << state_;
 
-        set_current_task(uuid);
+        task_spans_[uuid].reset(new util::TraceSpan(QStringLiteral("task"), {
+            {QStringLiteral("uuid"), uuid},
+            {QStringLiteral("display-name"), td.metadata.get_display_name()}
+        }));
+        task_timers_[uuid].start();
 
-        QObject::connect(task_.data(), &KeeperTask::task_state_changed,
-            std::bind(&TaskManagerPrivate::on_helper_state_changed, this, std::placeholders::_1)
+        update_task_state(uuid);
+
+        QObject::connect(task.data(), &KeeperTask::task_state_changed,
+            std::bind(&TaskManagerPrivate::on_helper_state_changed, this, uuid, std::placeholders::_1)
         );
 
-        QObject::connect(task_.data(), &KeeperTask::task_socket_ready,
-            std::bind(&TaskManager::socket_ready, q_ptr, std::placeholders::_1)
+        QObject::connect(task.data(), &KeeperTask::task_socket_ready,
+            std::bind(&TaskManagerPrivate::on_task_socket_ready, this, uuid, std::placeholders::_1)
         );
 
-        QObject::connect(task_.data(), &KeeperTask::task_socket_error,
-                    std::bind(&TaskManagerPrivate::on_task_socket_error, this, std::placeholders::_1)
+        QObject::connect(task.data(), &KeeperTask::task_socket_error,
+            std::bind(&TaskManagerPrivate::on_task_socket_error, this, uuid, std::placeholders::_1)
         );
 
-        return task_->start();
+        auto backup_task = qSharedPointerDynamicCast<KeeperTaskBackup>(task);
+        if (backup_task)
+        {
+            QObject::connect(backup_task.data(), &KeeperTaskBackup::task_parts_committed,
+                [this, uuid](quint64 n_bytes, QStringList const & part_file_names, QStringList const & part_hashes){
+                    journal_.set_task_parts(uuid, qint64(n_bytes), part_file_names, part_hashes);
+                }
+            );
+        }
+
+        return task->start();
     }
 
-    void on_task_socket_error(keeper::Error error)
+    // the helper of a prepared task asked for its uploader before the
+    // task got its slot, so the request was held until now
+    void on_task_promoted(QString const& uuid)
     {
-        if (!task_)
+        qDebug() << "Task" << uuid << "got its slot";
+        if (!held_uploads_.contains(uuid))
+            return;
+
+        auto backup_task = qSharedPointerDynamicCast<KeeperTaskBackup>(tasks_.value(uuid));
+        auto const n_bytes = held_uploads_.take(uuid);
+        if (backup_task)
+            ask_task_for_uploader(uuid, backup_task, n_bytes);
+    }
+
+    // the parts stored by the interrupted attempt of a resumed task are only
+    // kept when its archive has the same size and they were journaled with
+    // their hashes, otherwise it starts over. The uploader checks the hashes
+    void ask_task_for_uploader(QString const & uuid, QSharedPointer<KeeperTaskBackup> const & backup_task, quint64 n_bytes)
+    {
+        QStringList committed_parts;
+        QStringList part_hashes;
+        auto const resumed = resumed_uploads_.take(uuid);
+        if (!resumed.committed_parts.isEmpty())
         {
-            qWarning() << "Error updating current task state";
+            if (quint64(resumed.size) != n_bytes)
+                qDebug() << "The archive of" << uuid << "changed, its stored parts are not reused";
+            else if (resumed.part_hashes.size() != resumed.committed_parts.size())
+                qDebug() << "The stored parts of" << uuid << "can't be checked, they are not reused";
+            else
+            {
+                committed_parts = resumed.committed_parts;
+                part_hashes = resumed.part_hashes;
+            }
         }
-        auto& td = task_data_[current_task_];
-        td.error = error;
-        set_current_task_action(task_->to_string(Helper::State::FAILED));
-        Q_EMIT(q_ptr->socket_error(error));
+        backup_task->ask_for_uploader(n_bytes, backup_dir_name_, committed_parts, part_hashes);
     }
 
-    void set_current_task(QString const& uuid)
+    // the task is no longer running, so its helper path is not needed anymore
+    void deactivate_task(QString const& uuid)
     {
-        auto const prev = current_task_;
+        held_uploads_.remove(uuid);
+        socket_requests_.remove(uuid);
+        if (tasks_.contains(uuid))
+            Q_EMIT(q_ptr->helper_path_removed(tasks_[uuid]->helper_bus_path()));
+    }
 
-        current_task_ = uuid;
+    QString find_task_for_helper(QString const & helper_path) const
+    {
+        auto const started = scheduler_.active() + scheduler_.preparing();
+        for (auto const& uuid : started)
+        {
+            if (tasks_[uuid]->helper_bus_path() == helper_path)
+                return uuid;
+        }
 
-        if (!uuid.isEmpty())
-            update_task_state(uuid);
+        // helpers that don't use the path of their task get
+        // the oldest running task that has no socket yet
+        for (auto const& uuid : started)
+        {
+            if (!socket_requests_.contains(uuid))
+                return uuid;
+        }
+
+        return QString();
     }
 
-    void clear_current_task()
+    void on_task_socket_ready(QString const& uuid, int fd)
     {
-        set_current_task(QString());
+        Q_EMIT(q_ptr->socket_ready(socket_requests_.value(uuid), fd));
     }
 
-    void start_next_task()
+    void on_task_socket_error(QString const& uuid, keeper::Error error)
     {
-        bool started {false};
-
-        while (!started && !remaining_tasks_.isEmpty())
-            started = start_task(remaining_tasks_.takeFirst());
-
-        if (!started)
-            clear_current_task();
+        auto task = tasks_.value(uuid);
+        if (!task)
+        {
+            qWarning() << "Error updating task state for" << uuid;
+            return;
+        }
+        auto& td = task_data_[uuid];
+        td.error = error;
+        set_task_action(uuid, task->to_string(Helper::State::FAILED));
+        Q_EMIT(q_ptr->socket_error(socket_requests_.value(uuid), error));
     }
 
     /***
     ****  State
     ***/
 
-    void update_task_state(QString const& uuid)
+    void set_initial_task_state(KeeperTask::KeeperTask::TaskData& td)
     {
-        qDebug() << "Updating state for " << uuid << static_cast<void *>(task_.data());
-        auto it = task_data_.find(uuid);
-        if (it == task_data_.end())
+        set_task_state(td.metadata.get_uuid(), KeeperTask::get_initial_state(td));
+    }
+
+    void set_finished_task_state(KeeperTask::KeeperTask::TaskData& td, bool success)
+    {
+        auto task_state = KeeperTask::get_initial_state(td);
+        if (success)
+            task_state.percent_done = 1.0;
+        set_task_state(td.metadata.get_uuid(), task_state);
+    }
+
+    void set_task_state(QString const& uuid, KeeperTask::TaskState const& task_state)
+    {
+        set_task_state(uuid, task_state.to_item());
+    }
+
+    // stores the new state of a task and records the fields that changed,
+    // so they are sent in the next delta tagged with the next state version
+    void set_task_state(QString const& uuid, QVariantMap const& task_state)
+    {
+        auto const next_version = state_version_ + 1;
+        auto& old_state = state_[uuid];
+        auto& versions = field_versions_[uuid];
+        auto& removed = removed_field_versions_[uuid];
+        auto& delta = pending_delta_[uuid];
+
+        for (auto iter = task_state.begin(); iter != task_state.end(); ++iter)
         {
-            qCritical() << "no task data for" << uuid;
-            return;
+            auto const old_value = old_state.find(iter.key());
+            if (old_value == old_state.end() || old_value.value() != iter.value())
+            {
+                versions[iter.key()] = next_version;
+                removed.remove(iter.key());
+                delta.insert(iter.key(), iter.value());
+            }
+        }
+
+        // fields that are no longer set, e.g. the error of a task that is retried
+        for (auto iter = old_state.begin(); iter != old_state.end(); ++iter)
+        {
+            if (!task_state.contains(iter.key()))
+            {
+                versions.remove(iter.key());
+                removed[iter.key()] = next_version;
+            }
         }
 
-        update_task_state(it.value());
+        // a task removed and set again in the same delta replaces the old one
+        QStringList removed_now;
+        for (auto iter = removed.begin(); iter != removed.end(); ++iter)
+        {
+            if (iter.value() == next_version)
+                removed_now << iter.key();
+        }
+        if (removed_now.isEmpty())
+            delta.remove(keeper::Item::REMOVED_PROPERTIES_KEY);
+        else
+            delta.insert(keeper::Item::REMOVED_PROPERTIES_KEY, removed_now);
+
+        if (delta.isEmpty())
+            pending_delta_.remove(uuid);
+
+        removed_versions_.remove(uuid);
+        old_state = task_state;
     }
 
-    void set_initial_task_state(KeeperTask::KeeperTask::TaskData& td)
+    // the fields of the task are remembered as removed too,
+    // in case the task is set again in the same run
+    void remove_task_state(QString const& uuid)
     {
-        state_[td.metadata.get_uuid()] = KeeperTask::get_initial_state(td);
+        auto const next_version = state_version_ + 1;
+        auto& removed = removed_field_versions_[uuid];
+        for (auto const& field : state_.value(uuid).keys())
+            removed[field] = next_version;
+        field_versions_.remove(uuid);
+        pending_delta_[uuid] = keeper::Item();
+        removed_versions_[uuid] = next_version;
     }
 
     void notify_state_changed()
     {
+        if (!pending_delta_.isEmpty())
+        {
+            ++state_version_;
+            keeper::Items delta;
+            delta.swap(pending_delta_);
+            Q_EMIT(q_ptr->state_delta(state_version_, delta));
+        }
+
         DBusUtils::notifyPropertyChanged(
             QDBusConnection::sessionBus(),
             *q_ptr,
@@ -360,17 +936,23 @@ private:
         Q_EMIT(q_ptr->state_changed());
     }
 
-    void update_task_state(KeeperTask::KeeperTask::TaskData& td)
+    void update_task_state(QString const& uuid)
     {
-        auto task_state = task_->state();
+        auto task = tasks_.value(uuid);
+        if (!task)
+        {
+            qCritical() << "no task for" << uuid;
+            return;
+        }
+
+        auto const task_state = task->state();
 
         // avoid sending repeated states to minimize the use of the bus
-        if (task_state != state_[td.metadata.get_uuid()] && !task_state.isEmpty())
+        // the typed state is compared with the published one, so
+        // it's only converted to an item when it changed
+        if (!task_state.is_empty() && !task_state.is_published_in(state_.value(uuid)))
         {
-            state_[td.metadata.get_uuid()] = task_state;
-
-            // FIXME: we don't need this to work correctly for the sprint because Marcus is polling in a loop
-            // but we will need this in order for him to stop doing that
+            set_task_state(uuid, task_state);
 
             // TODO: compare old and new and decide if it's worth emitting a PropertyChanged signal;
             // eg don't contribute to dbus noise for minor speed fluctuations
@@ -378,31 +960,80 @@ private:
         }
     }
 
-    void set_current_task_action(QString const& action)
+    void set_task_action(QString const& uuid, QString const& action)
     {
-        auto& td = task_data_[current_task_];
+        auto& td = task_data_[uuid];
         td.action = action;
-        task_->recalculate_task_state();
-        update_task_state(td);
+        tasks_[uuid]->recalculate_task_state();
+        update_task_state(uuid);
     }
 
     /***
     ****  Misc
     ***/
 
+    // the maximum number of tasks running at once can be set with
+    // the KEEPER_MAX_CONCURRENT_TASKS environment variable
+    static int default_max_concurrent_tasks()
+    {
+        bool ok {false};
+        auto const n_tasks = qgetenv("KEEPER_MAX_CONCURRENT_TASKS").toInt(&ok);
+        if (ok && n_tasks > 0)
+            return n_tasks;
+        return DEFAULT_MAX_CONCURRENT_TASKS;
+    }
+
+    // every helper runs as its own UAL instance, even when the tasks
+    // share the app id, so a few tasks can read and upload at once
+    static constexpr int DEFAULT_MAX_CONCURRENT_TASKS {2};
+
+    // tasks started ahead of time, whose helpers wait for a slot to stream
+    static constexpr int DEFAULT_MAX_PREPARING_TASKS {1};
+
     TaskManager * const q_ptr;
     Mode mode_ {Mode::IDLE};
     QSharedPointer<HelperRegistry> helper_registry_;
     QSharedPointer<StorageFrameworkClient> storage_;
 
-    QStringList remaining_tasks_;
-    QString current_task_;
+    TaskScheduler scheduler_;
+    int n_started_tasks_ {0};
+
+    QString last_task_;
     QString backup_dir_name_;
 
     QVariantDictMap state_;
-    QSharedPointer<KeeperTask> task_;
+    QMap<QString, QSharedPointer<KeeperTask>> tasks_;
+
+    // task uuid -> helper path used by the task helper to ask for its socket
+    QMap<QString, QString> socket_requests_;
+
+    // task uuid -> size of the uploader its helper asked for while the task was preparing
+    QMap<QString, quint64> held_uploads_;
+
+    // task uuid -> the parts stored before the service stopped, for the resumed tasks
+    QMap<QString, TaskJournal::Task> resumed_uploads_;
+
+    // delta state tracking: the version in which every field last changed,
+    // the version in which a field or a task was removed and the changes
+    // not yet notified. Removals are only kept for the current run, and
+    // history_start_ is the oldest version whose later changes are all known
+    quint64 state_version_ {0};
+    quint64 history_start_ {0};
+    QMap<QString, QMap<QString, quint64>> field_versions_;
+    QMap<QString, QMap<QString, quint64>> removed_field_versions_;
+    QMap<QString, quint64> removed_versions_;
+    keeper::Items pending_delta_;
 
     QSharedPointer<Manifest> active_manifest_;
+    TaskJournal journal_;
+
+    // spans of the trace of the current run
+    QSharedPointer<util::TraceSpan> run_span_;
+    QSharedPointer<util::TraceSpan> manifest_span_;
+    QMap<QString, QSharedPointer<util::TraceSpan>> task_spans_;
+
+    // task uuid -> time since the task was started, for the metrics
+    QMap<QString, QElapsedTimer> task_timers_;
 
     ConnectionHelper connections_;
 
@@ -446,18 +1077,53 @@ keeper::Items TaskManager::get_state() const
     return d->get_state();
 }
 
-void TaskManager::ask_for_uploader(quint64 n_bytes)
+keeper::Items TaskManager::get_state_since(quint64 since, quint64 & version, bool & full) const
+{
+    Q_D(const TaskManager);
+
+    return d->get_state_since(since, version, full);
+}
+
+quint64 TaskManager::get_state_version() const
+{
+    Q_D(const TaskManager);
+
+    return d->get_state_version();
+}
+
+void TaskManager::ask_for_uploader(quint64 n_bytes, QString const & helper_path)
 {
     Q_D(TaskManager);
 
-    d->ask_for_uploader(n_bytes);
+    d->ask_for_uploader(n_bytes, helper_path);
 }
 
-void TaskManager::ask_for_downloader()
+void TaskManager::ask_for_downloader(QString const & helper_path)
 {
     Q_D(TaskManager);
 
-    d->ask_for_downloader();
+    d->ask_for_downloader(helper_path);
+}
+
+QFuture<bool> TaskManager::set_file_catalog(QString const & helper_path, int catalog_fd)
+{
+    Q_D(TaskManager);
+
+    return d->set_file_catalog(helper_path, catalog_fd);
+}
+
+void TaskManager::set_max_concurrent_tasks(int max_tasks)
+{
+    Q_D(TaskManager);
+
+    d->set_max_concurrent_tasks(max_tasks);
+}
+
+int TaskManager::max_concurrent_tasks() const
+{
+    Q_D(const TaskManager);
+
+    return d->max_concurrent_tasks();
 }
 
 void TaskManager::cancel()
@@ -466,3 +1132,10 @@ void TaskManager::cancel()
 
     d->cancel();
 }
+
+QString TaskManager::resume()
+{
+    Q_D(TaskManager);
+
+    return d->resume();
+}
@@ -24,6 +24,7 @@
 #include "helper/metadata.h"
 #include "keeper-task.h"
 
+#include <QFuture>
 #include <QObject>
 #include <QList>
 
@@ -56,16 +57,48 @@ public:
 
     keeper::Items get_state() const;
 
-    void ask_for_uploader(quint64 n_bytes);
+    // returns the properties that changed after the given state version.
+    // A task mapped to an empty property map has been removed from the state,
+    // and the properties listed in keeper::Item::REMOVED_PROPERTIES_KEY were unset.
+    // full is set when the whole state is returned instead, because since
+    // is 0 or older than the changes that are remembered.
+    keeper::Items get_state_since(quint64 since, quint64 & version, bool & full) const;
 
-    void ask_for_downloader();
+    quint64 get_state_version() const;
+
+    // helper_path is the D-Bus path the helper used to ask for its socket.
+    // Helpers that use the generic helper path are given the oldest
+    // running task that has no socket yet.
+    void ask_for_uploader(quint64 n_bytes, QString const & helper_path);
+
+    void ask_for_downloader(QString const & helper_path);
+
+    // keeps the file catalog the backup helper at helper_path sent
+    // in catalog_fd. It is read in a worker thread from a copy of the
+    // descriptor, the future tells whether it was kept.
+    // It is stored next to the backup if the task completes.
+    QFuture<bool> set_file_catalog(QString const & helper_path, int catalog_fd);
 
     void cancel();
 
+    // resumes the run that was in progress when the service stopped.
+    // Returns its mode, "backup" or "restore", or an empty string
+    // if there was no unfinished run to resume.
+    QString resume();
+
+    // the maximum number of tasks that run at the same time
+    void set_max_concurrent_tasks(int max_tasks);
+    int max_concurrent_tasks() const;
+
 Q_SIGNALS:
-    void socket_ready(int reply);
-    void socket_error(keeper::Error error);
+    void socket_ready(QString const & helper_path, int reply);
+    void socket_error(QString const & helper_path, keeper::Error error);
+
+    // emitted when a task starts or stops using its own helper path
+    void helper_path_added(QString const & helper_path);
+    void helper_path_removed(QString const & helper_path);
     void state_changed();
+    void state_delta(quint64 version, keeper::Items const & changed);
     void finished();
 
 private:
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include "task-scheduler.h"
+
+#include <QDebug>
+
+TaskScheduler::TaskScheduler(start_func const & start, QObject * parent)
+    : QObject(parent)
+    , start_(start)
+{
+}
+
+TaskScheduler::~TaskScheduler() = default;
+
+void TaskScheduler::set_max_running(int max_running)
+{
+    max_running_ = qMax(1, max_running);
+    start_next_tasks();
+}
+
+int TaskScheduler::max_running() const
+{
+    return max_running_;
+}
+
+void TaskScheduler::set_max_preparing(int max_preparing)
+{
+    max_preparing_ = qMax(0, max_preparing);
+    start_next_tasks();
+}
+
+int TaskScheduler::max_preparing() const
+{
+    return max_preparing_;
+}
+
+void TaskScheduler::start(QStringList const & uuids)
+{
+    if (is_busy())
+    {
+        qWarning() << "A run is already in progress";
+        return;
+    }
+
+    queued_ = uuids;
+    in_run_ = true;
+    start_next_tasks();
+}
+
+void TaskScheduler::set_committing(QString const & uuid)
+{
+    if (!active_.contains(uuid))
+        return;
+
+    deactivate(uuid);
+    committing_ << uuid;
+    start_next_tasks();
+}
+
+void TaskScheduler::set_finished(QString const & uuid)
+{
+    deactivate(uuid);
+    committing_.removeAll(uuid);
+    start_next_tasks();
+}
+
+QStringList TaskScheduler::clear()
+{
+    auto const running = preparing_ + active_ + committing_;
+    for (auto const & uuid : running)
+        deactivate(uuid);
+    queued_.clear();
+    committing_.clear();
+    in_run_ = false;
+    return running;
+}
+
+bool TaskScheduler::is_busy() const
+{
+    return !queued_.isEmpty() || !preparing_.isEmpty() || !active_.isEmpty() || !committing_.isEmpty();
+}
+
+bool TaskScheduler::is_running(QString const & uuid) const
+{
+    return preparing_.contains(uuid) || active_.contains(uuid) || committing_.contains(uuid);
+}
+
+bool TaskScheduler::is_preparing(QString const & uuid) const
+{
+    return preparing_.contains(uuid);
+}
+
+bool TaskScheduler::is_last(QString const & uuid) const
+{
+    return queued_.isEmpty()
+        && preparing_.size() + active_.size() + committing_.size() == 1
+        && is_running(uuid);
+}
+
+QStringList TaskScheduler::queued() const
+{
+    return queued_;
+}
+
+QStringList TaskScheduler::preparing() const
+{
+    return preparing_;
+}
+
+QStringList TaskScheduler::active() const
+{
+    return active_;
+}
+
+QStringList TaskScheduler::committing() const
+{
+    return committing_;
+}
+
+// a task that fails to start may report its end from inside start_(),
+// so the tasks that finish meanwhile are left to the outer loop
+void TaskScheduler::start_next_tasks()
+{
+    if (starting_)
+        return;
+
+    starting_ = true;
+    while (active_.size() < max_running_ && (!preparing_.isEmpty() || !queued_.isEmpty()))
+    {
+        if (!preparing_.isEmpty())
+        {
+            auto const uuid = preparing_.takeFirst();
+            active_ << uuid;
+            Q_EMIT(task_promoted(uuid));
+            continue;
+        }
+
+        auto const uuid = queued_.takeFirst();
+        active_ << uuid;
+        if (!start_(uuid))
+            set_finished(uuid);
+    }
+    while (active_.size() >= max_running_ && preparing_.size() < max_preparing_ && !queued_.isEmpty())
+    {
+        auto const uuid = queued_.takeFirst();
+        preparing_ << uuid;
+        if (!start_(uuid))
+            set_finished(uuid);
+    }
+    starting_ = false;
+
+    if (in_run_ && !is_busy())
+    {
+        in_run_ = false;
+        Q_EMIT(all_finished());
+    }
+}
+
+void TaskScheduler::deactivate(QString const & uuid)
+{
+    if (active_.removeAll(uuid) || preparing_.removeAll(uuid))
+        Q_EMIT(task_deactivated(uuid));
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+#include <functional>
+
+/**
+ * Decides when the tasks of a backup or restore run are started.
+ *
+ * Tasks start in the order they were queued, and up to max_running()
+ * of them are active at the same time. A task that only waits for its
+ * remote file to be committed is no longer active, so the next one can
+ * start meanwhile.
+ *
+ * When every slot is taken, up to max_preparing() more tasks are started
+ * ahead of time, so their helpers launch and enumerate their files while
+ * the active tasks stream. They are promoted, in order, as soon as a slot
+ * is free, and task_promoted() tells when they may stream.
+ *
+ * all_finished() is emitted once per run, as soon as no task is queued,
+ * preparing, active or committing, even when the last tasks failed to start.
+ */
+class TaskScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    // starts the task, returns false if it could not be started
+    using start_func = std::function<bool(QString const & uuid)>;
+
+    explicit TaskScheduler(start_func const & start, QObject * parent = nullptr);
+    ~TaskScheduler();
+
+    Q_DISABLE_COPY(TaskScheduler)
+
+    void set_max_running(int max_running);
+    int max_running() const;
+
+    void set_max_preparing(int max_preparing);
+    int max_preparing() const;
+
+    // starts a new run with the given tasks
+    void start(QStringList const & uuids);
+
+    // the task sent all its data and only its commit is left
+    void set_committing(QString const & uuid);
+
+    // the task is over, whatever its result
+    void set_finished(QString const & uuid);
+
+    // forgets the run without emitting all_finished().
+    // Returns the tasks that were preparing, active or committing
+    QStringList clear();
+
+    bool is_busy() const;
+
+    // preparing, active or committing
+    bool is_running(QString const & uuid) const;
+
+    bool is_preparing(QString const & uuid) const;
+
+    // the only task of the run that is not over yet
+    bool is_last(QString const & uuid) const;
+
+    QStringList queued() const;
+    QStringList preparing() const;
+    QStringList active() const;
+    QStringList committing() const;
+
+Q_SIGNALS:
+    // the prepared task got a slot
+    void task_promoted(QString const & uuid);
+
+    // the task stopped being preparing or active
+    void task_deactivated(QString const & uuid);
+
+    void all_finished();
+
+private:
+    void start_next_tasks();
+    void deactivate(QString const & uuid);
+
+    start_func start_;
+    int max_running_ {1};
+    int max_preparing_ {0};
+    bool in_run_ {false};
+    bool starting_ {false};
+    QStringList queued_;
+    QStringList preparing_;
+    QStringList active_;
+    QStringList committing_;
+};
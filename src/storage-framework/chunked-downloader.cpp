@@ -0,0 +1,252 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include "storage-framework/chunked-downloader.h"
+
+#include <QDebug>
+#include <QMap>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <functional> // std::bind()
+
+class ChunkedDownloaderPrivate
+{
+public:
+
+    ChunkedDownloaderPrivate(ChunkedDownloader * chunked_downloader,
+                             ChunkedDownloader::PartFactory const & part_factory,
+                             QVector<qint64> const & part_sizes,
+                             int n_prefetched_parts)
+        : q_ptr(chunked_downloader)
+        , part_factory_(part_factory)
+        , part_sizes_(part_sizes)
+        , n_prefetched_parts_(qMax(0, n_prefetched_parts))
+    {
+        for (auto const size : part_sizes_)
+            file_size_ += size;
+
+        QObject::connect(&write_socket_, &QLocalSocket::bytesWritten,
+            std::bind(&ChunkedDownloaderPrivate::process_more, this)
+        );
+
+        // fire up the sockets
+        int fds[2];
+        int rc = socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds);
+        if (rc == -1)
+        {
+            qWarning() << "Error creating socket for the chunked downloader";
+            return;
+        }
+
+        // the read socket is for the client
+        read_socket_.reset(new QLocalSocket());
+        read_socket_->setSocketDescriptor(fds[0], QLocalSocket::ConnectedState, QIODevice::ReadOnly);
+
+        write_socket_.setSocketDescriptor(fds[1], QLocalSocket::ConnectedState, QIODevice::WriteOnly);
+
+        request_parts();
+    }
+
+    ~ChunkedDownloaderPrivate()
+    {
+        QObject::disconnect(part_connection_);
+    }
+
+    Q_DISABLE_COPY(ChunkedDownloaderPrivate)
+
+    std::shared_ptr<QLocalSocket> socket()
+    {
+        return read_socket_;
+    }
+
+    void finish()
+    {
+        QObject::disconnect(part_connection_);
+        if (part_downloader_)
+        {
+            part_downloader_->finish();
+            part_downloader_.reset();
+        }
+        for (auto& downloader : prefetched_parts_)
+            downloader->finish();
+        prefetched_parts_.clear();
+        Q_EMIT(q_ptr->download_finished());
+    }
+
+    qint64 file_size() const
+    {
+        return file_size_;
+    }
+
+private:
+
+    // requests the downloaders of the current part and the prefetched ones
+    void request_parts()
+    {
+        while (requested_part_ < part_sizes_.size() && requested_part_ <= current_part_ + n_prefetched_parts_)
+        {
+            auto const part = requested_part_++;
+            qDebug() << "Downloading part" << part << "of" << part_sizes_.size();
+            connections_.connect_future(
+                part_factory_(part),
+                std::function<void(std::shared_ptr<Downloader> const&)>{
+                    [this, part](std::shared_ptr<Downloader> const& downloader){
+                        on_part_downloader_ready(part, downloader);
+                    }
+                }
+            );
+        }
+    }
+
+    void on_part_downloader_ready(int part, std::shared_ptr<Downloader> const& downloader)
+    {
+        if (!downloader)
+        {
+            // the client sees the data ending early
+            qWarning() << "Error retrieving the downloader of part" << part;
+            write_socket_.disconnectFromServer();
+            return;
+        }
+
+        // the data of a prefetched part waits in its socket until its turn
+        prefetched_parts_.insert(part, downloader);
+        if (part == current_part_)
+            start_current_part();
+    }
+
+    void start_current_part()
+    {
+        part_downloader_ = prefetched_parts_.take(current_part_);
+        n_part_read_ = 0;
+        part_connection_ = QObject::connect(
+            part_downloader_->socket().get(), &QLocalSocket::readyRead,
+            std::bind(&ChunkedDownloaderPrivate::process_more, this)
+        );
+
+        // maybe there's data already to be read
+        process_more();
+    }
+
+    void process_more()
+    {
+        for(;;)
+        {
+            // try to fill the buffer with the data of the current part.
+            // The buffer may still hold data of the previous part
+            if (part_downloader_)
+            {
+                auto const max_bytes = qMin(qint64(BUFFER_MAX - buffer_.size()),
+                                            part_sizes_[current_part_] - n_part_read_);
+                if (max_bytes > 0)
+                {
+                    auto const data = part_downloader_->socket()->read(max_bytes);
+                    n_part_read_ += data.size();
+                    buffer_.append(data);
+                }
+            }
+
+            if (buffer_.isEmpty())
+                break;
+
+            // try to empty the buffer
+            auto const n = write_socket_.write(buffer_);
+            if (n < 0)
+            {
+                qWarning() << "Write error:" << write_socket_.errorString();
+                return;
+            }
+            if (n == 0)
+                break;
+            buffer_.remove(0, int(n));
+        }
+
+        if (part_downloader_ && n_part_read_ == part_sizes_[current_part_])
+        {
+            QObject::disconnect(part_connection_);
+            part_downloader_->finish();
+            part_downloader_.reset();
+            ++current_part_;
+            request_parts();
+            if (prefetched_parts_.contains(current_part_))
+                start_current_part();
+        }
+    }
+
+    static constexpr int BUFFER_MAX {1024*16};
+
+    ChunkedDownloader * const q_ptr;
+    ChunkedDownloader::PartFactory part_factory_;
+    QVector<qint64> part_sizes_;
+    int const n_prefetched_parts_;
+    qint64 file_size_ = 0;
+
+    std::shared_ptr<QLocalSocket> read_socket_;
+    QLocalSocket write_socket_;
+
+    int current_part_ = 0;
+    int requested_part_ = 0;
+    QMap<int, std::shared_ptr<Downloader>> prefetched_parts_;
+    std::shared_ptr<Downloader> part_downloader_;
+    QMetaObject::Connection part_connection_;
+    qint64 n_part_read_ = 0;
+    QByteArray buffer_;
+
+    ConnectionHelper connections_;
+};
+
+/***
+****
+***/
+
+ChunkedDownloader::ChunkedDownloader(PartFactory const & part_factory,
+                                     QVector<qint64> const & part_sizes,
+                                     int n_prefetched_parts,
+                                     QObject * parent)
+    : Downloader(parent)
+    , d_ptr(new ChunkedDownloaderPrivate(this, part_factory, part_sizes, n_prefetched_parts))
+{
+}
+
+ChunkedDownloader::~ChunkedDownloader() = default;
+
+std::shared_ptr<QLocalSocket>
+ChunkedDownloader::socket()
+{
+    Q_D(ChunkedDownloader);
+
+    return d->socket();
+}
+
+void
+ChunkedDownloader::finish()
+{
+    Q_D(ChunkedDownloader);
+
+    d->finish();
+}
+
+qint64
+ChunkedDownloader::file_size() const
+{
+    Q_D(const ChunkedDownloader);
+
+    return d->file_size();
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#pragma once
+
+#include "util/connection-helper.h"
+#include "storage-framework/downloader.h"
+
+#include <QFuture>
+#include <QLocalSocket>
+#include <QScopedPointer>
+#include <QVector>
+
+#include <functional>
+#include <memory>
+
+class ChunkedDownloaderPrivate;
+
+/**
+ * Downloads a file stored by ChunkedUploader as a sequence of parts.
+ *
+ * The parts are downloaded in order and their data is written
+ * to a single socket, so clients read the file as a whole.
+ * While a part is being read, the downloaders of the next
+ * n_prefetched_parts parts are already requested.
+ */
+class ChunkedDownloader final: public Downloader
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(ChunkedDownloader)
+
+public:
+
+    // returns the downloader of the given part
+    typedef std::function<QFuture<std::shared_ptr<Downloader>>(int part)> PartFactory;
+
+    ChunkedDownloader(PartFactory const & part_factory,
+                      QVector<qint64> const & part_sizes,
+                      int n_prefetched_parts = 1,
+                      QObject * parent = nullptr);
+    virtual ~ChunkedDownloader();
+
+    Q_DISABLE_COPY(ChunkedDownloader)
+
+    std::shared_ptr<QLocalSocket> socket() override;
+    void finish() override;
+    qint64 file_size() const override;
+
+private:
+    QScopedPointer<ChunkedDownloaderPrivate> const d_ptr;
+};
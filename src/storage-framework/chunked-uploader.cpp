@@ -0,0 +1,753 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include "storage-framework/chunked-uploader.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QTemporaryFile>
+#include <QTimer>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <functional> // std::bind()
+
+class ChunkedUploaderPrivate
+{
+public:
+
+    ChunkedUploaderPrivate(ChunkedUploader * chunked_uploader,
+                           ChunkedUploader::PartFactory const & part_factory,
+                           qint64 n_bytes,
+                           QString const & file_name,
+                           qint64 part_size,
+                           int max_parallel_parts)
+        : q_ptr(chunked_uploader)
+        , part_factory_(part_factory)
+        , file_name_(file_name)
+        , max_parallel_parts_(bounded_parallel_parts(max_parallel_parts, part_size))
+        , receive_hash_(QCryptographicHash::Sha256)
+    {
+        // split the file in parts. An empty file still has one empty part
+        part_size = qMax(qint64(1), part_size);
+        auto const n_parts = n_bytes > 0 ? int((n_bytes + part_size - 1) / part_size) : 1;
+        for (int i = 0; i < n_parts; ++i)
+        {
+            Part part;
+            part.size = qMin(part_size, n_bytes - i * part_size);
+            parts_.push_back(part);
+        }
+
+        // listen for data ready to stream
+        QObject::connect(&read_socket_, &QLocalSocket::readyRead,
+            std::bind(&ChunkedUploaderPrivate::receive_more, this)
+        );
+
+        // fire up the sockets
+        int fds[2];
+        int rc = socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds);
+        if (rc == -1)
+        {
+            fail(QStringLiteral("Error creating socket for the chunked uploader"));
+            return;
+        }
+
+        // the write socket is for the client
+        write_socket_.reset(new QLocalSocket());
+        write_socket_->setSocketDescriptor(fds[1], QLocalSocket::ConnectedState, QIODevice::WriteOnly);
+
+        read_socket_.setSocketDescriptor(fds[0], QLocalSocket::ConnectedState, QIODevice::ReadOnly);
+
+        // the first part starts uploading as soon as the parts
+        // committed by an earlier attempt are known
+        QTimer::singleShot(0, q_ptr, std::bind(&ChunkedUploaderPrivate::receive_more, this));
+    }
+
+    ~ChunkedUploaderPrivate()
+    {
+        for (auto & part : parts_)
+        {
+            QObject::disconnect(part.sent_connection);
+            QObject::disconnect(part.closed_connection);
+        }
+    }
+
+    Q_DISABLE_COPY(ChunkedUploaderPrivate)
+
+    std::shared_ptr<QLocalSocket> socket()
+    {
+        return write_socket_;
+    }
+
+    void skip_parts(QStringList const & part_file_names, QStringList const & part_hashes)
+    {
+        if (receiving_part_ > 0 || parts_[0].attempts > 0 || parts_[0].retry_copy)
+        {
+            qWarning() << "The parts of" << file_name_ << "can only be skipped before they are sent";
+            return;
+        }
+
+        // a part can only be skipped if its data can be checked
+        for (int i = 0; i < part_file_names.size() && i < part_hashes.size() && i < parts_.size(); ++i)
+        {
+            if (part_file_names[i] != remote_file_name(i))
+            {
+                qWarning() << "Unexpected part" << part_file_names[i] << "of" << file_name_;
+                return;
+            }
+            auto& part = parts_[i];
+            part.committed = true;
+            part.committed_file_name = part_file_names[i];
+            part.stored_hash = QByteArray::fromHex(part_hashes[i].toLatin1());
+            ++n_committed_;
+            // an empty part has no data to differ
+            if (part.size > 0)
+                ++n_unverified_;
+        }
+        qDebug() << "Skipping" << n_committed_ << "parts of" << file_name_ << "committed already";
+    }
+
+    void commit()
+    {
+        commit_requested_ = true;
+        check_for_done();
+    }
+
+    QString file_name() const
+    {
+        if (n_committed_ != parts_.size())
+            return QString();
+
+        return parts_.size() == 1 ? parts_[0].committed_file_name : file_name_;
+    }
+
+    QStringList part_file_names() const
+    {
+        QStringList ret;
+        if (n_committed_ == parts_.size())
+        {
+            for (auto const & part : parts_)
+                ret << part.committed_file_name;
+        }
+        return ret;
+    }
+
+    int n_parts() const
+    {
+        return parts_.size();
+    }
+
+    QStringList committed_part_file_names() const
+    {
+        QStringList ret;
+        for (auto const & part : parts_)
+        {
+            if (!part.committed)
+                break;
+            ret << part.committed_file_name;
+        }
+        return ret;
+    }
+
+    void set_part_remover(ChunkedUploader::PartRemover const & part_remover)
+    {
+        part_remover_ = part_remover;
+    }
+
+    QStringList committed_part_hashes() const
+    {
+        QStringList ret;
+        for (auto const & part : parts_)
+        {
+            if (!part.committed)
+                break;
+            ret << QString::fromLatin1((part.hash.isEmpty() ? part.stored_hash : part.hash).toHex());
+        }
+        return ret;
+    }
+
+    QVector<int> committed_parts() const
+    {
+        QVector<int> ret;
+        for (int i = 0; i < parts_.size(); ++i)
+        {
+            if (parts_[i].committed)
+                ret.push_back(i);
+        }
+        return ret;
+    }
+
+private:
+
+    struct Part
+    {
+        qint64 size = 0;
+
+        // the data of the part received so far, kept until the part
+        // is committed so that a failed attempt can be sent again
+        qint64 n_received = 0;
+        std::shared_ptr<QTemporaryFile> retry_copy;
+        int attempts = 0;
+        bool committed = false;
+        QString committed_file_name;
+
+        // the hash of the data of the part, once it is received. A part
+        // committed by an earlier upload also keeps the one it was stored with
+        QByteArray hash;
+        QByteArray stored_hash;
+
+        // the part stored by an earlier upload is being removed
+        bool removing = false;
+
+        // the attempt in progress
+        bool uploading = false;
+        bool committing = false;
+        std::shared_ptr<Uploader> uploader;
+        QMetaObject::Connection sent_connection;
+        QMetaObject::Connection closed_connection;
+        qint64 n_queued = 0;
+        qint64 n_sent = 0;
+    };
+
+    // the retry copies of the parts on their way fit in MAX_RETRY_COPY_BYTES
+    static int bounded_parallel_parts(int max_parallel_parts, qint64 part_size)
+    {
+        qint64 const max_bytes = ChunkedUploader::MAX_RETRY_COPY_BYTES;
+        auto const max_parts = qMax(qint64(1), max_bytes / qMax(qint64(1), part_size));
+        return int(qBound(qint64(1), qint64(max_parallel_parts), max_parts));
+    }
+
+    /***
+    ****  Streaming the data written by the client
+    ***/
+
+    // the data of the client is read ahead into the retry copies of the
+    // parts on their way, each of them is sent by its own uploader as it
+    // gets room. The client is only read while a part has a stream, so
+    // the rest of the data waits in the client socket
+    void receive_more()
+    {
+        while (!failed_ && receiving_part_ < parts_.size())
+        {
+            auto const i = receiving_part_;
+            auto& part = parts_[i];
+
+            // a part committed by an earlier attempt is not sent again if
+            // its data is the same. It is kept until every skipped part is
+            // checked, so all of them can be sent again if any differs
+            if (part.committed)
+            {
+                if (part.n_received == part.size)
+                {
+                    ++receiving_part_;
+                    continue;
+                }
+                if (!part.retry_copy && !open_retry_copy(part))
+                    return;
+                if (receive(part).isEmpty())
+                    return;
+                Q_EMIT(q_ptr->upload_progress());
+                if (part.n_received == part.size)
+                    verify_skipped_part(i);
+                continue;
+            }
+
+            // a part that was never sent waits for a stream of its own
+            if (part.attempts == 0)
+            {
+                if (i - n_committed_ >= max_parallel_parts_ || part.removing)
+                    return;
+
+                if (!part.retry_copy && !open_retry_copy(part))
+                    return;
+                upload_part(i);
+                continue;
+            }
+
+            if (part.n_received == part.size)
+            {
+                ++receiving_part_;
+                continue;
+            }
+
+            // an uploader that keeps up gets the data right away,
+            // otherwise it sends it from the retry copy once it has room
+            auto const streaming = is_streaming(part);
+            auto const data = receive(part);
+            if (data.isEmpty())
+                return;
+            if (!streaming)
+                continue;
+
+            if (part.uploader->socket()->write(data) != data.size())
+            {
+                part_failed(i, part.uploader->socket()->errorString());
+                continue;
+            }
+            part.n_queued += data.size();
+        }
+    }
+
+    bool open_retry_copy(Part & part)
+    {
+        part.retry_copy.reset(new QTemporaryFile());
+        if (!part.retry_copy->open())
+        {
+            fail(QStringLiteral("Error creating the retry copy of a part: %1").arg(part.retry_copy->errorString()));
+            return false;
+        }
+        return true;
+    }
+
+    // reads the next data of the part into its retry copy and its hash
+    QByteArray receive(Part & part)
+    {
+        auto const data = read_socket_.read(qMin(part.size - part.n_received, qint64(READ_BUFFER_MAX)));
+        if (data.isEmpty())
+            return data;
+
+        if (part.retry_copy->write(data) != data.size())
+        {
+            fail(QStringLiteral("Error writing the retry copy of a part: %1").arg(part.retry_copy->errorString()));
+            return QByteArray();
+        }
+        part.n_received += data.size();
+        receive_hash_.addData(data);
+
+        if (part.n_received == part.size)
+        {
+            part.hash = receive_hash_.result();
+            receive_hash_.reset();
+        }
+        return data;
+    }
+
+    void verify_skipped_part(int i)
+    {
+        if (parts_[i].hash != parts_[i].stored_hash)
+        {
+            qWarning() << "Part" << i << "of" << file_name_ << "changed since it was stored, sending every part again";
+            resend_skipped_parts();
+            return;
+        }
+
+        if (--n_unverified_ > 0)
+            return;
+
+        // every skipped part holds the same data, their copies are not needed anymore
+        for (auto & part : parts_)
+        {
+            if (part.committed)
+                part.retry_copy.reset();
+        }
+        check_for_done();
+    }
+
+    // the parts received so far are sent again from their retry copies,
+    // the rest is sent as it arrives. The stored parts are removed first,
+    // as they have the same remote file names
+    void resend_skipped_parts()
+    {
+        for (int i = 0; i < parts_.size(); ++i)
+        {
+            auto& part = parts_[i];
+            if (!part.committed)
+                continue;
+            if (part_remover_)
+            {
+                part.removing = true;
+                connections_.connect_future(
+                    part_remover_(part.committed_file_name),
+                    std::function<void(bool)>{
+                        [this, i](bool removed){
+                            if (!removed)
+                                qWarning() << "Error removing the stored part" << i << "of" << file_name_;
+                            parts_[i].removing = false;
+                            receive_more();
+                        }
+                    }
+                );
+            }
+            part.committed = false;
+            part.committed_file_name.clear();
+            part.stored_hash.clear();
+        }
+        n_committed_ = 0;
+        n_unverified_ = 0;
+        receiving_part_ = 0;
+    }
+
+    // the uploader has sent everything it was given and has room for more
+    bool is_streaming(Part const & part) const
+    {
+        return part.uploader
+            && !part.committing
+            && part.n_queued == part.n_received
+            && part.uploader->socket()->bytesToWrite() < UPLOAD_BUFFER_MAX;
+    }
+
+    /***
+    ****  Uploading the parts
+    ***/
+
+    QString remote_file_name(int i) const
+    {
+        return parts_.size() == 1 ? file_name_ : ChunkedUploader::part_file_name(file_name_, i);
+    }
+
+    void upload_part(int i)
+    {
+        auto& part = parts_[i];
+        part.uploading = true;
+        ++part.attempts;
+        qDebug() << "Uploading part" << i << "of" << file_name_ << "attempt" << part.attempts;
+
+        connections_.connect_future(
+            part_factory_(remote_file_name(i), part.size),
+            std::function<void(std::shared_ptr<Uploader> const&)>{
+                [this, i](std::shared_ptr<Uploader> const& uploader){
+                    on_part_uploader_ready(i, uploader);
+                }
+            }
+        );
+    }
+
+    void on_part_uploader_ready(int i, std::shared_ptr<Uploader> const& uploader)
+    {
+        if (!parts_[i].uploading || failed_)
+            return;
+
+        if (!uploader)
+        {
+            part_failed(i, QStringLiteral("no uploader"));
+            return;
+        }
+
+        auto& part = parts_[i];
+        part.uploader = uploader;
+        part.n_queued = 0;
+        part.n_sent = 0;
+
+        part.sent_connection = QObject::connect(
+            part.uploader->socket().get(), &QLocalSocket::bytesWritten,
+            std::bind(&ChunkedUploaderPrivate::on_part_data_sent, this, i, std::placeholders::_1)
+        );
+
+        // the storage may drop the stream before the part is sent
+        part.closed_connection = QObject::connect(
+            part.uploader->socket().get(), &QLocalSocket::disconnected,
+            std::bind(&ChunkedUploaderPrivate::on_part_disconnected, this, i)
+        );
+
+        resend_more(i);
+        receive_more();
+        check_for_part_sent(i);
+    }
+
+    void on_part_data_sent(int i, qint64 n)
+    {
+        parts_[i].n_sent += n;
+        Q_EMIT(q_ptr->upload_progress());
+        resend_more(i);
+        receive_more();
+        check_for_part_sent(i);
+    }
+
+    void on_part_disconnected(int i)
+    {
+        // the uploader closes the stream itself once it commits
+        if (parts_[i].committing)
+            return;
+
+        part_failed(i, QStringLiteral("the stream was closed"));
+    }
+
+    // sends the data of the part that is only in its retry copy: the data
+    // received before the attempt started or while the uploader was busy
+    void resend_more(int i)
+    {
+        auto& part = parts_[i];
+        if (!part.uploader)
+            return;
+
+        auto socket = part.uploader->socket();
+        while (part.n_queued < part.n_received && socket->bytesToWrite() < UPLOAD_BUFFER_MAX)
+        {
+            if (!part.retry_copy->seek(part.n_queued))
+            {
+                part_failed(i, part.retry_copy->errorString());
+                return;
+            }
+            auto const data = part.retry_copy->read(qMin(part.n_received - part.n_queued, qint64(UPLOAD_BUFFER_MAX)));
+            if (data.isEmpty())
+            {
+                part_failed(i, part.retry_copy->errorString());
+                return;
+            }
+            if (socket->write(data) != data.size())
+            {
+                part_failed(i, socket->errorString());
+                return;
+            }
+            part.n_queued += data.size();
+        }
+
+        // new data is appended after what was sent again
+        part.retry_copy->seek(part.n_received);
+    }
+
+    void check_for_part_sent(int i)
+    {
+        auto& part = parts_[i];
+        if (!part.uploader || part.committing || part.n_received < part.size || part.n_sent < part.size)
+            return;
+
+        part.committing = true;
+        connections_.connect_oneshot(
+            part.uploader.get(),
+            &Uploader::commit_finished,
+            std::function<void(bool)>{[this, i](bool success){
+                on_part_committed(i, success);
+            }}
+        );
+        part.uploader->commit();
+    }
+
+    void on_part_committed(int i, bool success)
+    {
+        // an attempt that was given up already
+        if (!parts_[i].committing)
+            return;
+
+        if (!success)
+        {
+            part_failed(i, QStringLiteral("commit failed"));
+            return;
+        }
+
+        auto& part = parts_[i];
+        part.committed = true;
+        part.committed_file_name = part.uploader->file_name();
+        part.retry_copy.reset();
+        release_part_uploader(i);
+        ++n_committed_;
+        Q_EMIT(q_ptr->upload_progress());
+        Q_EMIT(q_ptr->part_committed(i));
+
+        // its stream is free for the next part
+        receive_more();
+        check_for_done();
+    }
+
+    void part_failed(int i, QString const & reason)
+    {
+        release_part_uploader(i);
+
+        auto& part = parts_[i];
+        if (part.attempts >= ChunkedUploader::MAX_PART_ATTEMPTS)
+        {
+            fail(QStringLiteral("Part %1 of %2 failed %3 times: %4").arg(i).arg(file_name_).arg(part.attempts).arg(reason));
+            return;
+        }
+
+        // wait longer after every failed attempt
+        int const max_delay = ChunkedUploader::MAX_RETRY_DELAY;
+        auto const delay = qMin(RETRY_DELAY << (part.attempts - 1), max_delay);
+        qWarning() << "Part" << i << "of" << file_name_ << "failed:" << reason << "retrying in" << delay << "ms";
+        QTimer::singleShot(delay, q_ptr, [this, i](){
+            if (!failed_)
+                upload_part(i);
+        });
+
+        // retrying is still progress for the client waiting on the data
+        Q_EMIT(q_ptr->upload_progress());
+    }
+
+    void release_part_uploader(int i)
+    {
+        auto& part = parts_[i];
+        QObject::disconnect(part.sent_connection);
+        QObject::disconnect(part.closed_connection);
+        part.uploader.reset();
+        part.uploading = false;
+        part.committing = false;
+        part.n_queued = 0;
+        part.n_sent = 0;
+    }
+
+    /***
+    ****  Finishing
+    ***/
+
+    void fail(QString const & reason)
+    {
+        qWarning() << reason;
+        failed_ = true;
+        for (int i = 0; i < parts_.size(); ++i)
+        {
+            release_part_uploader(i);
+            parts_[i].retry_copy.reset();
+        }
+
+        // the client notices on its next write
+        read_socket_.disconnectFromServer();
+
+        check_for_done();
+    }
+
+    void check_for_done()
+    {
+        if (!commit_requested_ || finished_)
+            return;
+
+        if (failed_ || (n_committed_ == parts_.size() && n_unverified_ == 0))
+        {
+            finished_ = true;
+            Q_EMIT(q_ptr->commit_finished(!failed_));
+        }
+    }
+
+    static constexpr int READ_BUFFER_MAX {1024*64};
+    static constexpr int UPLOAD_BUFFER_MAX {1024*64};
+    static constexpr int RETRY_DELAY {1000};
+
+    ChunkedUploader * const q_ptr;
+    ChunkedUploader::PartFactory part_factory_;
+    ChunkedUploader::PartRemover part_remover_;
+    QString file_name_;
+    int const max_parallel_parts_;
+    QVector<Part> parts_;
+
+    std::shared_ptr<QLocalSocket> write_socket_;
+    QLocalSocket read_socket_;
+    int receiving_part_ = 0;
+    int n_committed_ = 0;
+    int n_unverified_ = 0;
+    QCryptographicHash receive_hash_;
+
+    bool commit_requested_ = false;
+    bool failed_ = false;
+    bool finished_ = false;
+
+    ConnectionHelper connections_;
+};
+
+/***
+****
+***/
+
+ChunkedUploader::ChunkedUploader(PartFactory const & part_factory,
+                                 qint64 n_bytes,
+                                 QString const & file_name,
+                                 qint64 part_size,
+                                 int max_parallel_parts,
+                                 QObject * parent)
+    : Uploader(parent)
+    , d_ptr(new ChunkedUploaderPrivate(this, part_factory, n_bytes, file_name, part_size, max_parallel_parts))
+{
+}
+
+ChunkedUploader::~ChunkedUploader() = default;
+
+std::shared_ptr<QLocalSocket>
+ChunkedUploader::socket()
+{
+    Q_D(ChunkedUploader);
+
+    return d->socket();
+}
+
+void
+ChunkedUploader::commit()
+{
+    Q_D(ChunkedUploader);
+
+    d->commit();
+}
+
+QString
+ChunkedUploader::file_name() const
+{
+    Q_D(const ChunkedUploader);
+
+    return d->file_name();
+}
+
+QStringList
+ChunkedUploader::part_file_names() const
+{
+    Q_D(const ChunkedUploader);
+
+    return d->part_file_names();
+}
+
+int
+ChunkedUploader::n_parts() const
+{
+    Q_D(const ChunkedUploader);
+
+    return d->n_parts();
+}
+
+void
+ChunkedUploader::skip_parts(QStringList const & part_file_names, QStringList const & part_hashes)
+{
+    Q_D(ChunkedUploader);
+
+    d->skip_parts(part_file_names, part_hashes);
+}
+
+QStringList
+ChunkedUploader::committed_part_file_names() const
+{
+    Q_D(const ChunkedUploader);
+
+    return d->committed_part_file_names();
+}
+
+void
+ChunkedUploader::set_part_remover(PartRemover const & part_remover)
+{
+    Q_D(ChunkedUploader);
+
+    d->set_part_remover(part_remover);
+}
+
+QStringList
+ChunkedUploader::committed_part_hashes() const
+{
+    Q_D(const ChunkedUploader);
+
+    return d->committed_part_hashes();
+}
+
+QVector<int>
+ChunkedUploader::committed_parts() const
+{
+    Q_D(const ChunkedUploader);
+
+    return d->committed_parts();
+}
+
+QString
+ChunkedUploader::part_file_name(QString const & file_name, int part)
+{
+    return QStringLiteral("%1.part%2").arg(file_name).arg(part, 4, 10, QLatin1Char('0'));
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#pragma once
+
+#include "util/connection-helper.h"
+#include "storage-framework/uploader.h"
+
+#include <QFuture>
+#include <QLocalSocket>
+#include <QScopedPointer>
+#include <QStringList>
+#include <QVector>
+
+#include <functional>
+#include <memory>
+
+class ChunkedUploaderPrivate;
+
+/**
+ * Uploads a file as a sequence of fixed-size parts.
+ *
+ * Every part is stored in its own remote file. The data the client
+ * writes is kept in a temporary file, the retry copy of its part, and
+ * each part is sent from there by its own uploader, so a part that fails
+ * to upload or commit is sent again, after a growing delay, without
+ * having to restart the whole file.
+ *
+ * Up to max_parallel_parts parts are on their way at once, each one on
+ * its own stream. The client is read ahead into the retry copies of the
+ * next parts while the previous ones are still being sent, so all those
+ * streams upload at the same time. The retry copies of the parts on
+ * their way never take more than MAX_RETRY_COPY_BYTES, so fewer streams
+ * are used when the parts are too big.
+ *
+ * A file that fits in a single part is stored with its own file name.
+ *
+ * An upload interrupted after some parts were committed is resumed by
+ * passing the names and the hashes of those parts to skip_parts(). The
+ * client writes the whole file again, and the data of those parts is
+ * dropped once all of them are found to hash the same. If any of them
+ * differs, every part is sent again from the first one, after removing
+ * the stored one with the part remover, if there is one.
+ */
+class ChunkedUploader final: public Uploader
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(ChunkedUploader)
+
+public:
+
+    // returns the uploader of a part, given its remote file name and size
+    typedef std::function<QFuture<std::shared_ptr<Uploader>>(QString const & file_name, qint64 n_bytes)> PartFactory;
+
+    // removes the remote file of a part, returns true if it is gone
+    typedef std::function<QFuture<bool>(QString const & file_name)> PartRemover;
+
+    ChunkedUploader(PartFactory const & part_factory,
+                    qint64 n_bytes,
+                    QString const & file_name,
+                    qint64 part_size = DEFAULT_PART_SIZE,
+                    int max_parallel_parts = 1,
+                    QObject * parent = nullptr);
+    virtual ~ChunkedUploader();
+
+    Q_DISABLE_COPY(ChunkedUploader)
+
+    std::shared_ptr<QLocalSocket> socket() override;
+    void commit() override;
+    QString file_name() const override;
+    QStringList part_file_names() const override;
+
+    // the first parts were committed by an earlier upload of the same data,
+    // with the given hashes. Must be called before the client writes anything
+    void skip_parts(QStringList const & part_file_names, QStringList const & part_hashes);
+    void set_part_remover(PartRemover const & part_remover);
+
+    // the remote files of the parts committed so far, up to
+    // the first part that is not. An interrupted upload resumes after them
+    QStringList committed_part_file_names() const;
+
+    // the hex SHA-256 hashes of the data of those parts
+    QStringList committed_part_hashes() const;
+
+    int n_parts() const;
+    QVector<int> committed_parts() const;
+
+    static QString part_file_name(QString const & file_name, int part);
+
+    static constexpr qint64 DEFAULT_PART_SIZE {64 * 1024 * 1024};
+    static constexpr int MAX_PART_ATTEMPTS {5};
+    static constexpr int MAX_RETRY_DELAY {8000};
+    static constexpr qint64 MAX_RETRY_COPY_BYTES {256 * 1024 * 1024};
+
+Q_SIGNALS:
+    void part_committed(int part);
+
+private:
+    QScopedPointer<ChunkedUploaderPrivate> const d_ptr;
+};
@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include "storage-framework/shaped-downloader.h"
+#include "util/connection-helper.h"
+
+#include <QDebug>
+#include <QTimer>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <functional> // std::bind()
+
+class ShapedDownloaderPrivate
+{
+public:
+
+    ShapedDownloaderPrivate(ShapedDownloader * shaped_downloader,
+                            std::shared_ptr<Downloader> const & downloader,
+                            QSharedPointer<StorageShaping> const & shaping)
+        : q_ptr(shaped_downloader)
+        , downloader_(downloader)
+        , shaping_(shaping)
+    {
+        timer_.setSingleShot(true);
+        QObject::connect(&timer_, &QTimer::timeout,
+            std::bind(&ShapedDownloaderPrivate::send_more, this)
+        );
+
+        // listen for data to send and for room to send it
+        connections_.remember(QObject::connect(
+            downloader_->socket().get(), &QLocalSocket::readyRead,
+            std::bind(&ShapedDownloaderPrivate::send_more, this)
+        ));
+        QObject::connect(&write_socket_, &QLocalSocket::bytesWritten,
+            std::bind(&ShapedDownloaderPrivate::send_more, this)
+        );
+
+        connections_.remember(QObject::connect(
+            downloader_.get(), &Downloader::download_finished,
+            q_ptr, &Downloader::download_finished
+        ));
+
+        // fire up the sockets
+        int fds[2];
+        int rc = socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds);
+        if (rc == -1)
+        {
+            qWarning() << "Error creating socket for the shaped downloader";
+            return;
+        }
+
+        // the read socket is for the client
+        read_socket_.reset(new QLocalSocket());
+        read_socket_->setSocketDescriptor(fds[0], QLocalSocket::ConnectedState, QIODevice::ReadOnly);
+
+        write_socket_.setSocketDescriptor(fds[1], QLocalSocket::ConnectedState, QIODevice::WriteOnly);
+
+        // maybe there's data already to be read
+        send_more();
+    }
+
+    ~ShapedDownloaderPrivate() = default;
+
+    Q_DISABLE_COPY(ShapedDownloaderPrivate)
+
+    std::shared_ptr<QLocalSocket> socket()
+    {
+        return read_socket_;
+    }
+
+    void finish()
+    {
+        timer_.stop();
+        downloader_->finish();
+    }
+
+    qint64 file_size() const
+    {
+        return downloader_->file_size();
+    }
+
+private:
+
+    void send_more()
+    {
+        // waiting for a stall to end or for more bandwidth
+        if (timer_.isActive() || failed_)
+            return;
+
+        auto const options = shaping_->options();
+        auto const download_socket = downloader_->socket();
+        while (write_socket_.bytesToWrite() < BUFFER_MAX)
+        {
+            // what the last write left is sent before taking more
+            if (!pending_.isEmpty())
+            {
+                if (!write_pending())
+                    return;
+                continue;
+            }
+
+            if (options.stall_every > 0 && options.stall_msec > 0 && n_since_stall_ >= options.stall_every)
+            {
+                n_since_stall_ = 0;
+                timer_.start(options.stall_msec);
+                return;
+            }
+
+            auto wanted = qMin(download_socket->bytesAvailable(), qint64(BUFFER_MAX));
+            if (options.stall_every > 0 && options.stall_msec > 0)
+                wanted = qMin(wanted, options.stall_every - n_since_stall_);
+            if (wanted <= 0)
+                break;
+
+            auto const n = shaping_->take(wanted);
+            if (n == 0)
+            {
+                timer_.start(shaping_->msec_to_wait());
+                return;
+            }
+
+            pending_ = download_socket->read(n);
+            n_since_stall_ += pending_.size();
+        }
+    }
+
+    // returns false when the rest has to wait for the socket to drain
+    bool write_pending()
+    {
+        auto const n = write_socket_.write(pending_);
+        if (n < 0)
+        {
+            // the client sees its socket close before the end of the file
+            qWarning() << "Write error:" << write_socket_.errorString();
+            failed_ = true;
+            write_socket_.abort();
+            return false;
+        }
+
+        pending_.remove(0, int(n));
+        return pending_.isEmpty();
+    }
+
+    static constexpr qint64 BUFFER_MAX {1024*16};
+
+    ShapedDownloader * const q_ptr;
+    std::shared_ptr<Downloader> downloader_;
+    QSharedPointer<StorageShaping> shaping_;
+
+    std::shared_ptr<QLocalSocket> read_socket_;
+    QLocalSocket write_socket_;
+    QTimer timer_;
+
+    // read and paid for, but not written yet
+    QByteArray pending_;
+    qint64 n_since_stall_ = 0;
+    bool failed_ = false;
+
+    ConnectionHelper connections_;
+};
+
+/***
+****
+***/
+
+ShapedDownloader::ShapedDownloader(std::shared_ptr<Downloader> const & downloader,
+                                   QSharedPointer<StorageShaping> const & shaping,
+                                   QObject * parent)
+    : Downloader(parent)
+    , d_ptr(new ShapedDownloaderPrivate(this, downloader, shaping))
+{
+}
+
+ShapedDownloader::~ShapedDownloader() = default;
+
+std::shared_ptr<QLocalSocket>
+ShapedDownloader::socket()
+{
+    Q_D(ShapedDownloader);
+
+    return d->socket();
+}
+
+void
+ShapedDownloader::finish()
+{
+    Q_D(ShapedDownloader);
+
+    d->finish();
+}
+
+qint64
+ShapedDownloader::file_size() const
+{
+    Q_D(const ShapedDownloader);
+
+    return d->file_size();
+}
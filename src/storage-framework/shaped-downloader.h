@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#pragma once
+
+#include "storage-framework/downloader.h"
+#include "storage-framework/storage-shaping.h"
+
+#include <QLocalSocket>
+#include <QScopedPointer>
+#include <QSharedPointer>
+
+#include <memory>
+
+class ShapedDownloaderPrivate;
+
+/**
+ * Passes the data of a downloader through a StorageShaping.
+ *
+ * The data of the wrapped downloader reaches the socket of the
+ * shaped one as fast as the shaping allows.
+ */
+class ShapedDownloader final: public Downloader
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(ShapedDownloader)
+
+public:
+
+    ShapedDownloader(std::shared_ptr<Downloader> const & downloader,
+                     QSharedPointer<StorageShaping> const & shaping,
+                     QObject * parent = nullptr);
+    virtual ~ShapedDownloader();
+
+    Q_DISABLE_COPY(ShapedDownloader)
+
+    std::shared_ptr<QLocalSocket> socket() override;
+    void finish() override;
+    qint64 file_size() const override;
+
+private:
+    QScopedPointer<ShapedDownloaderPrivate> const d_ptr;
+};
@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include "storage-framework/shaped-uploader.h"
+#include "util/connection-helper.h"
+
+#include <QDebug>
+#include <QTimer>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <functional> // std::bind()
+
+class ShapedUploaderPrivate
+{
+public:
+
+    ShapedUploaderPrivate(ShapedUploader * shaped_uploader,
+                          std::shared_ptr<Uploader> const & uploader,
+                          qint64 n_bytes,
+                          QSharedPointer<StorageShaping> const & shaping)
+        : q_ptr(shaped_uploader)
+        , uploader_(uploader)
+        , n_bytes_(n_bytes)
+        , shaping_(shaping)
+    {
+        timer_.setSingleShot(true);
+        QObject::connect(&timer_, &QTimer::timeout,
+            std::bind(&ShapedUploaderPrivate::send_more, this)
+        );
+
+        // listen for data to send and for room to send it
+        QObject::connect(&read_socket_, &QLocalSocket::readyRead,
+            std::bind(&ShapedUploaderPrivate::send_more, this)
+        );
+        connections_.remember(QObject::connect(
+            uploader_->socket().get(), &QLocalSocket::bytesWritten,
+            std::bind(&ShapedUploaderPrivate::send_more, this)
+        ));
+
+        connections_.remember(QObject::connect(
+            uploader_.get(), &Uploader::upload_progress,
+            q_ptr, &Uploader::upload_progress
+        ));
+        connections_.remember(QObject::connect(
+            uploader_.get(), &Uploader::commit_finished,
+            q_ptr, &Uploader::commit_finished
+        ));
+
+        // fire up the sockets
+        int fds[2];
+        int rc = socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds);
+        if (rc == -1)
+        {
+            qWarning() << "Error creating socket for the shaped uploader";
+            return;
+        }
+
+        // the write socket is for the client
+        write_socket_.reset(new QLocalSocket());
+        write_socket_->setSocketDescriptor(fds[1], QLocalSocket::ConnectedState, QIODevice::WriteOnly);
+
+        read_socket_.setSocketDescriptor(fds[0], QLocalSocket::ConnectedState, QIODevice::ReadOnly);
+    }
+
+    ~ShapedUploaderPrivate() = default;
+
+    Q_DISABLE_COPY(ShapedUploaderPrivate)
+
+    std::shared_ptr<QLocalSocket> socket()
+    {
+        return write_socket_;
+    }
+
+    void commit()
+    {
+        commit_requested_ = true;
+        check_for_commit();
+    }
+
+    QString file_name() const
+    {
+        return uploader_->file_name();
+    }
+
+    QStringList part_file_names() const
+    {
+        return uploader_->part_file_names();
+    }
+
+private:
+
+    void send_more()
+    {
+        // waiting for a stall to end or for more bandwidth
+        if (timer_.isActive() || failed_)
+            return;
+
+        auto const options = shaping_->options();
+        auto const upload_socket = uploader_->socket();
+        while (upload_socket->bytesToWrite() < BUFFER_MAX)
+        {
+            // what the last write left is sent before taking more
+            if (!pending_.isEmpty())
+            {
+                if (!write_pending())
+                    return;
+                continue;
+            }
+
+            if (options.stall_every > 0 && options.stall_msec > 0 && n_since_stall_ >= options.stall_every)
+            {
+                n_since_stall_ = 0;
+                timer_.start(options.stall_msec);
+                return;
+            }
+
+            auto wanted = qMin(read_socket_.bytesAvailable(), qint64(BUFFER_MAX));
+            if (options.stall_every > 0 && options.stall_msec > 0)
+                wanted = qMin(wanted, options.stall_every - n_since_stall_);
+            if (wanted <= 0)
+                break;
+
+            auto const n = shaping_->take(wanted);
+            if (n == 0)
+            {
+                timer_.start(shaping_->msec_to_wait());
+                return;
+            }
+
+            pending_ = read_socket_.read(n);
+            n_since_stall_ += pending_.size();
+        }
+
+        check_for_commit();
+    }
+
+    // returns false when the rest has to wait for the socket to drain
+    bool write_pending()
+    {
+        auto const upload_socket = uploader_->socket();
+        auto const n = upload_socket->write(pending_);
+        if (n < 0)
+        {
+            // the client sees its socket close, and the upload is not committed
+            qWarning() << "Write error:" << upload_socket->errorString();
+            failed_ = true;
+            read_socket_.abort();
+            return false;
+        }
+
+        pending_.remove(0, int(n));
+        n_sent_ += n;
+        if (n > 0)
+            Q_EMIT(q_ptr->upload_progress());
+        return pending_.isEmpty();
+    }
+
+    // the commit is a round trip too, and goes after the data
+    void check_for_commit()
+    {
+        if (!commit_requested_ || committing_ || failed_ || n_sent_ < n_bytes_ || uploader_->socket()->bytesToWrite() > 0)
+            return;
+
+        committing_ = true;
+        QTimer::singleShot(shaping_->options().latency_msec, q_ptr, [this](){
+            uploader_->commit();
+        });
+    }
+
+    static constexpr qint64 BUFFER_MAX {1024*16};
+
+    ShapedUploader * const q_ptr;
+    std::shared_ptr<Uploader> uploader_;
+    qint64 const n_bytes_;
+    QSharedPointer<StorageShaping> shaping_;
+
+    std::shared_ptr<QLocalSocket> write_socket_;
+    QLocalSocket read_socket_;
+    QTimer timer_;
+
+    // read and paid for, but not written yet
+    QByteArray pending_;
+    qint64 n_sent_ = 0;
+    qint64 n_since_stall_ = 0;
+    bool commit_requested_ = false;
+    bool committing_ = false;
+    bool failed_ = false;
+
+    ConnectionHelper connections_;
+};
+
+/***
+****
+***/
+
+ShapedUploader::ShapedUploader(std::shared_ptr<Uploader> const & uploader,
+                               qint64 n_bytes,
+                               QSharedPointer<StorageShaping> const & shaping,
+                               QObject * parent)
+    : Uploader(parent)
+    , d_ptr(new ShapedUploaderPrivate(this, uploader, n_bytes, shaping))
+{
+}
+
+ShapedUploader::~ShapedUploader() = default;
+
+std::shared_ptr<QLocalSocket>
+ShapedUploader::socket()
+{
+    Q_D(ShapedUploader);
+
+    return d->socket();
+}
+
+void
+ShapedUploader::commit()
+{
+    Q_D(ShapedUploader);
+
+    d->commit();
+}
+
+QString
+ShapedUploader::file_name() const
+{
+    Q_D(const ShapedUploader);
+
+    return d->file_name();
+}
+
+QStringList
+ShapedUploader::part_file_names() const
+{
+    Q_D(const ShapedUploader);
+
+    return d->part_file_names();
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#pragma once
+
+#include "storage-framework/storage-shaping.h"
+#include "storage-framework/uploader.h"
+
+#include <QLocalSocket>
+#include <QScopedPointer>
+#include <QSharedPointer>
+
+#include <memory>
+
+class ShapedUploaderPrivate;
+
+/**
+ * Passes the data of an uploader through a StorageShaping.
+ *
+ * The client writes to the socket of the shaped uploader, which
+ * sends the data to the wrapped one as fast as the shaping allows.
+ * The commit is sent once all the n_bytes have been sent.
+ */
+class ShapedUploader final: public Uploader
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(ShapedUploader)
+
+public:
+
+    ShapedUploader(std::shared_ptr<Uploader> const & uploader,
+                   qint64 n_bytes,
+                   QSharedPointer<StorageShaping> const & shaping,
+                   QObject * parent = nullptr);
+    virtual ~ShapedUploader();
+
+    Q_DISABLE_COPY(ShapedUploader)
+
+    std::shared_ptr<QLocalSocket> socket() override;
+    void commit() override;
+    QString file_name() const override;
+    QStringList part_file_names() const override;
+
+private:
+    QScopedPointer<ShapedUploaderPrivate> const d_ptr;
+};
@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include "storage-framework/storage-handle-cache.h"
+
+namespace sf = unity::storage::qt::client;
+
+StorageHandleCache::StorageHandleCache(qint64 ttl)
+    : ttl_(ttl)
+{
+    clock_.start();
+}
+
+/***
+****
+***/
+
+bool
+StorageHandleCache::get_accounts(QVector<sf::Account::SPtr> & accounts) const
+{
+    if (!has_accounts_ || !is_valid(accounts_.expires))
+        return false;
+
+    accounts = accounts_.value;
+    return true;
+}
+
+void
+StorageHandleCache::set_accounts(QVector<sf::Account::SPtr> const & accounts)
+{
+    // an empty list is not worth remembering
+    has_accounts_ = !accounts.isEmpty();
+    accounts_ = Entry<QVector<sf::Account::SPtr>>{accounts, expiration()};
+}
+
+bool
+StorageHandleCache::get_roots(QString const & account_id, QVector<sf::Root::SPtr> & roots) const
+{
+    auto it = roots_.constFind(account_id);
+    if (it == roots_.constEnd() || !is_valid(it->expires))
+        return false;
+
+    roots = it->value;
+    return true;
+}
+
+void
+StorageHandleCache::set_roots(QString const & account_id, QVector<sf::Root::SPtr> const & roots)
+{
+    if (roots.isEmpty())
+        roots_.remove(account_id);
+    else
+        roots_[account_id] = Entry<QVector<sf::Root::SPtr>>{roots, expiration()};
+}
+
+sf::Folder::SPtr
+StorageHandleCache::get_folder(QString const & account_id, QString const & path) const
+{
+    auto const folders = folders_.value(account_id);
+    auto it = folders.constFind(path);
+    if (it == folders.constEnd() || !is_valid(it->expires))
+        return sf::Folder::SPtr();
+
+    return it->value;
+}
+
+void
+StorageHandleCache::set_folder(QString const & account_id, QString const & path, sf::Folder::SPtr const & folder)
+{
+    if (!folder)
+    {
+        invalidate_folder(account_id, path);
+        return;
+    }
+
+    folders_[account_id][path] = Entry<sf::Folder::SPtr>{folder, expiration()};
+
+    // a folder created since its parent was listed joins the listing
+    auto const separator = path.lastIndexOf(QLatin1Char('/'));
+    if (separator < 0)
+        return;
+    auto& dirs = dirs_[account_id];
+    auto it = dirs.find(path.left(separator));
+    auto const name = path.mid(separator + 1);
+    if (it != dirs.end() && !it->value.contains(name))
+        it->value.push_back(name);
+}
+
+bool
+StorageHandleCache::get_dirs(QString const & account_id, QString const & path, QVector<QString> & dirs) const
+{
+    auto const listings = dirs_.value(account_id);
+    auto it = listings.constFind(path);
+    if (it == listings.constEnd() || !is_valid(it->expires))
+        return false;
+
+    dirs = it->value;
+    return true;
+}
+
+void
+StorageHandleCache::set_dirs(QString const & account_id, QString const & path, QVector<QString> const & dirs)
+{
+    // an empty listing is not worth remembering
+    if (dirs.isEmpty())
+        dirs_[account_id].remove(path);
+    else
+        dirs_[account_id][path] = Entry<QVector<QString>>{dirs, expiration()};
+}
+
+void
+StorageHandleCache::invalidate_folder(QString const & account_id, QString const & path)
+{
+    if (path.isEmpty())
+    {
+        folders_.remove(account_id);
+        dirs_.remove(account_id);
+        return;
+    }
+
+    auto const prefix = path + QLatin1Char('/');
+    auto const is_under = [&path, &prefix](QString const & key){
+        return key == path || key.startsWith(prefix);
+    };
+
+    auto& folders = folders_[account_id];
+    for (auto it = folders.begin(); it != folders.end(); )
+    {
+        if (is_under(it.key()))
+            it = folders.erase(it);
+        else
+            ++it;
+    }
+
+    auto& dirs = dirs_[account_id];
+    for (auto it = dirs.begin(); it != dirs.end(); )
+    {
+        if (is_under(it.key()))
+            it = dirs.erase(it);
+        else
+            ++it;
+    }
+}
+
+void
+StorageHandleCache::invalidate_account(QString const & account_id)
+{
+    has_accounts_ = false;
+    roots_.remove(account_id);
+    invalidate_folder(account_id, QString());
+}
+
+void
+StorageHandleCache::clear()
+{
+    has_accounts_ = false;
+    accounts_.value.clear();
+    roots_.clear();
+    folders_.clear();
+    dirs_.clear();
+}
+
+qint64
+StorageHandleCache::ttl() const
+{
+    return ttl_;
+}
+
+void
+StorageHandleCache::set_ttl(qint64 ttl)
+{
+    ttl_ = ttl;
+}
+
+/***
+****
+***/
+
+bool
+StorageHandleCache::is_valid(qint64 expires) const
+{
+    return clock_.elapsed() < expires;
+}
+
+qint64
+StorageHandleCache::expiration() const
+{
+    return clock_.elapsed() + ttl_;
+}
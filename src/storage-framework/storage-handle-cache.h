@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#pragma once
+
+#include <unity/storage/qt/client/client-api.h>
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+/**
+ * Remembers the storage-framework handles that were resolved recently,
+ * so the next operations skip the round trips to look them up again.
+ *
+ * Accounts are cached as a whole, roots by account id and folders by
+ * account id and path, as are the names of the folders listed in a folder.
+ * A folder resolved under a listed one is added to the listing.
+ * Entries expire after ttl milliseconds and can be dropped earlier
+ * when using them fails.
+ */
+class StorageHandleCache
+{
+public:
+
+    explicit StorageHandleCache(qint64 ttl = DEFAULT_TTL);
+    ~StorageHandleCache() =default;
+
+    Q_DISABLE_COPY(StorageHandleCache)
+
+    bool get_accounts(QVector<unity::storage::qt::client::Account::SPtr> & accounts) const;
+    void set_accounts(QVector<unity::storage::qt::client::Account::SPtr> const & accounts);
+
+    bool get_roots(QString const & account_id, QVector<unity::storage::qt::client::Root::SPtr> & roots) const;
+    void set_roots(QString const & account_id, QVector<unity::storage::qt::client::Root::SPtr> const & roots);
+
+    unity::storage::qt::client::Folder::SPtr get_folder(QString const & account_id, QString const & path) const;
+    void set_folder(QString const & account_id, QString const & path, unity::storage::qt::client::Folder::SPtr const & folder);
+
+    bool get_dirs(QString const & account_id, QString const & path, QVector<QString> & dirs) const;
+    void set_dirs(QString const & account_id, QString const & path, QVector<QString> const & dirs);
+
+    // drops the folder, the folders under it and their listings.
+    // An empty path drops all the folders of the account
+    void invalidate_folder(QString const & account_id, QString const & path);
+    // drops everything that was resolved through the account
+    void invalidate_account(QString const & account_id);
+    void clear();
+
+    qint64 ttl() const;
+    void set_ttl(qint64 ttl);
+
+    static constexpr qint64 DEFAULT_TTL {60 * 1000};
+
+private:
+
+    template<typename T>
+    struct Entry
+    {
+        T value;
+        qint64 expires;
+    };
+
+    bool is_valid(qint64 expires) const;
+    qint64 expiration() const;
+
+    qint64 ttl_;
+    QElapsedTimer clock_;
+    bool has_accounts_ = false;
+    Entry<QVector<unity::storage::qt::client::Account::SPtr>> accounts_;
+    QHash<QString, Entry<QVector<unity::storage::qt::client::Root::SPtr>>> roots_;
+    // folders by account id and path
+    QHash<QString, QHash<QString, Entry<unity::storage::qt::client::Folder::SPtr>>> folders_;
+    // names of the folders in a folder, by account id and path
+    QHash<QString, QHash<QString, Entry<QVector<QString>>>> dirs_;
+};
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include "storage-framework/storage-session.h"
+
+namespace sf = unity::storage::qt::client;
+
+StorageSession::StorageSession()
+    : runtime_(sf::Runtime::create())
+{
+}
+
+StorageSession::~StorageSession() = default;
+
+/***
+****
+***/
+
+sf::Runtime::SPtr
+StorageSession::runtime() const
+{
+    return runtime_;
+}
+
+StorageHandleCache &
+StorageSession::cache()
+{
+    return cache_;
+}
+
+void
+StorageSession::count_round_trip(QString const & operation, QString const & call)
+{
+    ++round_trips_[operation][call];
+}
+
+QMap<QString, int>
+StorageSession::round_trips() const
+{
+    QMap<QString, int> ret;
+    for (auto const & calls : round_trips_)
+        for (auto it = calls.cbegin(), end = calls.cend(); it != end; ++it)
+            ret[it.key()] += it.value();
+    return ret;
+}
+
+QMap<QString, int>
+StorageSession::round_trips(QString const & operation) const
+{
+    return round_trips_.value(operation);
+}
+
+void
+StorageSession::reset_round_trips()
+{
+    round_trips_.clear();
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#pragma once
+
+#include "storage-framework/storage-handle-cache.h"
+
+#include <unity/storage/qt/client/client-api.h>
+
+#include <QMap>
+#include <QString>
+
+/**
+ * The storage-framework state shared by the whole service.
+ *
+ * Owns the runtime, and so the connection to the storage providers,
+ * the cache of resolved handles and the count of remote calls.
+ * Every StorageFrameworkClient built on the same session reuses them,
+ * while keeping its own choice of account and its own last error.
+ */
+class StorageSession
+{
+public:
+
+    StorageSession();
+    ~StorageSession();
+
+    Q_DISABLE_COPY(StorageSession)
+
+    unity::storage::qt::client::Runtime::SPtr runtime() const;
+    StorageHandleCache & cache();
+
+    void count_round_trip(QString const & operation, QString const & call);
+
+    // the remote calls made so far, by kind of call.
+    // The first one adds up every operation
+    QMap<QString, int> round_trips() const;
+    QMap<QString, int> round_trips(QString const & operation) const;
+    void reset_round_trips();
+
+private:
+
+    unity::storage::qt::client::Runtime::SPtr runtime_;
+    StorageHandleCache cache_;
+    // operation -> call -> count
+    QMap<QString, QMap<QString, int>> round_trips_;
+};
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include "storage-framework/storage-shaping.h"
+
+#include <QtGlobal>
+
+#include <algorithm> // std::min(), std::max()
+#include <cmath> // std::ceil()
+
+namespace
+{
+    // the data that can be sent at once after an idle period
+    constexpr int BURST_MSEC {100};
+
+    // waiting for less than this makes many tiny writes
+    constexpr double MIN_SEND {1024};
+
+    qint64 env_value(char const * name)
+    {
+        bool ok {false};
+        auto const value = qgetenv(name).toLongLong(&ok);
+        return ok && value > 0 ? value : 0;
+    }
+}
+
+StorageShaping::StorageShaping(Options const & options)
+    : options_(options)
+{
+    tokens_ = capacity();
+    clock_.start();
+}
+
+StorageShaping::~StorageShaping() = default;
+
+StorageShaping::Options
+StorageShaping::options() const
+{
+    return options_;
+}
+
+bool
+StorageShaping::is_enabled() const
+{
+    return options_.latency_msec > 0
+        || options_.bytes_per_sec > 0
+        || (options_.stall_every > 0 && options_.stall_msec > 0)
+        || options_.max_write > 0;
+}
+
+double
+StorageShaping::capacity() const
+{
+    return std::max(double(options_.bytes_per_sec) * BURST_MSEC / 1000.0,
+                    std::max(double(options_.max_write), MIN_SEND));
+}
+
+void
+StorageShaping::refill()
+{
+    auto const now = clock_.nsecsElapsed();
+    auto const elapsed = double(now - last_refill_nsec_) / 1e9;
+    last_refill_nsec_ = now;
+    tokens_ = std::min(capacity(), tokens_ + elapsed * double(options_.bytes_per_sec));
+}
+
+qint64
+StorageShaping::take(qint64 wanted)
+{
+    auto ret = wanted;
+    if (options_.max_write > 0)
+        ret = std::min(ret, options_.max_write);
+
+    if (options_.bytes_per_sec > 0)
+    {
+        refill();
+        ret = std::min(ret, qint64(tokens_));
+        tokens_ -= double(ret);
+    }
+
+    return std::max(qint64(0), ret);
+}
+
+int
+StorageShaping::msec_to_wait() const
+{
+    if (options_.bytes_per_sec <= 0)
+        return 0;
+
+    auto const missing = std::min(capacity(), MIN_SEND) - tokens_;
+    return std::max(1, int(std::ceil(missing * 1000.0 / double(options_.bytes_per_sec))));
+}
+
+StorageShaping::Options
+StorageShaping::options_from_environment()
+{
+    Options ret;
+    ret.latency_msec = int(env_value("KEEPER_SHAPING_LATENCY_MSEC"));
+    ret.bytes_per_sec = env_value("KEEPER_SHAPING_KBITS") * 1000 / 8;
+    ret.stall_every = env_value("KEEPER_SHAPING_STALL_EVERY_KB") * 1024;
+    ret.stall_msec = int(env_value("KEEPER_SHAPING_STALL_MSEC"));
+    ret.max_write = env_value("KEEPER_SHAPING_MAX_WRITE");
+    return ret;
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#pragma once
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QFutureInterface>
+#include <QFutureWatcher>
+#include <QTimer>
+
+#include <exception>
+
+/**
+ * Makes a storage look like a remote one behind a slow link.
+ *
+ * It adds latency to the calls that are a round trip to the server,
+ * caps the throughput of the data streams and injects stalls and
+ * short writes, so the behaviour of keeper on mobile links can be
+ * measured against the local storage framework.
+ *
+ * The streams that share a StorageShaping share its bandwidth,
+ * like the connections of a single uplink or downlink.
+ */
+class StorageShaping
+{
+public:
+
+    struct Options
+    {
+        // added to every call that is a round trip to the server
+        int latency_msec {0};
+        // 0 means no limit
+        qint64 bytes_per_sec {0};
+        // every stream stops for stall_msec after this many bytes.
+        // 0 means no stalls
+        qint64 stall_every {0};
+        int stall_msec {0};
+        // the most a stream writes at once. 0 means no limit
+        qint64 max_write {0};
+    };
+
+    explicit StorageShaping(Options const & options);
+    ~StorageShaping();
+
+    Q_DISABLE_COPY(StorageShaping)
+
+    Options options() const;
+    bool is_enabled() const;
+
+    // the bytes, up to wanted, that can be sent now.
+    // When it returns 0, try again after msec_to_wait()
+    qint64 take(qint64 wanted);
+    int msec_to_wait() const;
+
+    // KEEPER_SHAPING_LATENCY_MSEC, KEEPER_SHAPING_KBITS,
+    // KEEPER_SHAPING_STALL_EVERY_KB, KEEPER_SHAPING_STALL_MSEC
+    // and KEEPER_SHAPING_MAX_WRITE
+    static Options options_from_environment();
+
+    // a future with the result of future, reported msec later
+    template<typename T>
+    static QFuture<T> delayed(QFuture<T> const & future, int msec)
+    {
+        if (msec <= 0)
+            return future;
+
+        QFutureInterface<T> fi;
+        fi.reportStarted();
+        auto watcher = new QFutureWatcher<T>();
+        QObject::connect(watcher, &QFutureWatcherBase::finished, [watcher, fi, msec]() {
+            // like ConnectionHelper, a future that threw gives a default result
+            T result {};
+            try {
+                result = watcher->result();
+            } catch(std::exception& e) {
+                qWarning() << "future threw error:" << e.what();
+            }
+            watcher->deleteLater();
+            QTimer::singleShot(msec, [fi, result]() {
+                QFutureInterface<T> qfi(fi);
+                qfi.reportResult(result);
+                qfi.reportFinished();
+            });
+        });
+        watcher->setFuture(future);
+        return fi.future();
+    }
+
+private:
+    void refill();
+    double capacity() const;
+
+    Options const options_;
+    double tokens_ {0};
+    QElapsedTimer clock_;
+    qint64 last_refill_nsec_ {0};
+};
@@ -19,25 +19,76 @@
  */
 
 #include "storage-framework/storage_framework_client.h"
+#include "storage-framework/chunked-downloader.h"
+#include "storage-framework/chunked-uploader.h"
 #include "storage-framework/sf-downloader.h"
 #include "storage-framework/sf-uploader.h"
+#if KEEPER_STORAGE_SHAPING
+#include "storage-framework/shaped-downloader.h"
+#include "storage-framework/shaped-uploader.h"
+#endif
 
 #include <QDateTime>
+#include <QStringList>
 #include <QVector>
 #include <QString>
 
+#include <algorithm> // std::find
+
 namespace sf = unity::storage::qt::client;
 
+namespace
+{
+    // one part commits while the next one streams
+    constexpr int DEFAULT_UPLOAD_STREAMS {2};
+
+    // the next parts are ready as soon as the current one is read
+    constexpr int DEFAULT_PREFETCHED_PARTS {2};
+
+    // the number of parts uploaded at once can be set with
+    // the KEEPER_UPLOAD_STREAMS environment variable
+    int default_upload_streams()
+    {
+        bool ok {false};
+        auto const n_streams = qgetenv("KEEPER_UPLOAD_STREAMS").toInt(&ok);
+        return ok && n_streams > 0 ? n_streams : DEFAULT_UPLOAD_STREAMS;
+    }
+
+    // the number of parts requested ahead on restore can be set with
+    // the KEEPER_PREFETCHED_PARTS environment variable
+    int default_prefetched_parts()
+    {
+        bool ok {false};
+        auto const n_parts = qgetenv("KEEPER_PREFETCHED_PARTS").toInt(&ok);
+        return ok && n_parts >= 0 ? n_parts : DEFAULT_PREFETCHED_PARTS;
+    }
+}
+
 /***
 ****
 ***/
 
 const QString StorageFrameworkClient::KEEPER_FOLDER = QStringLiteral("Ubuntu-Backups");
 
+const QString StorageFrameworkClient::UPLOAD_OPERATION = QStringLiteral("upload");
+const QString StorageFrameworkClient::DOWNLOAD_OPERATION = QStringLiteral("download");
+const QString StorageFrameworkClient::LIST_DIRS_OPERATION = QStringLiteral("list_dirs");
+const QString StorageFrameworkClient::ACCOUNTS_OPERATION = QStringLiteral("accounts");
+
 StorageFrameworkClient::StorageFrameworkClient(QObject *parent)
+    : StorageFrameworkClient(QSharedPointer<StorageSession>(new StorageSession()), parent)
+{
+}
+
+StorageFrameworkClient::StorageFrameworkClient(QSharedPointer<StorageSession> const & session, QObject *parent)
     : QObject(parent)
-    , runtime_(sf::Runtime::create())
+    , session_(session)
+    , upload_streams_(default_upload_streams())
+    , prefetched_parts_(default_prefetched_parts())
 {
+#if KEEPER_STORAGE_SHAPING
+    set_shaping(StorageShaping::options_from_environment());
+#endif
 }
 
 StorageFrameworkClient::~StorageFrameworkClient() = default;
@@ -47,7 +98,7 @@ StorageFrameworkClient::~StorageFrameworkClient() = default;
 ***/
 
 sf::Account::SPtr
-StorageFrameworkClient::choose(QVector<sf::Account::SPtr> const& choices) const
+StorageFrameworkClient::choose(QVector<sf::Account::SPtr> const& choices, Operation const & op) const
 {
     sf::Account::SPtr ret;
 
@@ -55,7 +106,7 @@ StorageFrameworkClient::choose(QVector<sf::Account::SPtr> const& choices) const
     if (choices.empty())
     {
         qWarning() << "no storage-framework accounts to pick from";
-        last_error_ = keeper::Error::NO_REMOTE_ACCOUNTS;
+        *op.error = keeper::Error::NO_REMOTE_ACCOUNTS;
     }
     else // for now just pick the first one. FIXME
     {
@@ -81,7 +132,7 @@ StorageFrameworkClient::choose(QVector<sf::Account::SPtr> const& choices) const
             if (!ret)
             {
                 qWarning() << "Storage framework account [" << storage_id_ << "] was not found";
-                last_error_ = keeper::Error::ACCOUNT_NOT_FOUND;
+                *op.error = keeper::Error::ACCOUNT_NOT_FOUND;
             }
         }
     }
@@ -90,17 +141,17 @@ StorageFrameworkClient::choose(QVector<sf::Account::SPtr> const& choices) const
 }
 
 sf::Root::SPtr
-StorageFrameworkClient::choose(QVector<sf::Root::SPtr> const& choices) const
+StorageFrameworkClient::choose(QVector<sf::Root::SPtr> const& choices, Operation const & op) const
 {
     sf::Root::SPtr ret;
 
-    if (last_error_ != keeper::Error::ACCOUNT_NOT_FOUND)
+    if (*op.error != keeper::Error::ACCOUNT_NOT_FOUND)
     {
         qDebug() << "choosing from" << choices.size() << "roots";
         if (choices.empty())
         {
             qWarning() << "no storage-framework roots to pick from";
-            last_error_ = keeper::Error::NO_REMOTE_ROOTS;
+            *op.error = keeper::Error::NO_REMOTE_ROOTS;
         }
         else // for now just pick the first one. FIXME
         {
@@ -115,24 +166,65 @@ StorageFrameworkClient::choose(QVector<sf::Root::SPtr> const& choices) const
 ****
 ***/
 
+StorageFrameworkClient::Operation
+StorageFrameworkClient::new_operation(QString const & name)
+{
+    return Operation{name, QString(), std::make_shared<keeper::Error>(keeper::Error::OK)};
+}
+
 void
-StorageFrameworkClient::add_accounts_task(std::function<void(QVector<sf::Account::SPtr> const&)> task)
+StorageFrameworkClient::add_accounts_task(QString const & operation, std::function<void(QVector<sf::Account::SPtr> const&)> task)
 {
-    connection_helper_.connect_future(runtime_->accounts(), task);
+    QVector<sf::Account::SPtr> accounts;
+    if (session_->cache().get_accounts(accounts))
+    {
+        task(accounts);
+        return;
+    }
+
+    connection_helper_.connect_future(
+        round_trip(operation, QStringLiteral("accounts"), session_->runtime()->accounts()),
+        std::function<void(QVector<sf::Account::SPtr> const&)>{
+            [this, task](QVector<sf::Account::SPtr> const& accounts){
+                session_->cache().set_accounts(accounts);
+                task(accounts);
+            }
+        }
+    );
 }
 
 void
-StorageFrameworkClient::add_roots_task(std::function<void(QVector<sf::Root::SPtr> const&)> task)
+StorageFrameworkClient::add_roots_task(Operation const & account_op, std::function<void(QVector<sf::Root::SPtr> const&, Operation const&)> task)
 {
-    add_accounts_task([this, task](QVector<sf::Account::SPtr> const& accounts)
+    add_accounts_task(account_op.name, [this, account_op, task](QVector<sf::Account::SPtr> const& accounts)
     {
-        auto account = choose(accounts);
+        auto account = choose(accounts, account_op);
         if (account)
-            connection_helper_.connect_future(account->roots(), task);
+        {
+            auto op = account_op;
+            op.account_id = get_account_id(account);
+
+            QVector<sf::Root::SPtr> roots;
+            if (session_->cache().get_roots(op.account_id, roots))
+            {
+                task(roots, op);
+                return;
+            }
+
+            connection_helper_.connect_future(
+                round_trip(op.name, QStringLiteral("roots"), account->roots()),
+                std::function<void(QVector<sf::Root::SPtr> const&)>{
+                    [this, task, op](QVector<sf::Root::SPtr> const& roots){
+                        session_->cache().set_roots(op.account_id, roots);
+                        task(roots, op);
+                    }
+                }
+            );
+        }
         else
         {
             QVector<sf::Root::SPtr> no_accounts;
-            task(no_accounts);
+            task(no_accounts, account_op);
         }
     });
 }
@@ -145,19 +237,17 @@ void StorageFrameworkClient::set_storage(QString const & storage)
 QFuture<std::shared_ptr<Uploader>>
 StorageFrameworkClient::get_new_uploader(int64_t n_bytes, QString const & dir_name, QString const & file_name)
 {
-    clear_last_error();
-
     QFutureInterface<std::shared_ptr<Uploader>> fi;
 
-    add_roots_task([this, fi, n_bytes, dir_name, file_name](QVector<sf::Root::SPtr> const& roots)
+    add_roots_task(new_operation(UPLOAD_OPERATION), [this, fi, n_bytes, dir_name, file_name](QVector<sf::Root::SPtr> const& roots, Operation const& op)
     {
-        auto root = choose(roots);
+        auto root = choose(roots, op);
         if (root)
         {
             connection_helper_.connect_future(
-                get_keeper_folder(root, dir_name, true),
+                get_keeper_folder(op, root, dir_name, true),
                 std::function<void(sf::Folder::SPtr const&)>{
-                    [this, fi, n_bytes, file_name,root](sf::Folder::SPtr const& keeper_folder){
+                    [this, fi, op, n_bytes, file_name,root](sf::Folder::SPtr const& keeper_folder){
                         if (!keeper_folder)
                         {
                             qWarning() << "Error creating keeper root folder";
@@ -169,9 +259,9 @@ StorageFrameworkClient::get_new_uploader(int64_t n_bytes, QString const & dir_na
                         else
                         {
                             connection_helper_.connect_future(
-                                keeper_folder->create_file(file_name, n_bytes),
+                                round_trip(op.name, QStringLiteral("create_file"), keeper_folder->create_file(file_name, n_bytes)),
                                 std::function<void(std::shared_ptr<sf::Uploader> const&)>{
-                                    [this, fi, keeper_folder](std::shared_ptr<sf::Uploader> const& sf_uploader){
+                                    [this, fi, op, keeper_folder, n_bytes](std::shared_ptr<sf::Uploader> const& sf_uploader){
                                         qDebug() << "keeper_root->create_file() finished";
                                         std::shared_ptr<Uploader> ret;
                                         if (sf_uploader)
@@ -180,10 +270,12 @@ StorageFrameworkClient::get_new_uploader(int64_t n_bytes, QString const & dir_na
                                                 new StorageFrameworkUploader(sf_uploader, this),
                                                 [](Uploader* u){u->deleteLater();}
                                             );
+                                            ret = shaped(ret, n_bytes);
                                         }
                                         else
                                         {
-                                            last_error_ = keeper::Error::CREATING_REMOTE_FILE;
+                                            *op.error = keeper::Error::CREATING_REMOTE_FILE;
+                                            invalidate_cache(op.account_id);
                                         }
                                         QFutureInterface<decltype(ret)> qfi(fi);
                                         qfi.reportResult(ret);
@@ -211,39 +303,50 @@ StorageFrameworkClient::get_new_uploader(int64_t n_bytes, QString const & dir_na
 QFuture<std::shared_ptr<Downloader>>
 StorageFrameworkClient::get_new_downloader(QString const & dir_name, QString const & file_name)
 {
-    clear_last_error();
-
     QFutureInterface<std::shared_ptr<Downloader>> fi;
 
-    add_roots_task([this, fi, dir_name, file_name](QVector<sf::Root::SPtr> const& roots)
+    download_file(new_operation(DOWNLOAD_OPERATION), dir_name, file_name, [fi](std::shared_ptr<Downloader> const& downloader)
+    {
+        QFutureInterface<std::shared_ptr<Downloader>> qfi(fi);
+        qfi.reportResult(downloader);
+        qfi.reportFinished();
+    });
+
+    return fi.future();
+}
+
+void
+StorageFrameworkClient::download_file(Operation const & download_op,
+                                      QString const & dir_name,
+                                      QString const & file_name,
+                                      std::function<void(std::shared_ptr<Downloader> const&)> const & on_done)
+{
+    add_roots_task(download_op, [this, on_done, dir_name, file_name](QVector<sf::Root::SPtr> const& roots, Operation const& op)
     {
-        auto root = choose(roots);
+        auto root = choose(roots, op);
         if (root)
         {
             connection_helper_.connect_future(
-                get_keeper_folder(root, dir_name, false),
+                get_keeper_folder(op, root, dir_name, false),
                 std::function<void(sf::Folder::SPtr const&)>{
-                    [this, fi, file_name, root](sf::Folder::SPtr const& keeper_root){
+                    [this, on_done, op, file_name, root](sf::Folder::SPtr const& keeper_root){
                         if (!keeper_root)
                         {
                             qWarning() << "Error accessing keeper root folder";
-                            std::shared_ptr<Downloader> ret;
-                            QFutureInterface<decltype(ret)> qfi(fi);
-                            qfi.reportResult(ret);
-                            qfi.reportFinished();
+                            on_done(std::shared_ptr<Downloader>());
                         }
                         else
                         {
                             qDebug() << "We found the storage-framework root folder" << keeper_root->name();
                             connection_helper_.connect_future(
-                                get_storage_framework_file(keeper_root, file_name),
+                                get_storage_framework_file(op, keeper_root, file_name),
                                 std::function<void(sf::File::SPtr const&)>{
-                                    [this, fi, root, keeper_root](sf::File::SPtr const& sf_file){
+                                    [this, on_done, op, root, keeper_root](sf::File::SPtr const& sf_file){
                                         if (sf_file) {
                                             connection_helper_.connect_future(
-                                                sf_file->create_downloader(),
+                                                round_trip(op.name, QStringLiteral("create_downloader"), sf_file->create_downloader()),
                                                 std::function<void(sf::Downloader::SPtr const&)>{
-                                                    [this, fi, sf_file, keeper_root, root](sf::Downloader::SPtr const& sf_downloader){
+                                                    [this, on_done, op, sf_file, keeper_root, root](sf::Downloader::SPtr const& sf_downloader){
                                                         std::shared_ptr<Downloader> ret;
                                                         if (sf_downloader)
                                                         {
@@ -251,23 +354,21 @@ StorageFrameworkClient::get_new_downloader(QString const & dir_name, QString con
                                                                 new StorageFrameworkDownloader(sf_downloader, sf_file->size(), this),
                                                                 [](Downloader* d){d->deleteLater();}
                                                             );
+                                                            ret = shaped(ret);
                                                         }
                                                         else
                                                         {
-                                                            last_error_ = keeper::Error::READING_REMOTE_FILE;
+                                                            *op.error = keeper::Error::READING_REMOTE_FILE;
+                                                            invalidate_cache(op.account_id);
                                                         }
-                                                        QFutureInterface<decltype(ret)> qfi(fi);
-                                                        qfi.reportResult(ret);
-                                                        qfi.reportFinished();
+                                                        on_done(ret);
                                                     }
                                                 }
                                             );
                                         } else {
-                                            last_error_ = keeper::Error::READING_REMOTE_FILE;
-                                            std::shared_ptr<Downloader> ret_null;
-                                            QFutureInterface<decltype(ret_null)> qfi(fi);
-                                            qfi.reportResult(ret_null);
-                                            qfi.reportFinished();
+                                            *op.error = keeper::Error::READING_REMOTE_FILE;
+                                            invalidate_cache(op.account_id);
+                                            on_done(std::shared_ptr<Downloader>());
                                         }
                                     }
                                 }
@@ -279,7 +380,69 @@ StorageFrameworkClient::get_new_downloader(QString const & dir_name, QString con
         }
         else
         {
-            std::shared_ptr<Downloader> ret;
+            on_done(std::shared_ptr<Downloader>());
+        }
+    });
+}
+
+QFuture<StorageFrameworkClient::UploaderResult>
+StorageFrameworkClient::get_new_chunked_uploader(int64_t n_bytes,
+                                                 QString const & dir_name,
+                                                 QString const & file_name,
+                                                 QStringList const & committed_part_file_names,
+                                                 QStringList const & committed_part_hashes)
+{
+    QFutureInterface<UploaderResult> fi;
+
+    // the remote folder is resolved first, so errors with the
+    // account or the folder are reported before any data is sent
+    add_roots_task(new_operation(UPLOAD_OPERATION), [this, fi, n_bytes, dir_name, file_name, committed_part_file_names, committed_part_hashes](QVector<sf::Root::SPtr> const& roots, Operation const& op)
+    {
+        auto root = choose(roots, op);
+        if (root)
+        {
+            connection_helper_.connect_future(
+                get_keeper_folder(op, root, dir_name, true),
+                std::function<void(sf::Folder::SPtr const&)>{
+                    [this, fi, op, n_bytes, dir_name, file_name, committed_part_file_names, committed_part_hashes](sf::Folder::SPtr const& keeper_folder){
+                        UploaderResult ret;
+                        if (!keeper_folder)
+                        {
+                            qWarning() << "Error creating keeper root folder";
+                        }
+                        else
+                        {
+                            auto uploader = new ChunkedUploader(
+                                [this, dir_name](QString const & part_file_name, qint64 part_size){
+                                    return get_new_uploader(part_size, dir_name, part_file_name);
+                                },
+                                n_bytes,
+                                file_name,
+                                ChunkedUploader::DEFAULT_PART_SIZE,
+                                upload_streams_,
+                                this
+                            );
+                            uploader->set_part_remover(
+                                [this, dir_name](QString const & part_file_name){
+                                    return remove_file(dir_name, part_file_name);
+                                }
+                            );
+                            if (!committed_part_file_names.isEmpty())
+                                uploader->skip_parts(committed_part_file_names, committed_part_hashes);
+                            ret.uploader.reset(uploader, [](Uploader* u){u->deleteLater();});
+                        }
+                        ret.error = *op.error;
+                        QFutureInterface<decltype(ret)> qfi(fi);
+                        qfi.reportResult(ret);
+                        qfi.reportFinished();
+                    }
+                }
+            );
+        }
+        else
+        {
+            UploaderResult ret;
+            ret.error = *op.error;
             QFutureInterface<decltype(ret)> qfi(fi);
             qfi.reportResult(ret);
             qfi.reportFinished();
@@ -289,32 +452,256 @@ StorageFrameworkClient::get_new_downloader(QString const & dir_name, QString con
     return fi.future();
 }
 
+QFuture<StorageFrameworkClient::DownloaderResult>
+StorageFrameworkClient::get_new_downloader(QString const & dir_name, QStringList const & file_names)
+{
+    QFutureInterface<DownloaderResult> fi;
+
+    auto const download_op = new_operation(DOWNLOAD_OPERATION);
+    if (file_names.size() == 1)
+    {
+        download_file(download_op, dir_name, file_names.front(), [fi, download_op](std::shared_ptr<Downloader> const& downloader)
+        {
+            DownloaderResult ret {downloader, *download_op.error};
+            QFutureInterface<decltype(ret)> qfi(fi);
+            qfi.reportResult(ret);
+            qfi.reportFinished();
+        });
+        return fi.future();
+    }
+
+    add_roots_task(download_op, [this, fi, dir_name, file_names](QVector<sf::Root::SPtr> const& roots, Operation const& op)
+    {
+        auto root = choose(roots, op);
+        if (root)
+        {
+            connection_helper_.connect_future(
+                get_keeper_folder(op, root, dir_name, false),
+                std::function<void(sf::Folder::SPtr const&)>{
+                    [this, fi, op, file_names](sf::Folder::SPtr const& keeper_root){
+                        if (!keeper_root)
+                        {
+                            qWarning() << "Error accessing keeper root folder";
+                            DownloaderResult ret {nullptr, *op.error};
+                            QFutureInterface<decltype(ret)> qfi(fi);
+                            qfi.reportResult(ret);
+                            qfi.reportFinished();
+                        }
+                        else
+                        {
+                            connection_helper_.connect_future(
+                                get_storage_framework_files(op, keeper_root, file_names),
+                                std::function<void(QVector<sf::File::SPtr> const&)>{
+                                    [this, fi, op](QVector<sf::File::SPtr> const& files){
+                                        DownloaderResult ret;
+                                        if (files.isEmpty())
+                                        {
+                                            *op.error = keeper::Error::READING_REMOTE_FILE;
+                                            invalidate_cache(op.account_id);
+                                        }
+                                        else
+                                        {
+                                            QVector<qint64> part_sizes;
+                                            for (auto const& file : files)
+                                                part_sizes.push_back(file->size());
+                                            ret.downloader.reset(
+                                                new ChunkedDownloader(
+                                                    [this, op, files](int part){
+                                                        return create_downloader(op, files[part]);
+                                                    },
+                                                    part_sizes,
+                                                    prefetched_parts_,
+                                                    this
+                                                ),
+                                                [](Downloader* d){d->deleteLater();}
+                                            );
+                                        }
+                                        ret.error = *op.error;
+                                        QFutureInterface<decltype(ret)> qfi(fi);
+                                        qfi.reportResult(ret);
+                                        qfi.reportFinished();
+                                    }
+                                }
+                            );
+                        }
+                    }
+                }
+            );
+        }
+        else
+        {
+            DownloaderResult ret {nullptr, *op.error};
+            QFutureInterface<decltype(ret)> qfi(fi);
+            qfi.reportResult(ret);
+            qfi.reportFinished();
+        }
+    });
+
+    return fi.future();
+}
+
+QFuture<bool>
+StorageFrameworkClient::file_exists(QString const & dir_name, QString const & file_name)
+{
+    QFutureInterface<bool> fi;
+
+    add_roots_task(new_operation(DOWNLOAD_OPERATION), [this, fi, dir_name, file_name](QVector<sf::Root::SPtr> const& roots, Operation const& op)
+    {
+        auto root = choose(roots, op);
+        if (root)
+        {
+            connection_helper_.connect_future(
+                get_keeper_folder(op, root, dir_name, false),
+                std::function<void(sf::Folder::SPtr const&)>{
+                    [this, fi, op, file_name](sf::Folder::SPtr const& keeper_folder){
+                        if (!keeper_folder)
+                        {
+                            QFutureInterface<bool> qfi(fi);
+                            qfi.reportResult(false);
+                            qfi.reportFinished();
+                            return;
+                        }
+                        connection_helper_.connect_future(
+                            get_storage_framework_file(op, keeper_folder, file_name),
+                            std::function<void(sf::File::SPtr const&)>{
+                                [fi](sf::File::SPtr const& sf_file){
+                                    QFutureInterface<bool> qfi(fi);
+                                    qfi.reportResult(bool(sf_file));
+                                    qfi.reportFinished();
+                                }
+                            }
+                        );
+                    }
+                }
+            );
+        }
+        else
+        {
+            QFutureInterface<bool> qfi(fi);
+            qfi.reportResult(false);
+            qfi.reportFinished();
+        }
+    });
+
+    return fi.future();
+}
+
+QFuture<bool>
+StorageFrameworkClient::remove_file(QString const & dir_name, QString const & file_name)
+{
+    QFutureInterface<bool> fi;
+
+    add_roots_task(new_operation(UPLOAD_OPERATION), [this, fi, dir_name, file_name](QVector<sf::Root::SPtr> const& roots, Operation const& op)
+    {
+        auto root = choose(roots, op);
+        if (!root)
+        {
+            QFutureInterface<bool> qfi(fi);
+            qfi.reportResult(false);
+            qfi.reportFinished();
+            return;
+        }
+        connection_helper_.connect_future(
+            get_keeper_folder(op, root, dir_name, false),
+            std::function<void(sf::Folder::SPtr const&)>{
+                [this, fi, op, file_name](sf::Folder::SPtr const& keeper_folder){
+                    if (!keeper_folder)
+                    {
+                        QFutureInterface<bool> qfi(fi);
+                        qfi.reportResult(false);
+                        qfi.reportFinished();
+                        return;
+                    }
+                    connection_helper_.connect_future(
+                        get_storage_framework_file(op, keeper_folder, file_name),
+                        std::function<void(sf::File::SPtr const&)>{
+                            [this, fi, op](sf::File::SPtr const& sf_file){
+                                // nothing to remove
+                                if (!sf_file)
+                                {
+                                    QFutureInterface<bool> qfi(fi);
+                                    qfi.reportResult(true);
+                                    qfi.reportFinished();
+                                    return;
+                                }
+                                auto watcher = new QFutureWatcher<void>();
+                                connection_helper_.connect_oneshot(
+                                    watcher,
+                                    &QFutureWatcher<void>::finished,
+                                    std::function<void()>{[this, fi, op, watcher](){
+                                        bool removed = true;
+                                        try {
+                                            watcher->future().waitForFinished();
+                                        } catch (std::exception & e) {
+                                            qWarning() << "Error removing a file:" << e.what();
+                                            invalidate_cache(op.account_id);
+                                            removed = false;
+                                        }
+                                        QFutureInterface<bool> qfi(fi);
+                                        qfi.reportResult(removed);
+                                        qfi.reportFinished();
+                                    }},
+                                    [watcher](){watcher->deleteLater();}
+                                );
+                                // round_trip() needs a result to delay, so the call is only counted
+                                count_round_trip(op.name, QStringLiteral("delete"));
+                                watcher->setFuture(sf_file->delete_item());
+                            }
+                        }
+                    );
+                }
+            }
+        );
+    });
+
+    return fi.future();
+}
+
 QFuture<QVector<QString>>
 StorageFrameworkClient::get_keeper_dirs()
 {
-    clear_last_error();
-
     QFutureInterface<QVector<QString>> fi;
 
-    add_roots_task([this, fi](QVector<sf::Root::SPtr> const& roots)
+    connection_helper_.connect_future(
+        get_account_keeper_dirs(),
+        std::function<void(KeeperDirs const &)>{
+            [fi](KeeperDirs const & keeper_dirs){
+                QFutureInterface<QVector<QString>> qfi(fi);
+                qfi.reportResult(keeper_dirs.dirs);
+                qfi.reportFinished();
+            }
+        }
+    );
+
+    return fi.future();
+}
+
+QFuture<StorageFrameworkClient::KeeperDirs>
+StorageFrameworkClient::get_account_keeper_dirs()
+{
+    QFutureInterface<KeeperDirs> fi;
+
+    add_roots_task(new_operation(LIST_DIRS_OPERATION), [this, fi](QVector<sf::Root::SPtr> const& roots, Operation const& op)
     {
-        auto root = choose(roots);
+        auto root = choose(roots, op);
         if (root)
         {
             connection_helper_.connect_future(
-                     get_storage_framework_folder(root, KEEPER_FOLDER, false),
+                     get_cached_folder(op, root, KEEPER_FOLDER, KEEPER_FOLDER, false),
                      std::function<void(sf::Folder::SPtr const &)>{
-                          [this, fi, root](sf::Folder::SPtr const & keeper_folder){
-                              QVector<QString> res;
+                          [this, fi, op, root](sf::Folder::SPtr const & keeper_folder){
+                              KeeperDirs res {op.account_id, QVector<QString>(), *op.error};
                               if (keeper_folder)
                               {
                                   qDebug() << "Keeper root folder was found";
                                   connection_helper_.connect_future(
-                                          get_storage_framework_dirs(keeper_folder),
+                                          get_cached_dirs(op, keeper_folder, KEEPER_FOLDER),
                                           std::function<void(QVector<QString> const &)> {
                                               [this, fi, res](QVector<QString> const & keeper_folders){
-                                                  QFutureInterface<decltype(res)> qfi(fi);
-                                                  qfi.reportResult(keeper_folders);
+                                                  auto ret = res;
+                                                  ret.dirs = keeper_folders;
+                                                  QFutureInterface<decltype(ret)> qfi(fi);
+                                                  qfi.reportResult(ret);
                                                   qfi.reportFinished();
                                               }
                                           }
@@ -334,7 +721,8 @@ StorageFrameworkClient::get_keeper_dirs()
         else
         {
             qDebug() << "No dirs were found";
-            QVector<QString> res;
+            KeeperDirs res;
+            res.error = *op.error;
             QFutureInterface<decltype(res)> qfi(fi);
             qfi.reportResult(res);
             qfi.reportFinished();
@@ -343,17 +731,59 @@ StorageFrameworkClient::get_keeper_dirs()
     return fi.future();
 }
 
-keeper::Error
-StorageFrameworkClient::get_last_error() const
+void
+StorageFrameworkClient::set_upload_streams(int n_streams)
+{
+    upload_streams_ = qMax(1, n_streams);
+}
+
+int
+StorageFrameworkClient::upload_streams() const
 {
-    return last_error_;
+    return upload_streams_;
+}
+
+void
+StorageFrameworkClient::set_prefetched_parts(int n_parts)
+{
+    prefetched_parts_ = qMax(0, n_parts);
+}
+
+int
+StorageFrameworkClient::prefetched_parts() const
+{
+    return prefetched_parts_;
+}
+
+void
+StorageFrameworkClient::set_cache_ttl(qint64 ttl)
+{
+    session_->cache().set_ttl(ttl);
+}
+
+QMap<QString, int>
+StorageFrameworkClient::get_round_trips() const
+{
+    return session_->round_trips();
+}
+
+QMap<QString, int>
+StorageFrameworkClient::get_round_trips(QString const & operation) const
+{
+    return session_->round_trips(operation);
+}
+
+void
+StorageFrameworkClient::reset_round_trips()
+{
+    session_->reset_round_trips();
 }
 
 QFuture<QStringList>
 StorageFrameworkClient::get_accounts()
 {
     QFutureInterface<QStringList> fi;
-    add_accounts_task([this, fi](QVector<sf::Account::SPtr> const& accounts)
+    add_accounts_task(ACCOUNTS_OPERATION, [this, fi](QVector<sf::Account::SPtr> const& accounts)
     {
         QFutureInterface<QStringList> qfi(fi);
         QStringList ret_accounts;
@@ -369,14 +799,14 @@ StorageFrameworkClient::get_accounts()
 }
 
 QFuture<sf::Folder::SPtr>
-StorageFrameworkClient::get_keeper_folder(sf::Folder::SPtr const & root, QString const & dir_name, bool create_if_not_exists)
+StorageFrameworkClient::get_keeper_folder(Operation const & op, sf::Folder::SPtr const & root, QString const & dir_name, bool create_if_not_exists)
 {
     QFutureInterface<sf::Folder::SPtr> fi;
 
     connection_helper_.connect_future(
-        get_storage_framework_folder(root, KEEPER_FOLDER, create_if_not_exists),
+        get_cached_folder(op, root, KEEPER_FOLDER, KEEPER_FOLDER, create_if_not_exists),
         std::function<void(sf::Folder::SPtr const &)>{
-            [this, fi, root, dir_name, create_if_not_exists](sf::Folder::SPtr const & keeper_folder){
+            [this, fi, op, root, dir_name, create_if_not_exists](sf::Folder::SPtr const & keeper_folder){
                 if (!keeper_folder)
                 {
                     qWarning() << "Error creating keeper root folder: " << dir_name;
@@ -388,7 +818,7 @@ StorageFrameworkClient::get_keeper_folder(sf::Folder::SPtr const & root, QString
                 else
                 {
                     connection_helper_.connect_future(
-                        get_storage_framework_folder(keeper_folder, dir_name, create_if_not_exists),
+                        get_cached_folder(op, keeper_folder, QStringLiteral("%1/%2").arg(KEEPER_FOLDER).arg(dir_name), dir_name, create_if_not_exists),
                         std::function<void(sf::Folder::SPtr const &)>{
                             [this, fi, root](sf::Folder::SPtr const & timestamp_folder){
                                 if (!timestamp_folder)
@@ -410,16 +840,49 @@ StorageFrameworkClient::get_keeper_folder(sf::Folder::SPtr const & root, QString
 }
 
 QFuture<sf::Folder::SPtr>
-StorageFrameworkClient::get_storage_framework_folder(sf::Folder::SPtr const & root,
+StorageFrameworkClient::get_cached_folder(Operation const & op,
+                                          sf::Folder::SPtr const & parent,
+                                          QString const & path,
+                                          QString const & dir_name,
+                                          bool create_if_not_exists)
+{
+    QFutureInterface<sf::Folder::SPtr> fi;
+
+    auto folder = session_->cache().get_folder(op.account_id, path);
+    if (folder)
+    {
+        fi.reportResult(folder);
+        fi.reportFinished();
+        return fi.future();
+    }
+
+    connection_helper_.connect_future(
+        get_storage_framework_folder(op, parent, dir_name, create_if_not_exists),
+        std::function<void(sf::Folder::SPtr const &)>{
+            [this, fi, op, path](sf::Folder::SPtr const & folder){
+                session_->cache().set_folder(op.account_id, path, folder);
+                QFutureInterface<sf::Folder::SPtr> qfi(fi);
+                qfi.reportResult(folder);
+                qfi.reportFinished();
+            }
+        }
+    );
+
+    return fi.future();
+}
+
+QFuture<sf::Folder::SPtr>
+StorageFrameworkClient::get_storage_framework_folder(Operation const & op,
+                                                     sf::Folder::SPtr const & root,
                                                      QString const & dir_name,
                                                      bool create_if_not_exists)
 {
     QFutureInterface<sf::Folder::SPtr> fi;
 
     connection_helper_.connect_future(
-        root->lookup(dir_name),
+        round_trip(op.name, QStringLiteral("lookup"), root->lookup(dir_name)),
         std::function<void(QVector<sf::Item::SPtr> const &)>{
-            [this, fi, root, dir_name, create_if_not_exists](QVector<sf::Item::SPtr> const & item){
+            [this, fi, op, root, dir_name, create_if_not_exists](QVector<sf::Item::SPtr> const & item){
                 if (item.size())
                 {
                     auto it = item.at(0);
@@ -434,21 +897,23 @@ StorageFrameworkClient::get_storage_framework_folder(sf::Folder::SPtr const & ro
                     sf::Folder::SPtr res;
                     if (!create_if_not_exists)
                     {
+                        *op.error = keeper::Error::REMOTE_DIR_NOT_EXISTS;
+                        invalidate_cache(op.account_id);
                         QFutureInterface<decltype(res)> qfi(fi);
                         qfi.reportResult(res);
                         qfi.reportFinished();
-                        last_error_ = keeper::Error::REMOTE_DIR_NOT_EXISTS;
                     }
                     else
                     {
                         // we need to create the folder
                         connection_helper_.connect_future(
-                            root->create_folder(dir_name),
+                            round_trip(op.name, QStringLiteral("create_folder"), root->create_folder(dir_name)),
                             std::function<void(sf::Folder::SPtr const &)>{
-                                [this, fi, res, root](sf::Folder::SPtr const & folder){
+                                [this, fi, op, res, root](sf::Folder::SPtr const & folder){
                                     if (!folder)
                                     {
-                                        last_error_ = keeper::Error::CREATING_REMOTE_DIR;
+                                        *op.error = keeper::Error::CREATING_REMOTE_DIR;
+                                        invalidate_cache(op.account_id);
                                     }
                                     QFutureInterface<decltype(res)> qfi(fi);
                                     qfi.reportResult(folder);
@@ -466,12 +931,12 @@ StorageFrameworkClient::get_storage_framework_folder(sf::Folder::SPtr const & ro
 }
 
 QFuture<sf::File::SPtr>
-StorageFrameworkClient::get_storage_framework_file(sf::Folder::SPtr const & root, QString const & file_name)
+StorageFrameworkClient::get_storage_framework_file(Operation const & op, sf::Folder::SPtr const & root, QString const & file_name)
 {
     QFutureInterface<sf::File::SPtr> fi;
 
     connection_helper_.connect_future(
-        root->lookup(file_name),
+        round_trip(op.name, QStringLiteral("lookup"), root->lookup(file_name)),
         std::function<void(QVector<sf::Item::SPtr> const &)>{
             [this, fi, root, file_name](QVector<sf::Item::SPtr> const & item){
                 if (item.size())
@@ -500,13 +965,86 @@ StorageFrameworkClient::get_storage_framework_file(sf::Folder::SPtr const & root
     return fi.future();
 }
 
+QFuture<QVector<sf::File::SPtr>>
+StorageFrameworkClient::get_storage_framework_files(Operation const & op, sf::Folder::SPtr const & root, QStringList const & file_names)
+{
+    QFutureInterface<QVector<sf::File::SPtr>> fi;
+
+    // the files are looked up at once; the result is empty if any of them is missing
+    if (file_names.isEmpty())
+    {
+        QVector<sf::File::SPtr> res;
+        fi.reportResult(res);
+        fi.reportFinished();
+        return fi.future();
+    }
+
+    auto files = std::make_shared<QVector<sf::File::SPtr>>(file_names.size());
+    auto n_pending = std::make_shared<int>(file_names.size());
+    for (int i = 0; i < file_names.size(); ++i)
+    {
+        connection_helper_.connect_future(
+            get_storage_framework_file(op, root, file_names[i]),
+            std::function<void(sf::File::SPtr const&)>{
+                [fi, files, n_pending, i](sf::File::SPtr const& file){
+                    (*files)[i] = file;
+                    if (--(*n_pending) > 0)
+                        return;
+
+                    QVector<sf::File::SPtr> res;
+                    if (std::find(files->begin(), files->end(), nullptr) == files->end())
+                        res = *files;
+                    QFutureInterface<decltype(res)> qfi(fi);
+                    qfi.reportResult(res);
+                    qfi.reportFinished();
+                }
+            }
+        );
+    }
+
+    return fi.future();
+}
+
+QFuture<std::shared_ptr<Downloader>>
+StorageFrameworkClient::create_downloader(Operation const & op, sf::File::SPtr const & file)
+{
+    QFutureInterface<std::shared_ptr<Downloader>> fi;
+
+    connection_helper_.connect_future(
+        round_trip(op.name, QStringLiteral("create_downloader"), file->create_downloader()),
+        std::function<void(sf::Downloader::SPtr const&)>{
+            [this, fi, op, file](sf::Downloader::SPtr const& sf_downloader){
+                std::shared_ptr<Downloader> ret;
+                if (sf_downloader)
+                {
+                    ret.reset(
+                        new StorageFrameworkDownloader(sf_downloader, file->size(), this),
+                        [](Downloader* d){d->deleteLater();}
+                    );
+                    ret = shaped(ret);
+                }
+                else
+                {
+                    *op.error = keeper::Error::READING_REMOTE_FILE;
+                    invalidate_cache(op.account_id);
+                }
+                QFutureInterface<decltype(ret)> qfi(fi);
+                qfi.reportResult(ret);
+                qfi.reportFinished();
+            }
+        }
+    );
+
+    return fi.future();
+}
+
 QFuture<QVector<QString>>
-StorageFrameworkClient::get_storage_framework_dirs(unity::storage::qt::client::Folder::SPtr const & root)
+StorageFrameworkClient::get_storage_framework_dirs(Operation const & op, unity::storage::qt::client::Folder::SPtr const & root)
 {
     QFutureInterface<QVector<QString>> fi;
 
     connection_helper_.connect_future(
-        root->list(),
+        round_trip(op.name, QStringLiteral("list"), root->list()),
         std::function<void(QVector<sf::Item::SPtr> const &)>{
             [this, fi, root](QVector<sf::Item::SPtr> const & items){
                 QVector<QString> res;
@@ -529,10 +1067,100 @@ StorageFrameworkClient::get_storage_framework_dirs(unity::storage::qt::client::F
     return fi.future();
 }
 
+QFuture<QVector<QString>>
+StorageFrameworkClient::get_cached_dirs(Operation const & op,
+                                        sf::Folder::SPtr const & root,
+                                        QString const & path)
+{
+    QFutureInterface<QVector<QString>> fi;
+
+    QVector<QString> dirs;
+    if (session_->cache().get_dirs(op.account_id, path, dirs))
+    {
+        fi.reportResult(dirs);
+        fi.reportFinished();
+        return fi.future();
+    }
+
+    connection_helper_.connect_future(
+        get_storage_framework_dirs(op, root),
+        std::function<void(QVector<QString> const &)>{
+            [this, fi, op, path](QVector<QString> const & dirs){
+                session_->cache().set_dirs(op.account_id, path, dirs);
+                QFutureInterface<QVector<QString>> qfi(fi);
+                qfi.reportResult(dirs);
+                qfi.reportFinished();
+            }
+        }
+    );
+
+    return fi.future();
+}
+
+void
+StorageFrameworkClient::count_round_trip(QString const & operation, QString const & call) const
+{
+    session_->count_round_trip(operation, call);
+}
+
+#if KEEPER_STORAGE_SHAPING
+
+void
+StorageFrameworkClient::set_shaping(StorageShaping::Options const & options)
+{
+    // uploads and downloads don't share the bandwidth, like most links
+    upload_shaping_.reset(new StorageShaping(options));
+    download_shaping_.reset(new StorageShaping(options));
+}
+
+std::shared_ptr<Uploader>
+StorageFrameworkClient::shaped(std::shared_ptr<Uploader> const & uploader, qint64 n_bytes)
+{
+    if (!upload_shaping_->is_enabled())
+        return uploader;
+
+    return std::shared_ptr<Uploader>(
+        new ShapedUploader(uploader, n_bytes, upload_shaping_, this),
+        [](Uploader* u){u->deleteLater();}
+    );
+}
+
+std::shared_ptr<Downloader>
+StorageFrameworkClient::shaped(std::shared_ptr<Downloader> const & downloader)
+{
+    if (!download_shaping_->is_enabled())
+        return downloader;
+
+    return std::shared_ptr<Downloader>(
+        new ShapedDownloader(downloader, download_shaping_, this),
+        [](Downloader* d){d->deleteLater();}
+    );
+}
+
+#else
+
+// built without the link shaping, the streams are used as they are
+
+std::shared_ptr<Uploader>
+StorageFrameworkClient::shaped(std::shared_ptr<Uploader> const & uploader, qint64)
+{
+    return uploader;
+}
+
+std::shared_ptr<Downloader>
+StorageFrameworkClient::shaped(std::shared_ptr<Downloader> const & downloader)
+{
+    return downloader;
+}
+
+#endif
+
 void
-StorageFrameworkClient::clear_last_error()
+StorageFrameworkClient::invalidate_cache(QString const & account_id)
 {
-    last_error_ = keeper::Error::OK;
+    // the cached handles may be stale, resolve them again next time
+    qDebug() << "Dropping the cached storage-framework handles of account" << account_id;
+    session_->cache().invalidate_account(account_id);
 }
 
 QString
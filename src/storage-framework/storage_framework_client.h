@@ -22,13 +22,21 @@
 
 #include "client/keeper-errors.h"
 #include "util/connection-helper.h"
+#include "util/metrics.h"
 #include "storage-framework/uploader.h"
 #include "storage-framework/downloader.h"
+#include "storage-framework/storage-session.h"
+#if KEEPER_STORAGE_SHAPING
+#include "storage-framework/storage-shaping.h"
+#endif
 
 #include <unity/storage/qt/client/client-api.h>
 
+#include <QElapsedTimer>
 #include <QObject>
 #include <QFutureWatcher>
+#include <QMap>
+#include <QSharedPointer>
 
 #include <cstddef> // int64_t
 #include <functional>
@@ -41,37 +49,161 @@ class StorageFrameworkClient final: public QObject
 public:
 
     explicit StorageFrameworkClient(QObject *parent = nullptr);
+    // shares the runtime and the cached handles of the session
+    explicit StorageFrameworkClient(QSharedPointer<StorageSession> const & session, QObject *parent = nullptr);
     virtual ~StorageFrameworkClient();
 
     Q_DISABLE_COPY(StorageFrameworkClient)
 
     void set_storage(QString const & storage);
+
+    // a stream, or the error that kept it from being created.
+    // Every call gets its own error, as several calls may be in flight
+    struct UploaderResult
+    {
+        std::shared_ptr<Uploader> uploader;
+        keeper::Error error {keeper::Error::OK};
+    };
+    struct DownloaderResult
+    {
+        std::shared_ptr<Downloader> downloader;
+        keeper::Error error {keeper::Error::OK};
+    };
+
+    // a null stream when it could not be created
     QFuture<std::shared_ptr<Uploader>> get_new_uploader(int64_t n_bytes, QString const & dir_name, QString const & file_name);
     QFuture<std::shared_ptr<Downloader>> get_new_downloader(QString const & dir_name, QString const & file_name);
+
+    // uploads the file in parts, retrying the parts that fail.
+    // Up to upload_streams() parts are uploaded at once, and each of them
+    // keeps a retry copy on disk, see ChunkedUploader::MAX_RETRY_COPY_BYTES.
+    // The parts committed by an interrupted upload of the same file are not sent again
+    // if their data still has the same hashes, see ChunkedUploader::skip_parts()
+    QFuture<UploaderResult> get_new_chunked_uploader(int64_t n_bytes,
+                                                     QString const & dir_name,
+                                                     QString const & file_name,
+                                                     QStringList const & committed_part_file_names = QStringList(),
+                                                     QStringList const & committed_part_hashes = QStringList());
+
+    // downloads a file stored in parts as a single file.
+    // The next prefetched_parts() parts are requested while a part is read
+    QFuture<DownloaderResult> get_new_downloader(QString const & dir_name, QStringList const & file_names);
+
+    // tells whether the file is in the backup directory, without downloading it
+    QFuture<bool> file_exists(QString const & dir_name, QString const & file_name);
+
+    // removes the file from the backup directory, returns true if it is gone
+    QFuture<bool> remove_file(QString const & dir_name, QString const & file_name);
     QFuture<QVector<QString>> get_keeper_dirs();
-    keeper::Error get_last_error() const;
+
+    // the backup directories and the account they were listed from.
+    // The account id is empty if no account could be chosen
+    struct KeeperDirs
+    {
+        QString account_id;
+        QVector<QString> dirs;
+        keeper::Error error {keeper::Error::OK};
+    };
+    QFuture<KeeperDirs> get_account_keeper_dirs();
+    void set_upload_streams(int n_streams);
+    int upload_streams() const;
+    void set_prefetched_parts(int n_parts);
+    int prefetched_parts() const;
+
+    // accounts, roots and folders are reused for this many milliseconds
+    void set_cache_ttl(qint64 ttl);
+
+#if KEEPER_STORAGE_SHAPING
+    // makes the storage look like a remote one behind a slow link.
+    // By default the options come from the KEEPER_SHAPING_* environment variables
+    void set_shaping(StorageShaping::Options const & options);
+#endif
+
+    // the number of remote calls made so far in the session, by kind of call.
+    // The second one only counts the calls made by one of the operations below
+    QMap<QString, int> get_round_trips() const;
+    QMap<QString, int> get_round_trips(QString const & operation) const;
+    void reset_round_trips();
     QFuture<QStringList> get_accounts();
 
     static QString const KEEPER_FOLDER;
-private:
 
-    void add_accounts_task(std::function<void(QVector<unity::storage::qt::client::Account::SPtr> const&)> task);
-    void add_roots_task(std::function<void(QVector<unity::storage::qt::client::Root::SPtr> const&)> task);
-
-    unity::storage::qt::client::Account::SPtr choose(QVector<unity::storage::qt::client::Account::SPtr> const& choices) const;
-    unity::storage::qt::client::Root::SPtr choose(QVector<unity::storage::qt::client::Root::SPtr> const& choices) const;
-
-    QFuture<unity::storage::qt::client::Folder::SPtr> get_keeper_folder(unity::storage::qt::client::Folder::SPtr const & root, QString const & dir_name, bool create_if_not_exists);
-    QFuture<unity::storage::qt::client::Folder::SPtr> get_storage_framework_folder(unity::storage::qt::client::Folder::SPtr const & root, QString const & dir_name, bool create_if_not_exists);
-    QFuture<unity::storage::qt::client::File::SPtr> get_storage_framework_file(unity::storage::qt::client::Folder::SPtr const & root, QString const & file_name);
-    QFuture<QVector<QString>> get_storage_framework_dirs(unity::storage::qt::client::Folder::SPtr const & root);
+    // the operations the round trips are counted under
+    static QString const UPLOAD_OPERATION;
+    static QString const DOWNLOAD_OPERATION;
+    static QString const LIST_DIRS_OPERATION;
+    static QString const ACCOUNTS_OPERATION;
+private:
 
-    void clear_last_error();
+    // what a public call resolved on its way to the storage, and the
+    // first error it found. It goes along with the call, as several
+    // of them may be in flight; its copies share the error
+    struct Operation
+    {
+        QString name;
+        QString account_id;
+        std::shared_ptr<keeper::Error> error;
+    };
+    static Operation new_operation(QString const & name);
+
+    void add_accounts_task(QString const & operation, std::function<void(QVector<unity::storage::qt::client::Account::SPtr> const&)> task);
+    void add_roots_task(Operation const & op, std::function<void(QVector<unity::storage::qt::client::Root::SPtr> const&, Operation const&)> task);
+
+    unity::storage::qt::client::Account::SPtr choose(QVector<unity::storage::qt::client::Account::SPtr> const& choices, Operation const & op) const;
+    unity::storage::qt::client::Root::SPtr choose(QVector<unity::storage::qt::client::Root::SPtr> const& choices, Operation const & op) const;
+
+    // reports the downloader of a single file to on_done
+    void download_file(Operation const & op, QString const & dir_name, QString const & file_name,
+                       std::function<void(std::shared_ptr<Downloader> const&)> const & on_done);
+
+    QFuture<unity::storage::qt::client::Folder::SPtr> get_keeper_folder(Operation const & op, unity::storage::qt::client::Folder::SPtr const & root, QString const & dir_name, bool create_if_not_exists);
+    QFuture<unity::storage::qt::client::Folder::SPtr> get_cached_folder(Operation const & op, unity::storage::qt::client::Folder::SPtr const & parent, QString const & path, QString const & dir_name, bool create_if_not_exists);
+    QFuture<unity::storage::qt::client::Folder::SPtr> get_storage_framework_folder(Operation const & op, unity::storage::qt::client::Folder::SPtr const & root, QString const & dir_name, bool create_if_not_exists);
+    QFuture<unity::storage::qt::client::File::SPtr> get_storage_framework_file(Operation const & op, unity::storage::qt::client::Folder::SPtr const & root, QString const & file_name);
+    QFuture<QVector<unity::storage::qt::client::File::SPtr>> get_storage_framework_files(Operation const & op, unity::storage::qt::client::Folder::SPtr const & root, QStringList const & file_names);
+    QFuture<std::shared_ptr<Downloader>> create_downloader(Operation const & op, unity::storage::qt::client::File::SPtr const & file);
+    QFuture<QVector<QString>> get_storage_framework_dirs(Operation const & op, unity::storage::qt::client::Folder::SPtr const & root);
+    QFuture<QVector<QString>> get_cached_dirs(Operation const & op, unity::storage::qt::client::Folder::SPtr const & root, QString const & path);
+
+    void count_round_trip(QString const & operation, QString const & call) const;
+
+    // counts a remote call, adds the latency of the shaping to it
+    // and records how long it takes
+    template<typename T>
+    QFuture<T> round_trip(QString const & operation, QString const & call, QFuture<T> const & future) const
+    {
+        count_round_trip(operation, call);
+#if KEEPER_STORAGE_SHAPING
+        auto const ret = StorageShaping::delayed(future, upload_shaping_->options().latency_msec);
+#else
+        auto const ret = future;
+#endif
+
+        QElapsedTimer timer;
+        timer.start();
+        auto watcher = new QFutureWatcher<T>();
+        QObject::connect(watcher, &QFutureWatcherBase::finished, [watcher, timer, operation, call]() {
+            util::Metrics::observe(util::METRIC_STORAGE_ROUND_TRIP, timer.nsecsElapsed() / 1e9,
+                                   {{QStringLiteral("operation"), operation}, {QStringLiteral("call"), call}});
+            watcher->deleteLater();
+        });
+        watcher->setFuture(ret);
+
+        return ret;
+    }
+    std::shared_ptr<Uploader> shaped(std::shared_ptr<Uploader> const & uploader, qint64 n_bytes);
+    std::shared_ptr<Downloader> shaped(std::shared_ptr<Downloader> const & downloader);
+    void invalidate_cache(QString const & account_id);
 
     static QString get_account_id(unity::storage::qt::client::Account::SPtr const & account);
 
-    unity::storage::qt::client::Runtime::SPtr runtime_;
+    QSharedPointer<StorageSession> session_;
     ConnectionHelper connection_helper_;
     QString storage_id_ = "";
-    mutable keeper::Error last_error_ = keeper::Error::OK;
+    int upload_streams_;
+    int prefetched_parts_;
+#if KEEPER_STORAGE_SHAPING
+    QSharedPointer<StorageShaping> upload_shaping_;
+    QSharedPointer<StorageShaping> download_shaping_;
+#endif
 };
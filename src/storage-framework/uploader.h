@@ -21,6 +21,7 @@
 
 #include <QLocalSocket>
 #include <QObject>
+#include <QStringList>
 
 #include <memory>
 
@@ -39,7 +40,19 @@ public:
     virtual void commit() =0;
     virtual QString file_name() const =0;
 
+    // the remote files that hold the data, in order.
+    // Only uploaders that split the data use more than one file.
+    virtual QStringList part_file_names() const
+    {
+        auto const name = file_name();
+        return name.isEmpty() ? QStringList() : QStringList(name);
+    }
+
 Q_SIGNALS:
 
     void commit_finished(bool success);
+
+    // emitted by uploaders that keep working on the data
+    // after it was written, so clients know they are alive
+    void upload_progress();
 };
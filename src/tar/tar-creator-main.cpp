@@ -20,6 +20,8 @@
 #include "tar/tar-creator.h"
 #include "qdbus-stubs/dbus-types.h"
 #include "qdbus-stubs/keeper_helper_interface.h"
+#include "util/logging.h"
+#include "util/tracing.h"
 
 #include <QCommandLineParser>
 #include <QCoreApplication>
@@ -29,6 +31,7 @@
 #include <QDBusUnixFileDescriptor>
 #include <QFile>
 #include <QLocalSocket>
+#include <QTemporaryFile>
 
 #include <sys/select.h>
 #include <unistd.h>
@@ -36,6 +39,7 @@
 #include <cstdio> // fileno()
 #include <ctime>
 #include <iostream>
+#include <limits>
 #include <type_traits>
 
 namespace
@@ -44,6 +48,9 @@ namespace
 QStringList
 get_filenames_from_file(FILE * fp)
 {
+    // this is also the time find takes to walk the tree
+    util::TraceSpan span(QStringLiteral("file enumeration"));
+
     // don't wait forever...
     int fd = fileno(fp);
     fd_set readfds;
@@ -69,6 +76,7 @@ get_filenames_from_file(FILE * fp)
         if (!token.isEmpty())
             filenames.append(QString::fromUtf8(token));
 
+    span.set_arg(QStringLiteral("files"), filenames.size());
     return filenames;
 }
 
@@ -114,7 +122,7 @@ parse_args(QCoreApplication& app)
     // gotta have files
     const auto filenames = get_filenames_from_file(stdin);
     for (const auto& filename : filenames)
-        qDebug() << "filename:" << filename;
+        qCDebug(util::logFiles) << "filename:" << filename;
 
     return std::make_tuple(compress, bus_path, filenames);
 }
@@ -130,6 +138,9 @@ get_socket_from_keeper(size_t n_bytes, const QString& bus_path)
         bus_path,
         QDBusConnection::sessionBus()
     );
+    // keeper holds the reply while the backups started before this one
+    // are still streaming, so wait for as long as it takes
+    helperInterface.setTimeout(std::numeric_limits<int>::max());
     auto fd_reply = helperInterface.StartBackup(n_bytes);
     fd_reply.waitForFinished();
     if (fd_reply.isError()) {
@@ -145,6 +156,36 @@ get_socket_from_keeper(size_t n_bytes, const QString& bus_path)
     return ret;
 }
 
+void
+send_file_catalog_to_keeper(const FileCatalog& catalog, const QString& bus_path)
+{
+    // the catalog is optional, so the backup is still good without it
+    qDebug() << "sending the catalog of" << catalog.entries().size() << "files to keeper";
+
+    // it goes in a file, as it may not fit in a bus message
+    QTemporaryFile catalog_file;
+    if (!catalog_file.open() || catalog_file.write(catalog.to_data()) < 0 || !catalog_file.flush()) {
+        qWarning() << "Unable to write the file catalog:" << catalog_file.errorString();
+        return;
+    }
+    catalog_file.seek(0);
+
+    DBusInterfaceKeeperHelper helperInterface(
+        DBusTypes::KEEPER_SERVICE,
+        bus_path,
+        QDBusConnection::sessionBus()
+    );
+    auto reply = helperInterface.SetFileCatalog(QDBusUnixFileDescriptor(catalog_file.handle()));
+    reply.waitForFinished();
+    if (reply.isError()) {
+        qWarning("Call to '%s.SetFileCatalog() at '%s' call failed: %s",
+            DBusTypes::KEEPER_SERVICE,
+            qPrintable(bus_path),
+            qPrintable(reply.error().message())
+        );
+    }
+}
+
 ssize_t
 send_tar_to_keeper(TarCreator& tar_creator, int fd)
 {
@@ -189,7 +230,10 @@ main(int argc, char **argv)
 
     // build the creator
     TarCreator tar_creator{filenames, compress};
+    util::TraceSpan sizing_span(QStringLiteral("sizing"));
     const auto n_bytes_in = tar_creator.calculate_size();
+    sizing_span.set_arg(QStringLiteral("bytes"), qint64(n_bytes_in));
+    sizing_span.end();
     if (n_bytes_in < 0) {
         qCritical("Unable to estimate tar size");
         return EXIT_FAILURE;
@@ -198,14 +242,21 @@ main(int argc, char **argv)
     qDebug() << "tar size should be" << n_bytes;
 
     // do it!
+    util::TraceSpan socket_span(QStringLiteral("socket acquisition"));
     const auto qfd = get_socket_from_keeper(n_bytes, bus_path);
+    socket_span.end();
     if (!qfd.isValid()) {
         qCritical() << "Can't proceed without a socket from keeper";
         return EXIT_FAILURE;
     }
     const auto fd = qfd.fileDescriptor();
+    util::TraceSpan streaming_span(QStringLiteral("streaming"));
     const auto n_sent = send_tar_to_keeper(tar_creator, fd);
+    streaming_span.set_arg(QStringLiteral("bytes"), qint64(n_sent));
+    streaming_span.end();
     qDebug() << "tar size was" << n_sent;
+    if (n_sent == ssize_t(n_bytes))
+        send_file_catalog_to_keeper(tar_creator.file_catalog(), bus_path);
 
     return EXIT_SUCCESS;
 }
@@ -34,10 +34,12 @@
 #include <archive.h>
 #include <archive_entry.h>
 
+#include <QCryptographicHash>
 #include <QDebug>
 #include <QFile>
 #include <QSharedPointer>
 #include <QString>
+#include <QVector>
 
 #include <memory>
 
@@ -52,6 +54,7 @@ public:
         , step_filenum_(-1)
         , step_file_()
         , step_buf_()
+        , step_hash_(QCryptographicHash::Sha256)
     {
     }
 
@@ -76,6 +79,7 @@ public:
 
             step_file_.reset();
             step_filenum_ = -1;
+            catalog_entries_.clear();
         }
 
         // if we don't have a file we're working on, then get one
@@ -92,9 +96,19 @@ public:
             }
             else
             {
-                // write the file's header
+                // write the file's header.
+                // The offset is only useful to seek in uncompressed archives
                 const auto& filename = filenames_[step_filenum_];
-                add_file_header_to_archive(step_archive_.get(), filename);
+                FileCatalog::Entry entry;
+                entry.path = filename;
+                if (!compress_)
+                    entry.offset = archive_filter_bytes(step_archive_.get(), 0);
+                struct stat st;
+                add_file_header_to_archive(step_archive_.get(), filename, &st);
+                entry.size = st.st_size;
+                entry.mtime = st.st_mtime;
+                catalog_entries_.push_back(entry);
+                step_hash_.reset();
 
                 // prep it for reading
                 step_file_.reset(new QFile(filename));
@@ -109,6 +123,7 @@ public:
             auto inbuf_len = step_file_->read(inbuf, sizeof(inbuf));
             if (inbuf_len > 0) // got data
             {
+                step_hash_.addData(inbuf, int(inbuf_len));
                 decltype(inbuf_len) offset = 0;
                 while(offset < inbuf_len) {
                     auto const n_written = archive_write_data(step_archive_.get(), inbuf+offset, inbuf_len-offset);
@@ -142,13 +157,24 @@ public:
             }
 
             if (step_file_->atEnd()) // if we're done with the file, close it
+            {
+                catalog_entries_.last().hash = step_hash_.result();
                 step_file_.reset();
+            }
         }
 
         std::swap(fillme,step_buf_);
         return success;
     }
 
+    FileCatalog file_catalog() const
+    {
+        FileCatalog ret;
+        for (auto const& entry : catalog_entries_)
+            ret.add(entry);
+        return ret;
+    }
+
 private:
 
     static ssize_t append_bytes_write_cb(struct archive *,
@@ -172,11 +198,14 @@ private:
     }
 
     static void add_file_header_to_archive(struct archive* archive,
-                                           const QString& filename)
+                                           const QString& filename,
+                                           struct stat* st_out = nullptr)
     {
         struct stat st;
         const auto filename_utf8 = filename.toUtf8();
         stat(filename_utf8.constData(), &st);
+        if (st_out)
+            *st_out = st;
 
         auto entry = archive_entry_new();
         archive_entry_copy_stat(entry, &st);
@@ -268,6 +297,8 @@ private:
     int step_filenum_ {-1};
     QSharedPointer<QFile> step_file_;
     std::vector<char> step_buf_;
+    QCryptographicHash step_hash_;
+    QVector<FileCatalog::Entry> catalog_entries_;
 };
 
 /**
@@ -292,3 +323,9 @@ TarCreator::step(std::vector<char>& fillme)
 {
     return impl_->step(fillme);
 }
+
+FileCatalog
+TarCreator::file_catalog() const
+{
+    return impl_->file_catalog();
+}
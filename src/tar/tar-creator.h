@@ -19,6 +19,8 @@
 
 #pragma once
 
+#include "helper/file-catalog.h"
+
 #include <QStringList>
 
 #include <cstddef> // ssize_t
@@ -35,6 +37,9 @@ public:
     ssize_t calculate_size() const;
     bool step(std::vector<char>& fillme);
 
+    // the files added to the archive so far
+    FileCatalog file_catalog() const;
+
 private:
     class Impl;
     friend class Impl;
@@ -20,6 +20,7 @@
 #include "tar/untar.h"
 #include "qdbus-stubs/dbus-types.h"
 #include "qdbus-stubs/keeper_helper_interface.h"
+#include "util/tracing.h"
 
 #include <QCommandLineParser>
 #include <QCoreApplication>
@@ -152,7 +153,9 @@ main(int argc, char **argv)
     std::tie(bus_path) = parse_args(app);
 
     // ask keeper for a socket to read
+    util::TraceSpan socket_span(QStringLiteral("socket acquisition"));
     const auto qfd = get_socket_from_keeper(bus_path);
+    socket_span.end();
     if (!qfd.isValid()) {
         qCritical() << "Can't proceed without a socket from keeper";
         return EXIT_FAILURE;
@@ -161,9 +164,12 @@ main(int argc, char **argv)
     // do it!
     auto const cwd = QDir::currentPath().toStdString();
     Untar untar{cwd};
+    util::TraceSpan streaming_span(QStringLiteral("streaming"));
     auto const ret = untar_from_socket(untar, qfd.fileDescriptor())
         ? EXIT_SUCCESS
         : EXIT_FAILURE;
+    streaming_span.set_arg(QStringLiteral("success"), ret == EXIT_SUCCESS);
+    streaming_span.end();
     qInfo() << Q_FUNC_INFO << "returning" << ret;
     return ret;
 }
@@ -0,0 +1,355 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include "util/async-logger.h"
+#include "util/logging.h"
+
+#include <QDir>
+
+#include <chrono>
+#include <cerrno>
+#include <cstdlib>
+
+#include <unistd.h>
+
+namespace util
+{
+
+namespace
+{
+    // the writer thread wakes up at least this often,
+    // in case a wake up was missed
+    constexpr int WAKE_UP_INTERVAL_MSEC = 100;
+
+    // a fatal message waits this long for the pending ones before aborting
+    constexpr int FATAL_FLUSH_MSEC = 1000;
+
+    // bytes written to the file descriptor at once
+    constexpr int BATCH_MAX = 64 * 1024;
+
+    std::atomic<AsyncLogger*> current_logger {nullptr};
+    std::atomic<int> n_producers {0};
+
+    bool is_droppable(QtMsgType type)
+    {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 5, 0)
+        if (type == QtMsgType::QtInfoMsg)
+            return true;
+#endif
+        return type == QtMsgType::QtDebugMsg;
+    }
+
+    const char * prefix(QtMsgType type)
+    {
+        switch (type)
+        {
+            case QtMsgType::QtDebugMsg:
+                return "[debug] ";
+#if QT_VERSION >= QT_VERSION_CHECK(5, 5, 0)
+            case QtMsgType::QtInfoMsg:
+                return "[info] ";
+#endif
+            case QtMsgType::QtWarningMsg:
+                return "[WARN] ";
+            case QtMsgType::QtCriticalMsg:
+                return "[CRITICAL]  ";
+            case QtMsgType::QtFatalMsg:
+                return "[FATAL] ";
+        }
+        return "";
+    }
+
+    QByteArray relative_path(const char * file)
+    {
+        if (!file)
+            return QByteArray();
+        return QDir(CMAKE_SOURCE_DIR).relativeFilePath(QString::fromUtf8(file)).toLocal8Bit();
+    }
+
+    // same format as loggingFunction()
+    void append_line(QByteArray & out, QtMsgType type, const QByteArray & file, int line, const QByteArray & msg)
+    {
+        out += prefix(type);
+        out += msg;
+        out += " (";
+        out += file;
+        out += ':';
+        out += QByteArray::number(line);
+        out += ")\n";
+    }
+
+    std::size_t round_up_to_power_of_two(std::size_t n)
+    {
+        std::size_t ret {2};
+        while (ret < n)
+            ret <<= 1;
+        return ret;
+    }
+}
+
+constexpr std::size_t AsyncLogger::DEFAULT_CAPACITY;
+
+AsyncLogger::AsyncLogger(std::size_t capacity, int fd)
+    : mask_(round_up_to_power_of_two(capacity) - 1)
+    , slots_(new Slot[mask_ + 1])
+    , fd_(fd)
+{
+    for (std::size_t i = 0; i <= mask_; ++i)
+        slots_[i].sequence.store(i, std::memory_order_relaxed);
+
+    thread_ = std::thread(&AsyncLogger::run, this);
+
+    current_logger.store(this);
+    previous_handler_ = qInstallMessageHandler(AsyncLogger::messageHandler);
+}
+
+AsyncLogger::~AsyncLogger()
+{
+    // stop taking messages, wait for the ones being queued...
+    AsyncLogger * expected = this;
+    if (current_logger.compare_exchange_strong(expected, nullptr))
+        qInstallMessageHandler(previous_handler_);
+    while (n_producers.load() > 0)
+        std::this_thread::yield();
+
+    // ...and write everything before leaving
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_.store(true);
+        wake_.notify_one();
+    }
+    thread_.join();
+}
+
+void AsyncLogger::messageHandler(QtMsgType type, const QMessageLogContext &context,
+                                 const QString &msg)
+{
+    ++n_producers;
+    auto logger = current_logger.load();
+    if (logger)
+        logger->log(type, context, msg);
+    --n_producers;
+
+    if (!logger)
+        loggingFunction(type, context, msg);
+    else if (type == QtMsgType::QtFatalMsg)
+        abort();
+}
+
+bool AsyncLogger::log(QtMsgType type, const QMessageLogContext &context, const QString &msg)
+{
+    auto utf8 = msg.toUtf8();
+
+    if (type == QtMsgType::QtFatalMsg)
+    {
+        // the process is about to die, write it from here
+        flush(FATAL_FLUSH_MSEC);
+        QByteArray line;
+        append_line(line, type, relative_path(context.file), context.line, utf8);
+        writeAll(line);
+        return true;
+    }
+
+    if (push(type, context.file, context.line, utf8))
+        return true;
+
+    if (is_droppable(type))
+    {
+        ++dropped_;
+        return false;
+    }
+
+    // warnings and errors are never lost
+    do
+    {
+        wakeUp();
+        std::this_thread::yield();
+    }
+    while (!push(type, context.file, context.line, utf8));
+    return true;
+}
+
+void AsyncLogger::flush()
+{
+    flush(-1);
+}
+
+quint64 AsyncLogger::droppedCount() const
+{
+    return dropped_.load();
+}
+
+bool AsyncLogger::flush(int msec)
+{
+    auto const target = tail_.load();
+    auto const done = [this, target]() {
+        return written_.load() >= target || stopping_.load();
+    };
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    wake_.notify_one();
+    if (msec < 0)
+    {
+        written_cond_.wait(lock, done);
+        return true;
+    }
+    return written_cond_.wait_for(lock, std::chrono::milliseconds(msec), done);
+}
+
+// Bounded multi-producer queue with a sequence number per slot,
+// as described by Dmitry Vyukov. A slot is free for the producer at
+// position pos when its sequence is pos, and holds a message for the
+// consumer when it is pos + 1.
+bool AsyncLogger::push(QtMsgType type, const char *file, int line, QByteArray &msg)
+{
+    auto pos = tail_.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        auto & slot = slots_[pos & mask_];
+        auto const seq = slot.sequence.load(std::memory_order_acquire);
+        auto const diff = std::ptrdiff_t(seq) - std::ptrdiff_t(pos);
+        if (diff == 0)
+        {
+            if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                slot.type = type;
+                slot.file = file;
+                slot.line = line;
+                slot.msg = std::move(msg);
+                slot.sequence.store(pos + 1, std::memory_order_release);
+                wakeUp();
+                return true;
+            }
+        }
+        else if (diff < 0)
+        {
+            // full
+            return false;
+        }
+        else
+        {
+            pos = tail_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool AsyncLogger::ready() const
+{
+    return slots_[head_ & mask_].sequence.load(std::memory_order_acquire) == head_ + 1;
+}
+
+bool AsyncLogger::pop(QByteArray &out)
+{
+    if (!ready())
+        return false;
+
+    auto & slot = slots_[head_ & mask_];
+    append_line(out, slot.type, relativeFile(slot.file), slot.line, slot.msg);
+    slot.msg = QByteArray();
+    slot.sequence.store(head_ + mask_ + 1, std::memory_order_release);
+    ++head_;
+    return true;
+}
+
+void AsyncLogger::wakeUp()
+{
+    // pairs with the fence in run(), so either the writer sees the
+    // new message before sleeping or we see it sleeping
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping_.load(std::memory_order_relaxed))
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        wake_.notify_one();
+    }
+}
+
+void AsyncLogger::run()
+{
+    QByteArray batch;
+    batch.reserve(BATCH_MAX);
+
+    for (;;)
+    {
+        batch.clear();
+        while (batch.size() < BATCH_MAX && pop(batch))
+            ;
+
+        auto const dropped = dropped_.load();
+        if (dropped != reported_dropped_)
+        {
+            batch += prefix(QtMsgType::QtWarningMsg);
+            batch += QByteArray::number(dropped - reported_dropped_);
+            batch += " debug messages dropped, the log is too busy\n";
+            reported_dropped_ = dropped;
+        }
+
+        if (!batch.isEmpty())
+        {
+            writeAll(batch);
+            std::lock_guard<std::mutex> lock(mutex_);
+            written_.store(head_);
+            written_cond_.notify_all();
+            continue;
+        }
+
+        // nothing is left and nobody can queue more
+        if (stopping_.load())
+            break;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        sleeping_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!ready() && !stopping_.load())
+            wake_.wait_for(lock, std::chrono::milliseconds(WAKE_UP_INTERVAL_MSEC));
+        sleeping_.store(false, std::memory_order_relaxed);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    written_cond_.notify_all();
+}
+
+void AsyncLogger::writeAll(const QByteArray &data)
+{
+    auto p = data.constData();
+    auto n_left = data.size();
+    while (n_left > 0)
+    {
+        auto const n = ::write(fd_, p, size_t(n_left));
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            // nowhere left to report it
+            break;
+        }
+        p += n;
+        n_left -= int(n);
+    }
+}
+
+const QByteArray& AsyncLogger::relativeFile(const char *file)
+{
+    // __FILE__ is a literal, so its address identifies the file
+    auto it = relative_files_.find(file);
+    if (it == relative_files_.end())
+        it = relative_files_.emplace(file, relative_path(file)).first;
+    return it->second;
+}
+
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#pragma once
+
+#include <QByteArray>
+#include <QMessageLogContext>
+#include <QString>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace util
+{
+
+/**
+ * Message handler that keeps stderr off the calling thread.
+ *
+ * The message is queued in a lock-free ring and a background thread
+ * formats it, with the source path relative to the source tree cached
+ * per file, and writes the pending lines to stderr in one go.
+ *
+ * The output looks like the one of loggingFunction().
+ * When the ring is full, debug and info messages are dropped and counted,
+ * warnings and above wait for room. Fatal messages flush the ring and abort.
+ *
+ * While an instance is alive it is the application message handler,
+ * the previous one is restored, and the ring drained, on destruction.
+ */
+class AsyncLogger
+{
+public:
+    explicit AsyncLogger(std::size_t capacity = DEFAULT_CAPACITY, int fd = 2);
+    ~AsyncLogger();
+
+    Q_DISABLE_COPY(AsyncLogger)
+
+    // false when the message was dropped
+    bool log(QtMsgType type, const QMessageLogContext &context, const QString &msg);
+
+    // waits until every message queued so far has been written
+    void flush();
+
+    quint64 droppedCount() const;
+
+    static void messageHandler(QtMsgType type, const QMessageLogContext &context,
+                               const QString &msg);
+
+    static constexpr std::size_t DEFAULT_CAPACITY = 4096;
+
+private:
+    struct Slot
+    {
+        std::atomic<std::size_t> sequence {0};
+        QtMsgType type {QtDebugMsg};
+        const char * file {nullptr};
+        int line {0};
+        QByteArray msg;
+    };
+
+    bool push(QtMsgType type, const char *file, int line, QByteArray &msg);
+    bool pop(QByteArray &out);
+    bool ready() const;
+    void run();
+    void writeAll(const QByteArray &data);
+    const QByteArray& relativeFile(const char *file);
+    void wakeUp();
+    bool flush(int msec);
+
+    const std::size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+    const int fd_;
+
+    // producers
+    std::atomic<std::size_t> tail_ {0};
+    std::atomic<quint64> dropped_ {0};
+
+    // consumer
+    std::size_t head_ {0};
+    std::atomic<std::size_t> written_ {0};
+    quint64 reported_dropped_ {0};
+    std::unordered_map<const char*, QByteArray> relative_files_;
+
+    std::atomic<bool> stopping_ {false};
+    std::atomic<bool> sleeping_ {false};
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable written_cond_;
+    std::thread thread_;
+
+    QtMessageHandler previous_handler_ {nullptr};
+};
+
+}
@@ -22,6 +22,9 @@
 
 namespace util
 {
+    Q_LOGGING_CATEGORY(logFiles, "keeper.files", QtInfoMsg)
+    Q_LOGGING_CATEGORY(logState, "keeper.state", QtInfoMsg)
+
     void
     loggingFunction (QtMsgType type, const QMessageLogContext &context,
                      const QString &msg)
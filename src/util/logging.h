@@ -18,11 +18,18 @@
 
 #pragma once
 
+#include <QLoggingCategory>
 #include <QMessageLogContext>
 #include <QString>
 
 namespace util
 {
+    // Categories for the messages written once per file or per state
+    // change. Their debug output is off unless enabled at runtime,
+    // e.g. QT_LOGGING_RULES="keeper.files.debug=true"
+    Q_DECLARE_LOGGING_CATEGORY(logFiles)
+    Q_DECLARE_LOGGING_CATEGORY(logState)
+
     void
     loggingFunction (QtMsgType type, const QMessageLogContext &context,
                      const QString &msg);
@@ -0,0 +1,308 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include "util/metrics.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QVector>
+
+#include <algorithm>
+
+namespace util
+{
+
+namespace
+{
+    constexpr const char TYPE_COUNTER[]   = "counter";
+    constexpr const char TYPE_GAUGE[]     = "gauge";
+    constexpr const char TYPE_HISTOGRAM[] = "histogram";
+
+    // where keeper-service writes the metrics after every run
+    constexpr const char ENV_METRICS_FILE[] = "KEEPER_METRICS_FILE";
+
+    struct Definition
+    {
+        const char * name;
+        const char * type;
+        const char * help;
+        QVector<double> buckets;
+    };
+
+    QVector<Definition> const & definitions()
+    {
+        static QVector<Definition> const defs {
+            {METRIC_BACKUP_BYTES, TYPE_COUNTER,
+             "Bytes sent to the storage by backup tasks.", {}},
+            {METRIC_RESTORE_BYTES, TYPE_COUNTER,
+             "Bytes received from the storage by restore tasks.", {}},
+            {METRIC_TASK_DURATION, TYPE_HISTOGRAM,
+             "Duration of the backup and restore tasks, by mode and result.",
+             {1, 5, 15, 60, 300, 900, 3600}},
+            {METRIC_TASK_FAILURES, TYPE_COUNTER,
+             "Tasks that failed, by keeper error.", {}},
+            {METRIC_HELPER_LAUNCH, TYPE_HISTOGRAM,
+             "Time from launching a helper until it is running.",
+             {0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30}},
+            {METRIC_STORAGE_ROUND_TRIP, TYPE_HISTOGRAM,
+             "Latency of the calls to the storage framework, by operation and call.",
+             {0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5}},
+            {METRIC_RELAY_BACKLOG, TYPE_COUNTER,
+             "Time the relay between the helpers and the storage had a full buffer of data queued for the other side.", {}},
+            {METRIC_RELAY_BUFFER_PEAK, TYPE_GAUGE,
+             "Highest number of bytes waiting in the relay buffer.", {}}
+        };
+        return defs;
+    }
+
+    Definition const * find_definition(const char * name)
+    {
+        for (auto const & def : definitions())
+            if (qstrcmp(def.name, name) == 0)
+                return &def;
+        qWarning() << "unknown metric" << name;
+        return nullptr;
+    }
+
+    struct Series
+    {
+        double value {0};
+        quint64 count {0};
+        QVector<quint64> bucket_counts;
+    };
+
+    QMutex mutex;
+
+    // metric name -> formatted labels -> series
+    QMap<QString, QMap<QString, Series>> all_series;
+
+    QString escape_label_value(QString value)
+    {
+        value.replace(QLatin1Char('\\'), QStringLiteral("\\\\"));
+        value.replace(QLatin1Char('"'), QStringLiteral("\\\""));
+        value.replace(QLatin1Char('\n'), QStringLiteral("\\n"));
+        return value;
+    }
+
+    // 'key="value",...', sorted by key
+    QString format_labels(Metrics::Labels const & labels)
+    {
+        QStringList pairs;
+        for (auto it = labels.cbegin(), end = labels.cend(); it != end; ++it)
+            pairs << QStringLiteral("%1=\"%2\"").arg(it.key()).arg(escape_label_value(it.value()));
+        return pairs.join(QLatin1Char(','));
+    }
+
+    QString with_braces(QString const & labels)
+    {
+        return labels.isEmpty() ? QString() : QStringLiteral("{%1}").arg(labels);
+    }
+
+    QString format_value(double value)
+    {
+        return QString::number(value, 'g', 15);
+    }
+
+    // must be called with the mutex locked
+    Series & series(Definition const & def, Metrics::Labels const & labels)
+    {
+        auto & s = all_series[QString::fromLatin1(def.name)][format_labels(labels)];
+        if (s.bucket_counts.size() != def.buckets.size())
+            s.bucket_counts.fill(0, def.buckets.size());
+        return s;
+    }
+}
+
+void Metrics::add(const char * name, double value, Labels const & labels)
+{
+    auto const def = find_definition(name);
+    if (!def)
+        return;
+
+    QMutexLocker lock(&mutex);
+    series(*def, labels).value += value;
+}
+
+void Metrics::set_max(const char * name, double value, Labels const & labels)
+{
+    auto const def = find_definition(name);
+    if (!def)
+        return;
+
+    QMutexLocker lock(&mutex);
+    auto & s = series(*def, labels);
+    s.value = std::max(s.value, value);
+}
+
+void Metrics::observe(const char * name, double value, Labels const & labels)
+{
+    auto const def = find_definition(name);
+    if (!def)
+        return;
+
+    QMutexLocker lock(&mutex);
+    auto & s = series(*def, labels);
+    s.value += value;
+    ++s.count;
+    for (int i = 0; i < def->buckets.size(); ++i)
+        if (value <= def->buckets[i])
+            ++s.bucket_counts[i];
+}
+
+QMap<QString, QVariantMap> Metrics::snapshot()
+{
+    QMap<QString, QVariantMap> ret;
+
+    QMutexLocker lock(&mutex);
+    for (auto const & def : definitions())
+    {
+        auto const name = QString::fromLatin1(def.name);
+        auto const metric_series = all_series.value(name);
+        for (auto it = metric_series.cbegin(), end = metric_series.cend(); it != end; ++it)
+        {
+            QVariantMap properties;
+            properties[QStringLiteral("type")] = QString::fromLatin1(def.type);
+            if (!def.buckets.isEmpty())
+            {
+                QVariantList buckets, bucket_counts;
+                for (int i = 0; i < def.buckets.size(); ++i)
+                {
+                    buckets << def.buckets[i];
+                    bucket_counts << it->bucket_counts[i];
+                }
+                properties[QStringLiteral("count")] = it->count;
+                properties[QStringLiteral("sum")] = it->value;
+                properties[QStringLiteral("buckets")] = buckets;
+                properties[QStringLiteral("bucket-counts")] = bucket_counts;
+            }
+            else
+            {
+                properties[QStringLiteral("value")] = it->value;
+            }
+            ret[name + with_braces(it.key())] = properties;
+        }
+    }
+    return ret;
+}
+
+QString Metrics::to_prometheus()
+{
+    QString text;
+
+    QMutexLocker lock(&mutex);
+    for (auto const & def : definitions())
+    {
+        auto const name = QString::fromLatin1(def.name);
+        text += QStringLiteral("# HELP %1 %2\n").arg(name).arg(QString::fromLatin1(def.help));
+        text += QStringLiteral("# TYPE %1 %2\n").arg(name).arg(QString::fromLatin1(def.type));
+
+        auto const metric_series = all_series.value(name);
+        for (auto it = metric_series.cbegin(), end = metric_series.cend(); it != end; ++it)
+        {
+            auto const & labels = it.key();
+            if (def.buckets.isEmpty())
+            {
+                text += QStringLiteral("%1%2 %3\n").arg(name).arg(with_braces(labels)).arg(format_value(it->value));
+                continue;
+            }
+
+            auto const prefix = labels.isEmpty() ? QString() : labels + QLatin1Char(',');
+            for (int i = 0; i < def.buckets.size(); ++i)
+            {
+                text += QStringLiteral("%1_bucket{%2le=\"%3\"} %4\n")
+                    .arg(name).arg(prefix).arg(format_value(def.buckets[i])).arg(it->bucket_counts[i]);
+            }
+            text += QStringLiteral("%1_bucket{%2le=\"+Inf\"} %3\n").arg(name).arg(prefix).arg(it->count);
+            text += QStringLiteral("%1_sum%2 %3\n").arg(name).arg(with_braces(labels)).arg(format_value(it->value));
+            text += QStringLiteral("%1_count%2 %3\n").arg(name).arg(with_braces(labels)).arg(it->count);
+        }
+    }
+    return text;
+}
+
+bool Metrics::write_prometheus(QString const & path)
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    // the collector never reads half a file
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qWarning() << "unable to write the metrics to" << path << ":" << file.errorString();
+        return false;
+    }
+    file.write(to_prometheus().toUtf8());
+    if (!file.commit())
+    {
+        qWarning() << "unable to write the metrics to" << path << ":" << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+QString Metrics::configured_file()
+{
+    return QString::fromLocal8Bit(qgetenv(ENV_METRICS_FILE));
+}
+
+void Metrics::reset()
+{
+    QMutexLocker lock(&mutex);
+    all_series.clear();
+}
+
+/***
+****
+***/
+
+RelayMetrics::RelayMetrics(QString const & mode)
+    : labels_{{QStringLiteral("mode"), mode}}
+{
+}
+
+RelayMetrics::~RelayMetrics()
+{
+    if (backlogged_.isValid())
+        Metrics::add(METRIC_RELAY_BACKLOG, backlogged_.nsecsElapsed() / 1e9, labels_);
+}
+
+void RelayMetrics::update(qint64 pending, qint64 capacity)
+{
+    if (pending > peak_)
+    {
+        peak_ = pending;
+        Metrics::set_max(METRIC_RELAY_BUFFER_PEAK, peak_, labels_);
+    }
+
+    if (pending >= capacity && !backlogged_.isValid())
+    {
+        backlogged_.start();
+    }
+    else if (pending < capacity && backlogged_.isValid())
+    {
+        Metrics::add(METRIC_RELAY_BACKLOG, backlogged_.nsecsElapsed() / 1e9, labels_);
+        backlogged_.invalidate();
+    }
+}
+
+}
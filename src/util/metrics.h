@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QMap>
+#include <QString>
+#include <QVariantMap>
+
+namespace util
+{
+
+// the metrics keeper-service keeps. The list of the metrics,
+// with their type and help, is in metrics.cpp
+constexpr const char METRIC_BACKUP_BYTES[]       = "keeper_backup_bytes_total";
+constexpr const char METRIC_RESTORE_BYTES[]      = "keeper_restore_bytes_total";
+constexpr const char METRIC_TASK_DURATION[]      = "keeper_task_duration_seconds";
+constexpr const char METRIC_TASK_FAILURES[]      = "keeper_task_failures_total";
+constexpr const char METRIC_HELPER_LAUNCH[]      = "keeper_helper_launch_seconds";
+constexpr const char METRIC_STORAGE_ROUND_TRIP[] = "keeper_storage_round_trip_seconds";
+constexpr const char METRIC_RELAY_BACKLOG[]      = "keeper_relay_backlog_seconds_total";
+constexpr const char METRIC_RELAY_BUFFER_PEAK[]  = "keeper_relay_buffer_peak_bytes";
+
+/**
+ * Cumulative performance metrics of the process.
+ *
+ * Counters only grow, peaks keep the highest value seen and histograms
+ * count the observations in fixed buckets, the same way Prometheus does,
+ * so the metrics of several machines can be aggregated.
+ */
+class Metrics
+{
+public:
+    using Labels = QMap<QString, QString>;
+
+    // counters
+    static void add(const char * name, double value, Labels const & labels = Labels());
+
+    // peaks
+    static void set_max(const char * name, double value, Labels const & labels = Labels());
+
+    // histograms
+    static void observe(const char * name, double value, Labels const & labels = Labels());
+
+    // a map from 'name{labels}' to the properties of the metric:
+    // its 'type' and either its 'value' or, for histograms,
+    // its 'count', 'sum', 'buckets' and cumulative 'bucket-counts'
+    static QMap<QString, QVariantMap> snapshot();
+
+    // the Prometheus text exposition format
+    static QString to_prometheus();
+
+    // replaces the file with to_prometheus(), atomically
+    static bool write_prometheus(QString const & path);
+
+    // the file set in KEEPER_METRICS_FILE, or an empty string
+    static QString configured_file();
+
+    static void reset();
+};
+
+/**
+ * Backlog time and peak occupancy of a relay between
+ * a helper socket and the storage framework.
+ *
+ * The relay keeps reading while its writes are pending, because
+ * QLocalSocket buffers them without bound, so it never stalls as such.
+ * update() is given the bytes queued for the other side after every
+ * pass, and the time they stay at or above capacity is counted as a
+ * backlog: the other side is not keeping up with the relay.
+ */
+class RelayMetrics
+{
+public:
+    explicit RelayMetrics(QString const & mode);
+    ~RelayMetrics();
+
+    Q_DISABLE_COPY(RelayMetrics)
+
+    void update(qint64 pending, qint64 capacity);
+
+private:
+    Metrics::Labels const labels_;
+    qint64 peak_ {0};
+    QElapsedTimer backlogged_;
+};
+
+}
@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include "util/tracing.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <QUuid>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace util
+{
+
+namespace
+{
+    constexpr const char ENV_TRACE[]    = "KEEPER_TRACE";
+    constexpr const char ENV_TRACE_ID[] = "KEEPER_TRACE_ID";
+
+    constexpr const char CATEGORY[] = "keeper";
+
+    QMutex mutex;
+
+    // the trace of this process and the file it is written to
+    bool trace_id_loaded {false};
+    QString current_trace_id;
+    QString open_trace_id;
+    int open_fd {-1};
+
+    QString process_name()
+    {
+        if (QCoreApplication::instance())
+            return QCoreApplication::applicationName();
+        return QStringLiteral("keeper");
+    }
+
+    void write_event(int fd, QJsonObject const & event)
+    {
+        // one write per event, so the lines appended by
+        // several processes to the same file don't mix
+        auto const line = QJsonDocument(event).toJson(QJsonDocument::Compact) + ",\n";
+        if (::write(fd, line.constData(), size_t(line.size())) != line.size())
+            qWarning() << "unable to write the trace event" << event.value(QStringLiteral("name")).toString();
+    }
+
+    // must be called with the mutex locked
+    int trace_fd(QString const & trace_id)
+    {
+        if (trace_id == open_trace_id)
+            return open_fd;
+
+        if (open_fd != -1)
+            ::close(open_fd);
+        open_trace_id = trace_id;
+
+        auto const path = Tracing::trace_file_path(trace_id);
+        QDir().mkpath(QFileInfo(path).absolutePath());
+        open_fd = ::open(QFile::encodeName(path).constData(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+        if (open_fd == -1)
+        {
+            qWarning() << "unable to open the trace file" << path;
+            return open_fd;
+        }
+
+        // the JSON array format doesn't need the closing ']',
+        // so every process can append to the file
+        struct stat st;
+        if (fstat(open_fd, &st) == 0 && st.st_size == 0)
+        {
+            constexpr char header[] = "[\n";
+            if (::write(open_fd, header, sizeof(header) - 1) != ssize_t(sizeof(header) - 1))
+                qWarning() << "unable to write the trace file" << path;
+        }
+
+        // give the process a name in the timeline
+        write_event(open_fd, QJsonObject{
+            {QStringLiteral("name"), QStringLiteral("process_name")},
+            {QStringLiteral("ph"), QStringLiteral("M")},
+            {QStringLiteral("pid"), qint64(getpid())},
+            {QStringLiteral("args"), QJsonObject{{QStringLiteral("name"), process_name()}}}
+        });
+
+        return open_fd;
+    }
+}
+
+bool Tracing::is_enabled()
+{
+    bool ok;
+    auto const value = qgetenv(ENV_TRACE).toInt(&ok);
+    return ok && value > 0;
+}
+
+QString Tracing::start_trace()
+{
+    QString trace_id;
+    if (is_enabled())
+    {
+        trace_id = QDateTime::currentDateTime().toString(QStringLiteral("yyyy-MM-ddTHH-mm-ss-"))
+                 + QString::fromLatin1(QUuid::createUuid().toRfc4122().toHex().left(8));
+        qDebug() << "tracing the run in" << trace_file_path(trace_id);
+    }
+    set_trace_id(trace_id);
+    return trace_id;
+}
+
+QString Tracing::trace_id()
+{
+    QMutexLocker lock(&mutex);
+    if (!trace_id_loaded)
+    {
+        current_trace_id = QString::fromLatin1(qgetenv(ENV_TRACE_ID));
+        trace_id_loaded = true;
+    }
+    return current_trace_id;
+}
+
+void Tracing::set_trace_id(QString const & trace_id)
+{
+    QMutexLocker lock(&mutex);
+    current_trace_id = trace_id;
+    trace_id_loaded = true;
+}
+
+QString Tracing::trace_file_path(QString const & trace_id)
+{
+    return QStringLiteral("%1/keeper/traces/%2.json")
+        .arg(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation))
+        .arg(trace_id);
+}
+
+qint64 Tracing::now_usec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return qint64(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+void Tracing::add_span(QString const & trace_id,
+                       QString const & name,
+                       qint64 start_usec,
+                       qint64 duration_usec,
+                       QVariantMap const & args)
+{
+    if (trace_id.isEmpty())
+        return;
+
+    QJsonObject event{
+        {QStringLiteral("name"), name},
+        {QStringLiteral("cat"), QString::fromLatin1(CATEGORY)},
+        {QStringLiteral("ph"), QStringLiteral("X")},
+        {QStringLiteral("ts"), start_usec},
+        {QStringLiteral("dur"), duration_usec},
+        {QStringLiteral("pid"), qint64(getpid())},
+        {QStringLiteral("tid"), qint64(syscall(SYS_gettid))}
+    };
+    if (!args.isEmpty())
+        event.insert(QStringLiteral("args"), QJsonObject::fromVariantMap(args));
+
+    QMutexLocker lock(&mutex);
+    auto const fd = trace_fd(trace_id);
+    if (fd != -1)
+        write_event(fd, event);
+}
+
+/***
+****
+***/
+
+TraceSpan::TraceSpan(QString const & name, QVariantMap const & args)
+    : trace_id_(Tracing::trace_id())
+    , name_(name)
+    , start_usec_(Tracing::now_usec())
+    , args_(args)
+{
+}
+
+TraceSpan::~TraceSpan()
+{
+    end();
+}
+
+void TraceSpan::set_arg(QString const & key, QVariant const & value)
+{
+    args_[key] = value;
+}
+
+void TraceSpan::end()
+{
+    if (ended_)
+        return;
+    ended_ = true;
+    Tracing::add_span(trace_id_, name_, start_usec_, Tracing::now_usec() - start_usec_, args_);
+}
+
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#pragma once
+
+#include <QString>
+#include <QVariant>
+#include <QVariantMap>
+
+namespace util
+{
+
+/**
+ * Timeline of a backup or restore in the Chrome Trace Event format.
+ *
+ * A trace follows one run across every process that takes part in it.
+ * keeper-service starts a trace for each run when KEEPER_TRACE=1 and
+ * passes its id to the helpers, which find it in KEEPER_TRACE_ID.
+ * All of them append their spans to the same file,
+ * $XDG_CACHE_HOME/keeper/traces/<trace id>.json, that can be loaded
+ * as it is in chrome://tracing or Perfetto.
+ *
+ * Timestamps come from the monotonic clock, which all the processes share.
+ */
+class Tracing
+{
+public:
+    // true when keeper-service should trace its runs
+    static bool is_enabled();
+
+    // starts a new trace and makes it the one of this process.
+    // Returns its id, or an empty string when tracing is not enabled
+    static QString start_trace();
+
+    // the trace of this process, or an empty string when not tracing
+    static QString trace_id();
+    static void set_trace_id(QString const & trace_id);
+
+    static QString trace_file_path(QString const & trace_id);
+
+    static qint64 now_usec();
+
+    static void add_span(QString const & trace_id,
+                         QString const & name,
+                         qint64 start_usec,
+                         qint64 duration_usec,
+                         QVariantMap const & args);
+};
+
+/**
+ * A span of the current trace, from its creation until end() is called
+ * or it is destroyed. It does nothing when the process is not tracing.
+ */
+class TraceSpan
+{
+public:
+    explicit TraceSpan(QString const & name, QVariantMap const & args = QVariantMap());
+    ~TraceSpan();
+
+    Q_DISABLE_COPY(TraceSpan)
+
+    void set_arg(QString const & key, QVariant const & value);
+    void end();
+
+private:
+    QString const trace_id_;
+    QString const name_;
+    qint64 const start_usec_;
+    QVariantMap args_;
+    bool ended_ {false};
+};
+
+}
@@ -0,0 +1,265 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include "tests/unit/helper/fake-helper.h"
+
+#include <helper/backup-helper.h>
+#include <helper/restore-helper.h>
+#if KEEPER_STORAGE_SHAPING
+#include <storage-framework/shaped-downloader.h>
+#include <storage-framework/shaped-uploader.h>
+#endif
+
+#include <benchmark/benchmark.h>
+
+#include <QCoreApplication>
+#include <QLocalSocket>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace
+{
+    constexpr int CHUNK_SIZE {64 * 1024};
+
+    // one end of a socket pair for the helper, the other one for the benchmark
+    class SocketPair
+    {
+    public:
+        explicit SocketPair(QIODevice::OpenMode mode)
+            : socket_(new QLocalSocket)
+        {
+            int fds[2];
+            socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds);
+            socket_->setSocketDescriptor(fds[0], QLocalSocket::ConnectedState, mode);
+            peer_ = fds[1];
+        }
+
+        ~SocketPair()
+        {
+            close(peer_);
+        }
+
+        std::shared_ptr<QLocalSocket> socket_;
+        int peer_;
+    };
+
+    // an uploader that only hands the data to the benchmark
+    class BenchUploader final: public Uploader
+    {
+    public:
+        BenchUploader(): sockets_(QIODevice::WriteOnly) {}
+
+        std::shared_ptr<QLocalSocket> socket() override { return sockets_.socket_; }
+        void commit() override { Q_EMIT commit_finished(true); }
+        QString file_name() const override { return QStringLiteral("bench"); }
+        int peer() const { return sockets_.peer_; }
+
+    private:
+        SocketPair sockets_;
+    };
+
+    // a downloader whose data comes from the benchmark
+    class BenchDownloader final: public Downloader
+    {
+    public:
+        explicit BenchDownloader(qint64 file_size): sockets_(QIODevice::ReadOnly), file_size_(file_size) {}
+
+        std::shared_ptr<QLocalSocket> socket() override { return sockets_.socket_; }
+        void finish() override {}
+        qint64 file_size() const override { return file_size_; }
+        int peer() const { return sockets_.peer_; }
+
+    private:
+        SocketPair sockets_;
+        qint64 const file_size_;
+    };
+
+    // writes n_bytes to write_fd and reads them back from read_fd,
+    // letting the helper relay them in between
+    void relay(int write_fd, int read_fd, qint64 n_bytes)
+    {
+        static std::vector<char> const chunk(CHUNK_SIZE, 'k');
+        static std::vector<char> sink(CHUNK_SIZE);
+
+        qint64 n_written {0};
+        qint64 n_read {0};
+        while (n_read < n_bytes)
+        {
+            if (n_written < n_bytes)
+            {
+                auto const n = ::write(write_fd, chunk.data(), size_t(std::min(qint64(CHUNK_SIZE), n_bytes - n_written)));
+                if (n > 0)
+                    n_written += n;
+            }
+
+            QCoreApplication::processEvents();
+
+            ssize_t n;
+            while ((n = ::read(read_fd, sink.data(), sink.size())) > 0)
+                n_read += n;
+        }
+    }
+}
+
+// args: bytes relayed
+static void BM_BackupHelperRelay(benchmark::State & state)
+{
+    auto const n_bytes = qint64(state.range(0));
+    while (state.KeepRunning())
+    {
+        state.PauseTiming();
+        BackupHelper helper(QStringLiteral("bench"));
+        helper.set_expected_size(n_bytes);
+        auto uploader = std::make_shared<BenchUploader>();
+        helper.set_uploader(uploader);
+        state.ResumeTiming();
+
+        relay(helper.get_helper_socket(), uploader->peer(), n_bytes);
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * n_bytes);
+}
+BENCHMARK(BM_BackupHelperRelay)
+    ->Arg(1024 * 1024)
+    ->Arg(16 * 1024 * 1024)
+    ->Unit(benchmark::kMillisecond);
+
+// args: bytes relayed
+static void BM_RestoreHelperRelay(benchmark::State & state)
+{
+    auto const n_bytes = qint64(state.range(0));
+    while (state.KeepRunning())
+    {
+        state.PauseTiming();
+        RestoreHelper helper(QStringLiteral("bench"));
+        auto downloader = std::make_shared<BenchDownloader>(n_bytes);
+        helper.set_downloader(downloader);
+        state.ResumeTiming();
+
+        relay(downloader->peer(), helper.get_helper_socket(), n_bytes);
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * n_bytes);
+}
+BENCHMARK(BM_RestoreHelperRelay)
+    ->Arg(1024 * 1024)
+    ->Arg(16 * 1024 * 1024)
+    ->Unit(benchmark::kMillisecond);
+
+#if KEEPER_STORAGE_SHAPING
+
+// the relays through a shaped link, to tune them for slow networks.
+// The real time is what matters here: the relay mostly waits for the link.
+// args: link speed in kbit/s, biggest write of the link in bytes (0 for no limit)
+static StorageShaping::Options bench_shaping(benchmark::State const & state)
+{
+    StorageShaping::Options options;
+    options.bytes_per_sec = state.range(0) * 1000 / 8;
+    options.max_write = state.range(1);
+    return options;
+}
+
+static void BM_BackupHelperRelayShaped(benchmark::State & state)
+{
+    constexpr qint64 n_bytes {256 * 1024};
+    QSharedPointer<StorageShaping> shaping(new StorageShaping(bench_shaping(state)));
+    while (state.KeepRunning())
+    {
+        state.PauseTiming();
+        BackupHelper helper(QStringLiteral("bench"));
+        helper.set_expected_size(n_bytes);
+        auto uploader = std::make_shared<BenchUploader>();
+        helper.set_uploader(std::make_shared<ShapedUploader>(uploader, n_bytes, shaping));
+        state.ResumeTiming();
+
+        relay(helper.get_helper_socket(), uploader->peer(), n_bytes);
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * n_bytes);
+}
+BENCHMARK(BM_BackupHelperRelayShaped)
+    ->Args({16000, 0})
+    ->Args({16000, 1400})
+    ->Args({64000, 1400})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_RestoreHelperRelayShaped(benchmark::State & state)
+{
+    constexpr qint64 n_bytes {256 * 1024};
+    QSharedPointer<StorageShaping> shaping(new StorageShaping(bench_shaping(state)));
+    while (state.KeepRunning())
+    {
+        state.PauseTiming();
+        RestoreHelper helper(QStringLiteral("bench"));
+        auto downloader = std::make_shared<BenchDownloader>(n_bytes);
+        helper.set_downloader(std::make_shared<ShapedDownloader>(downloader, shaping));
+        state.ResumeTiming();
+
+        relay(downloader->peer(), helper.get_helper_socket(), n_bytes);
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * n_bytes);
+}
+BENCHMARK(BM_RestoreHelperRelayShaped)
+    ->Args({16000, 0})
+    ->Args({16000, 1400})
+    ->Args({64000, 1400})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+#endif
+
+// RateHistory::add(), through the helper that owns it
+static void BM_RateHistoryAdd(benchmark::State & state)
+{
+    uint64_t now_msec {0};
+    TestHelper helper(QString(), [&now_msec](){return now_msec;});
+    helper.set_expected_size(std::numeric_limits<qint64>::max());
+
+    while (state.KeepRunning())
+    {
+        now_msec += 10;
+        helper.record_data_transferred(4096);
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(BM_RateHistoryAdd);
+
+// RateHistory::speed_bytes_per_second() with a full history
+static void BM_RateHistorySpeed(benchmark::State & state)
+{
+    uint64_t now_msec {0};
+    TestHelper helper(QString(), [&now_msec](){return now_msec;});
+    helper.set_expected_size(std::numeric_limits<qint64>::max());
+    for (int i = 0; i < 1000; ++i)
+    {
+        now_msec += 10;
+        helper.record_data_transferred(4096);
+    }
+
+    while (state.KeepRunning())
+    {
+        benchmark::DoNotOptimize(helper.speed());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(BM_RateHistorySpeed);
@@ -0,0 +1,187 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include <helper/metadata.h>
+#include <service/binary-manifest.h>
+#include <service/manifest.h>
+#include <storage-framework/storage_framework_client.h>
+
+#include <benchmark/benchmark.h>
+
+#include <QEventLoop>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSharedPointer>
+#include <QTemporaryDir>
+#include <QUuid>
+#include <QVector>
+
+namespace
+{
+    Metadata create_metadata(int i)
+    {
+        Metadata ret(QUuid::createUuid().toString(), QStringLiteral("Music %1").arg(i));
+        ret.set_property_value(keeper::Item::TYPE_KEY, keeper::Item::FOLDER_VALUE);
+        ret.set_property_value(keeper::Item::SUBTYPE_KEY, QStringLiteral("/home/phablet/Music"));
+        ret.set_property_value(keeper::Item::DIR_NAME_KEY, QStringLiteral("2016-09-01T10:00:00"));
+        ret.set_property_value(keeper::Item::FILE_NAME_KEY, QStringLiteral("Music %1.keeper").arg(i));
+        ret.set_property_value(keeper::Item::CATALOG_FILE_NAME_KEY, QStringLiteral("Music %1.catalog").arg(i));
+        return ret;
+    }
+
+    QVector<Metadata> create_entries(int n_entries)
+    {
+        QVector<Metadata> ret;
+        for (int i = 0; i < n_entries; ++i)
+            ret.push_back(create_metadata(i));
+        return ret;
+    }
+
+    // waits for the manifest to finish storing or reading
+    bool wait_for(Manifest & manifest)
+    {
+        QEventLoop loop;
+        bool success {false};
+        QObject::connect(&manifest, &Manifest::finished, [&loop, &success](bool s){
+            success = s;
+            loop.quit();
+        });
+        loop.exec();
+        return success;
+    }
+
+    // a manifest stored in a local storage that only lasts as long as the object
+    class StoredManifest
+    {
+    public:
+        StoredManifest(int n_entries, Manifest::Format format)
+        {
+            // the local storage is looked up when the client is created
+            qputenv("XDG_DATA_HOME", data_dir_.path().toUtf8());
+            storage_.reset(new StorageFrameworkClient, [](StorageFrameworkClient* sf){sf->deleteLater();});
+            Manifest manifest(storage_, dir_name());
+            manifest.set_format(format);
+            for (auto const & entry : create_entries(n_entries))
+                manifest.add_entry(entry);
+            manifest.store();
+            stored_ = wait_for(manifest);
+        }
+
+        ~StoredManifest()
+        {
+            qunsetenv("XDG_DATA_HOME");
+        }
+
+        bool is_stored() const { return stored_; }
+        QSharedPointer<StorageFrameworkClient> storage() const { return storage_; }
+        static QString dir_name() { return QStringLiteral("bench_dir"); }
+
+    private:
+        QTemporaryDir data_dir_;
+        QSharedPointer<StorageFrameworkClient> storage_;
+        bool stored_ {false};
+    };
+
+    // what the restore listing does for every new backup directory
+    void read_manifest(benchmark::State & state, Manifest::Format format)
+    {
+        StoredManifest stored(int(state.range(0)), format);
+        if (!stored.is_stored())
+        {
+            state.SkipWithError("The manifest could not be stored");
+            return;
+        }
+        while (state.KeepRunning())
+        {
+            Manifest manifest(stored.storage(), StoredManifest::dir_name());
+            manifest.read();
+            if (!wait_for(manifest))
+            {
+                state.SkipWithError("The manifest could not be read");
+                return;
+            }
+            benchmark::DoNotOptimize(manifest.get_entries());
+        }
+        state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+    }
+}
+
+// Metadata -> JSON text -> Metadata
+static void BM_MetadataJsonRoundTrip(benchmark::State & state)
+{
+    auto const metadata = create_metadata(0);
+    while (state.KeepRunning())
+    {
+        auto const json = QJsonDocument(metadata.json()).toJson(QJsonDocument::Compact);
+        Metadata read(QJsonDocument::fromJson(json).object());
+        benchmark::DoNotOptimize(read);
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(BM_MetadataJsonRoundTrip);
+
+// Manifest::read() of a JSON manifest, as stored by older versions
+// args: number of entries
+static void BM_ManifestReadJson(benchmark::State & state)
+{
+    read_manifest(state, Manifest::Format::JSON);
+}
+BENCHMARK(BM_ManifestReadJson)->Arg(10)->Arg(1000);
+
+// Manifest::read() of a binary manifest
+// args: number of entries
+static void BM_ManifestReadBinary(benchmark::State & state)
+{
+    read_manifest(state, Manifest::Format::BINARY);
+}
+BENCHMARK(BM_ManifestReadBinary)->Arg(10)->Arg(1000);
+
+// loading only checks the tables, and the properties are read in place
+// one by one. Compared with BM_ManifestDecodeBinary it tells how much
+// decoding every entry costs
+// args: number of entries
+static void BM_ManifestLoadBinary(benchmark::State & state)
+{
+    auto const data = BinaryManifest::encode(create_entries(int(state.range(0))));
+    while (state.KeepRunning())
+    {
+        BinaryManifest manifest;
+        manifest.load(data);
+        for (int i = 0; i < manifest.size(); ++i)
+            benchmark::DoNotOptimize(manifest.value(i, keeper::Item::UUID_KEY));
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * data.size());
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_ManifestLoadBinary)->Arg(10)->Arg(1000);
+
+// args: number of entries
+static void BM_ManifestDecodeBinary(benchmark::State & state)
+{
+    auto const data = BinaryManifest::encode(create_entries(int(state.range(0))));
+    while (state.KeepRunning())
+    {
+        BinaryManifest manifest;
+        manifest.load(data);
+        benchmark::DoNotOptimize(manifest.entries());
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * data.size());
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_ManifestDecodeBinary)->Arg(10)->Arg(1000);
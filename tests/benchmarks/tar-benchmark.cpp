@@ -0,0 +1,141 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include "tar/tar-creator.h"
+#include "tar/untar.h"
+
+#include <benchmark/benchmark.h>
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+
+#include <random>
+#include <vector>
+
+namespace
+{
+    enum Sizes {SMALL_FILES, LARGE_FILES};
+
+    // {number of files, size of each file}
+    constexpr int SMALL_N_FILES {200};
+    constexpr int SMALL_FILE_SIZE {4 * 1024};
+    constexpr int LARGE_N_FILES {4};
+    constexpr int LARGE_FILE_SIZE {8 * 1024 * 1024};
+
+    constexpr unsigned DATA_SEED {1};
+
+    // a directory with the same files on every run.
+    // Returns the paths of the files, relative to the directory
+    QStringList create_files(QTemporaryDir const & dir, int sizes)
+    {
+        auto const n_files = sizes == SMALL_FILES ? SMALL_N_FILES : LARGE_N_FILES;
+        auto const file_size = sizes == SMALL_FILES ? SMALL_FILE_SIZE : LARGE_FILE_SIZE;
+
+        // half random and half text, so compression has something to do
+        std::mt19937 generator(DATA_SEED);
+        QByteArray contents(file_size, 'k');
+        for (int i = 0; i < file_size / 2; ++i)
+            contents[i] = char(generator());
+
+        QStringList ret;
+        for (int i = 0; i < n_files; ++i)
+        {
+            auto const name = QStringLiteral("file-%1").arg(i);
+            QFile file(QDir(dir.path()).filePath(name));
+            file.open(QIODevice::WriteOnly);
+            file.write(contents);
+            ret << name;
+        }
+        return ret;
+    }
+
+    std::vector<char> create_tar(QStringList const & files, bool compress)
+    {
+        std::vector<char> ret;
+        std::vector<char> step;
+        TarCreator tar_creator(files, compress);
+        while (tar_creator.step(step))
+            ret.insert(ret.end(), step.begin(), step.end());
+        return ret;
+    }
+}
+
+// args: compress, sizes
+static void BM_TarCreatorStep(benchmark::State & state)
+{
+    auto const compress = state.range(0) != 0;
+    QTemporaryDir dir;
+    auto const files = create_files(dir, int(state.range(1)));
+    auto const old_current = QDir::currentPath();
+    QDir::setCurrent(dir.path());
+
+    int64_t n_bytes {0};
+    std::vector<char> step;
+    while (state.KeepRunning())
+    {
+        TarCreator tar_creator(files, compress);
+        while (tar_creator.step(step))
+            n_bytes += int64_t(step.size());
+    }
+
+    QDir::setCurrent(old_current);
+    state.SetBytesProcessed(n_bytes);
+    state.SetItemsProcessed(int64_t(state.iterations()) * files.size());
+}
+BENCHMARK(BM_TarCreatorStep)
+    ->ArgNames({"compress", "large"})
+    ->Args({0, SMALL_FILES})
+    ->Args({1, SMALL_FILES})
+    ->Args({0, LARGE_FILES})
+    ->Args({1, LARGE_FILES})
+    ->Unit(benchmark::kMillisecond);
+
+// args: step size, sizes
+static void BM_UntarStep(benchmark::State & state)
+{
+    auto const step_size = size_t(state.range(0));
+    QTemporaryDir in;
+    auto const files = create_files(in, int(state.range(1)));
+    auto const old_current = QDir::currentPath();
+    QDir::setCurrent(in.path());
+    auto const contents = create_tar(files, false);
+    QDir::setCurrent(old_current);
+
+    while (state.KeepRunning())
+    {
+        state.PauseTiming();
+        QTemporaryDir out;
+        state.ResumeTiming();
+
+        Untar untar(out.path().toStdString());
+        for (size_t offset = 0; offset < contents.size(); offset += step_size)
+            untar.step(&contents[offset], std::min(step_size, contents.size() - offset));
+        untar.finish();
+    }
+
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(contents.size()));
+    state.SetItemsProcessed(int64_t(state.iterations()) * files.size());
+}
+BENCHMARK(BM_UntarStep)
+    ->ArgNames({"step", "large"})
+    ->Args({4096, SMALL_FILES})
+    ->Args({64 * 1024, SMALL_FILES})
+    ->Args({64 * 1024, LARGE_FILES})
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include <service/keeper-task.h>
+
+#include <benchmark/benchmark.h>
+
+namespace
+{
+    KeeperTask::TaskData create_task_data(QString const & action)
+    {
+        KeeperTask::TaskData td;
+        td.action = action;
+        td.error = keeper::Error::OK;
+        td.metadata = Metadata(QStringLiteral("uuid-1"), QStringLiteral("Music"));
+        return td;
+    }
+}
+
+// what the service does on every progress update of a helper:
+// the state is recalculated and compared with the published one
+static void BM_TaskStateRecalculation(benchmark::State & state)
+{
+    auto const td = create_task_data(QStringLiteral("saving"));
+    auto const published = KeeperTask::get_initial_state(td).to_item();
+    int64_t i {0};
+    while (state.KeepRunning())
+    {
+        auto const task_state = KeeperTask::calculate_state(td, double(i % 100) / 100, qint32(i), keeper::Error::OK);
+        benchmark::DoNotOptimize(task_state.is_published_in(published));
+        ++i;
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(BM_TaskStateRecalculation);
+
+// what the service does when the state changed and is published
+static void BM_TaskStateToItem(benchmark::State & state)
+{
+    auto const task_state = KeeperTask::calculate_state(create_task_data(QStringLiteral("saving")), 0.5, 1024, keeper::Error::OK);
+    while (state.KeepRunning())
+        benchmark::DoNotOptimize(task_state.to_item());
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(BM_TaskStateToItem);
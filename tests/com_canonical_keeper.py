@@ -78,6 +78,7 @@ class TaskData:
         self.error = ''
         self.chunks = []
         self.sock = None
+        self.file_catalog = None
         self.uuid = None
         self.bytes_per_second = {}
 
@@ -358,11 +359,50 @@ def user_build_state(user):
     )
 
 
+def user_build_state_delta(old_state, new_state):
+    """Returns the task properties that differ between two states.
+
+    Tasks that are not in new_state are mapped to an empty property map.
+    """
+
+    delta = {}
+    for uuid, props in new_state.items():
+        old_props = old_state.get(uuid, {})
+        changed = {}
+        for key, value in props.items():
+            if old_props.get(key, None) != value:
+                changed[key] = value
+        if changed:
+            delta[uuid] = dbus.Dictionary(changed, signature='sv')
+    for uuid in old_state:
+        if uuid not in new_state:
+            delta[uuid] = dbus.Dictionary({}, signature='sv')
+    return dbus.Dictionary(delta, signature='sa{sv}')
+
+
 def user_update_state_property(user):
     old_state = user.Get(USER_IFACE, 'State')
     new_state = user.build_state(user)
     if old_state != new_state:
         user.Set(USER_IFACE, 'State', new_state)
+        user.state_version += 1
+        user.EmitSignal(
+            USER_IFACE,
+            'StateChanged',
+            'ta{sa{sv}}',
+            [dbus.UInt64(user.state_version),
+             user_build_state_delta(old_state, new_state)]
+        )
+
+
+def user_get_state_since(user, since):
+    # the mock doesn't keep per-property versions,
+    # so the whole state is returned when the caller is behind
+    state = user.Get(USER_IFACE, 'State')
+    full = since < user.state_version
+    if not full:
+        state = dbus.Dictionary({}, signature='sa{sv}')
+    return (state, dbus.UInt64(user.state_version), dbus.Boolean(full))
 
 
 #
@@ -414,6 +454,19 @@ def helper_start_restore(helper):
     sock2.close()
     return ret
 
+def helper_set_file_catalog(helper, catalog):
+
+    user = mockobject.objects[USER_PATH]
+    uuid = user.current_task
+
+    with os.fdopen(catalog.take(), 'rb') as f:
+        data = f.read()
+
+    helper.log("got set_file_catalog request of %s bytes" % (len(data)))
+
+    td = user.task_data[uuid]
+    td.file_catalog = data
+
 #
 #  Controlling the mock
 #
@@ -431,6 +484,7 @@ def mock_add_backup_choice(mock, uuid, props):
         signature='sv',
         variant_level=1
     )
+    user.EmitSignal(USER_IFACE, 'BackupChoicesChanged', '', [])
 
 
 def mock_add_restore_choice(mock, uuid, props):
@@ -475,6 +529,8 @@ def load(main, parameters):
     o.cancel = user_cancel
     o.build_state = user_build_state
     o.update_state_property = user_update_state_property
+    o.get_state_since = user_get_state_since
+    o.state_version = 0
     o.start_next_task = user_start_next_task
     o.all_tasks = []
     o.remaining_tasks = []
@@ -489,14 +545,18 @@ def load(main, parameters):
     o.AddMethods(USER_IFACE, [
         ('GetBackupChoices', '', 'a{sa{sv}}',
          'ret = self.get_backup_choices(self)'),
-        ('StartBackup', 'as', '',
+        ('StartBackup', 'ass', '',
          'self.start_backup(self, args[0])'),
-        ('GetRestoreChoices', '', 'a{sa{sv}}',
+        ('GetRestoreChoices', 's', 'a{sa{sv}}',
          'ret = self.get_restore_choices(self)'),
-        ('StartRestore', 'as', '',
+        ('StartRestore', 'ass', '',
          'self.start_restore(self, args[0])'),
         ('Cancel', '', '',
          'self.cancel(self)'),
+        ('Resume', '', 'b',
+         'ret = False'),
+        ('GetStateSince', 't', 'a{sa{sv}}tb',
+         'ret = self.get_state_since(self, args[0])'),
     ])
     o.AddProperty(USER_IFACE, "State", o.build_state(o))
 
@@ -506,11 +566,14 @@ def load(main, parameters):
     o = mockobject.objects[path]
     o.start_backup = helper_start_backup
     o.start_restore = helper_start_restore
+    o.set_file_catalog = helper_set_file_catalog
     o.AddMethods(HELPER_IFACE, [
         ('StartBackup', 't', 'h',
          'ret = self.start_backup(self, args[0])'),
         ('StartRestore', '', 'h',
-         'ret = self.start_restore(self)')
+         'ret = self.start_restore(self)'),
+        ('SetFileCatalog', 'h', '',
+         'self.set_file_catalog(self, args[0])')
     ])
 
     # com.canonical.keeper.Mock
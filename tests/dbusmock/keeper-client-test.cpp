@@ -0,0 +1,154 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Charles Kerr <charles.kerr@canonical.com>
+ */
+
+#include "tests/fakes/fake-backup-helper.h"
+
+#include "tests/utils/keeper-dbusmock-fixture.h"
+
+#include <client/client.h>
+
+#include <QSignalSpy>
+#include <QUuid>
+
+using KeeperClientTest = KeeperDBusMockFixture;
+
+namespace
+{
+    QMap<QString,QVariant> backup_choice_properties()
+    {
+        return QMap<QString,QVariant>{
+            { KEY_NAME, QStringLiteral("some-name") },
+            { KEY_TYPE, QStringLiteral("some-type") },
+            { KEY_SUBTYPE, QStringLiteral("some-subtype") },
+            { KEY_HELPER, QString::fromUtf8(FAKE_BACKUP_HELPER_EXEC) }
+        };
+    }
+}
+
+TEST_F(KeeperClientTest, BackupChoicesAsync)
+{
+    KeeperClient client(connection());
+    auto const uuid = add_backup_choice(backup_choice_properties());
+
+    QSignalSpy spy(&client, &KeeperClient::backupChoicesReady);
+    client.getBackupChoicesAsync();
+    ASSERT_TRUE(spy.wait());
+    auto const arguments = spy.takeFirst();
+    EXPECT_EQ(keeper::Error::OK, arguments.at(1).value<keeper::Error>());
+    auto const choices = arguments.at(0).value<keeper::Items>();
+    ASSERT_TRUE(choices.contains(uuid));
+    EXPECT_EQ(QStringLiteral("some-name"), choices.value(uuid).get_display_name());
+
+    // the local copy of the choices is updated too
+    EXPECT_TRUE(client.backupUuids().contains(uuid));
+}
+
+TEST_F(KeeperClientTest, RestoreChoicesAsync)
+{
+    KeeperClient client(connection());
+    auto const uuid = add_restore_choice(QMap<QString,QVariant>{
+        { KEY_NAME, QStringLiteral("some-name") },
+        { KEY_TYPE, QStringLiteral("some-type") },
+        { KEY_SUBTYPE, QStringLiteral("some-subtype") },
+        { KEY_HELPER, QString::fromUtf8(FAKE_BACKUP_HELPER_EXEC) },
+        { KEY_SIZE, quint64(1024) },
+        { KEY_CTIME, quint64(1470000000) },
+        { KEY_BLOB, QByteArray("some-blob") }
+    });
+
+    QSignalSpy spy(&client, &KeeperClient::restoreChoicesReady);
+    client.getRestoreChoicesAsync(QStringLiteral("some-storage"));
+    ASSERT_TRUE(spy.wait());
+    auto const arguments = spy.takeFirst();
+    EXPECT_EQ(QStringLiteral("some-storage"), arguments.at(0).toString());
+    EXPECT_EQ(keeper::Error::OK, arguments.at(2).value<keeper::Error>());
+    EXPECT_TRUE(arguments.at(1).value<keeper::Items>().contains(uuid));
+}
+
+// the mock service doesn't implement GetBackupContents nor GetStorageAccounts,
+// so the calls fail and their results are still delivered
+TEST_F(KeeperClientTest, AsyncErrors)
+{
+    KeeperClient client(connection());
+
+    QSignalSpy contents_spy(&client, &KeeperClient::backupContentsReady);
+    client.getBackupContentsAsync(QStringLiteral("some-uuid"), QString(), QString());
+    ASSERT_TRUE(contents_spy.wait());
+    auto arguments = contents_spy.takeFirst();
+    EXPECT_EQ(QStringLiteral("some-uuid"), arguments.at(0).toString());
+    EXPECT_TRUE(arguments.at(1).value<keeper::Items>().isEmpty());
+    EXPECT_NE(keeper::Error::OK, arguments.at(2).value<keeper::Error>());
+
+    QSignalSpy accounts_spy(&client, &KeeperClient::storageAccountsReady);
+    client.getStorageAccountsAsync();
+    ASSERT_TRUE(accounts_spy.wait());
+    EXPECT_TRUE(accounts_spy.takeFirst().at(0).toStringList().isEmpty());
+}
+
+TEST_F(KeeperClientTest, StartBackup)
+{
+    KeeperClient client(connection());
+    auto const uuid = add_backup_choice(backup_choice_properties());
+
+    // the service announces the new choice, and the client fetches it
+    ASSERT_TRUE(wait_for([&client, &uuid]{
+        QCoreApplication::processEvents();
+        return client.backupUuids().contains(uuid);
+    }));
+
+    client.enableBackup(uuid, true);
+    client.startBackup(QString());
+    EXPECT_TRUE(client.backupBusy());
+
+    // the client is busy until the state of the tasks says they are done
+    EXPECT_TRUE(wait_for([&client]{
+        QCoreApplication::processEvents();
+        return !client.backupBusy();
+    }, 5000));
+    EXPECT_EQ(QStringLiteral("Backup Complete"), client.status());
+}
+
+TEST_F(KeeperClientTest, FailedStartBackupIsNotBusy)
+{
+    KeeperClient client(connection());
+
+    // the service doesn't know this choice, so it refuses to start
+    client.enableBackup(QUuid::createUuid().toString(), true);
+    QSignalSpy busy_spy(&client, &KeeperClient::backupBusyChanged);
+    client.startBackup(QString());
+    EXPECT_TRUE(client.backupBusy());
+
+    ASSERT_TRUE(busy_spy.wait());
+    EXPECT_FALSE(client.backupBusy());
+    EXPECT_EQ(QStringLiteral("Backup Failed"), client.status());
+}
+
+TEST_F(KeeperClientTest, FailedStartRestoreIsNotBusy)
+{
+    KeeperClient client(connection());
+
+    client.enableRestore(QUuid::createUuid().toString(), true);
+    QSignalSpy busy_spy(&client, &KeeperClient::backupBusyChanged);
+    client.startRestore(QString());
+    EXPECT_TRUE(client.backupBusy());
+
+    ASSERT_TRUE(busy_spy.wait());
+    EXPECT_FALSE(client.backupBusy());
+    EXPECT_EQ(QStringLiteral("Restore Failed"), client.status());
+}
@@ -46,8 +46,9 @@ public:
 Q_SIGNALS:
     void EventEmitted(QString const &name, QStringList const &env);
 private:
-    bool start_process(QString const & app_id, QString const & path, QString const & cwd);
+    bool start_process(QString const & app_id, QString const & instance_id, QString const & path, QString const & cwd, QStringList const & args);
 
+    // "instance_id:app_id" -> helper process
     QMap<QString, QSharedPointer<QProcess>> processes_;
     QMap<QString, QString> job_paths_;
     QSharedPointer<UpstartMockAdaptor> upstart_adaptor_;
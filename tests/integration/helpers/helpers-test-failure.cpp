@@ -19,9 +19,12 @@
  *     Charles Kerr <charles.kerr@canonical.com>
  */
 #include "test-helpers-base.h"
+#include "qdbus-stubs/keeper_metrics_interface.h"
 #include "tests/utils/storage-framework-local.h"
 #include "tests/fakes/fake-backup-helper.h"
 
+#include <util/metrics.h>
+
 class TestHelpers: public TestHelpersBase
 {
     using super = TestHelpersBase;
@@ -117,3 +120,73 @@ TEST_F(TestHelpers, BackupHelperWritesTooMuch)
     // sent 1 byte more than the expected, so percentage has to be greater than 1.0
     EXPECT_LT(1.0, state_values.get_percent_done());
 }
+
+TEST_F(TestHelpers, FailedBackupIsInTheMetrics)
+{
+    XdgUserDirsSandbox tmp_dir;
+
+    // keeper-service gets no file to write the metrics to
+    qunsetenv("KEEPER_METRICS_FILE");
+
+    // starts the services, including keeper-service
+    start_tasks();
+
+    QSharedPointer<DBusInterfaceKeeperUser> user_iface(new DBusInterfaceKeeperUser(
+                                                            DBusTypes::KEEPER_SERVICE,
+                                                            DBusTypes::KEEPER_USER_PATH,
+                                                            dbus_test_runner.sessionConnection()
+                                                        ) );
+    ASSERT_TRUE(user_iface->isValid()) << qPrintable(dbus_test_runner.sessionConnection().lastError().message());
+
+    DBusInterfaceKeeperMetrics metrics_iface(DBusTypes::KEEPER_SERVICE,
+                                             DBusTypes::KEEPER_METRICS_PATH,
+                                             dbus_test_runner.sessionConnection());
+    ASSERT_TRUE(metrics_iface.isValid()) << qPrintable(dbus_test_runner.sessionConnection().lastError().message());
+
+    // nothing ran yet
+    QDBusReply<QVariantDictMap> metrics = metrics_iface.call("GetMetrics");
+    ASSERT_TRUE(metrics.isValid()) << qPrintable(metrics.error().message());
+    EXPECT_FALSE(metrics.value().contains(QString::fromLatin1(util::METRIC_HELPER_LAUNCH)));
+
+    QDBusReply<keeper::Items> choices = user_iface->call("GetBackupChoices");
+    ASSERT_TRUE(choices.isValid()) << qPrintable(choices.error().message());
+
+    auto user_dir = qgetenv("XDG_MUSIC_DIR");
+    ASSERT_FALSE(user_dir.isEmpty());
+    FileUtils::fillTemporaryDirectory(user_dir, qrand() % 1000);
+
+    auto user_folder_uuid = get_uuid_for_xdg_folder_path(user_dir, choices.value());
+    ASSERT_FALSE(user_folder_uuid.isEmpty());
+
+    // the helper writes more than it announced, so the task fails
+    QDBusReply<void> backup_reply = user_iface->call("StartBackup", QStringList{user_folder_uuid}, "");
+    ASSERT_TRUE(backup_reply.isValid()) << qPrintable(backup_reply.error().message());
+    EXPECT_TRUE(wait_for_all_tasks_have_action_state({user_folder_uuid}, "failed", user_iface));
+
+    metrics = metrics_iface.call("GetMetrics");
+    ASSERT_TRUE(metrics.isValid()) << qPrintable(metrics.error().message());
+    auto const values = metrics.value();
+
+    auto const duration = values.value(QStringLiteral("%1{mode=\"backup\",result=\"failed\"}").arg(util::METRIC_TASK_DURATION));
+    EXPECT_EQ(QStringLiteral("histogram"), duration.value(QStringLiteral("type")).toString());
+    EXPECT_EQ(1, duration.value(QStringLiteral("count")).toULongLong());
+    EXPECT_LT(0.0, duration.value(QStringLiteral("sum")).toDouble());
+
+    auto const failures = values.value(QStringLiteral("%1{error=\"helper_write\"}").arg(util::METRIC_TASK_FAILURES));
+    EXPECT_EQ(QStringLiteral("counter"), failures.value(QStringLiteral("type")).toString());
+    EXPECT_EQ(1.0, failures.value(QStringLiteral("value")).toDouble());
+
+    auto const launch = values.value(QString::fromLatin1(util::METRIC_HELPER_LAUNCH));
+    EXPECT_EQ(QStringLiteral("histogram"), launch.value(QStringLiteral("type")).toString());
+    EXPECT_EQ(1, launch.value(QStringLiteral("count")).toULongLong());
+
+    // the text format has the same samples
+    QDBusReply<QString> text = metrics_iface.call("GetPrometheusText");
+    ASSERT_TRUE(text.isValid()) << qPrintable(text.error().message());
+    EXPECT_TRUE(text.value().contains(QStringLiteral("%1_count 1").arg(util::METRIC_HELPER_LAUNCH)));
+
+    // keeper-service was started without KEEPER_METRICS_FILE, so there is no file to write
+    QDBusReply<bool> written = metrics_iface.call("WritePrometheusFile");
+    ASSERT_TRUE(written.isValid()) << qPrintable(written.error().message());
+    EXPECT_FALSE(written.value());
+}
@@ -22,6 +22,8 @@
 #include "test-helpers-base.h"
 #include "tests/fakes/fake-restore-helper.h"
 
+#include <service/task-journal.h>
+
 class TestHelpers: public TestHelpersBase
 {
     using super = TestHelpersBase;
@@ -126,6 +128,7 @@ TEST_F(TestHelpers, StartFullTest)
     ASSERT_TRUE(properties_interface->isValid()) << qPrintable(QDBusConnection::sessionBus().lastError().message());
 
     QSignalSpy spy(properties_interface.data(),&DBusPropertiesInterface::PropertiesChanged);
+    QSignalSpy spy_delta(user_iface.data(), &DBusInterfaceKeeperUser::StateChanged);
 
     // Now we know the music folder uuid, let's start the backup for it.
     QDBusReply<void> backup_reply = user_iface->call("StartBackup", QStringList{user_folder_uuid, user_folder_uuid_2}, "");
@@ -139,6 +142,45 @@ TEST_F(TestHelpers, StartFullTest)
     // this one uses pooling so it should just call Get once
     EXPECT_TRUE(wait_for_all_tasks_have_action_state({user_folder_uuid, user_folder_uuid_2}, "complete", user_iface));
 
+    // the merged StateChanged deltas must rebuild the full state
+    keeper::Items merged_state;
+    quint64 last_version = 0;
+    for (auto const& arguments : spy_delta)
+    {
+        auto const version = arguments.at(0).toULongLong();
+        EXPECT_EQ(last_version + 1, version);
+        last_version = version;
+        auto const changed = qdbus_cast<keeper::Items>(arguments.at(1));
+        for (auto iter = changed.begin(); iter != changed.end(); ++iter)
+        {
+            for (auto field = iter->begin(); field != iter->end(); ++field)
+            {
+                if (field.key() == keeper::Item::REMOVED_PROPERTIES_KEY)
+                {
+                    for (auto const& removed : field.value().toStringList())
+                        merged_state[iter.key()].remove(removed);
+                    continue;
+                }
+                merged_state[iter.key()].insert(field.key(), field.value());
+            }
+        }
+    }
+    QDBusPendingReply<keeper::Items, quint64, bool> state_since_reply = user_iface->GetStateSince(0);
+    state_since_reply.waitForFinished();
+    ASSERT_TRUE(state_since_reply.isValid()) << qPrintable(state_since_reply.error().message());
+    auto const current_version = state_since_reply.argumentAt<1>();
+    EXPECT_EQ(last_version, current_version);
+    EXPECT_TRUE(state_since_reply.argumentAt<2>());
+    EXPECT_EQ(user_iface->state(), merged_state);
+    EXPECT_EQ(state_since_reply.argumentAt<0>(), merged_state);
+
+    // nothing changed since the last version
+    state_since_reply = user_iface->GetStateSince(current_version);
+    state_since_reply.waitForFinished();
+    ASSERT_TRUE(state_since_reply.isValid()) << qPrintable(state_since_reply.error().message());
+    EXPECT_TRUE(state_since_reply.argumentAt<0>().isEmpty());
+    EXPECT_FALSE(state_since_reply.argumentAt<2>());
+
     // check that the content of the file is the expected
     EXPECT_TRUE(StorageFrameworkLocalUtils::check_storage_framework_files(QStringList{user_dir, user_dir_2}));
 
@@ -153,13 +195,11 @@ TEST_F(TestHelpers, StartFullTest)
     EXPECT_EQ(2, restore_choices.size());
 
     // check that we have the first uuid that we did the backup
-    const auto iter_restore = restore_choices.find(user_folder_uuid);
+    const auto iter_restore = restore_choices.find(get_restore_uuid(user_folder_uuid, restore_choices));
     EXPECT_NE(iter_restore, restore_choices.end());
-    EXPECT_EQ(user_folder_uuid, iter_restore.key());
 
-    const auto iter_restore_2 = restore_choices.find(user_folder_uuid_2);
+    const auto iter_restore_2 = restore_choices.find(get_restore_uuid(user_folder_uuid_2, restore_choices));
     EXPECT_NE(iter_restore_2, restore_choices.end());
-    EXPECT_EQ(user_folder_uuid_2, iter_restore_2.key());
 
     QTemporaryDir temp_source_dir_1;
     ASSERT_TRUE(FileUtils::copyDirsRecursively(user_dir, temp_source_dir_1.path()));
@@ -188,6 +228,25 @@ TEST_F(TestHelpers, StartFullTest)
     // check that the contents now are the same after the restore
     EXPECT_TRUE(FileUtils::compareDirectories(temp_source_dir_1.path(), user_dir));
     EXPECT_TRUE(FileUtils::compareDirectories(temp_source_dir_2.path(), user_dir_2));
+
+    // the removals of the backup tasks are known from the end of the backup...
+    state_since_reply = user_iface->GetStateSince(current_version);
+    state_since_reply.waitForFinished();
+    ASSERT_TRUE(state_since_reply.isValid()) << qPrintable(state_since_reply.error().message());
+    EXPECT_FALSE(state_since_reply.argumentAt<2>());
+    auto const restore_state = user_iface->state();
+    auto const since_backup = state_since_reply.argumentAt<0>();
+    for (auto iter = since_backup.begin(); iter != since_backup.end(); ++iter)
+        EXPECT_EQ(restore_state.contains(iter.key()), !iter->isEmpty()) << qPrintable(iter.key());
+    for (auto const& uuid : restore_state.keys())
+        EXPECT_TRUE(since_backup.contains(uuid)) << qPrintable(uuid);
+
+    // ...but not from the middle of it, so the whole state is returned
+    state_since_reply = user_iface->GetStateSince(1);
+    state_since_reply.waitForFinished();
+    ASSERT_TRUE(state_since_reply.isValid()) << qPrintable(state_since_reply.error().message());
+    EXPECT_TRUE(state_since_reply.argumentAt<2>());
+    EXPECT_EQ(user_iface->state(), state_since_reply.argumentAt<0>());
 }
 
 TEST_F(TestHelpers, StartFullTestCancelling)
@@ -336,13 +395,11 @@ TEST_F(TestHelpers, StartFullTestCancellingRestore)
     EXPECT_EQ(2, restore_choices.size());
 
     // check that we have the first uuid that we did the backup
-    const auto iter_restore = restore_choices.find(user_folder_uuid);
+    const auto iter_restore = restore_choices.find(get_restore_uuid(user_folder_uuid, restore_choices));
     EXPECT_NE(iter_restore, restore_choices.end());
-    EXPECT_EQ(user_folder_uuid, iter_restore.key());
 
-    const auto iter_restore_2 = restore_choices.find(user_folder_uuid_2);
+    const auto iter_restore_2 = restore_choices.find(get_restore_uuid(user_folder_uuid_2, restore_choices));
     EXPECT_NE(iter_restore_2, restore_choices.end());
-    EXPECT_EQ(user_folder_uuid_2, iter_restore_2.key());
 
     QTemporaryDir temp_source_dir_1;
     ASSERT_TRUE(FileUtils::copyDirsRecursively(user_dir, temp_source_dir_1.path()));
@@ -369,6 +426,104 @@ TEST_F(TestHelpers, StartFullTestCancellingRestore)
     EXPECT_FALSE(FileUtils::compareDirectories(temp_source_dir_2.path(), user_dir_2));
 }
 
+TEST_F(TestHelpers, ResumeInterruptedBackup)
+{
+    XdgUserDirsSandbox tmp_dir;
+
+    // starts the services, including keeper-service
+    start_tasks();
+
+    QSharedPointer<DBusInterfaceKeeperUser> user_iface(new DBusInterfaceKeeperUser(
+                                                            DBusTypes::KEEPER_SERVICE,
+                                                            DBusTypes::KEEPER_USER_PATH,
+                                                            dbus_test_runner.sessionConnection()
+                                                        ) );
+
+    ASSERT_TRUE(user_iface->isValid()) << qPrintable(dbus_test_runner.sessionConnection().lastError().message());
+
+    // nothing to resume yet
+    QDBusReply<bool> resume_reply = user_iface->call("Resume");
+    ASSERT_TRUE(resume_reply.isValid()) << qPrintable(resume_reply.error().message());
+    EXPECT_FALSE(resume_reply.value());
+
+    QDBusReply<keeper::Items> choices = user_iface->call("GetBackupChoices");
+    ASSERT_TRUE(choices.isValid()) << qPrintable(choices.error().message());
+
+    auto user_dir = qgetenv("XDG_MUSIC_DIR");
+    ASSERT_FALSE(user_dir.isEmpty());
+    FileUtils::fillTemporaryDirectory(user_dir, qrand() % 100);
+    auto user_folder_uuid = get_uuid_for_xdg_folder_path(user_dir, choices.value());
+    ASSERT_FALSE(user_folder_uuid.isEmpty());
+
+    auto user_dir_2 = qgetenv("XDG_VIDEOS_DIR");
+    ASSERT_FALSE(user_dir_2.isEmpty());
+    FileUtils::fillTemporaryDirectory(user_dir_2, qrand() % 100);
+    auto user_folder_uuid_2 = get_uuid_for_xdg_folder_path(user_dir_2, choices.value());
+    ASSERT_FALSE(user_folder_uuid_2.isEmpty());
+
+    // the previous service instance stopped after the first task failed,
+    // while the second one was still queued
+    QList<Metadata> tasks;
+    for (auto const & uuid : {user_folder_uuid, user_folder_uuid_2})
+    {
+        auto const choice = choices.value()[uuid];
+        Metadata metadata(uuid, choice.get_display_name());
+        for (auto it = choice.cbegin(), end = choice.cend(); it != end; ++it)
+            metadata.set_property_value(it.key(), it.value());
+        tasks << metadata;
+    }
+    TaskJournal journal;
+    journal.begin(QStringLiteral("backup"), QString(), QStringLiteral("2016-01-01T00-00-00"), tasks);
+    journal.set_task_finished(tasks[0], false);
+
+    resume_reply = user_iface->call("Resume");
+    ASSERT_TRUE(resume_reply.isValid()) << qPrintable(resume_reply.error().message());
+    EXPECT_TRUE(resume_reply.value());
+
+    // the failed task is reported but not run again
+    EXPECT_TRUE(wait_for_all_tasks_have_action_state({user_folder_uuid_2}, "complete", user_iface));
+    keeper::Item value;
+    ASSERT_TRUE(get_task_value_now(user_folder_uuid, user_iface, value));
+    EXPECT_EQ(QStringLiteral("failed"), value.get_status());
+
+    // only the resumed task is in the backup, in the folder of the interrupted run
+    EXPECT_EQ(QStringLiteral("2016-01-01T00-00-00"), StorageFrameworkLocalUtils::get_storage_framework_dir_name());
+    EXPECT_TRUE(StorageFrameworkLocalUtils::check_storage_framework_files(QStringList{user_dir_2}));
+    EXPECT_TRUE(check_manifest_file({BackupItem{get_display_name_for_xdg_folder_path(user_dir_2, choices.value()),
+                                                get_type_for_xdg_folder_path(user_dir_2, choices.value()),
+                                                user_folder_uuid_2}}));
+
+    // the run is over, so it's not resumed twice
+    EXPECT_FALSE(QFile::exists(journal.path()));
+    resume_reply = user_iface->call("Resume");
+    ASSERT_TRUE(resume_reply.isValid()) << qPrintable(resume_reply.error().message());
+    EXPECT_FALSE(resume_reply.value());
+}
+
+TEST_F(TestHelpers, ResumeRejectsUnknownMode)
+{
+    // starts the services, including keeper-service
+    start_tasks();
+
+    QSharedPointer<DBusInterfaceKeeperUser> user_iface(new DBusInterfaceKeeperUser(
+                                                            DBusTypes::KEEPER_SERVICE,
+                                                            DBusTypes::KEEPER_USER_PATH,
+                                                            dbus_test_runner.sessionConnection()
+                                                        ) );
+
+    ASSERT_TRUE(user_iface->isValid()) << qPrintable(dbus_test_runner.sessionConnection().lastError().message());
+
+    TaskJournal journal;
+    journal.begin(QStringLiteral("archive"), QString(), QString(), {Metadata(QStringLiteral("uuid"), QStringLiteral("name"))});
+
+    // the journal of an unknown run is dropped instead of restoring anything
+    QDBusReply<bool> resume_reply = user_iface->call("Resume");
+    ASSERT_TRUE(resume_reply.isValid()) << qPrintable(resume_reply.error().message());
+    EXPECT_FALSE(resume_reply.value());
+    EXPECT_FALSE(QFile::exists(journal.path()));
+    EXPECT_TRUE(user_iface->state().isEmpty());
+}
+
 TEST_F(TestHelpers, CheckBadUUIDS)
 {
     XdgUserDirsSandbox tmp_dir;
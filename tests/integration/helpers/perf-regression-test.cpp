@@ -0,0 +1,364 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Xavi Garcia <xavi.garcia.mena@canonical.com>
+ */
+
+/*
+ * Backs up and restores large datasets through the local storage framework
+ * and checks the cost of every run against the budgets in perf-budgets.json.
+ *
+ * KEEPER_PERF_BUDGETS   path of an alternative budgets file
+ * KEEPER_PERF_RESULTS   path of a JSON file where the measurements are merged
+ * KEEPER_PERF_SCALE     multiplies the number of files of every profile,
+ *                       and the time and bytes budgets with it
+ */
+
+#include "test-helpers-base.h"
+#include "qdbus-stubs/keeper_metrics_interface.h"
+#include "tests/utils/dataset-generator.h"
+
+#include <util/metrics.h>
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+
+#include <algorithm> // std::max()
+
+#include <unistd.h> // sysconf()
+
+namespace
+{
+    constexpr const char BUDGETS_ENV[] = "KEEPER_PERF_BUDGETS";
+    constexpr const char RESULTS_ENV[] = "KEEPER_PERF_RESULTS";
+    constexpr const char SCALE_ENV[] = "KEEPER_PERF_SCALE";
+
+    constexpr const char WALL_KEY[] = "wall_msec";
+    constexpr const char CPU_KEY[] = "cpu_msec";
+    constexpr const char RSS_KEY[] = "peak_rss_kb";
+    constexpr const char BYTES_KEY[] = "bytes_relayed";
+
+    // used when a profile has no wall time budget
+    constexpr int DEFAULT_TIMEOUT_MSEC {10 * 60 * 1000};
+
+    struct Profile
+    {
+        QString name;
+        DatasetGenerator::Options dataset;
+    };
+
+    struct Measurement
+    {
+        qint64 wall_msec {0};
+        qint64 cpu_msec {0};
+        qint64 peak_rss_kb {0};
+        qint64 bytes_relayed {0};
+    };
+
+    DatasetGenerator::Options dataset(int n_files, qint64 min_file_size, qint64 max_file_size, int depth, int fan_out)
+    {
+        DatasetGenerator::Options ret;
+        ret.n_files = n_files;
+        ret.min_file_size = min_file_size;
+        ret.max_file_size = max_file_size;
+        ret.depth = depth;
+        ret.fan_out = fan_out;
+        ret.compressibility = 0.5;
+        return ret;
+    }
+
+    double scale()
+    {
+        bool ok {false};
+        auto const value = qgetenv(SCALE_ENV).toDouble(&ok);
+        return ok && value > 0 ? value : 1.0;
+    }
+
+    // utime + stime + cutime + cstime, in msec.
+    // The helpers are children of the upstart mock, so they show up in its
+    // cutime and cstime once they are reaped.
+    qint64 process_cpu_msec(qint64 pid)
+    {
+        QFile file(QStringLiteral("/proc/%1/stat").arg(pid));
+        if (pid <= 0 || !file.open(QIODevice::ReadOnly))
+            return 0;
+
+        // the command name may have spaces, the fields start after it
+        auto const stat = file.readAll();
+        auto const fields = stat.mid(stat.lastIndexOf(')') + 2).split(' ');
+        if (fields.size() < 15)
+            return 0;
+
+        qint64 ticks {0};
+        for (int i = 11; i <= 14; ++i)
+            ticks += fields[i].toLongLong();
+        return ticks * 1000 / sysconf(_SC_CLK_TCK);
+    }
+
+    qint64 process_peak_rss_kb(qint64 pid)
+    {
+        QFile file(QStringLiteral("/proc/%1/status").arg(pid));
+        if (pid <= 0 || !file.open(QIODevice::ReadOnly))
+            return 0;
+
+        for (auto const & line : file.readAll().split('\n'))
+        {
+            if (line.startsWith("VmHWM:"))
+                return line.mid(6).trimmed().split(' ').first().toLongLong();
+        }
+        return 0;
+    }
+
+    // resets VmHWM, so every phase gets its own peak
+    void reset_peak_rss(qint64 pid)
+    {
+        QFile file(QStringLiteral("/proc/%1/clear_refs").arg(pid));
+        if (file.open(QIODevice::WriteOnly))
+            file.write("5");
+    }
+
+    // the budgets that depend on the number of files grow with it.
+    // The peak memory doesn't, as the data is streamed
+    QJsonObject scale_budget(QJsonObject budget, double factor)
+    {
+        for (auto const & phase : budget.keys())
+        {
+            auto limits = budget.value(phase).toObject();
+            for (auto const key : {WALL_KEY, CPU_KEY, BYTES_KEY})
+            {
+                auto const name = QString::fromLatin1(key);
+                if (limits.contains(name))
+                    limits[name] = limits.value(name).toDouble() * factor;
+            }
+            budget[phase] = limits;
+        }
+        return budget;
+    }
+
+    QJsonObject load_json(QString const & path)
+    {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly))
+            return QJsonObject();
+        return QJsonDocument::fromJson(file.readAll()).object();
+    }
+
+    QJsonObject to_json(Measurement const & measurement)
+    {
+        QJsonObject ret;
+        ret[QString::fromLatin1(WALL_KEY)] = measurement.wall_msec;
+        ret[QString::fromLatin1(CPU_KEY)] = measurement.cpu_msec;
+        ret[QString::fromLatin1(RSS_KEY)] = measurement.peak_rss_kb;
+        ret[QString::fromLatin1(BYTES_KEY)] = measurement.bytes_relayed;
+        return ret;
+    }
+}
+
+class PerfRegression: public TestHelpersBase
+{
+    using super = TestHelpersBase;
+
+protected:
+
+    void SetUp() override
+    {
+        super::SetUp();
+        init_helper_registry(HELPER_REGISTRY);
+
+        auto budgets_path = QString::fromUtf8(qgetenv(BUDGETS_ENV));
+        if (budgets_path.isEmpty())
+            budgets_path = QStringLiteral(PERF_BUDGETS);
+        budgets_ = load_json(budgets_path);
+    }
+
+    void run_profile(Profile const & profile)
+    {
+        XdgUserDirsSandbox tmp_dir;
+
+        // starts the services, including keeper-service
+        start_tasks();
+
+        QSharedPointer<DBusInterfaceKeeperUser> user_iface(new DBusInterfaceKeeperUser(
+                                                                DBusTypes::KEEPER_SERVICE,
+                                                                DBusTypes::KEEPER_USER_PATH,
+                                                                dbus_test_runner.sessionConnection()
+                                                            ) );
+        ASSERT_TRUE(user_iface->isValid()) << qPrintable(dbus_test_runner.sessionConnection().lastError().message());
+
+        auto const user_dir = QString::fromUtf8(qgetenv("XDG_MUSIC_DIR"));
+        ASSERT_FALSE(user_dir.isEmpty());
+        auto options = profile.dataset;
+        options.n_files = std::max(1, int(options.n_files * scale()));
+        auto const budget = scale_budget(budgets_.value(profile.name).toObject(),
+                                         double(options.n_files) / profile.dataset.n_files);
+        ASSERT_TRUE(DatasetGenerator(options).generate(user_dir));
+
+        QDBusReply<keeper::Items> choices = user_iface->call("GetBackupChoices");
+        ASSERT_TRUE(choices.isValid()) << qPrintable(choices.error().message());
+        auto const user_folder_uuid = get_uuid_for_xdg_folder_path(user_dir, choices.value());
+        ASSERT_FALSE(user_folder_uuid.isEmpty());
+
+        // backup
+        auto backup = start_phase(util::METRIC_BACKUP_BYTES);
+        QDBusReply<void> backup_reply = user_iface->call("StartBackup", QStringList{user_folder_uuid}, "");
+        ASSERT_TRUE(backup_reply.isValid()) << qPrintable(backup_reply.error().message());
+        ASSERT_TRUE(wait_for_all_tasks_have_action_state({user_folder_uuid}, "complete", user_iface, timeout(budget, "backup")));
+        end_phase(backup, util::METRIC_BACKUP_BYTES);
+
+        // keep a copy to compare with the restored files
+        QTemporaryDir source_copy;
+        ASSERT_TRUE(FileUtils::copyDirsRecursively(user_dir, source_copy.path()));
+        ASSERT_TRUE(FileUtils::clearDir(user_dir));
+
+        QDBusReply<keeper::Items> restore_choices = user_iface->call("GetRestoreChoices", "");
+        ASSERT_TRUE(restore_choices.isValid()) << qPrintable(restore_choices.error().message());
+        auto const restore_uuid = get_restore_uuid(user_folder_uuid, restore_choices.value());
+        ASSERT_FALSE(restore_uuid.isEmpty());
+
+        // restore
+        auto restore = start_phase(util::METRIC_RESTORE_BYTES);
+        QDBusReply<void> restore_reply = user_iface->call("StartRestore", QStringList{restore_uuid}, "");
+        ASSERT_TRUE(restore_reply.isValid()) << qPrintable(restore_reply.error().message());
+        ASSERT_TRUE(wait_for_all_tasks_have_action_state({restore_uuid}, "complete", user_iface, timeout(budget, "restore")));
+        end_phase(restore, util::METRIC_RESTORE_BYTES);
+
+        EXPECT_TRUE(FileUtils::compareDirectories(source_copy.path(), user_dir));
+
+        save_results(profile.name, backup, restore);
+        check_budget(profile.name, "backup", budget, backup);
+        check_budget(profile.name, "restore", budget, restore);
+    }
+
+private:
+
+    qint64 keeper_pid() const
+    {
+        return keeper_service ? keeper_service->underlyingProcess().pid() : 0;
+    }
+
+    qint64 helpers_pid() const
+    {
+        return upstart_service ? upstart_service->underlyingProcess().pid() : 0;
+    }
+
+    qint64 cpu_msec() const
+    {
+        return process_cpu_msec(keeper_pid()) + process_cpu_msec(helpers_pid());
+    }
+
+    // the bytes keeper-service relayed between the helpers and the storage,
+    // as counted by its metrics. The manifest and the file catalogs are
+    // stored by the service itself, so they are not included
+    qint64 bytes_relayed(char const * metric)
+    {
+        DBusInterfaceKeeperMetrics metrics_iface(DBusTypes::KEEPER_SERVICE,
+                                                 DBusTypes::KEEPER_METRICS_PATH,
+                                                 dbus_test_runner.sessionConnection());
+        QDBusReply<QVariantDictMap> metrics = metrics_iface.call("GetMetrics");
+        EXPECT_TRUE(metrics.isValid()) << qPrintable(metrics.error().message());
+        return qint64(metrics.value().value(QString::fromLatin1(metric)).value(QStringLiteral("value")).toDouble());
+    }
+
+    Measurement start_phase(char const * bytes_metric)
+    {
+        reset_peak_rss(keeper_pid());
+        Measurement ret;
+        ret.cpu_msec = cpu_msec();
+        ret.bytes_relayed = bytes_relayed(bytes_metric);
+        timer_.start();
+        return ret;
+    }
+
+    void end_phase(Measurement & measurement, char const * bytes_metric)
+    {
+        measurement.wall_msec = timer_.elapsed();
+        measurement.cpu_msec = cpu_msec() - measurement.cpu_msec;
+        measurement.peak_rss_kb = process_peak_rss_kb(keeper_pid());
+        measurement.bytes_relayed = bytes_relayed(bytes_metric) - measurement.bytes_relayed;
+    }
+
+    static int timeout(QJsonObject const & budget, char const * phase)
+    {
+        auto const wall = budget.value(QString::fromLatin1(phase)).toObject().value(QString::fromLatin1(WALL_KEY)).toDouble();
+        // leave room to report by how much the budget was exceeded
+        return wall > 0 ? int(wall * 2) : DEFAULT_TIMEOUT_MSEC;
+    }
+
+    static void check_budget(QString const & profile, char const * phase, QJsonObject const & budget, Measurement const & measurement)
+    {
+        auto const limits = budget.value(QString::fromLatin1(phase)).toObject();
+        auto const values = to_json(measurement);
+        for (auto it = limits.begin(); it != limits.end(); ++it)
+        {
+            auto const limit = qint64(it.value().toDouble());
+            auto const value = qint64(values.value(it.key()).toDouble());
+            EXPECT_LE(value, limit) << qPrintable(profile) << " " << phase << " exceeded its " << qPrintable(it.key()) << " budget";
+        }
+    }
+
+    static void save_results(QString const & profile, Measurement const & backup, Measurement const & restore)
+    {
+        qDebug() << profile << "backup:" << to_json(backup) << "restore:" << to_json(restore);
+
+        auto const path = QString::fromUtf8(qgetenv(RESULTS_ENV));
+        if (path.isEmpty())
+            return;
+
+        // every profile runs in its own test, so merge them in the same file
+        auto results = load_json(path);
+        QJsonObject runs;
+        runs[QStringLiteral("backup")] = to_json(backup);
+        runs[QStringLiteral("restore")] = to_json(restore);
+        results[profile] = runs;
+
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            qWarning() << "Error writing the performance results to" << path << ":" << file.errorString();
+            return;
+        }
+        file.write(QJsonDocument(results).toJson());
+    }
+
+    QJsonObject budgets_;
+    QElapsedTimer timer_;
+};
+
+TEST_F(PerfRegression, ManyTinyFiles)
+{
+    run_profile(Profile{QStringLiteral("many-tiny-files"), dataset(20000, 0, 1024, 2, 16)});
+}
+
+TEST_F(PerfRegression, FewHugeFiles)
+{
+    run_profile(Profile{QStringLiteral("few-huge-files"), dataset(3, 192 * 1024 * 1024, 256 * 1024 * 1024, 0, 1)});
+}
+
+TEST_F(PerfRegression, IncompressibleMedia)
+{
+    auto media = dataset(64, 2 * 1024 * 1024, 8 * 1024 * 1024, 1, 4);
+    media.compressibility = 0.0;
+    media.suffix = QStringLiteral(".jpg");
+    run_profile(Profile{QStringLiteral("incompressible-media"), media});
+}
+
+TEST_F(PerfRegression, DeepTree)
+{
+    run_profile(Profile{QStringLiteral("deep-tree"), dataset(2048, 1024, 16 * 1024, 16, 2)});
+}
@@ -21,6 +21,7 @@
 
 #include "test-helpers-base.h"
 #include <service/manifest.h>
+#include <service/restore-choices.h>
 #include <storage-framework/storage_framework_client.h>
 
 class TestHelpers: public TestHelpersBase
@@ -100,9 +101,12 @@ TEST_F(TestHelpers, GetRestoreChoices)
     auto choices = choices_reply.value();
     ASSERT_EQ(all_choices.size(), choices.size());
 
+    // every backup is listed with a uuid derived from its choice uuid
     for (auto i = 0; i < all_choices.size(); ++i)
     {
-        auto iter = choices.find(all_choices[i].get_uuid());
+        auto const restore_uuid = RestoreChoices::restore_uuid(all_choices[i]);
+        EXPECT_NE(all_choices[i].get_uuid(), restore_uuid);
+        auto iter = choices.find(restore_uuid);
         ASSERT_TRUE(iter != choices.end());
 
         auto iter_name = (*iter).find(keeper::Item::DISPLAY_NAME_KEY);
@@ -111,7 +115,7 @@ TEST_F(TestHelpers, GetRestoreChoices)
 
         auto iter_uuid = (*iter).find(keeper::Item::UUID_KEY);
         ASSERT_TRUE(iter_uuid != (*iter).end());
-        EXPECT_EQ(all_choices[i].get_uuid(), (*iter_uuid));
+        EXPECT_EQ(restore_uuid, (*iter_uuid));
 
         auto iter_prop1 = (*iter).find(PROP_1_KEY);
         ASSERT_TRUE(iter_prop1 != (*iter).end());
@@ -21,6 +21,7 @@
 #include "test-helpers-base.h"
 
 #include "service/manifest.h"
+#include "service/restore-choices.h"
 #include "storage-framework/storage_framework_client.h"
 
 #include <sys/types.h>
@@ -736,6 +737,18 @@ QString TestHelpersBase::get_display_name_for_xdg_folder_path(QString const &pat
     return QString();
 }
 
+QString TestHelpersBase::get_restore_uuid(QString const & choice_uuid, keeper::Items const & restore_choices) const
+{
+    for (auto iter = restore_choices.begin(); iter != restore_choices.end(); ++iter)
+    {
+        Metadata backup(choice_uuid, QString());
+        backup.set_property_value(keeper::Item::DIR_NAME_KEY, (*iter).value(keeper::Item::DIR_NAME_KEY));
+        if (RestoreChoices::restore_uuid(backup) == iter.key())
+            return iter.key();
+    }
+    return QString();
+}
+
 bool TestHelpersBase::check_manifest_file(QVector<BackupItem> const & backup_items)
 {
     auto dir_name = StorageFrameworkLocalUtils::get_storage_framework_dir_name();
@@ -808,6 +821,13 @@ bool TestHelpersBase::check_manifest_file(QVector<BackupItem> const & backup_ite
                     qWarning() << "Property " << Metadata::FILE_NAME_KEY << " was not found in the manifest file for item: " << backup_item.uuid;
                     return false;
                 }
+
+                // the size estimates of the choices are not stored
+                if (metadata.has_property(Metadata::SIZE_ESTIMATE_KEY) || metadata.has_property(Metadata::FILE_COUNT_KEY))
+                {
+                    qWarning() << "The size estimate of the choice was stored in the manifest file for item: " << backup_item.uuid;
+                    return false;
+                }
             }
         }
         if (!item_found)
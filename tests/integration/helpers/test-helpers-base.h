@@ -106,6 +106,9 @@ protected:
     QString get_type_for_xdg_folder_path(QString const &path, keeper::Items const & choices) const;
     QString get_display_name_for_xdg_folder_path(QString const &path, keeper::Items const & choices) const;
 
+    // the uuid a backup of the choice is listed with in the restore choices
+    QString get_restore_uuid(QString const & choice_uuid, keeper::Items const & restore_choices) const;
+
     bool check_manifest_file(QVector<BackupItem> const & backup_items);
 
     bool start_dbus_monitor();
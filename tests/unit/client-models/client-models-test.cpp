@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include "backup-choices-model.h"
+#include "task-model.h"
+
+#include <QSignalSpy>
+
+#include <gtest/gtest.h>
+
+#include <algorithm> // std::sort
+
+namespace
+{
+    keeper::Item create_choice(QString const & display_name, QString const & type = keeper::Item::FOLDER_VALUE)
+    {
+        keeper::Item item;
+        item.insert(keeper::Item::DISPLAY_NAME_KEY, display_name);
+        item.insert(keeper::Item::TYPE_KEY, type);
+        return item;
+    }
+
+    keeper::Item create_task(QString const & display_name, QString const & status, double percent_done)
+    {
+        keeper::Item item;
+        item.insert(keeper::Item::DISPLAY_NAME_KEY, display_name);
+        item.insert(keeper::Item::STATUS_KEY, status);
+        item.insert(keeper::Item::PERCENT_DONE_KEY, percent_done);
+        return item;
+    }
+
+    keeper::Items single_change(QString const & uuid, keeper::Item const & item)
+    {
+        keeper::Items ret;
+        ret.insert(uuid, item);
+        return ret;
+    }
+
+    QVector<int> changed_roles(QSignalSpy & spy, int i)
+    {
+        return spy.at(i).at(2).value<QVector<int>>();
+    }
+}
+
+TEST(BackupChoicesModel, UpdatesOnlyWhatChanged)
+{
+    BackupChoicesModel model;
+
+    keeper::Items choices;
+    choices.insert(QStringLiteral("uuid-1"), create_choice(QStringLiteral("Music")));
+    choices.insert(QStringLiteral("uuid-2"), create_choice(QStringLiteral("Videos")));
+    choices.insert(QStringLiteral("uuid-3"), create_choice(QStringLiteral("Some app"), keeper::Item::APPLICATION_VALUE));
+    model.setChoices(choices);
+
+    // only the folders are listed
+    ASSERT_EQ(2, model.rowCount());
+    EXPECT_EQ(QStringLiteral("uuid-1"), model.data(model.index(0), BackupChoicesModel::UuidRole).toString());
+    EXPECT_EQ(QStringLiteral("Videos"), model.data(model.index(1), BackupChoicesModel::DisplayNameRole).toString());
+
+    QSignalSpy spy_reset(&model, &QAbstractItemModel::modelReset);
+    QSignalSpy spy_inserted(&model, &QAbstractItemModel::rowsInserted);
+    QSignalSpy spy_removed(&model, &QAbstractItemModel::rowsRemoved);
+    QSignalSpy spy_changed(&model, &QAbstractItemModel::dataChanged);
+
+    // uuid-1 is estimated, uuid-2 goes away and uuid-4 shows up
+    choices[QStringLiteral("uuid-1")].insert(keeper::Item::SIZE_ESTIMATE_KEY, qint64(1024));
+    choices.remove(QStringLiteral("uuid-2"));
+    choices.insert(QStringLiteral("uuid-4"), create_choice(QStringLiteral("Pictures")));
+    model.setChoices(choices);
+
+    EXPECT_EQ(0, spy_reset.count());
+    ASSERT_EQ(1, spy_removed.count());
+    EXPECT_EQ(1, spy_removed.at(0).at(1).toInt());
+    ASSERT_EQ(1, spy_inserted.count());
+    EXPECT_EQ(1, spy_inserted.at(0).at(1).toInt());
+    ASSERT_EQ(1, spy_changed.count());
+    EXPECT_EQ(0, spy_changed.at(0).at(0).value<QModelIndex>().row());
+    EXPECT_EQ(QVector<int>{BackupChoicesModel::SizeEstimateRole}, changed_roles(spy_changed, 0));
+
+    ASSERT_EQ(2, model.rowCount());
+    EXPECT_EQ(1024, model.data(model.index(0), BackupChoicesModel::SizeEstimateRole).toLongLong());
+    EXPECT_EQ(QStringLiteral("Pictures"), model.data(model.index(1), BackupChoicesModel::DisplayNameRole).toString());
+
+    // the same choices again change nothing
+    spy_changed.clear();
+    model.setChoices(choices);
+    EXPECT_EQ(0, spy_changed.count());
+}
+
+TEST(BackupChoicesModel, Enable)
+{
+    BackupChoicesModel model;
+
+    keeper::Items choices;
+    choices.insert(QStringLiteral("uuid-1"), create_choice(QStringLiteral("Music")));
+    model.setChoices(choices);
+    EXPECT_FALSE(model.data(model.index(0), BackupChoicesModel::EnabledRole).toBool());
+
+    QSignalSpy spy_changed(&model, &QAbstractItemModel::dataChanged);
+    EXPECT_TRUE(model.setData(model.index(0), true, BackupChoicesModel::EnabledRole));
+    EXPECT_TRUE(model.data(model.index(0), BackupChoicesModel::EnabledRole).toBool());
+    ASSERT_EQ(1, spy_changed.count());
+    EXPECT_EQ(QVector<int>{BackupChoicesModel::EnabledRole}, changed_roles(spy_changed, 0));
+
+    // other roles are read only
+    EXPECT_FALSE(model.setData(model.index(0), QStringLiteral("Videos"), BackupChoicesModel::DisplayNameRole));
+}
+
+TEST(TaskModel, ApplyChanges)
+{
+    TaskModel model;
+
+    keeper::Items changed;
+    changed.insert(QStringLiteral("uuid-1"), create_task(QStringLiteral("Music"), QStringLiteral("queued"), 0.0));
+    changed.insert(QStringLiteral("uuid-2"), create_task(QStringLiteral("Videos"), QStringLiteral("queued"), 0.0));
+    model.applyChanges(changed);
+    ASSERT_EQ(2, model.rowCount());
+    EXPECT_EQ(QStringLiteral("queued"), model.data(model.index(1), TaskModel::StatusRole).toString());
+
+    QSignalSpy spy_changed(&model, &QAbstractItemModel::dataChanged);
+
+    // only the progress of uuid-2 changes
+    keeper::Item progress;
+    progress.insert(keeper::Item::PERCENT_DONE_KEY, 0.5);
+    model.applyChanges(single_change(QStringLiteral("uuid-2"), progress));
+    ASSERT_TRUE(spy_changed.wait());
+    ASSERT_EQ(1, spy_changed.count());
+    EXPECT_EQ(1, spy_changed.at(0).at(0).value<QModelIndex>().row());
+    EXPECT_EQ(QVector<int>{TaskModel::PercentDoneRole}, changed_roles(spy_changed, 0));
+    EXPECT_DOUBLE_EQ(0.5, model.data(model.index(1), TaskModel::PercentDoneRole).toDouble());
+    EXPECT_EQ(QStringLiteral("Videos"), model.data(model.index(1), TaskModel::DisplayNameRole).toString());
+
+    // removing a task keeps the rows after it in sync
+    QSignalSpy spy_removed(&model, &QAbstractItemModel::rowsRemoved);
+    model.applyChanges(single_change(QStringLiteral("uuid-1"), keeper::Item()));
+    ASSERT_EQ(1, spy_removed.count());
+    ASSERT_EQ(1, model.rowCount());
+    EXPECT_EQ(QStringLiteral("uuid-2"), model.data(model.index(0), TaskModel::UuidRole).toString());
+
+    spy_changed.clear();
+    progress.insert(keeper::Item::PERCENT_DONE_KEY, 0.75);
+    model.applyChanges(single_change(QStringLiteral("uuid-2"), progress));
+    model.flush();
+    ASSERT_EQ(1, spy_changed.count());
+    EXPECT_EQ(0, spy_changed.at(0).at(0).value<QModelIndex>().row());
+}
+
+TEST(TaskModel, RemovedProperties)
+{
+    TaskModel model;
+
+    auto task = create_task(QStringLiteral("Music"), QStringLiteral("saving"), 0.5);
+    task.insert(keeper::Item::SPEED_KEY, 1000);
+    model.applyChanges(single_change(QStringLiteral("uuid-1"), task));
+    ASSERT_EQ(1, model.rowCount());
+    EXPECT_EQ(1000, model.data(model.index(0), TaskModel::SpeedRole).toInt());
+
+    QSignalSpy spy_changed(&model, &QAbstractItemModel::dataChanged);
+
+    // the speed is unset once the task is done
+    keeper::Item done;
+    done.insert(keeper::Item::STATUS_KEY, QStringLiteral("complete"));
+    done.insert(keeper::Item::REMOVED_PROPERTIES_KEY, QStringList{keeper::Item::SPEED_KEY});
+    model.applyChanges(single_change(QStringLiteral("uuid-1"), done));
+    model.flush();
+    ASSERT_EQ(1, spy_changed.count());
+    auto roles = changed_roles(spy_changed, 0);
+    std::sort(roles.begin(), roles.end());
+    EXPECT_EQ(QVector<int>({TaskModel::StatusRole, TaskModel::SpeedRole}), roles);
+    EXPECT_EQ(0, model.data(model.index(0), TaskModel::SpeedRole).toInt());
+    EXPECT_EQ(QStringLiteral("complete"), model.data(model.index(0), TaskModel::StatusRole).toString());
+}
+
+TEST(TaskModel, CoalescesChanges)
+{
+    constexpr int N_TASKS {500};
+    constexpr int N_UPDATES {20};
+
+    TaskModel model;
+
+    keeper::Items tasks;
+    for (int i = 0; i < N_TASKS; ++i)
+        tasks.insert(QStringLiteral("uuid-%1").arg(i, 4, 10, QLatin1Char('0')), create_task(QStringLiteral("task %1").arg(i), QStringLiteral("saving"), 0.0));
+    model.applyChanges(tasks);
+    ASSERT_EQ(N_TASKS, model.rowCount());
+
+    QSignalSpy spy_changed(&model, &QAbstractItemModel::dataChanged);
+    QSignalSpy spy_reset(&model, &QAbstractItemModel::modelReset);
+
+    // every task reports progress many times before the next frame
+    for (int update = 1; update <= N_UPDATES; ++update)
+    {
+        keeper::Items changed;
+        for (auto iter = tasks.begin(); iter != tasks.end(); ++iter)
+        {
+            keeper::Item progress;
+            progress.insert(keeper::Item::PERCENT_DONE_KEY, double(update) / N_UPDATES);
+            changed.insert(iter.key(), progress);
+        }
+        model.applyChanges(changed);
+    }
+    EXPECT_EQ(0, spy_changed.count());
+
+    // they are delivered once per task
+    ASSERT_TRUE(spy_changed.wait());
+    EXPECT_EQ(N_TASKS, spy_changed.count());
+    EXPECT_EQ(0, spy_reset.count());
+    for (int row = 0; row < N_TASKS; ++row)
+        EXPECT_DOUBLE_EQ(1.0, model.data(model.index(row), TaskModel::PercentDoneRole).toDouble());
+}
@@ -0,0 +1,203 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Xavi Garcia <xavi.garcia.mena@canonical.com>
+ */
+
+#include "tests/utils/dataset-generator.h"
+#include "tests/utils/file-utils.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMap>
+#include <QTemporaryDir>
+
+#include <gtest/gtest.h>
+
+#include <sys/stat.h>
+
+namespace
+{
+    DatasetGenerator::Options small_options()
+    {
+        DatasetGenerator::Options options;
+        options.n_files = 50;
+        options.max_file_size = 16 * 1024;
+        options.depth = 2;
+        options.fan_out = 3;
+        return options;
+    }
+
+    qint64 compressed_size(QString const & dir)
+    {
+        qint64 ret {0};
+        for (auto const & path : FileUtils::getFilesRecursively(dir))
+        {
+            QFile file(path);
+            if (file.open(QIODevice::ReadOnly))
+                ret += qCompress(file.readAll()).size();
+        }
+        return ret;
+    }
+
+    QMap<QString, qint64> file_sizes(QString const & dir)
+    {
+        QMap<QString, qint64> ret;
+        for (auto const & path : FileUtils::getFilesRecursively(dir))
+            ret[QDir(dir).relativeFilePath(path)] = QFileInfo(path).size();
+        return ret;
+    }
+}
+
+TEST(DatasetGenerator, SameSeedSameTree)
+{
+    QTemporaryDir dir_1, dir_2, dir_3;
+
+    DatasetGenerator::Stats stats_1, stats_2;
+    ASSERT_TRUE(DatasetGenerator(small_options()).generate(dir_1.path(), &stats_1));
+    ASSERT_TRUE(DatasetGenerator(small_options()).generate(dir_2.path(), &stats_2));
+    EXPECT_TRUE(FileUtils::compareDirectories(dir_1.path(), dir_2.path()));
+    EXPECT_EQ(stats_1.n_bytes, stats_2.n_bytes);
+    EXPECT_EQ(50, stats_1.n_files);
+    EXPECT_EQ(50, FileUtils::getFilesRecursively(dir_1.path()).size());
+    EXPECT_LE(stats_1.n_dirs, 9);
+
+    auto options = small_options();
+    options.seed += 1;
+    ASSERT_TRUE(DatasetGenerator(options).generate(dir_3.path()));
+    EXPECT_FALSE(FileUtils::compareDirectories(dir_1.path(), dir_3.path()));
+}
+
+TEST(DatasetGenerator, FilesDontDependOnThePreviousOnes)
+{
+    QTemporaryDir dir_1, dir_2;
+
+    // sparse files take fewer values from the engine than full ones
+    auto options = small_options();
+    ASSERT_TRUE(DatasetGenerator(options).generate(dir_1.path()));
+    options.sparse_ratio = 0.5;
+    DatasetGenerator::Stats stats;
+    ASSERT_TRUE(DatasetGenerator(options).generate(dir_2.path(), &stats));
+    EXPECT_LT(0, stats.n_sparse);
+
+    // every file is in the same place with the same size
+    EXPECT_EQ(file_sizes(dir_1.path()), file_sizes(dir_2.path()));
+}
+
+TEST(DatasetGenerator, FileSizes)
+{
+    QTemporaryDir dir;
+
+    auto options = small_options();
+    options.min_file_size = 100;
+    options.max_file_size = 1024 * 1024;
+    options.distribution = DatasetGenerator::SizeDistribution::LOG_UNIFORM;
+    ASSERT_TRUE(DatasetGenerator(options).generate(dir.path()));
+
+    // log-uniform sizes have many more small files than big ones
+    int n_small {0};
+    for (auto const & path : FileUtils::getFilesRecursively(dir.path()))
+    {
+        auto const size = QFileInfo(path).size();
+        EXPECT_LE(100, size);
+        EXPECT_GE(1024 * 1024, size);
+        if (size < 10 * 1024)
+            ++n_small;
+    }
+    EXPECT_LT(options.n_files / 3, n_small);
+}
+
+TEST(DatasetGenerator, Compressibility)
+{
+    QTemporaryDir random_dir, text_dir;
+
+    auto options = small_options();
+    options.min_file_size = options.max_file_size;
+    ASSERT_TRUE(DatasetGenerator(options).generate(random_dir.path()));
+
+    options.compressibility = 0.75;
+    DatasetGenerator::Stats stats;
+    ASSERT_TRUE(DatasetGenerator(options).generate(text_dir.path(), &stats));
+
+    // random data doesn't compress, the rest compresses close to the ratio
+    EXPECT_LE(stats.n_bytes, compressed_size(random_dir.path()));
+    EXPECT_GE(stats.n_bytes * 0.35, compressed_size(text_dir.path()));
+}
+
+TEST(DatasetGenerator, Duplicates)
+{
+    QTemporaryDir dir;
+
+    auto options = small_options();
+    options.duplicate_ratio = 1.0;
+    DatasetGenerator::Stats stats;
+    ASSERT_TRUE(DatasetGenerator(options).generate(dir.path(), &stats));
+
+    // only the first file has its own contents
+    EXPECT_EQ(options.n_files - 1, stats.n_duplicates);
+    auto const files = FileUtils::getFilesRecursively(dir.path());
+    ASSERT_EQ(options.n_files, files.size());
+    for (auto const & path : files)
+        EXPECT_TRUE(FileUtils::compareFiles(files.first(), path));
+}
+
+TEST(DatasetGenerator, SparseFiles)
+{
+    QTemporaryDir dir;
+
+    auto options = small_options();
+    options.n_files = 5;
+    options.min_file_size = options.max_file_size = 16 * 1024 * 1024;
+    options.sparse_ratio = 1.0;
+    DatasetGenerator::Stats stats;
+    ASSERT_TRUE(DatasetGenerator(options).generate(dir.path(), &stats));
+    EXPECT_EQ(options.n_files, stats.n_sparse);
+
+    for (auto const & path : FileUtils::getFilesRecursively(dir.path()))
+    {
+        EXPECT_EQ(options.max_file_size, QFileInfo(path).size());
+
+        // the holes take no space on disk
+        struct stat st;
+        ASSERT_EQ(0, stat(QFile::encodeName(path).constData(), &st));
+        EXPECT_GT(options.max_file_size / 2, qint64(st.st_blocks) * 512);
+    }
+}
+
+TEST(DatasetGenerator, Mutate)
+{
+    QTemporaryDir original, mutated_1, mutated_2;
+
+    auto const options = small_options();
+    ASSERT_TRUE(DatasetGenerator(options).generate(original.path()));
+    ASSERT_TRUE(FileUtils::copyDirsRecursively(original.path(), mutated_1.path()));
+    ASSERT_TRUE(FileUtils::copyDirsRecursively(original.path(), mutated_2.path()));
+
+    DatasetGenerator::MutationStats stats_1, stats_2;
+    ASSERT_TRUE(DatasetGenerator(options).mutate(mutated_1.path(), 0.2, &stats_1));
+    ASSERT_TRUE(DatasetGenerator(options).mutate(mutated_2.path(), 0.2, &stats_2));
+
+    // the same seed edits the same files in the same way
+    EXPECT_TRUE(FileUtils::compareDirectories(mutated_1.path(), mutated_2.path()));
+    EXPECT_FALSE(FileUtils::compareDirectories(original.path(), mutated_1.path()));
+
+    auto const n_edits = stats_1.n_modified + stats_1.n_appended + stats_1.n_truncated
+                       + stats_1.n_removed + stats_1.n_created;
+    EXPECT_EQ(10, n_edits);
+    EXPECT_EQ(options.n_files - stats_1.n_removed + stats_1.n_created,
+              FileUtils::getFilesRecursively(mutated_1.path()).size());
+}
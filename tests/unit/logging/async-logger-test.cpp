@@ -0,0 +1,207 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Xavi Garcia <xavi.garcia.mena@canonical.com>
+ */
+
+#include "util/async-logger.h"
+#include "util/logging.h"
+
+#include <QList>
+#include <QLoggingCategory>
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+namespace
+{
+    // collects what is written to a pipe, from start() until finish()
+    class PipeReader
+    {
+    public:
+        PipeReader()
+        {
+            EXPECT_EQ(0, pipe(fds_));
+        }
+
+        ~PipeReader()
+        {
+            finish();
+        }
+
+        int fd() const
+        {
+            return fds_[1];
+        }
+
+        void start()
+        {
+            if (!thread_.joinable())
+                thread_ = std::thread([this]() {
+                    char buf[4096];
+                    ssize_t n;
+                    while ((n = read(fds_[0], buf, sizeof(buf))) > 0)
+                        data_.append(buf, int(n));
+                });
+        }
+
+        QList<QByteArray> finish()
+        {
+            if (fds_[1] != -1)
+            {
+                close(fds_[1]);
+                fds_[1] = -1;
+            }
+            if (thread_.joinable())
+                thread_.join();
+            if (fds_[0] != -1)
+            {
+                close(fds_[0]);
+                fds_[0] = -1;
+            }
+            auto lines = data_.split('\n');
+            lines.removeAll(QByteArray());
+            return lines;
+        }
+
+    private:
+        int fds_[2] {-1, -1};
+        std::thread thread_;
+        QByteArray data_;
+    };
+
+    // line of the qWarning() below
+    constexpr int WARNING_LINE {__LINE__ + 3};
+    void warn(int thread, int i)
+    {
+        qWarning("thread %d message %d", thread, i);
+    }
+}
+
+TEST(AsyncLogger, KeepsTheOrderOfEveryThread)
+{
+    constexpr int n_threads {4};
+    constexpr int n_messages {1000};
+
+    PipeReader reader;
+    reader.start();
+    {
+        util::AsyncLogger logger(64, reader.fd());
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < n_threads; ++t)
+        {
+            threads.emplace_back([t]() {
+                for (int i = 0; i < n_messages; ++i)
+                    warn(t, i);
+            });
+        }
+        for (auto & thread : threads)
+            thread.join();
+
+        logger.flush();
+        EXPECT_EQ(quint64(0), logger.droppedCount());
+    }
+
+    auto const lines = reader.finish();
+    ASSERT_EQ(n_threads * n_messages, lines.size());
+
+    // same format as util::loggingFunction, with the path relative to the source tree
+    auto const location = QByteArrayLiteral(" (tests/unit/logging/async-logger-test.cpp:")
+                        + QByteArray::number(WARNING_LINE) + ')';
+    int next[n_threads] {};
+    for (auto const & l : lines)
+    {
+        ASSERT_TRUE(l.startsWith("[WARN] thread ")) << l.constData();
+        ASSERT_TRUE(l.endsWith(location)) << l.constData();
+
+        int t, i;
+        ASSERT_EQ(2, sscanf(l.constData(), "[WARN] thread %d message %d", &t, &i));
+        ASSERT_LE(0, t);
+        ASSERT_GT(n_threads, t);
+        EXPECT_EQ(next[t], i);
+        next[t] = i + 1;
+    }
+}
+
+TEST(AsyncLogger, DropsDebugMessagesWhenFull)
+{
+    constexpr int n_messages {200};
+    QMessageLogContext const context(__FILE__, __LINE__, "", "default");
+    auto const msg = QString(4096, QLatin1Char('x'));
+
+    PipeReader reader;
+    quint64 n_dropped {0};
+    {
+        // nobody reads the pipe yet, so the writer thread
+        // gets stuck once the pipe buffer is full
+        util::AsyncLogger logger(16, reader.fd());
+        for (int i = 0; i < n_messages; ++i)
+            logger.log(QtDebugMsg, context, msg);
+        n_dropped = logger.droppedCount();
+        EXPECT_LT(quint64(0), n_dropped);
+
+        // warnings wait for room instead
+        reader.start();
+        logger.log(QtWarningMsg, context, QStringLiteral("not dropped"));
+    }
+
+    auto const lines = reader.finish();
+    int n_debug {0};
+    bool warning_found {false};
+    quint64 n_reported {0};
+    for (auto const & l : lines)
+    {
+        if (l.startsWith("[debug] "))
+            ++n_debug;
+        else if (l.startsWith("[WARN] not dropped"))
+            warning_found = true;
+        else if (l.contains("debug messages dropped"))
+            n_reported += l.split(' ').at(1).toULongLong();
+    }
+    EXPECT_EQ(n_messages, n_debug + int(n_dropped));
+    EXPECT_TRUE(warning_found);
+    EXPECT_EQ(n_dropped, n_reported);
+}
+
+TEST(AsyncLogger, RestoresThePreviousHandler)
+{
+    auto const previous = qInstallMessageHandler(util::loggingFunction);
+    {
+        PipeReader reader;
+        util::AsyncLogger logger(16, reader.fd());
+        EXPECT_EQ(&util::AsyncLogger::messageHandler, qInstallMessageHandler(&util::AsyncLogger::messageHandler));
+    }
+    EXPECT_EQ(&util::loggingFunction, qInstallMessageHandler(previous));
+}
+
+TEST(AsyncLogger, NoisyCategoriesAreOffByDefault)
+{
+    EXPECT_FALSE(util::logFiles().isDebugEnabled());
+    EXPECT_FALSE(util::logState().isDebugEnabled());
+    EXPECT_TRUE(util::logState().isWarningEnabled());
+
+    QLoggingCategory::setFilterRules(QStringLiteral("keeper.*.debug=true"));
+    EXPECT_TRUE(util::logFiles().isDebugEnabled());
+    EXPECT_TRUE(util::logState().isDebugEnabled());
+
+    QLoggingCategory::setFilterRules(QString());
+    EXPECT_FALSE(util::logFiles().isDebugEnabled());
+}
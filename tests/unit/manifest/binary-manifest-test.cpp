@@ -0,0 +1,119 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include <service/binary-manifest.h>
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+    QVector<Metadata> create_entries(int n_entries)
+    {
+        QVector<Metadata> ret;
+        for (auto i = 0; i < n_entries; ++i)
+        {
+            Metadata metadata(QString("%1").arg(i), QString("Display name %1 éè").arg(i));
+            metadata.set_property_value(keeper::Item::TYPE_KEY, keeper::Item::FOLDER_VALUE);
+            metadata.set_property_value(keeper::Item::FILE_NAME_KEY, QString("folder-%1.keeper").arg(i));
+            ret.push_back(metadata);
+        }
+        return ret;
+    }
+}
+
+TEST(BinaryManifest, EncodeAndLoad)
+{
+    auto const entries = create_entries(100);
+    auto const data = BinaryManifest::encode(entries);
+    EXPECT_TRUE(BinaryManifest::is_binary(data));
+
+    BinaryManifest manifest;
+    ASSERT_TRUE(manifest.load(data));
+    EXPECT_FALSE(manifest.is_empty());
+    ASSERT_EQ(entries.size(), manifest.size());
+    EXPECT_EQ(entries, manifest.entries());
+
+    // single properties are decoded on their own
+    EXPECT_EQ(QStringLiteral("folder-42.keeper"), manifest.value(42, keeper::Item::FILE_NAME_KEY));
+    EXPECT_EQ(entries[7].get_display_name(), manifest.value(7, keeper::Item::DISPLAY_NAME_KEY));
+    EXPECT_TRUE(manifest.value(7, QStringLiteral("no-such-key")).isNull());
+    EXPECT_TRUE(manifest.value(100, keeper::Item::FILE_NAME_KEY).isNull());
+    EXPECT_TRUE(manifest.value(-1, keeper::Item::FILE_NAME_KEY).isNull());
+
+    manifest.clear();
+    EXPECT_TRUE(manifest.is_empty());
+    EXPECT_EQ(0, manifest.size());
+}
+
+TEST(BinaryManifest, SmallerThanJson)
+{
+    auto const entries = create_entries(1000);
+
+    QJsonArray json_entries;
+    for (auto const & entry : entries)
+        json_entries.append(QJsonObject::fromVariantMap(entry));
+    QJsonObject json_root;
+    json_root["entries"] = json_entries;
+    auto const json = QJsonDocument(json_root).toJson(QJsonDocument::Compact);
+
+    // the shared keys and values are only stored once
+    EXPECT_LT(BinaryManifest::encode(entries).size(), json.size());
+}
+
+TEST(BinaryManifest, EmptyManifest)
+{
+    BinaryManifest manifest;
+    ASSERT_TRUE(manifest.load(BinaryManifest::encode(QVector<Metadata>())));
+    EXPECT_EQ(0, manifest.size());
+    EXPECT_TRUE(manifest.entries().isEmpty());
+}
+
+TEST(BinaryManifest, RejectInvalidData)
+{
+    BinaryManifest manifest;
+    auto const data = BinaryManifest::encode(create_entries(10));
+
+    // JSON is not binary
+    EXPECT_FALSE(BinaryManifest::is_binary(QByteArray("{\"entries\":[]}")));
+    EXPECT_FALSE(manifest.load(QByteArray("{\"entries\":[]}")));
+
+    // truncated
+    EXPECT_FALSE(manifest.load(data.left(10)));
+    EXPECT_FALSE(manifest.load(data.left(data.size() - 1)));
+    EXPECT_TRUE(manifest.is_empty());
+
+    // newer version
+    auto newer = data;
+    newer[4] = char(BinaryManifest::VERSION + 1);
+    EXPECT_FALSE(manifest.load(newer));
+
+    // string table pointing out of the data
+    auto corrupt = data;
+    corrupt[20 + 4] = char(0xff);
+    corrupt[20 + 5] = char(0xff);
+    EXPECT_FALSE(manifest.load(corrupt));
+    EXPECT_TRUE(manifest.is_empty());
+
+    // the valid data still loads
+    EXPECT_TRUE(manifest.load(data));
+}
@@ -24,6 +24,7 @@
 #include "tests/utils/storage-framework-local.h"
 #include "tests/utils/xdg-user-dirs-sandbox.h"
 
+#include <QFile>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
@@ -78,6 +79,7 @@ TEST(ManifestClass, StoreTest)
 
     QSharedPointer<StorageFrameworkClient> sf_client(new StorageFrameworkClient, [](StorageFrameworkClient* sf){sf->deleteLater();});
     Manifest manifest(sf_client, test_dir);
+    manifest.set_format(Manifest::Format::JSON);
 
     auto objects_to_test = 10;
 
@@ -143,7 +145,8 @@ TEST(ManifestClass, StoreTest)
     }
 
     //
-    // now read the manifest with storage-framework
+    // now read the manifest with storage-framework.
+    // There's no binary manifest, so the JSON one is read
     //
     Manifest manifest_read(sf_client, test_dir);
     QSignalSpy spy_read(&manifest_read, &Manifest::finished);
@@ -168,3 +171,185 @@ TEST(ManifestClass, StoreTest)
 
     g_unsetenv("XDG_DATA_HOME");
 }
+
+TEST(ManifestClass, StoreAndReadBinary)
+{
+    QTemporaryDir tmp_dir;
+    QString test_dir = QStringLiteral("test_dir");
+
+    g_setenv("XDG_DATA_HOME", tmp_dir.path().toLatin1().data(), true);
+
+    QSharedPointer<StorageFrameworkClient> sf_client(new StorageFrameworkClient, [](StorageFrameworkClient* sf){sf->deleteLater();});
+    Manifest manifest(sf_client, test_dir);
+    EXPECT_EQ(Manifest::Format::BINARY, manifest.format());
+
+    QVector<Metadata> original_metadata;
+    for (auto i = 0; i < 10; ++i)
+    {
+        Metadata metadata(QString("%1").arg(i), QString("This is the display name for %1").arg(i));
+        metadata.set_property_value(QString("%1-prop").arg(i), QString("%1-prop-value").arg(i));
+        original_metadata.push_back(metadata);
+        manifest.add_entry(metadata);
+    }
+
+    QSignalSpy spy(&manifest, &Manifest::finished);
+    manifest.store();
+    ASSERT_TRUE(spy.wait());
+    EXPECT_TRUE(spy.takeFirst().at(0).toBool()) << qPrintable(manifest.error());
+
+    // the JSON manifest is stored too, for the versions that can't read the binary one
+    auto sf_files = StorageFrameworkLocalUtils::get_storage_framework_files();
+    ASSERT_EQ(2, sf_files.size());
+    QStringList file_names;
+    for (auto const & sf_file : sf_files)
+        file_names << sf_file.fileName();
+    file_names.sort();
+    EXPECT_EQ(QStringList({QStringLiteral("manifest.bin"), QStringLiteral("manifest.json")}), file_names);
+
+    Manifest manifest_read(sf_client, test_dir);
+    QSignalSpy spy_read(&manifest_read, &Manifest::finished);
+    manifest_read.read();
+    ASSERT_TRUE(spy_read.wait());
+    EXPECT_TRUE(spy_read.takeFirst().at(0).toBool()) << qPrintable(manifest_read.error());
+
+    // single entries are read without decoding the others
+    ASSERT_EQ(original_metadata.size(), manifest_read.size());
+    EXPECT_EQ(original_metadata.at(3), manifest_read.entry(3));
+    EXPECT_EQ(original_metadata, manifest_read.get_entries());
+
+    // entries added after reading go after the ones read
+    Metadata metadata("10", "This is the display name for 10");
+    manifest_read.add_entry(metadata);
+    original_metadata.push_back(metadata);
+    EXPECT_EQ(original_metadata, manifest_read.get_entries());
+
+    // without the binary manifest, the JSON one is read
+    for (auto const & sf_file : sf_files)
+    {
+        if (sf_file.fileName() == QStringLiteral("manifest.bin"))
+            ASSERT_TRUE(QFile::remove(sf_file.absoluteFilePath()));
+    }
+    original_metadata.removeLast();
+    Manifest manifest_json(sf_client, test_dir);
+    QSignalSpy spy_json(&manifest_json, &Manifest::finished);
+    manifest_json.read();
+    ASSERT_TRUE(spy_json.wait());
+    EXPECT_TRUE(spy_json.takeFirst().at(0).toBool()) << qPrintable(manifest_json.error());
+    EXPECT_EQ(original_metadata, manifest_json.get_entries());
+
+    g_unsetenv("XDG_DATA_HOME");
+}
+
+TEST(ManifestClass, ReadLargeManifestsInParallel)
+{
+    QTemporaryDir tmp_dir;
+
+    g_setenv("XDG_DATA_HOME", tmp_dir.path().toLatin1().data(), true);
+
+    QSharedPointer<StorageFrameworkClient> sf_client(new StorageFrameworkClient, [](StorageFrameworkClient* sf){sf->deleteLater();});
+
+    // manifests much bigger than a socket buffer
+    auto const objects_to_test = 5000;
+    QStringList const test_dirs{QStringLiteral("test_dir_1"), QStringLiteral("test_dir_2"), QStringLiteral("test_dir_3")};
+    QVector<Metadata> original_metadata;
+    for (auto i = 0; i < objects_to_test; ++i)
+    {
+        Metadata metadata(QString("%1").arg(i), QString("This is the display name for %1").arg(i));
+        metadata.set_property_value(QString("%1-prop").arg(i), QString("%1-prop-value").arg(i));
+        original_metadata.push_back(metadata);
+    }
+    for (auto const & test_dir : test_dirs)
+    {
+        Manifest manifest(sf_client, test_dir);
+        for (auto const & metadata : original_metadata)
+            manifest.add_entry(metadata);
+
+        QSignalSpy spy(&manifest, &Manifest::finished);
+        manifest.store();
+        ASSERT_TRUE(spy.wait());
+        ASSERT_TRUE(spy.takeFirst().at(0).toBool());
+    }
+
+    // all of them are read at once
+    QVector<QSharedPointer<Manifest>> manifests;
+    QVector<QSharedPointer<QSignalSpy>> spies;
+    for (auto const & test_dir : test_dirs)
+    {
+        QSharedPointer<Manifest> manifest(new Manifest(sf_client, test_dir));
+        spies.push_back(QSharedPointer<QSignalSpy>(new QSignalSpy(manifest.data(), &Manifest::finished)));
+        manifests.push_back(manifest);
+        manifest->read();
+    }
+
+    for (auto i = 0; i < manifests.size(); ++i)
+    {
+        if (spies[i]->isEmpty())
+            ASSERT_TRUE(spies[i]->wait(15000));
+        ASSERT_EQ(1, spies[i]->count());
+        EXPECT_TRUE(spies[i]->takeFirst().at(0).toBool()) << qPrintable(manifests[i]->error());
+        EXPECT_EQ(original_metadata, manifests[i]->get_entries());
+    }
+
+    g_unsetenv("XDG_DATA_HOME");
+}
+
+TEST(ManifestClass, StoreAndReadFileCatalog)
+{
+    QTemporaryDir tmp_dir;
+    QString test_dir = QStringLiteral("test_dir");
+
+    g_setenv("XDG_DATA_HOME", tmp_dir.path().toLatin1().data(), true);
+
+    QSharedPointer<StorageFrameworkClient> sf_client(new StorageFrameworkClient, [](StorageFrameworkClient* sf){sf->deleteLater();});
+
+    FileCatalog catalog;
+    for (auto i = 0; i < 100; ++i)
+    {
+        FileCatalog::Entry entry;
+        entry.path = QStringLiteral("Music/album %1/track.ogg").arg(i);
+        entry.size = i * 1000;
+        entry.mtime = 1470000000 + i;
+        entry.hash = QByteArray(32, char(i));
+        catalog.add(entry);
+    }
+
+    // the catalog is kept in a local file until it is stored
+    QTemporaryDir catalog_dir;
+    auto const catalog_path = catalog_dir.filePath(QStringLiteral("1234.catalog"));
+    QFile catalog_file(catalog_path);
+    ASSERT_TRUE(catalog_file.open(QIODevice::WriteOnly));
+    catalog_file.write(catalog.to_data());
+    catalog_file.close();
+
+    // the catalog is stored next to the manifest, and its entry points to it
+    Manifest manifest(sf_client, test_dir);
+    Metadata metadata("1234", "Music");
+    metadata.set_property_value(keeper::Item::FILE_NAME_KEY, "Music.keeper");
+    manifest.add_entry(metadata);
+    manifest.add_file_catalog("1234", catalog_path);
+    QSignalSpy spy(&manifest, &Manifest::finished);
+    manifest.store();
+    ASSERT_TRUE(spy.wait());
+    EXPECT_TRUE(spy.takeFirst().at(0).toBool()) << qPrintable(manifest.error());
+    EXPECT_EQ(3, StorageFrameworkLocalUtils::get_storage_framework_files().size());
+
+    Manifest manifest_read(sf_client, test_dir);
+    QSignalSpy spy_read(&manifest_read, &Manifest::finished);
+    manifest_read.read();
+    ASSERT_TRUE(spy_read.wait());
+    EXPECT_TRUE(spy_read.takeFirst().at(0).toBool()) << qPrintable(manifest_read.error());
+    auto const entries = manifest_read.get_entries();
+    ASSERT_EQ(1, entries.size());
+    auto const catalog_file_name = entries.at(0).get_catalog_file_name();
+    EXPECT_EQ(QStringLiteral("Music.keeper.catalog"), catalog_file_name);
+
+    manifest_read.read_file_catalog(catalog_file_name);
+    ASSERT_TRUE(spy_read.wait());
+    EXPECT_TRUE(spy_read.takeFirst().at(0).toBool()) << qPrintable(manifest_read.error());
+    auto const read_catalog = manifest_read.get_file_catalog();
+    EXPECT_EQ(100, read_catalog.entries().size());
+    EXPECT_EQ(11, read_catalog.find("album 1").size());
+    EXPECT_EQ(catalog.entries().at(42).hash, read_catalog.find("album 42/").at(0).hash);
+
+    g_unsetenv("XDG_DATA_HOME");
+}
@@ -24,6 +24,8 @@
 #include <gtest/gtest.h>
 
 #include <QDebug>
+#include <QDir>
+#include <QFile>
 #include <QString>
 #include <QSignalSpy>
 
@@ -112,3 +114,75 @@ TEST_F(UserDirsProviderTest, UserDirs)
     }
     EXPECT_EQ(expected_user_dir_display_names, user_dir_display_names);
 }
+
+TEST_F(UserDirsProviderTest, StableUuids)
+{
+    auto const list_choices = [](BackupChoices & choices){
+        QSignalSpy spy(&choices, &MetadataProvider::finished);
+        choices.get_backups_async();
+        if (!spy.count())
+            spy.wait();
+        std::set<QString> uuids;
+        for (auto const & choice : choices.get_backups())
+            uuids.insert(choice.get_uuid());
+        return uuids;
+    };
+
+    BackupChoices choices;
+    auto const uuids = list_choices(choices);
+    EXPECT_FALSE(uuids.empty());
+
+    // the same choices get the same uuids, even from another provider
+    EXPECT_EQ(uuids, list_choices(choices));
+    BackupChoices other_choices;
+    EXPECT_EQ(uuids, list_choices(other_choices));
+
+    EXPECT_EQ(BackupChoices::choice_uuid(keeper::Item::FOLDER_VALUE, "/home/user/Music"),
+              BackupChoices::choice_uuid(keeper::Item::FOLDER_VALUE, "/home/user/Music"));
+    EXPECT_NE(BackupChoices::choice_uuid(keeper::Item::FOLDER_VALUE, "/home/user/Music"),
+              BackupChoices::choice_uuid(keeper::Item::FOLDER_VALUE, "/home/user/Videos"));
+    EXPECT_NE(BackupChoices::choice_uuid(keeper::Item::APPLICATION_VALUE, "", "com.example.app"),
+              BackupChoices::choice_uuid(keeper::Item::APPLICATION_VALUE, "", "com.example.other"));
+}
+
+TEST_F(UserDirsProviderTest, UserDirsChanged)
+{
+    BackupChoices choices;
+    QSignalSpy spy(&choices, &MetadataProvider::finished);
+    choices.get_backups_async();
+    if (!spy.count())
+        ASSERT_TRUE(spy.wait());
+
+    auto const find_music = [&choices](){
+        for (auto const & choice : choices.get_backups())
+        {
+            if (choice.get_display_name() == QStringLiteral("Music"))
+                return choice;
+        }
+        return Metadata();
+    };
+    auto const music = find_music();
+    ASSERT_FALSE(music.get_uuid().isEmpty());
+
+    // move the music dir
+    QSignalSpy spy_changed(&choices, &MetadataProvider::choices_changed);
+    auto const config_dir = QDir(QString::fromUtf8(qgetenv("XDG_CONFIG_HOME")));
+    QDir(config_dir.absoluteFilePath(QStringLiteral(".."))).mkdir(QStringLiteral("Music2"));
+    QFile dirs_file(config_dir.absoluteFilePath(QStringLiteral("user-dirs.dirs")));
+    ASSERT_TRUE(dirs_file.open(QIODevice::Text | QIODevice::ReadOnly));
+    auto contents = QString::fromUtf8(dirs_file.readAll());
+    dirs_file.close();
+    contents.replace(QStringLiteral("/Music\""), QStringLiteral("/Music2\""));
+    ASSERT_TRUE(dirs_file.open(QIODevice::Text | QIODevice::WriteOnly | QIODevice::Truncate));
+    dirs_file.write(contents.toUtf8());
+    dirs_file.close();
+    ASSERT_TRUE(spy_changed.wait());
+
+    spy.clear();
+    choices.get_backups_async();
+    if (!spy.count())
+        ASSERT_TRUE(spy.wait());
+    auto const moved_music = find_music();
+    EXPECT_TRUE(moved_music.get_property_value(keeper::Item::SUBTYPE_KEY).toString().endsWith(QStringLiteral("/Music2")));
+    EXPECT_NE(music.get_uuid(), moved_music.get_uuid());
+}
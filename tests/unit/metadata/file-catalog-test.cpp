@@ -0,0 +1,102 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include <helper/file-catalog.h>
+
+#include <QCryptographicHash>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+    FileCatalog::Entry make_entry(QString const & path, qint64 size, qint64 offset = -1)
+    {
+        FileCatalog::Entry entry;
+        entry.path = path;
+        entry.size = size;
+        entry.mtime = 1470000000 + size;
+        entry.hash = QCryptographicHash::hash(path.toUtf8(), QCryptographicHash::Sha256);
+        entry.offset = offset;
+        return entry;
+    }
+
+    FileCatalog make_catalog()
+    {
+        FileCatalog catalog;
+        catalog.add(make_entry("Pictures/holidays/beach.jpg", 1024, 0));
+        catalog.add(make_entry("Pictures/holidays/mountain.JPG", 2048, 2048));
+        catalog.add(make_entry("Documents/notes.txt", 12));
+        return catalog;
+    }
+}
+
+TEST(FileCatalogClass, ToAndFromData)
+{
+    auto const catalog = make_catalog();
+
+    bool ok {false};
+    auto const read = FileCatalog::from_data(catalog.to_data(), &ok);
+    EXPECT_TRUE(ok);
+
+    auto const entries = catalog.entries();
+    auto const read_entries = read.entries();
+    ASSERT_EQ(entries.size(), read_entries.size());
+    for (int i = 0; i < entries.size(); ++i)
+    {
+        EXPECT_EQ(entries[i].path, read_entries[i].path);
+        EXPECT_EQ(entries[i].size, read_entries[i].size);
+        EXPECT_EQ(entries[i].mtime, read_entries[i].mtime);
+        EXPECT_EQ(entries[i].hash, read_entries[i].hash);
+        EXPECT_EQ(entries[i].offset, read_entries[i].offset);
+    }
+
+    // an empty catalog is valid too
+    FileCatalog::from_data(FileCatalog().to_data(), &ok);
+    EXPECT_TRUE(ok);
+}
+
+TEST(FileCatalogClass, Find)
+{
+    auto const catalog = make_catalog();
+
+    EXPECT_EQ(3, catalog.find(QString()).size());
+    EXPECT_EQ(2, catalog.find("holidays").size());
+    EXPECT_EQ(1, catalog.find("NOTES").size());
+    EXPECT_EQ(0, catalog.find("music").size());
+
+    // wildcards match the whole path or the file name
+    EXPECT_EQ(2, catalog.find("*.jpg").size());
+    EXPECT_EQ(1, catalog.find("Documents/*").size());
+    EXPECT_EQ(1, catalog.find("beach.???").size());
+    EXPECT_EQ(0, catalog.find("holidays*").size());
+}
+
+TEST(FileCatalogClass, InvalidData)
+{
+    bool ok {true};
+    auto read = FileCatalog::from_data(QByteArray("this is not a catalog"), &ok);
+    EXPECT_FALSE(ok);
+    EXPECT_TRUE(read.is_empty());
+
+    // a truncated catalog is not valid
+    auto const data = qUncompress(make_catalog().to_data());
+    read = FileCatalog::from_data(qCompress(data.left(data.size() - 10)), &ok);
+    EXPECT_FALSE(ok);
+    EXPECT_TRUE(read.is_empty());
+}
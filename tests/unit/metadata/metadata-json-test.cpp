@@ -98,3 +98,21 @@ TEST(MetadataClass, TestJsonMultipleObjects)
         EXPECT_EQ(read_metadata[i], original_metadata[i]);
     }
 }
+
+TEST(MetadataClass, PartFileNamesSurviveTheJson)
+{
+    QStringList const part_file_names {"backup.tar.part0000", "odd/name.part0001", "name, with \"quotes\".part0002"};
+
+    Metadata metadata("1234", "this is the display name");
+    metadata.set_part_file_names(part_file_names);
+    EXPECT_EQ(part_file_names, metadata.get_part_file_names());
+
+    auto str_json = QJsonDocument(metadata.json()).toJson(QJsonDocument::Compact);
+    Metadata metadata_read(QJsonDocument::fromJson(str_json).object());
+    EXPECT_EQ(part_file_names, metadata_read.get_part_file_names());
+
+    // no parts stored
+    bool valid {};
+    EXPECT_TRUE(Metadata("1234", "no parts").get_part_file_names(&valid).isEmpty());
+    EXPECT_FALSE(valid);
+}
@@ -0,0 +1,162 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Xavi Garcia <xavi.garcia.mena@canonical.com>
+ */
+
+#include "util/metrics.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QThread>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+    class MetricsTest : public ::testing::Test
+    {
+    protected:
+        void SetUp() override
+        {
+            util::Metrics::reset();
+        }
+
+        void TearDown() override
+        {
+            util::Metrics::reset();
+        }
+    };
+}
+
+TEST_F(MetricsTest, Counters)
+{
+    util::Metrics::add(util::METRIC_BACKUP_BYTES, 100);
+    util::Metrics::add(util::METRIC_BACKUP_BYTES, 50);
+    util::Metrics::add(util::METRIC_TASK_FAILURES, 1, {{QStringLiteral("error"), QStringLiteral("helper_read")}});
+
+    // unknown metrics are ignored
+    util::Metrics::add("keeper_unknown_total", 1);
+
+    auto const metrics = util::Metrics::snapshot();
+    ASSERT_EQ(2, metrics.size());
+
+    auto const bytes = metrics.value(QStringLiteral("keeper_backup_bytes_total"));
+    EXPECT_EQ(QStringLiteral("counter"), bytes[QStringLiteral("type")].toString());
+    EXPECT_EQ(150.0, bytes[QStringLiteral("value")].toDouble());
+
+    auto const failures = metrics.value(QStringLiteral("keeper_task_failures_total{error=\"helper_read\"}"));
+    EXPECT_EQ(1.0, failures[QStringLiteral("value")].toDouble());
+}
+
+TEST_F(MetricsTest, PeaksKeepTheHighestValue)
+{
+    util::Metrics::Labels const labels {{QStringLiteral("mode"), QStringLiteral("backup")}};
+    util::Metrics::set_max(util::METRIC_RELAY_BUFFER_PEAK, 100, labels);
+    util::Metrics::set_max(util::METRIC_RELAY_BUFFER_PEAK, 300, labels);
+    util::Metrics::set_max(util::METRIC_RELAY_BUFFER_PEAK, 200, labels);
+
+    auto const peak = util::Metrics::snapshot().value(QStringLiteral("keeper_relay_buffer_peak_bytes{mode=\"backup\"}"));
+    EXPECT_EQ(QStringLiteral("gauge"), peak[QStringLiteral("type")].toString());
+    EXPECT_EQ(300.0, peak[QStringLiteral("value")].toDouble());
+}
+
+TEST_F(MetricsTest, HistogramBucketsAreCumulative)
+{
+    util::Metrics::Labels const labels {{QStringLiteral("call"), QStringLiteral("roots")}};
+    util::Metrics::observe(util::METRIC_STORAGE_ROUND_TRIP, 0.005, labels);
+    util::Metrics::observe(util::METRIC_STORAGE_ROUND_TRIP, 0.2, labels);
+    util::Metrics::observe(util::METRIC_STORAGE_ROUND_TRIP, 60, labels);
+
+    auto const round_trip = util::Metrics::snapshot().value(QStringLiteral("keeper_storage_round_trip_seconds{call=\"roots\"}"));
+    EXPECT_EQ(QStringLiteral("histogram"), round_trip[QStringLiteral("type")].toString());
+    EXPECT_EQ(3u, round_trip[QStringLiteral("count")].toULongLong());
+    EXPECT_DOUBLE_EQ(60.205, round_trip[QStringLiteral("sum")].toDouble());
+
+    auto const buckets = round_trip[QStringLiteral("buckets")].toList();
+    auto const counts = round_trip[QStringLiteral("bucket-counts")].toList();
+    ASSERT_EQ(buckets.size(), counts.size());
+    for (int i = 0; i < buckets.size(); ++i)
+    {
+        auto const bound = buckets[i].toDouble();
+        auto const expected = (bound >= 0.005 ? 1u : 0u) + (bound >= 0.2 ? 1u : 0u);
+        EXPECT_EQ(expected, counts[i].toULongLong()) << "le=" << bound;
+    }
+}
+
+TEST_F(MetricsTest, PrometheusText)
+{
+    util::Metrics::add(util::METRIC_RESTORE_BYTES, 4096);
+    util::Metrics::observe(util::METRIC_TASK_DURATION, 10, {
+        {QStringLiteral("mode"), QStringLiteral("backup")},
+        {QStringLiteral("result"), QStringLiteral("complete")}
+    });
+    util::Metrics::add(util::METRIC_TASK_FAILURES, 1, {{QStringLiteral("error"), QStringLiteral("a \"quoted\\ error")}});
+
+    auto const text = util::Metrics::to_prometheus();
+    auto const lines = text.split(QLatin1Char('\n'), QString::SkipEmptyParts);
+
+    // every metric is described, even the ones without samples
+    EXPECT_TRUE(lines.contains(QStringLiteral("# TYPE keeper_restore_bytes_total counter")));
+    EXPECT_TRUE(lines.contains(QStringLiteral("# TYPE keeper_task_duration_seconds histogram")));
+    EXPECT_TRUE(lines.contains(QStringLiteral("# TYPE keeper_helper_launch_seconds histogram")));
+    EXPECT_TRUE(lines.contains(QStringLiteral("# TYPE keeper_relay_buffer_peak_bytes gauge")));
+
+    EXPECT_TRUE(lines.contains(QStringLiteral("keeper_restore_bytes_total 4096")));
+    EXPECT_TRUE(lines.contains(QStringLiteral("keeper_task_duration_seconds_bucket{mode=\"backup\",result=\"complete\",le=\"5\"} 0")));
+    EXPECT_TRUE(lines.contains(QStringLiteral("keeper_task_duration_seconds_bucket{mode=\"backup\",result=\"complete\",le=\"15\"} 1")));
+    EXPECT_TRUE(lines.contains(QStringLiteral("keeper_task_duration_seconds_bucket{mode=\"backup\",result=\"complete\",le=\"+Inf\"} 1")));
+    EXPECT_TRUE(lines.contains(QStringLiteral("keeper_task_duration_seconds_sum{mode=\"backup\",result=\"complete\"} 10")));
+    EXPECT_TRUE(lines.contains(QStringLiteral("keeper_task_duration_seconds_count{mode=\"backup\",result=\"complete\"} 1")));
+    EXPECT_TRUE(lines.contains(QStringLiteral("keeper_task_failures_total{error=\"a \\\"quoted\\\\ error\"} 1"))) << qPrintable(text);
+
+    for (auto const & line : lines)
+        EXPECT_TRUE(line.startsWith(QStringLiteral("# ")) || line.startsWith(QStringLiteral("keeper_"))) << qPrintable(line);
+}
+
+TEST_F(MetricsTest, WritePrometheusFile)
+{
+    QTemporaryDir dir;
+    auto const path = dir.path() + QStringLiteral("/node-exporter/keeper.prom");
+
+    util::Metrics::add(util::METRIC_BACKUP_BYTES, 1);
+    ASSERT_TRUE(util::Metrics::write_prometheus(path));
+
+    QFile file(path);
+    ASSERT_TRUE(file.open(QIODevice::ReadOnly));
+    EXPECT_EQ(util::Metrics::to_prometheus(), QString::fromUtf8(file.readAll()));
+}
+
+TEST_F(MetricsTest, RelayBacklog)
+{
+    {
+        util::RelayMetrics relay(QStringLiteral("restore"));
+        relay.update(1024, 4096);
+        relay.update(4096, 4096);
+        QThread::msleep(20);
+        relay.update(0, 4096);
+
+        // still backlogged when the relay goes away
+        relay.update(8192, 4096);
+        QThread::msleep(20);
+    }
+
+    auto const metrics = util::Metrics::snapshot();
+    auto const backlog = metrics.value(QStringLiteral("keeper_relay_backlog_seconds_total{mode=\"restore\"}"));
+    EXPECT_LE(0.04, backlog[QStringLiteral("value")].toDouble());
+    auto const peak = metrics.value(QStringLiteral("keeper_relay_buffer_peak_bytes{mode=\"restore\"}"));
+    EXPECT_EQ(8192.0, peak[QStringLiteral("value")].toDouble());
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include <service/restore-catalog.h>
+
+#include <QFile>
+#include <QTemporaryDir>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+    QVector<Metadata> create_entries(QString const & dir_name, int n_entries)
+    {
+        QVector<Metadata> ret;
+        for (auto i = 0; i < n_entries; ++i)
+        {
+            Metadata metadata(QString("%1-uuid-%2").arg(dir_name).arg(i), QString("Display name %1").arg(i));
+            metadata.set_property_value(keeper::Item::DIR_NAME_KEY, dir_name);
+            ret.push_back(metadata);
+        }
+        return ret;
+    }
+}
+
+TEST(RestoreCatalogClass, NoCatalog)
+{
+    QTemporaryDir tmp_dir;
+
+    RestoreCatalog catalog(tmp_dir.path() + "/keeper/restore-catalog.json");
+    EXPECT_FALSE(catalog.load());
+    EXPECT_FALSE(catalog.contains(QString(), QStringLiteral("dir")));
+    EXPECT_TRUE(catalog.dir_names(QString()).isEmpty());
+}
+
+TEST(RestoreCatalogClass, SaveAndLoad)
+{
+    QTemporaryDir tmp_dir;
+    auto const path = tmp_dir.path() + "/keeper/restore-catalog.json";
+    auto const first_storage = QStringLiteral("first-account");
+    auto const second_storage = QStringLiteral("second-account");
+
+    RestoreCatalog catalog(path);
+    catalog.set_entries(first_storage, QStringLiteral("dir-1"), create_entries(QStringLiteral("dir-1"), 2));
+    catalog.set_entries(first_storage, QStringLiteral("dir-2"), create_entries(QStringLiteral("dir-2"), 3));
+    catalog.set_entries(second_storage, QStringLiteral("dir-1"), create_entries(QStringLiteral("other"), 1));
+    ASSERT_TRUE(catalog.save());
+
+    // the backups are kept apart by storage account
+    RestoreCatalog reloaded(path);
+    ASSERT_TRUE(reloaded.load());
+    EXPECT_EQ((QStringList{QStringLiteral("dir-1"), QStringLiteral("dir-2")}), reloaded.dir_names(first_storage));
+    EXPECT_EQ(QStringList{QStringLiteral("dir-1")}, reloaded.dir_names(second_storage));
+    EXPECT_EQ(create_entries(QStringLiteral("dir-1"), 2), reloaded.entries(first_storage, QStringLiteral("dir-1")));
+    EXPECT_EQ(create_entries(QStringLiteral("dir-2"), 3), reloaded.entries(first_storage, QStringLiteral("dir-2")));
+    EXPECT_EQ(create_entries(QStringLiteral("other"), 1), reloaded.entries(second_storage, QStringLiteral("dir-1")));
+    EXPECT_FALSE(reloaded.contains(second_storage, QStringLiteral("dir-2")));
+}
+
+TEST(RestoreCatalogClass, RetainRemoteDirs)
+{
+    QTemporaryDir tmp_dir;
+    auto const storage = QStringLiteral("account");
+    auto const other_storage = QStringLiteral("other-account");
+
+    RestoreCatalog catalog(tmp_dir.path() + "/keeper/restore-catalog.json");
+    for (auto const & dir_name : {QStringLiteral("dir-1"), QStringLiteral("dir-2"), QStringLiteral("dir-3")})
+    {
+        catalog.set_entries(storage, dir_name, create_entries(dir_name, 1));
+        catalog.set_entries(other_storage, dir_name, create_entries(dir_name, 1));
+    }
+
+    // the directories deleted from the storage are forgotten
+    catalog.retain(storage, QVector<QString>{QStringLiteral("dir-2"), QStringLiteral("dir-4")});
+    EXPECT_EQ(QStringList{QStringLiteral("dir-2")}, catalog.dir_names(storage));
+    EXPECT_EQ(3, catalog.dir_names(other_storage).size());
+}
+
+TEST(RestoreCatalogClass, ClearCatalog)
+{
+    QTemporaryDir tmp_dir;
+    auto const path = tmp_dir.path() + "/keeper/restore-catalog.json";
+
+    RestoreCatalog catalog(path);
+    catalog.set_entries(QString(), QStringLiteral("dir"), create_entries(QStringLiteral("dir"), 1));
+    ASSERT_TRUE(catalog.save());
+    EXPECT_TRUE(QFile::exists(path));
+
+    catalog.clear();
+    EXPECT_FALSE(QFile::exists(path));
+    EXPECT_FALSE(catalog.contains(QString(), QStringLiteral("dir")));
+}
+
+TEST(RestoreCatalogClass, CorruptCatalog)
+{
+    QTemporaryDir tmp_dir;
+    auto const path = tmp_dir.path() + "/restore-catalog.json";
+
+    QFile file(path);
+    ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+    file.write("{\"storages\": {");
+    file.close();
+
+    RestoreCatalog catalog(path);
+    EXPECT_FALSE(catalog.load());
+    EXPECT_TRUE(catalog.dir_names(QString()).isEmpty());
+}
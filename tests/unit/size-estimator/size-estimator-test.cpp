@@ -0,0 +1,158 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include <service/size-estimator.h>
+
+#include <QDir>
+#include <QFile>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+
+#include <gtest/gtest.h>
+#include <glib.h>
+
+namespace
+{
+    bool create_file(QString const & path, int n_bytes)
+    {
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly))
+            return false;
+        file.write(QByteArray(n_bytes, 'x'));
+        return true;
+    }
+
+    // a.txt, sub/b.txt, sub/deep/c.txt and a link to sub
+    bool create_tree(QString const & root)
+    {
+        QDir dir(root);
+        return dir.mkpath(QStringLiteral("sub/deep"))
+            && create_file(dir.filePath(QStringLiteral("a.txt")), 100)
+            && create_file(dir.filePath(QStringLiteral("sub/b.txt")), 200)
+            && create_file(dir.filePath(QStringLiteral("sub/deep/c.txt")), 300)
+            && QFile::link(dir.filePath(QStringLiteral("sub")), dir.filePath(QStringLiteral("link")));
+    }
+
+    bool wait_for_estimate(QSignalSpy & spy)
+    {
+        if (spy.isEmpty() && !spy.wait(5000))
+            return false;
+        spy.clear();
+        return true;
+    }
+}
+
+TEST(SizeEstimator, EstimateTree)
+{
+    QTemporaryDir tmp_dir;
+    ASSERT_TRUE(create_tree(tmp_dir.path()));
+
+    SizeEstimator estimator;
+    QSignalSpy spy(&estimator, &SizeEstimator::estimate_changed);
+    estimator.set_paths(QStringList{tmp_dir.path()});
+    EXPECT_FALSE(estimator.estimate(tmp_dir.path()).complete);
+
+    ASSERT_TRUE(wait_for_estimate(spy));
+    auto const estimate = estimator.estimate(tmp_dir.path());
+    EXPECT_TRUE(estimate.complete);
+    // the link is counted, but not followed
+    EXPECT_EQ(600, estimate.n_bytes);
+    EXPECT_EQ(4, estimate.n_files);
+
+    // unknown paths have no estimate
+    EXPECT_FALSE(estimator.estimate(QStringLiteral("/no/such/path")).complete);
+}
+
+TEST(SizeEstimator, UpdateOnChanges)
+{
+    QTemporaryDir tmp_dir;
+    ASSERT_TRUE(create_tree(tmp_dir.path()));
+    QDir dir(tmp_dir.path());
+
+    SizeEstimator estimator;
+    QSignalSpy spy(&estimator, &SizeEstimator::estimate_changed);
+    estimator.set_paths(QStringList{tmp_dir.path()});
+    ASSERT_TRUE(wait_for_estimate(spy));
+
+    // a file added deep in the tree
+    ASSERT_TRUE(create_file(dir.filePath(QStringLiteral("sub/deep/d.txt")), 50));
+    ASSERT_TRUE(wait_for_estimate(spy));
+    EXPECT_EQ(650, estimator.estimate(tmp_dir.path()).n_bytes);
+    EXPECT_EQ(5, estimator.estimate(tmp_dir.path()).n_files);
+
+    // a new directory is walked
+    ASSERT_TRUE(dir.mkpath(QStringLiteral("new")));
+    ASSERT_TRUE(wait_for_estimate(spy));
+    ASSERT_TRUE(create_file(dir.filePath(QStringLiteral("new/e.txt")), 10));
+    ASSERT_TRUE(wait_for_estimate(spy));
+    EXPECT_EQ(660, estimator.estimate(tmp_dir.path()).n_bytes);
+
+    // a removed directory is forgotten with everything in it
+    ASSERT_TRUE(QDir(dir.filePath(QStringLiteral("sub"))).removeRecursively());
+    while (estimator.estimate(tmp_dir.path()).n_bytes != 110)
+        ASSERT_TRUE(wait_for_estimate(spy));
+    EXPECT_EQ(3, estimator.estimate(tmp_dir.path()).n_files);
+}
+
+TEST(SizeEstimator, SetPaths)
+{
+    QTemporaryDir tmp_dir_1;
+    QTemporaryDir tmp_dir_2;
+    ASSERT_TRUE(create_tree(tmp_dir_1.path()));
+    ASSERT_TRUE(create_file(QDir(tmp_dir_2.path()).filePath(QStringLiteral("f.txt")), 1000));
+
+    SizeEstimator estimator;
+    QSignalSpy spy(&estimator, &SizeEstimator::estimate_changed);
+    estimator.set_paths(QStringList{tmp_dir_1.path(), tmp_dir_2.path()});
+    while (!estimator.estimate(tmp_dir_1.path()).complete || !estimator.estimate(tmp_dir_2.path()).complete)
+        ASSERT_TRUE(wait_for_estimate(spy));
+    EXPECT_EQ(600, estimator.estimate(tmp_dir_1.path()).n_bytes);
+    EXPECT_EQ(1000, estimator.estimate(tmp_dir_2.path()).n_bytes);
+
+    // the paths left out are forgotten
+    estimator.set_paths(QStringList{tmp_dir_2.path()});
+    EXPECT_EQ(QStringList{tmp_dir_2.path()}, estimator.paths());
+    EXPECT_FALSE(estimator.estimate(tmp_dir_1.path()).complete);
+    EXPECT_TRUE(estimator.estimate(tmp_dir_2.path()).complete);
+}
+
+TEST(SizeEstimator, ReAddPathWhileScanning)
+{
+    QTemporaryDir tmp_dir;
+    ASSERT_TRUE(create_tree(tmp_dir.path()));
+
+    // the scans of the removed path are ignored, the path is walked again
+    SizeEstimator estimator;
+    QSignalSpy spy(&estimator, &SizeEstimator::estimate_changed);
+    estimator.set_paths(QStringList{tmp_dir.path()});
+    estimator.set_paths(QStringList());
+    estimator.set_paths(QStringList{tmp_dir.path()});
+    while (!estimator.estimate(tmp_dir.path()).complete)
+        ASSERT_TRUE(wait_for_estimate(spy));
+    EXPECT_EQ(600, estimator.estimate(tmp_dir.path()).n_bytes);
+    EXPECT_EQ(4, estimator.estimate(tmp_dir.path()).n_files);
+}
+
+TEST(SizeEstimator, MaxThreads)
+{
+    g_setenv("KEEPER_SIZE_ESTIMATOR_THREADS", "3", true);
+    SizeEstimator estimator;
+    EXPECT_EQ(3, estimator.max_threads());
+    g_unsetenv("KEEPER_SIZE_ESTIMATOR_THREADS");
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include <storage-framework/chunked-downloader.h>
+#include <storage-framework/storage_framework_client.h>
+
+#include <QSignalSpy>
+#include <QTemporaryDir>
+
+#include <gtest/gtest.h>
+#include <glib.h>
+
+namespace
+{
+    QList<QByteArray> const test_parts = {
+        "Dorothy was a waitress on the promenade\n",
+        "She worked the night shift\n",
+        "",
+        "Dishwater blonde, tall and fine\n",
+        "She got a lot of tips\n"
+    };
+
+    QString const test_dir = QStringLiteral("test_dir");
+
+    template<typename T>
+    T wait_for(QFuture<T> const & future)
+    {
+        QFutureWatcher<T> w;
+        QSignalSpy spy(&w, &decltype(w)::finished);
+        w.setFuture(future);
+        if (!future.isFinished() && !spy.wait())
+            return T();
+        return future.result();
+    }
+
+    // stores every part in its own remote file, like ChunkedUploader does
+    QStringList upload_parts(StorageFrameworkClient & sf_client)
+    {
+        QStringList file_names;
+        for (int i = 0; i < test_parts.size(); ++i)
+        {
+            auto const file_name = QStringLiteral("test_file.part%1").arg(i);
+            auto uploader = wait_for(sf_client.get_new_uploader(test_parts[i].size(), test_dir, file_name));
+            if (!uploader)
+                return QStringList();
+
+            QSignalSpy spy_commit(uploader.get(), &Uploader::commit_finished);
+            uploader->socket()->write(test_parts[i]);
+            uploader->commit();
+            if (!spy_commit.wait() || !spy_commit.takeFirst().at(0).toBool())
+                return QStringList();
+            file_names << uploader->file_name();
+        }
+        return file_names;
+    }
+
+    QVector<qint64> part_sizes()
+    {
+        QVector<qint64> ret;
+        for (auto const & part : test_parts)
+            ret.push_back(part.size());
+        return ret;
+    }
+
+    QByteArray read_all(Downloader & downloader)
+    {
+        QByteArray ret;
+        auto socket = downloader.socket();
+        while (ret.size() < downloader.file_size())
+        {
+            if (!socket->bytesAvailable() && !socket->waitForReadyRead(5000))
+                break;
+            ret += socket->readAll();
+        }
+        return ret;
+    }
+}
+
+TEST(ChunkedDownloader, ReadPartsAsOneFile)
+{
+    QTemporaryDir tmp_dir;
+    g_setenv("XDG_DATA_HOME", tmp_dir.path().toLatin1().data(), true);
+
+    StorageFrameworkClient sf_client;
+    auto const file_names = upload_parts(sf_client);
+    ASSERT_EQ(test_parts.size(), file_names.size());
+
+    QList<int> requested_parts;
+    ChunkedDownloader downloader(
+        [&sf_client, &requested_parts, file_names](int part){
+            requested_parts << part;
+            return sf_client.get_new_downloader(test_dir, file_names[part]);
+        },
+        part_sizes()
+    );
+
+    QByteArray expected;
+    for (auto const & part : test_parts)
+        expected += part;
+    EXPECT_EQ(expected.size(), downloader.file_size());
+
+    // the current part and the next one are requested up front
+    EXPECT_EQ(QList<int>({0, 1}), requested_parts);
+
+    EXPECT_EQ(expected, read_all(downloader));
+    EXPECT_EQ(QList<int>({0, 1, 2, 3, 4}), requested_parts);
+
+    QSignalSpy spy_finished(&downloader, &Downloader::download_finished);
+    downloader.finish();
+    EXPECT_EQ(1, spy_finished.count());
+
+    g_unsetenv("XDG_DATA_HOME");
+}
+
+TEST(ChunkedDownloader, PrefetchParts)
+{
+    QTemporaryDir tmp_dir;
+    g_setenv("XDG_DATA_HOME", tmp_dir.path().toLatin1().data(), true);
+
+    StorageFrameworkClient sf_client;
+    auto const file_names = upload_parts(sf_client);
+    ASSERT_EQ(test_parts.size(), file_names.size());
+
+    QList<int> requested_parts;
+    ChunkedDownloader downloader(
+        [&sf_client, &requested_parts, file_names](int part){
+            requested_parts << part;
+            return sf_client.get_new_downloader(test_dir, file_names[part]);
+        },
+        part_sizes(),
+        3
+    );
+    EXPECT_EQ(QList<int>({0, 1, 2, 3}), requested_parts);
+
+    // the prefetched parts are still read in order
+    QByteArray expected;
+    for (auto const & part : test_parts)
+        expected += part;
+    EXPECT_EQ(expected, read_all(downloader));
+    downloader.finish();
+
+    g_unsetenv("XDG_DATA_HOME");
+}
+
+TEST(ChunkedDownloader, MissingPartEndsTheData)
+{
+    QTemporaryDir tmp_dir;
+    g_setenv("XDG_DATA_HOME", tmp_dir.path().toLatin1().data(), true);
+
+    StorageFrameworkClient sf_client;
+    auto const file_names = upload_parts(sf_client);
+    ASSERT_EQ(test_parts.size(), file_names.size());
+
+    // the second part can't be downloaded
+    ChunkedDownloader downloader(
+        [&sf_client, file_names](int part){
+            if (part == 1)
+            {
+                QFutureInterface<std::shared_ptr<Downloader>> fi;
+                fi.reportResult(std::shared_ptr<Downloader>());
+                fi.reportFinished();
+                return fi.future();
+            }
+            return sf_client.get_new_downloader(test_dir, file_names[part]);
+        },
+        part_sizes()
+    );
+
+    QSignalSpy spy_disconnected(downloader.socket().get(), &QLocalSocket::disconnected);
+    auto const data = read_all(downloader);
+    EXPECT_TRUE(spy_disconnected.count() || spy_disconnected.wait());
+    EXPECT_GT(downloader.file_size(), data.size());
+    EXPECT_TRUE(test_parts[0].startsWith(data));
+    downloader.finish();
+
+    g_unsetenv("XDG_DATA_HOME");
+}
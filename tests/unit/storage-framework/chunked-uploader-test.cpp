@@ -0,0 +1,621 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include <storage-framework/chunked-uploader.h>
+#include <storage-framework/storage_framework_client.h>
+
+#include "tests/utils/storage-framework-local.h"
+
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTimer>
+
+#include <gtest/gtest.h>
+#include <glib.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+namespace
+{
+    QByteArray const test_content = R"(
+        Dorothy was a waitress on the promenade
+        She worked the night shift
+        Dishwater blonde, tall and fine
+        She got a lot of tips
+    )";
+
+    constexpr qint64 TEST_PART_SIZE {32};
+
+    // reads the data of a part like the storage does, but drops the
+    // stream after fail_after bytes, and its commit always fails
+    class FailingUploader : public Uploader
+    {
+    public:
+        explicit FailingUploader(qint64 fail_after)
+            : fail_after_(fail_after)
+        {
+            int fds[2];
+            socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds);
+            write_socket_.reset(new QLocalSocket());
+            write_socket_->setSocketDescriptor(fds[1], QLocalSocket::ConnectedState, QIODevice::WriteOnly);
+            read_socket_.setSocketDescriptor(fds[0], QLocalSocket::ConnectedState, QIODevice::ReadOnly);
+
+            QObject::connect(&read_socket_, &QLocalSocket::readyRead, [this](){
+                n_read_ += read_socket_.readAll().size();
+                if (n_read_ >= fail_after_)
+                    read_socket_.disconnectFromServer();
+            });
+        }
+
+        std::shared_ptr<QLocalSocket> socket() override
+        {
+            return write_socket_;
+        }
+
+        void commit() override
+        {
+            QTimer::singleShot(0, this, [this](){ Q_EMIT(commit_finished(false)); });
+        }
+
+        QString file_name() const override
+        {
+            return QString();
+        }
+
+    private:
+        qint64 const fail_after_;
+        qint64 n_read_ = 0;
+        std::shared_ptr<QLocalSocket> write_socket_;
+        QLocalSocket read_socket_;
+    };
+
+    QFuture<std::shared_ptr<Uploader>> failing_uploader(qint64 fail_after)
+    {
+        QFutureInterface<std::shared_ptr<Uploader>> fi;
+        fi.reportResult(std::shared_ptr<Uploader>(
+            new FailingUploader(fail_after),
+            [](Uploader* u){u->deleteLater();}
+        ));
+        fi.reportFinished();
+        return fi.future();
+    }
+
+    QByteArray download(StorageFrameworkClient & sf_client, QString const & dir, QStringList const & file_names)
+    {
+        auto downloader_fut = sf_client.get_new_downloader(dir, file_names);
+        {
+            QFutureWatcher<StorageFrameworkClient::DownloaderResult> w;
+            QSignalSpy spy(&w, &decltype(w)::finished);
+            w.setFuture(downloader_fut);
+            if (!spy.wait())
+                return QByteArray();
+        }
+        auto downloader = downloader_fut.result().downloader;
+        if (!downloader)
+            return QByteArray();
+
+        QByteArray ret;
+        auto socket = downloader->socket();
+        while (ret.size() < downloader->file_size())
+        {
+            if (!socket->bytesAvailable() && !socket->waitForReadyRead(5000))
+                break;
+            ret += socket->readAll();
+        }
+        downloader->finish();
+        return ret;
+    }
+}
+
+TEST(ChunkedUploader, UploadInParts)
+{
+    QTemporaryDir tmp_dir;
+    QString test_dir = QStringLiteral("test_dir");
+    QString test_file_name = QStringLiteral("test_file");
+
+    g_setenv("XDG_DATA_HOME", tmp_dir.path().toLatin1().data(), true);
+
+    StorageFrameworkClient sf_client;
+    ChunkedUploader uploader(
+        [&sf_client, test_dir](QString const & file_name, qint64 n_bytes){
+            return sf_client.get_new_uploader(n_bytes, test_dir, file_name);
+        },
+        test_content.size(),
+        test_file_name,
+        TEST_PART_SIZE
+    );
+
+    auto const n_parts = int((test_content.size() + TEST_PART_SIZE - 1) / TEST_PART_SIZE);
+    EXPECT_EQ(n_parts, uploader.n_parts());
+
+    QSignalSpy spy_commit(&uploader, &Uploader::commit_finished);
+    uploader.socket()->write(test_content);
+    uploader.commit();
+    ASSERT_TRUE(spy_commit.wait(10000));
+    ASSERT_EQ(1, spy_commit.count());
+    EXPECT_TRUE(spy_commit.takeFirst().at(0).toBool());
+
+    EXPECT_EQ(n_parts, uploader.committed_parts().size());
+    auto const part_file_names = uploader.part_file_names();
+    ASSERT_EQ(n_parts, part_file_names.size());
+    for (int i = 0; i < n_parts; ++i)
+        EXPECT_EQ(ChunkedUploader::part_file_name(test_file_name, i), part_file_names[i]);
+
+    const auto sf_files = StorageFrameworkLocalUtils::get_storage_framework_files();
+    EXPECT_EQ(n_parts, sf_files.size());
+
+    // the parts are read back as a single file
+    EXPECT_EQ(test_content, download(sf_client, test_dir, part_file_names));
+
+    g_unsetenv("XDG_DATA_HOME");
+}
+
+TEST(ChunkedUploader, SinglePartKeepsFileName)
+{
+    QTemporaryDir tmp_dir;
+    QString test_dir = QStringLiteral("test_dir");
+    QString test_file_name = QStringLiteral("test_file");
+
+    g_setenv("XDG_DATA_HOME", tmp_dir.path().toLatin1().data(), true);
+
+    StorageFrameworkClient sf_client;
+    auto uploader_fut = sf_client.get_new_chunked_uploader(test_content.size(), test_dir, test_file_name);
+    {
+        QFutureWatcher<StorageFrameworkClient::UploaderResult> w;
+        QSignalSpy spy(&w, &decltype(w)::finished);
+        w.setFuture(uploader_fut);
+        ASSERT_TRUE(spy.wait());
+    }
+    EXPECT_EQ(keeper::Error::OK, uploader_fut.result().error);
+    auto uploader = uploader_fut.result().uploader;
+    ASSERT_NE(uploader, nullptr);
+
+    QSignalSpy spy_commit(uploader.get(), &Uploader::commit_finished);
+    uploader->socket()->write(test_content);
+    uploader->commit();
+    ASSERT_TRUE(spy_commit.wait(10000));
+    EXPECT_TRUE(spy_commit.takeFirst().at(0).toBool());
+
+    EXPECT_EQ(test_file_name, uploader->file_name());
+    EXPECT_EQ(QStringList{test_file_name}, uploader->part_file_names());
+    EXPECT_EQ(test_content, download(sf_client, test_dir, uploader->part_file_names()));
+
+    g_unsetenv("XDG_DATA_HOME");
+}
+
+TEST(ChunkedUploader, RetryFailedPart)
+{
+    QTemporaryDir tmp_dir;
+    QString test_dir = QStringLiteral("test_dir");
+    QString test_file_name = QStringLiteral("test_file");
+
+    g_setenv("XDG_DATA_HOME", tmp_dir.path().toLatin1().data(), true);
+
+    // the first attempt of the second part gets no uploader
+    StorageFrameworkClient sf_client;
+    QStringList requested_parts;
+    ChunkedUploader uploader(
+        [&sf_client, &requested_parts, test_dir](QString const & file_name, qint64 n_bytes){
+            requested_parts << file_name;
+            if (requested_parts.size() == 2)
+            {
+                QFutureInterface<std::shared_ptr<Uploader>> fi;
+                fi.reportResult(std::shared_ptr<Uploader>());
+                fi.reportFinished();
+                return fi.future();
+            }
+            return sf_client.get_new_uploader(n_bytes, test_dir, file_name);
+        },
+        test_content.size(),
+        test_file_name,
+        TEST_PART_SIZE
+    );
+
+    QSignalSpy spy_commit(&uploader, &Uploader::commit_finished);
+    uploader.socket()->write(test_content);
+    uploader.commit();
+    ASSERT_TRUE(spy_commit.wait(15000));
+    EXPECT_TRUE(spy_commit.takeFirst().at(0).toBool());
+
+    // the failed part was requested again, the others only once
+    ASSERT_EQ(uploader.n_parts() + 1, requested_parts.size());
+    EXPECT_EQ(requested_parts[1], requested_parts[2]);
+    EXPECT_EQ(uploader.n_parts(), uploader.committed_parts().size());
+
+    EXPECT_EQ(test_content, download(sf_client, test_dir, uploader.part_file_names()));
+
+    g_unsetenv("XDG_DATA_HOME");
+}
+
+TEST(ChunkedUploader, UploadPartsInParallel)
+{
+    QTemporaryDir tmp_dir;
+    QString test_dir = QStringLiteral("test_dir");
+    QString test_file_name = QStringLiteral("test_file");
+
+    g_setenv("XDG_DATA_HOME", tmp_dir.path().toLatin1().data(), true);
+
+    StorageFrameworkClient sf_client;
+    sf_client.set_upload_streams(3);
+    EXPECT_EQ(3, sf_client.upload_streams());
+
+    QStringList requested_parts;
+    ChunkedUploader uploader(
+        [&sf_client, &requested_parts, test_dir](QString const & file_name, qint64 n_bytes){
+            requested_parts << file_name;
+            return sf_client.get_new_uploader(n_bytes, test_dir, file_name);
+        },
+        test_content.size(),
+        test_file_name,
+        TEST_PART_SIZE,
+        sf_client.upload_streams()
+    );
+    ASSERT_LT(1, uploader.n_parts());
+
+    QSignalSpy spy_commit(&uploader, &Uploader::commit_finished);
+    uploader.socket()->write(test_content);
+    uploader.commit();
+    ASSERT_TRUE(spy_commit.wait(10000));
+    EXPECT_TRUE(spy_commit.takeFirst().at(0).toBool());
+
+    // every part was uploaded once and they are listed in order
+    EXPECT_EQ(uploader.n_parts(), requested_parts.size());
+    auto const part_file_names = uploader.part_file_names();
+    ASSERT_EQ(uploader.n_parts(), part_file_names.size());
+    for (int i = 0; i < part_file_names.size(); ++i)
+        EXPECT_EQ(ChunkedUploader::part_file_name(test_file_name, i), part_file_names[i]);
+
+    EXPECT_EQ(test_content, download(sf_client, test_dir, part_file_names));
+
+    g_unsetenv("XDG_DATA_HOME");
+}
+
+TEST(ChunkedUploader, ReadAheadWhileAPartWaits)
+{
+    QTemporaryDir tmp_dir;
+    QString test_dir = QStringLiteral("test_dir");
+    QString test_file_name = QStringLiteral("test_file");
+
+    g_setenv("XDG_DATA_HOME", tmp_dir.path().toLatin1().data(), true);
+
+    // the stream of the first part is held back
+    StorageFrameworkClient sf_client;
+    QFutureInterface<std::shared_ptr<Uploader>> first_part;
+    first_part.reportStarted();
+    auto const first_part_name = ChunkedUploader::part_file_name(test_file_name, 0);
+    QStringList requested_parts;
+    ChunkedUploader uploader(
+        [&sf_client, &requested_parts, &first_part, first_part_name, test_dir](QString const & file_name, qint64 n_bytes){
+            requested_parts << file_name;
+            if (file_name == first_part_name)
+                return first_part.future();
+            return sf_client.get_new_uploader(n_bytes, test_dir, file_name);
+        },
+        test_content.size(),
+        test_file_name,
+        TEST_PART_SIZE,
+        3
+    );
+    ASSERT_LT(3, uploader.n_parts());
+
+    // the next parts are read and sent while the first one waits
+    QSignalSpy spy_part(&uploader, &ChunkedUploader::part_committed);
+    QSignalSpy spy_commit(&uploader, &Uploader::commit_finished);
+    uploader.socket()->write(test_content);
+    uploader.commit();
+    while (spy_part.count() < 2)
+        ASSERT_TRUE(spy_part.wait(10000));
+    EXPECT_FALSE(uploader.committed_parts().contains(0));
+    EXPECT_LE(3, requested_parts.size());
+
+    // once it gets its stream the rest follows
+    auto const first_uploader = sf_client.get_new_uploader(TEST_PART_SIZE, test_dir, first_part_name);
+    {
+        QFutureWatcher<std::shared_ptr<Uploader>> w;
+        QSignalSpy spy(&w, &decltype(w)::finished);
+        w.setFuture(first_uploader);
+        ASSERT_TRUE(spy.wait());
+    }
+    first_part.reportResult(first_uploader.result());
+    first_part.reportFinished();
+
+    ASSERT_TRUE(spy_commit.wait(10000));
+    EXPECT_TRUE(spy_commit.takeFirst().at(0).toBool());
+    EXPECT_EQ(uploader.n_parts(), requested_parts.size());
+    EXPECT_EQ(test_content, download(sf_client, test_dir, uploader.part_file_names()));
+
+    g_unsetenv("XDG_DATA_HOME");
+}
+
+TEST(ChunkedUploader, RetryPartDroppedMidStream)
+{
+    QTemporaryDir tmp_dir;
+    QString test_dir = QStringLiteral("test_dir");
+    QString test_file_name = QStringLiteral("test_file");
+
+    g_setenv("XDG_DATA_HOME", tmp_dir.path().toLatin1().data(), true);
+
+    // the stream of the first attempt of the second part is dropped
+    // halfway, the data already sent must be sent again
+    StorageFrameworkClient sf_client;
+    QStringList requested_parts;
+    ChunkedUploader uploader(
+        [&sf_client, &requested_parts, test_dir](QString const & file_name, qint64 n_bytes){
+            requested_parts << file_name;
+            if (requested_parts.size() == 2)
+                return failing_uploader(TEST_PART_SIZE / 2);
+            return sf_client.get_new_uploader(n_bytes, test_dir, file_name);
+        },
+        test_content.size(),
+        test_file_name,
+        TEST_PART_SIZE
+    );
+
+    QSignalSpy spy_commit(&uploader, &Uploader::commit_finished);
+    QSignalSpy spy_progress(&uploader, &Uploader::upload_progress);
+    uploader.socket()->write(test_content);
+    uploader.commit();
+    ASSERT_TRUE(spy_commit.wait(15000));
+    EXPECT_TRUE(spy_commit.takeFirst().at(0).toBool());
+    EXPECT_LT(0, spy_progress.count());
+
+    ASSERT_EQ(uploader.n_parts() + 1, requested_parts.size());
+    EXPECT_EQ(requested_parts[1], requested_parts[2]);
+    EXPECT_EQ(uploader.n_parts(), uploader.committed_parts().size());
+
+    EXPECT_EQ(test_content, download(sf_client, test_dir, uploader.part_file_names()));
+
+    g_unsetenv("XDG_DATA_HOME");
+}
+
+TEST(ChunkedUploader, RetryPartThatFailsToCommit)
+{
+    QTemporaryDir tmp_dir;
+    QString test_dir = QStringLiteral("test_dir");
+    QString test_file_name = QStringLiteral("test_file");
+
+    g_setenv("XDG_DATA_HOME", tmp_dir.path().toLatin1().data(), true);
+
+    // the first part takes all its data but the storage refuses it
+    StorageFrameworkClient sf_client;
+    QStringList requested_parts;
+    ChunkedUploader uploader(
+        [&sf_client, &requested_parts, test_dir](QString const & file_name, qint64 n_bytes){
+            requested_parts << file_name;
+            if (requested_parts.size() == 1)
+                return failing_uploader(TEST_PART_SIZE + 1);
+            return sf_client.get_new_uploader(n_bytes, test_dir, file_name);
+        },
+        test_content.size(),
+        test_file_name,
+        TEST_PART_SIZE
+    );
+
+    QSignalSpy spy_commit(&uploader, &Uploader::commit_finished);
+    uploader.socket()->write(test_content);
+    uploader.commit();
+    ASSERT_TRUE(spy_commit.wait(15000));
+    EXPECT_TRUE(spy_commit.takeFirst().at(0).toBool());
+
+    ASSERT_EQ(uploader.n_parts() + 1, requested_parts.size());
+    EXPECT_EQ(requested_parts[0], requested_parts[1]);
+
+    EXPECT_EQ(test_content, download(sf_client, test_dir, uploader.part_file_names()));
+
+    g_unsetenv("XDG_DATA_HOME");
+}
+
+TEST(ChunkedUploader, GiveUpAfterMaxAttempts)
+{
+    QTemporaryDir tmp_dir;
+    QString test_dir = QStringLiteral("test_dir");
+    QString test_file_name = QStringLiteral("test_file");
+
+    g_setenv("XDG_DATA_HOME", tmp_dir.path().toLatin1().data(), true);
+
+    // the second part never makes it
+    StorageFrameworkClient sf_client;
+    QStringList requested_parts;
+    auto const failing_part = ChunkedUploader::part_file_name(test_file_name, 1);
+    ChunkedUploader uploader(
+        [&sf_client, &requested_parts, test_dir, failing_part](QString const & file_name, qint64 n_bytes){
+            requested_parts << file_name;
+            if (file_name == failing_part)
+                return failing_uploader(1);
+            return sf_client.get_new_uploader(n_bytes, test_dir, file_name);
+        },
+        test_content.size(),
+        test_file_name,
+        TEST_PART_SIZE
+    );
+
+    QSignalSpy spy_commit(&uploader, &Uploader::commit_finished);
+    uploader.socket()->write(test_content);
+    uploader.commit();
+    ASSERT_TRUE(spy_commit.wait(30000));
+    EXPECT_FALSE(spy_commit.takeFirst().at(0).toBool());
+
+    EXPECT_EQ(int(ChunkedUploader::MAX_PART_ATTEMPTS), requested_parts.count(failing_part));
+    EXPECT_EQ(QVector<int>{0}, uploader.committed_parts());
+    EXPECT_TRUE(uploader.part_file_names().isEmpty());
+
+    g_unsetenv("XDG_DATA_HOME");
+}
+
+TEST(ChunkedUploader, StreamsFromEnvironment)
+{
+    g_unsetenv("KEEPER_UPLOAD_STREAMS");
+    g_unsetenv("KEEPER_PREFETCHED_PARTS");
+    {
+        StorageFrameworkClient sf_client;
+        EXPECT_EQ(2, sf_client.upload_streams());
+        EXPECT_EQ(2, sf_client.prefetched_parts());
+    }
+
+    g_setenv("KEEPER_UPLOAD_STREAMS", "4", true);
+    g_setenv("KEEPER_PREFETCHED_PARTS", "0", true);
+    {
+        StorageFrameworkClient sf_client;
+        EXPECT_EQ(4, sf_client.upload_streams());
+        EXPECT_EQ(0, sf_client.prefetched_parts());
+    }
+
+    // invalid values keep the defaults
+    g_setenv("KEEPER_UPLOAD_STREAMS", "0", true);
+    g_setenv("KEEPER_PREFETCHED_PARTS", "many", true);
+    {
+        StorageFrameworkClient sf_client;
+        EXPECT_EQ(2, sf_client.upload_streams());
+        EXPECT_EQ(2, sf_client.prefetched_parts());
+    }
+
+    g_unsetenv("KEEPER_UPLOAD_STREAMS");
+    g_unsetenv("KEEPER_PREFETCHED_PARTS");
+}
+
+TEST(ChunkedUploader, SkipPartsCommittedBefore)
+{
+    QTemporaryDir tmp_dir;
+    QString test_dir = QStringLiteral("test_dir");
+    QString test_file_name = QStringLiteral("test_file");
+
+    g_setenv("XDG_DATA_HOME", tmp_dir.path().toLatin1().data(), true);
+
+    // the first attempt stores the first two parts and stops
+    StorageFrameworkClient sf_client;
+    QStringList stored_parts;
+    QStringList stored_hashes;
+    {
+        ChunkedUploader uploader(
+            [&sf_client, test_dir](QString const & file_name, qint64 n_bytes){
+                return sf_client.get_new_uploader(n_bytes, test_dir, file_name);
+            },
+            test_content.size(),
+            test_file_name,
+            TEST_PART_SIZE
+        );
+        ASSERT_LT(2, uploader.n_parts());
+
+        QSignalSpy spy_part(&uploader, &ChunkedUploader::part_committed);
+        uploader.socket()->write(test_content.left(2 * TEST_PART_SIZE));
+        while (spy_part.count() < 2)
+            ASSERT_TRUE(spy_part.wait(10000));
+        stored_parts = uploader.committed_part_file_names();
+        stored_hashes = uploader.committed_part_hashes();
+    }
+    ASSERT_EQ(QStringList({ChunkedUploader::part_file_name(test_file_name, 0),
+                           ChunkedUploader::part_file_name(test_file_name, 1)}), stored_parts);
+    ASSERT_EQ(2, stored_hashes.size());
+
+    // the second attempt gets the whole file again, but only sends the rest
+    QStringList requested_parts;
+    ChunkedUploader uploader(
+        [&sf_client, &requested_parts, test_dir](QString const & file_name, qint64 n_bytes){
+            requested_parts << file_name;
+            return sf_client.get_new_uploader(n_bytes, test_dir, file_name);
+        },
+        test_content.size(),
+        test_file_name,
+        TEST_PART_SIZE
+    );
+    uploader.skip_parts(stored_parts, stored_hashes);
+
+    QSignalSpy spy_commit(&uploader, &Uploader::commit_finished);
+    uploader.socket()->write(test_content);
+    uploader.commit();
+    ASSERT_TRUE(spy_commit.wait(10000));
+    EXPECT_TRUE(spy_commit.takeFirst().at(0).toBool());
+
+    EXPECT_EQ(uploader.n_parts() - 2, requested_parts.size());
+    EXPECT_FALSE(requested_parts.contains(stored_parts[0]));
+    EXPECT_FALSE(requested_parts.contains(stored_parts[1]));
+    EXPECT_EQ(uploader.part_file_names(), uploader.committed_part_file_names());
+    EXPECT_EQ(test_content, download(sf_client, test_dir, uploader.part_file_names()));
+
+    g_unsetenv("XDG_DATA_HOME");
+}
+
+TEST(ChunkedUploader, ResendPartsThatChanged)
+{
+    QTemporaryDir tmp_dir;
+    QString test_dir = QStringLiteral("test_dir");
+    QString test_file_name = QStringLiteral("test_file");
+
+    g_setenv("XDG_DATA_HOME", tmp_dir.path().toLatin1().data(), true);
+
+    // the first attempt stores the first two parts and stops
+    StorageFrameworkClient sf_client;
+    QStringList stored_parts;
+    QStringList stored_hashes;
+    {
+        ChunkedUploader uploader(
+            [&sf_client, test_dir](QString const & file_name, qint64 n_bytes){
+                return sf_client.get_new_uploader(n_bytes, test_dir, file_name);
+            },
+            test_content.size(),
+            test_file_name,
+            TEST_PART_SIZE
+        );
+        ASSERT_LT(2, uploader.n_parts());
+
+        QSignalSpy spy_part(&uploader, &ChunkedUploader::part_committed);
+        uploader.socket()->write(test_content.left(2 * TEST_PART_SIZE));
+        while (spy_part.count() < 2)
+            ASSERT_TRUE(spy_part.wait(10000));
+        stored_parts = uploader.committed_part_file_names();
+        stored_hashes = uploader.committed_part_hashes();
+    }
+
+    // the archive of the second attempt has the same size, but its second part differs
+    auto changed_content = test_content;
+    changed_content[int(TEST_PART_SIZE) + 1] = changed_content[int(TEST_PART_SIZE) + 1] == 'x' ? 'y' : 'x';
+
+    QStringList requested_parts;
+    ChunkedUploader uploader(
+        [&sf_client, &requested_parts, test_dir](QString const & file_name, qint64 n_bytes){
+            requested_parts << file_name;
+            return sf_client.get_new_uploader(n_bytes, test_dir, file_name);
+        },
+        changed_content.size(),
+        test_file_name,
+        TEST_PART_SIZE
+    );
+    uploader.set_part_remover(
+        [&sf_client, test_dir](QString const & file_name){
+            return sf_client.remove_file(test_dir, file_name);
+        }
+    );
+    uploader.skip_parts(stored_parts, stored_hashes);
+
+    QSignalSpy spy_commit(&uploader, &Uploader::commit_finished);
+    uploader.socket()->write(changed_content);
+    uploader.commit();
+    ASSERT_TRUE(spy_commit.wait(10000));
+    EXPECT_TRUE(spy_commit.takeFirst().at(0).toBool());
+
+    // every part is sent again, the first one included
+    EXPECT_EQ(uploader.n_parts(), requested_parts.size());
+    EXPECT_TRUE(requested_parts.contains(stored_parts[0]));
+    EXPECT_EQ(stored_hashes[0], uploader.committed_part_hashes()[0]);
+    EXPECT_NE(stored_hashes[1], uploader.committed_part_hashes()[1]);
+    EXPECT_EQ(changed_content, download(sf_client, test_dir, uploader.part_file_names()));
+
+    g_unsetenv("XDG_DATA_HOME");
+}
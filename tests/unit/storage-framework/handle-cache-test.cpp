@@ -0,0 +1,247 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include <storage-framework/storage_framework_client.h>
+
+#include <QSignalSpy>
+#include <QTemporaryDir>
+
+#include <gtest/gtest.h>
+#include <glib.h>
+
+namespace
+{
+    template<typename T>
+    T wait_for(QFuture<T> const & future)
+    {
+        QFutureWatcher<T> w;
+        QSignalSpy spy(&w, &decltype(w)::finished);
+        w.setFuture(future);
+        if (!future.isFinished())
+            spy.wait();
+        return future.result();
+    }
+}
+
+TEST(SFHandleCache, ReuseResolvedHandles)
+{
+    QTemporaryDir tmp_dir;
+    QString test_dir = QStringLiteral("test_dir");
+
+    g_setenv("XDG_DATA_HOME", tmp_dir.path().toLatin1().data(), true);
+
+    StorageFrameworkClient sf_client;
+
+    // the first upload resolves everything and creates the folders
+    auto uploader = wait_for(sf_client.get_new_uploader(0, test_dir, QStringLiteral("file_1")));
+    ASSERT_NE(uploader, nullptr);
+    auto round_trips = sf_client.get_round_trips();
+    EXPECT_EQ(1, round_trips.value(QStringLiteral("accounts")));
+    EXPECT_EQ(1, round_trips.value(QStringLiteral("roots")));
+    EXPECT_EQ(2, round_trips.value(QStringLiteral("lookup")));
+    EXPECT_EQ(2, round_trips.value(QStringLiteral("create_folder")));
+    EXPECT_EQ(1, round_trips.value(QStringLiteral("create_file")));
+
+    // the next one in the same folder only creates the file
+    sf_client.reset_round_trips();
+    uploader = wait_for(sf_client.get_new_uploader(0, test_dir, QStringLiteral("file_2")));
+    ASSERT_NE(uploader, nullptr);
+    round_trips = sf_client.get_round_trips();
+    EXPECT_EQ(1, round_trips.size());
+    EXPECT_EQ(1, round_trips.value(QStringLiteral("create_file")));
+
+    g_unsetenv("XDG_DATA_HOME");
+}
+
+TEST(SFHandleCache, ExpiredHandlesAreResolvedAgain)
+{
+    QTemporaryDir tmp_dir;
+    QString test_dir = QStringLiteral("test_dir");
+
+    g_setenv("XDG_DATA_HOME", tmp_dir.path().toLatin1().data(), true);
+
+    StorageFrameworkClient sf_client;
+    sf_client.set_cache_ttl(0);
+
+    auto uploader = wait_for(sf_client.get_new_uploader(0, test_dir, QStringLiteral("file_1")));
+    ASSERT_NE(uploader, nullptr);
+
+    // the folders exist now, but are looked up again
+    sf_client.reset_round_trips();
+    uploader = wait_for(sf_client.get_new_uploader(0, test_dir, QStringLiteral("file_2")));
+    ASSERT_NE(uploader, nullptr);
+    auto const round_trips = sf_client.get_round_trips();
+    EXPECT_EQ(1, round_trips.value(QStringLiteral("accounts")));
+    EXPECT_EQ(1, round_trips.value(QStringLiteral("roots")));
+    EXPECT_EQ(2, round_trips.value(QStringLiteral("lookup")));
+    EXPECT_EQ(0, round_trips.value(QStringLiteral("create_folder")));
+    EXPECT_EQ(1, round_trips.value(QStringLiteral("create_file")));
+
+    g_unsetenv("XDG_DATA_HOME");
+}
+
+TEST(SFHandleCache, ErrorsDropCachedHandles)
+{
+    QTemporaryDir tmp_dir;
+    QString test_dir = QStringLiteral("test_dir");
+
+    g_setenv("XDG_DATA_HOME", tmp_dir.path().toLatin1().data(), true);
+
+    StorageFrameworkClient sf_client;
+    auto uploader = wait_for(sf_client.get_new_uploader(0, test_dir, QStringLiteral("file_1")));
+    ASSERT_NE(uploader, nullptr);
+
+    // reading a file that does not exist fails...
+    auto const downloader = wait_for(sf_client.get_new_downloader(test_dir, QStringList{QStringLiteral("missing_file")}));
+    EXPECT_EQ(downloader.downloader, nullptr);
+    EXPECT_EQ(keeper::Error::READING_REMOTE_FILE, downloader.error);
+
+    // ...so the next operation resolves the handles again
+    sf_client.reset_round_trips();
+    uploader = wait_for(sf_client.get_new_uploader(0, test_dir, QStringLiteral("file_2")));
+    ASSERT_NE(uploader, nullptr);
+    auto const round_trips = sf_client.get_round_trips();
+    EXPECT_EQ(1, round_trips.value(QStringLiteral("accounts")));
+    EXPECT_EQ(1, round_trips.value(QStringLiteral("roots")));
+    EXPECT_EQ(2, round_trips.value(QStringLiteral("lookup")));
+
+    g_unsetenv("XDG_DATA_HOME");
+}
+
+TEST(SFHandleCache, ClientsShareTheSession)
+{
+    QTemporaryDir tmp_dir;
+    QString test_dir = QStringLiteral("test_dir");
+
+    g_setenv("XDG_DATA_HOME", tmp_dir.path().toLatin1().data(), true);
+
+    QSharedPointer<StorageSession> session(new StorageSession());
+    StorageFrameworkClient first_client(session);
+    StorageFrameworkClient second_client(session);
+
+    auto uploader = wait_for(first_client.get_new_uploader(0, test_dir, QStringLiteral("file_1")));
+    ASSERT_NE(uploader, nullptr);
+
+    // the second client reuses what the first one resolved
+    session->reset_round_trips();
+    uploader = wait_for(second_client.get_new_uploader(0, test_dir, QStringLiteral("file_2")));
+    ASSERT_NE(uploader, nullptr);
+    auto const round_trips = second_client.get_round_trips();
+    EXPECT_EQ(1, round_trips.size());
+    EXPECT_EQ(1, round_trips.value(QStringLiteral("create_file")));
+    EXPECT_EQ(round_trips, session->round_trips());
+
+    // but a client with a session of its own resolves everything again
+    StorageFrameworkClient other_client;
+    uploader = wait_for(other_client.get_new_uploader(0, test_dir, QStringLiteral("file_3")));
+    ASSERT_NE(uploader, nullptr);
+    EXPECT_EQ(1, other_client.get_round_trips().value(QStringLiteral("accounts")));
+
+    g_unsetenv("XDG_DATA_HOME");
+}
+
+TEST(SFHandleCache, RoundTripsByOperation)
+{
+    QTemporaryDir tmp_dir;
+    QString test_dir = QStringLiteral("test_dir");
+
+    g_setenv("XDG_DATA_HOME", tmp_dir.path().toLatin1().data(), true);
+
+    StorageFrameworkClient sf_client;
+    auto uploader = wait_for(sf_client.get_new_uploader(0, test_dir, QStringLiteral("file_1")));
+    ASSERT_NE(uploader, nullptr);
+
+    // the listing and the download run at once, each one
+    // is counted under its own operation
+    sf_client.reset_round_trips();
+    auto dirs = sf_client.get_keeper_dirs();
+    auto downloader = sf_client.get_new_downloader(test_dir, QStringLiteral("missing_file"));
+    EXPECT_EQ(QVector<QString>({test_dir}), wait_for(dirs));
+    EXPECT_EQ(nullptr, wait_for(downloader));
+
+    auto const list_dirs = sf_client.get_round_trips(StorageFrameworkClient::LIST_DIRS_OPERATION);
+    EXPECT_EQ(1, list_dirs.size());
+    EXPECT_EQ(1, list_dirs.value(QStringLiteral("list")));
+
+    auto const download = sf_client.get_round_trips(StorageFrameworkClient::DOWNLOAD_OPERATION);
+    EXPECT_EQ(1, download.size());
+    EXPECT_EQ(1, download.value(QStringLiteral("lookup")));
+
+    EXPECT_TRUE(sf_client.get_round_trips(StorageFrameworkClient::UPLOAD_OPERATION).isEmpty());
+
+    // the totals add up every operation
+    auto const round_trips = sf_client.get_round_trips();
+    EXPECT_EQ(1, round_trips.value(QStringLiteral("list")));
+    EXPECT_EQ(1, round_trips.value(QStringLiteral("lookup")));
+
+    g_unsetenv("XDG_DATA_HOME");
+}
+
+TEST(SFHandleCache, ErrorsAreKeptByCall)
+{
+    QTemporaryDir tmp_dir;
+    QString test_dir = QStringLiteral("test_dir");
+
+    g_setenv("XDG_DATA_HOME", tmp_dir.path().toLatin1().data(), true);
+
+    StorageFrameworkClient sf_client;
+    auto uploader = wait_for(sf_client.get_new_uploader(0, test_dir, QStringLiteral("file_1")));
+    ASSERT_NE(uploader, nullptr);
+
+    // the failed download doesn't leak its error into the listing running at once
+    auto dirs = sf_client.get_account_keeper_dirs();
+    auto downloader = sf_client.get_new_downloader(QStringLiteral("missing_dir"), QStringList{QStringLiteral("file_1")});
+    auto const download_result = wait_for(downloader);
+    auto const dirs_result = wait_for(dirs);
+    EXPECT_EQ(nullptr, download_result.downloader);
+    EXPECT_EQ(keeper::Error::REMOTE_DIR_NOT_EXISTS, download_result.error);
+    EXPECT_EQ(QVector<QString>({test_dir}), dirs_result.dirs);
+    EXPECT_EQ(keeper::Error::OK, dirs_result.error);
+
+    g_unsetenv("XDG_DATA_HOME");
+}
+
+TEST(SFHandleCache, ReuseKeeperDirsListing)
+{
+    QTemporaryDir tmp_dir;
+
+    g_setenv("XDG_DATA_HOME", tmp_dir.path().toLatin1().data(), true);
+
+    StorageFrameworkClient sf_client;
+    auto uploader = wait_for(sf_client.get_new_uploader(0, QStringLiteral("dir_1"), QStringLiteral("file_1")));
+    ASSERT_NE(uploader, nullptr);
+
+    auto const keeper_dirs = wait_for(sf_client.get_account_keeper_dirs());
+    EXPECT_FALSE(keeper_dirs.account_id.isEmpty());
+    EXPECT_EQ(QVector<QString>({QStringLiteral("dir_1")}), keeper_dirs.dirs);
+
+    // listing again needs no round trip
+    sf_client.reset_round_trips();
+    EXPECT_EQ(QVector<QString>({QStringLiteral("dir_1")}), wait_for(sf_client.get_keeper_dirs()));
+    EXPECT_TRUE(sf_client.get_round_trips().isEmpty());
+
+    // and a folder created meanwhile joins the listing
+    uploader = wait_for(sf_client.get_new_uploader(0, QStringLiteral("dir_2"), QStringLiteral("file_2")));
+    ASSERT_NE(uploader, nullptr);
+    sf_client.reset_round_trips();
+    EXPECT_EQ(QVector<QString>({QStringLiteral("dir_1"), QStringLiteral("dir_2")}), wait_for(sf_client.get_keeper_dirs()));
+    EXPECT_TRUE(sf_client.get_round_trips().isEmpty());
+
+    g_unsetenv("XDG_DATA_HOME");
+}
@@ -0,0 +1,200 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include <storage-framework/storage_framework_client.h>
+
+#include <QElapsedTimer>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+
+#include <gtest/gtest.h>
+#include <glib.h>
+
+namespace
+{
+    QString const test_dir = QStringLiteral("test_dir");
+    QString const test_file_name = QStringLiteral("test_file");
+
+    QByteArray test_content(int n_bytes)
+    {
+        QByteArray ret;
+        ret.reserve(n_bytes);
+        for (int i = 0; i < n_bytes; ++i)
+            ret.append(char('a' + i % 26));
+        return ret;
+    }
+
+    template<typename T>
+    T wait_for(QFuture<T> const & future)
+    {
+        QFutureWatcher<T> w;
+        QSignalSpy spy(&w, &QFutureWatcher<T>::finished);
+        w.setFuture(future);
+        if (!future.isFinished())
+            spy.wait(15000);
+        return future.result();
+    }
+
+    bool upload(StorageFrameworkClient & sf_client, QByteArray const & content)
+    {
+        auto uploader = wait_for(sf_client.get_new_uploader(content.size(), test_dir, test_file_name));
+        if (!uploader)
+            return false;
+
+        QSignalSpy spy_commit(uploader.get(), &Uploader::commit_finished);
+        uploader->socket()->write(content);
+        uploader->commit();
+        return spy_commit.wait(30000) && spy_commit.takeFirst().at(0).toBool();
+    }
+
+    QByteArray download(StorageFrameworkClient & sf_client)
+    {
+        auto downloader = wait_for(sf_client.get_new_downloader(test_dir, test_file_name));
+        if (!downloader)
+            return QByteArray();
+
+        QByteArray ret;
+        auto socket = downloader->socket();
+        while (ret.size() < downloader->file_size())
+        {
+            if (!socket->bytesAvailable() && !socket->waitForReadyRead(5000))
+                break;
+            ret += socket->readAll();
+        }
+        downloader->finish();
+        return ret;
+    }
+
+    int total_round_trips(StorageFrameworkClient const & sf_client)
+    {
+        int ret {0};
+        for (auto const n : sf_client.get_round_trips())
+            ret += n;
+        return ret;
+    }
+}
+
+TEST(ShapedStorage, ThroughputIsCapped)
+{
+    QTemporaryDir tmp_dir;
+    g_setenv("XDG_DATA_HOME", tmp_dir.path().toLatin1().data(), true);
+
+    StorageShaping::Options options;
+    options.bytes_per_sec = 64 * 1024;
+    StorageFrameworkClient sf_client;
+    sf_client.set_shaping(options);
+
+    // two seconds at the capped rate, minus the initial burst
+    auto const content = test_content(128 * 1024);
+
+    QElapsedTimer timer;
+    timer.start();
+    ASSERT_TRUE(upload(sf_client, content));
+    EXPECT_LE(1500, timer.elapsed());
+
+    timer.restart();
+    EXPECT_EQ(content, download(sf_client));
+    EXPECT_LE(1500, timer.elapsed());
+
+    g_unsetenv("XDG_DATA_HOME");
+}
+
+TEST(ShapedStorage, StallsAndShortWritesKeepTheData)
+{
+    QTemporaryDir tmp_dir;
+    g_setenv("XDG_DATA_HOME", tmp_dir.path().toLatin1().data(), true);
+
+    StorageShaping::Options options;
+    options.stall_every = 16 * 1024;
+    options.stall_msec = 100;
+    options.max_write = 100;
+    StorageFrameworkClient sf_client;
+    sf_client.set_shaping(options);
+
+    // a stall after every 16 KiB but the last ones
+    auto const content = test_content(64 * 1024);
+
+    QElapsedTimer timer;
+    timer.start();
+    ASSERT_TRUE(upload(sf_client, content));
+    EXPECT_LE(300, timer.elapsed());
+
+    timer.restart();
+    EXPECT_EQ(content, download(sf_client));
+    EXPECT_LE(300, timer.elapsed());
+
+    g_unsetenv("XDG_DATA_HOME");
+}
+
+TEST(ShapedStorage, LatencyPerRoundTrip)
+{
+    QTemporaryDir tmp_dir;
+    g_setenv("XDG_DATA_HOME", tmp_dir.path().toLatin1().data(), true);
+
+    constexpr int latency {200};
+    StorageShaping::Options options;
+    options.latency_msec = latency;
+    StorageFrameworkClient sf_client;
+    sf_client.set_shaping(options);
+
+    QElapsedTimer timer;
+    timer.start();
+    auto uploader = wait_for(sf_client.get_new_uploader(0, test_dir, test_file_name));
+    ASSERT_NE(nullptr, uploader);
+
+    // the calls are made one after the other, each one waits for the previous
+    auto const n_round_trips = total_round_trips(sf_client);
+    EXPECT_LT(0, n_round_trips);
+    EXPECT_LE(n_round_trips * latency, timer.elapsed());
+
+    // and so does the commit
+    timer.restart();
+    QSignalSpy spy_commit(uploader.get(), &Uploader::commit_finished);
+    uploader->commit();
+    ASSERT_TRUE(spy_commit.wait());
+    EXPECT_TRUE(spy_commit.takeFirst().at(0).toBool());
+    EXPECT_LE(latency, timer.elapsed());
+
+    g_unsetenv("XDG_DATA_HOME");
+}
+
+TEST(ShapedStorage, OptionsFromEnvironment)
+{
+    g_setenv("KEEPER_SHAPING_LATENCY_MSEC", "300", true);
+    g_setenv("KEEPER_SHAPING_KBITS", "2000", true);
+    g_setenv("KEEPER_SHAPING_STALL_EVERY_KB", "512", true);
+    g_setenv("KEEPER_SHAPING_STALL_MSEC", "5000", true);
+    g_setenv("KEEPER_SHAPING_MAX_WRITE", "1400", true);
+
+    auto const options = StorageShaping::options_from_environment();
+    EXPECT_EQ(300, options.latency_msec);
+    EXPECT_EQ(250000, options.bytes_per_sec);
+    EXPECT_EQ(512 * 1024, options.stall_every);
+    EXPECT_EQ(5000, options.stall_msec);
+    EXPECT_EQ(1400, options.max_write);
+    EXPECT_TRUE(StorageShaping(options).is_enabled());
+
+    g_unsetenv("KEEPER_SHAPING_LATENCY_MSEC");
+    g_unsetenv("KEEPER_SHAPING_KBITS");
+    g_unsetenv("KEEPER_SHAPING_STALL_EVERY_KB");
+    g_unsetenv("KEEPER_SHAPING_STALL_MSEC");
+    g_unsetenv("KEEPER_SHAPING_MAX_WRITE");
+
+    EXPECT_FALSE(StorageShaping(StorageShaping::options_from_environment()).is_enabled());
+}
@@ -23,6 +23,7 @@
 
 #include <gtest/gtest.h>
 
+#include <QCryptographicHash>
 #include <QDebug>
 #include <QDir>
 #include <QFile>
@@ -94,6 +95,21 @@ TEST_F(TarCreatorFixture, Create)
             }
             ASSERT_EQ(estimated_size, actual_size);
 
+            // the catalog lists every file of the archive
+            const auto catalog = tar_creator.file_catalog().entries();
+            ASSERT_EQ(files.size(), catalog.size());
+            for (int j=0; j<files.size(); ++j) {
+                QFile file(files[j]);
+                ASSERT_TRUE(file.open(QIODevice::ReadOnly));
+                EXPECT_EQ(files[j], catalog[j].path);
+                EXPECT_EQ(QFileInfo(files[j]).size(), catalog[j].size);
+                EXPECT_EQ(QCryptographicHash::hash(file.readAll(), QCryptographicHash::Sha256), catalog[j].hash);
+                if (compression_enabled)
+                    EXPECT_EQ(-1, catalog[j].offset);
+                else
+                    EXPECT_LE(0, catalog[j].offset);
+            }
+
             // untar it
             QTemporaryDir out;
             QDir outdir(out.path());
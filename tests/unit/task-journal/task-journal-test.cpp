@@ -0,0 +1,181 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include <service/task-journal.h>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+    QList<Metadata> create_tasks(int n_tasks)
+    {
+        QList<Metadata> ret;
+        for (auto i = 0; i < n_tasks; ++i)
+        {
+            Metadata metadata(QString("uuid-%1").arg(i), QString("Display name %1").arg(i));
+            metadata.set_property_value(QString("%1-prop").arg(i), QString("%1-prop-value").arg(i));
+            ret.push_back(metadata);
+        }
+        return ret;
+    }
+}
+
+TEST(TaskJournalClass, NoJournal)
+{
+    QTemporaryDir tmp_dir;
+
+    TaskJournal journal(tmp_dir.path() + "/keeper/task-journal.json");
+    EXPECT_FALSE(journal.load());
+    EXPECT_TRUE(journal.tasks().isEmpty());
+}
+
+TEST(TaskJournalClass, ResumeRun)
+{
+    QTemporaryDir tmp_dir;
+    auto const path = tmp_dir.path() + "/keeper/task-journal.json";
+    auto const tasks = create_tasks(4);
+
+    TaskJournal journal(path);
+    journal.begin(QStringLiteral("backup"), QStringLiteral("storage-id"), QStringLiteral("dir-name"), tasks);
+
+    auto completed = tasks[0];
+    completed.set_property_value(keeper::Item::FILE_NAME_KEY, QStringLiteral("file.keeper"));
+    journal.set_task_finished(completed, true);
+    journal.set_task_finished(tasks[2], false);
+
+    // a new journal reads what the previous service instance wrote
+    TaskJournal reloaded(path);
+    ASSERT_TRUE(reloaded.load());
+    EXPECT_EQ(QStringLiteral("backup"), reloaded.mode());
+    EXPECT_EQ(QStringLiteral("storage-id"), reloaded.storage());
+    EXPECT_EQ(QStringLiteral("dir-name"), reloaded.dir_name());
+    ASSERT_EQ(tasks.size(), reloaded.tasks().size());
+
+    auto const complete = reloaded.tasks(TaskJournal::TaskStatus::COMPLETE);
+    ASSERT_EQ(1, complete.size());
+    EXPECT_EQ(completed, complete[0].metadata);
+
+    auto const failed = reloaded.tasks(TaskJournal::TaskStatus::FAILED);
+    ASSERT_EQ(1, failed.size());
+    EXPECT_EQ(tasks[2], failed[0].metadata);
+
+    auto const queued = reloaded.tasks(TaskJournal::TaskStatus::QUEUED);
+    ASSERT_EQ(2, queued.size());
+    EXPECT_EQ(tasks[1], queued[0].metadata);
+    EXPECT_EQ(tasks[3], queued[1].metadata);
+}
+
+TEST(TaskJournalClass, ClearRun)
+{
+    QTemporaryDir tmp_dir;
+    auto const path = tmp_dir.path() + "/keeper/task-journal.json";
+
+    TaskJournal journal(path);
+    journal.begin(QStringLiteral("restore"), QString(), QString(), create_tasks(2));
+    EXPECT_TRUE(QFile::exists(path));
+
+    journal.clear();
+    EXPECT_FALSE(QFile::exists(path));
+
+    TaskJournal reloaded(path);
+    EXPECT_FALSE(reloaded.load());
+}
+
+TEST(TaskJournalClass, CorruptJournal)
+{
+    QTemporaryDir tmp_dir;
+    auto const path = tmp_dir.path() + "/task-journal.json";
+
+    QFile file(path);
+    ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+    file.write("{\"mode\": \"backup\", \"tasks\": [");
+    file.close();
+
+    TaskJournal journal(path);
+    EXPECT_FALSE(journal.load());
+}
+
+TEST(TaskJournalClass, ResumeFromCommittedParts)
+{
+    QTemporaryDir tmp_dir;
+    auto const path = tmp_dir.path() + "/keeper/task-journal.json";
+    auto const tasks = create_tasks(2);
+    QStringList const parts {"Display name 0.keeper.part0000", "Display name 0.keeper.part0001"};
+    QStringList const hashes {"0123abcd", "4567ef01"};
+
+    TaskJournal journal(path);
+    journal.begin(QStringLiteral("backup"), QString(), QStringLiteral("dir-name"), tasks);
+    journal.set_task_parts(tasks[0].get_uuid(), 200000000, parts.mid(0, 1), hashes.mid(0, 1));
+    journal.set_task_parts(tasks[0].get_uuid(), 200000000, parts, hashes);
+
+    TaskJournal reloaded(path);
+    ASSERT_TRUE(reloaded.load());
+    auto const queued = reloaded.tasks(TaskJournal::TaskStatus::QUEUED);
+    ASSERT_EQ(2, queued.size());
+    EXPECT_EQ(200000000, queued[0].size);
+    EXPECT_EQ(parts, queued[0].committed_parts);
+    EXPECT_EQ(hashes, queued[0].part_hashes);
+    EXPECT_EQ(0, queued[1].size);
+    EXPECT_TRUE(queued[1].committed_parts.isEmpty());
+    EXPECT_TRUE(queued[1].part_hashes.isEmpty());
+
+    // once the task is over its parts are in its metadata
+    reloaded.set_task_finished(tasks[0], true);
+    reloaded.set_task_parts(tasks[0].get_uuid(), 200000000, parts, hashes);
+    TaskJournal finished(path);
+    ASSERT_TRUE(finished.load());
+    auto const complete = finished.tasks(TaskJournal::TaskStatus::COMPLETE);
+    ASSERT_EQ(1, complete.size());
+    EXPECT_TRUE(complete[0].committed_parts.isEmpty());
+    EXPECT_TRUE(complete[0].part_hashes.isEmpty());
+}
+
+TEST(TaskJournalClass, CatalogsLastUntilTheRunIsOver)
+{
+    QTemporaryDir tmp_dir;
+    auto const path = tmp_dir.path() + "/keeper/task-journal.json";
+    auto const tasks = create_tasks(2);
+
+    TaskJournal journal(path);
+    journal.begin(QStringLiteral("backup"), QStringLiteral("storage-id"), QStringLiteral("dir-name"), tasks);
+
+    auto const catalog_path = journal.catalog_path(tasks[0].get_uuid());
+    EXPECT_NE(catalog_path, journal.catalog_path(tasks[1].get_uuid()));
+    ASSERT_TRUE(QDir().mkpath(QFileInfo(catalog_path).absolutePath()));
+    QFile catalog(catalog_path);
+    ASSERT_TRUE(catalog.open(QIODevice::WriteOnly));
+    catalog.write("catalog");
+    catalog.close();
+
+    // a resumed run still finds it
+    journal.set_task_finished(tasks[0], true);
+    TaskJournal resumed(path);
+    ASSERT_TRUE(resumed.load());
+    EXPECT_EQ(catalog_path, resumed.catalog_path(tasks[0].get_uuid()));
+    EXPECT_TRUE(QFile::exists(catalog_path));
+
+    // but not once the run is over
+    resumed.clear();
+    EXPECT_FALSE(QFile::exists(catalog_path));
+}
@@ -0,0 +1,248 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Xavi Garcia <xavi.garcia.mena@canonical.com>
+ */
+
+#include <service/task-scheduler.h>
+
+#include <QSet>
+#include <QSignalSpy>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+    QStringList create_uuids(int n_tasks)
+    {
+        QStringList ret;
+        for (auto i = 0; i < n_tasks; ++i)
+            ret << QString("uuid-%1").arg(i);
+        return ret;
+    }
+}
+
+TEST(TaskScheduler, StartsInOrderUpToMaxRunning)
+{
+    QStringList started;
+    TaskScheduler scheduler([&started](QString const & uuid){ started << uuid; return true; });
+    scheduler.set_max_running(2);
+    QSignalSpy finished_spy(&scheduler, &TaskScheduler::all_finished);
+
+    auto const uuids = create_uuids(4);
+    scheduler.start(uuids);
+    EXPECT_EQ(QStringList({uuids[0], uuids[1]}), started);
+    EXPECT_EQ(QStringList({uuids[0], uuids[1]}), scheduler.active());
+    EXPECT_EQ(QStringList({uuids[2], uuids[3]}), scheduler.queued());
+
+    // the second task ends first, the queue order is kept anyway
+    scheduler.set_finished(uuids[1]);
+    EXPECT_EQ(QStringList({uuids[0], uuids[1], uuids[2]}), started);
+    scheduler.set_finished(uuids[0]);
+    EXPECT_EQ(uuids, started);
+    EXPECT_TRUE(scheduler.queued().isEmpty());
+
+    scheduler.set_finished(uuids[2]);
+    EXPECT_TRUE(scheduler.is_last(uuids[3]));
+    EXPECT_EQ(0, finished_spy.count());
+    scheduler.set_finished(uuids[3]);
+    EXPECT_EQ(1, finished_spy.count());
+    EXPECT_FALSE(scheduler.is_busy());
+
+    // a late report of a finished task doesn't end the run again
+    scheduler.set_finished(uuids[3]);
+    EXPECT_EQ(1, finished_spy.count());
+}
+
+TEST(TaskScheduler, CommittingTaskLetsTheNextOneStart)
+{
+    QStringList started;
+    TaskScheduler scheduler([&started](QString const & uuid){ started << uuid; return true; });
+    scheduler.set_max_running(2);
+    QSignalSpy finished_spy(&scheduler, &TaskScheduler::all_finished);
+    QSignalSpy deactivated_spy(&scheduler, &TaskScheduler::task_deactivated);
+
+    auto const uuids = create_uuids(3);
+    scheduler.start(uuids);
+    scheduler.set_committing(uuids[0]);
+    EXPECT_EQ(uuids, started);
+    EXPECT_EQ(QStringList({uuids[0]}), scheduler.committing());
+    EXPECT_TRUE(scheduler.is_running(uuids[0]));
+    ASSERT_EQ(1, deactivated_spy.count());
+    EXPECT_EQ(uuids[0], deactivated_spy.takeFirst().at(0).toString());
+
+    scheduler.set_finished(uuids[1]);
+    scheduler.set_finished(uuids[2]);
+    EXPECT_EQ(0, finished_spy.count());
+
+    // the run is only over once the commit is done
+    EXPECT_TRUE(scheduler.is_last(uuids[0]));
+    scheduler.set_finished(uuids[0]);
+    EXPECT_EQ(1, finished_spy.count());
+    // it was already deactivated when it started committing
+    EXPECT_EQ(3, deactivated_spy.count());
+}
+
+TEST(TaskScheduler, CancellingOneTaskStartsTheNext)
+{
+    QStringList started;
+    TaskScheduler scheduler([&started](QString const & uuid){ started << uuid; return true; });
+    scheduler.set_max_running(2);
+    QSignalSpy finished_spy(&scheduler, &TaskScheduler::all_finished);
+
+    auto const uuids = create_uuids(3);
+    scheduler.start(uuids);
+
+    // the helper of the first task is cancelled, the others go on
+    scheduler.set_finished(uuids[0]);
+    EXPECT_EQ(uuids, started);
+    EXPECT_EQ(QStringList({uuids[1], uuids[2]}), scheduler.active());
+    EXPECT_FALSE(scheduler.is_running(uuids[0]));
+
+    scheduler.set_finished(uuids[1]);
+    scheduler.set_finished(uuids[2]);
+    EXPECT_EQ(1, finished_spy.count());
+}
+
+TEST(TaskScheduler, CancellingTheRunDoesNotFinishIt)
+{
+    QStringList started;
+    TaskScheduler scheduler([&started](QString const & uuid){ started << uuid; return true; });
+    scheduler.set_max_running(2);
+    QSignalSpy finished_spy(&scheduler, &TaskScheduler::all_finished);
+    QSignalSpy deactivated_spy(&scheduler, &TaskScheduler::task_deactivated);
+
+    auto const uuids = create_uuids(4);
+    scheduler.start(uuids);
+    scheduler.set_committing(uuids[0]);
+
+    auto const running = scheduler.clear();
+    EXPECT_EQ(QSet<QString>({uuids[0], uuids[1], uuids[2]}), running.toSet());
+    EXPECT_FALSE(scheduler.is_busy());
+    EXPECT_EQ(3, deactivated_spy.count());
+
+    // the cancelled helpers report their end afterwards
+    for (auto const & uuid : running)
+        scheduler.set_finished(uuid);
+    EXPECT_EQ(QStringList({uuids[0], uuids[1], uuids[2]}), started);
+    EXPECT_EQ(0, finished_spy.count());
+}
+
+TEST(TaskScheduler, FailedStartsAreSkipped)
+{
+    auto const uuids = create_uuids(4);
+
+    QStringList started;
+    TaskScheduler scheduler([&started, &uuids](QString const & uuid){
+        started << uuid;
+        return uuid != uuids[0] && uuid != uuids[2];
+    });
+    scheduler.set_max_running(2);
+    QSignalSpy finished_spy(&scheduler, &TaskScheduler::all_finished);
+
+    scheduler.start(uuids);
+    EXPECT_EQ(uuids, started);
+    EXPECT_EQ(QStringList({uuids[1], uuids[3]}), scheduler.active());
+
+    scheduler.set_finished(uuids[1]);
+    scheduler.set_finished(uuids[3]);
+    EXPECT_EQ(1, finished_spy.count());
+}
+
+TEST(TaskScheduler, RunFinishesWhenEveryStartFails)
+{
+    // tasks report their failure while they are being started
+    TaskScheduler * scheduler_ptr {};
+    TaskScheduler scheduler([&scheduler_ptr](QString const & uuid){
+        scheduler_ptr->set_finished(uuid);
+        return false;
+    });
+    scheduler_ptr = &scheduler;
+    scheduler.set_max_running(2);
+    QSignalSpy finished_spy(&scheduler, &TaskScheduler::all_finished);
+
+    scheduler.start(create_uuids(3));
+    EXPECT_EQ(1, finished_spy.count());
+    EXPECT_FALSE(scheduler.is_busy());
+}
+
+TEST(TaskScheduler, EmptyRunFinishes)
+{
+    TaskScheduler scheduler([](QString const &){ return true; });
+    QSignalSpy finished_spy(&scheduler, &TaskScheduler::all_finished);
+
+    scheduler.start(QStringList());
+    EXPECT_EQ(1, finished_spy.count());
+}
+
+TEST(TaskScheduler, NextTaskIsPreparedWhileTheOthersStream)
+{
+    QStringList started;
+    TaskScheduler scheduler([&started](QString const & uuid){ started << uuid; return true; });
+    scheduler.set_max_running(1);
+    scheduler.set_max_preparing(1);
+    QSignalSpy promoted_spy(&scheduler, &TaskScheduler::task_promoted);
+    QSignalSpy finished_spy(&scheduler, &TaskScheduler::all_finished);
+
+    auto const uuids = create_uuids(3);
+    scheduler.start(uuids);
+
+    // the second helper is launched while the first one streams
+    EXPECT_EQ(QStringList({uuids[0], uuids[1]}), started);
+    EXPECT_EQ(QStringList({uuids[0]}), scheduler.active());
+    EXPECT_EQ(QStringList({uuids[1]}), scheduler.preparing());
+    EXPECT_TRUE(scheduler.is_running(uuids[1]));
+    EXPECT_EQ(0, promoted_spy.count());
+
+    // as soon as the first one commits, the prepared one streams
+    // and the third one is prepared
+    scheduler.set_committing(uuids[0]);
+    ASSERT_EQ(1, promoted_spy.count());
+    EXPECT_EQ(uuids[1], promoted_spy.takeFirst().at(0).toString());
+    EXPECT_EQ(uuids, started);
+    EXPECT_EQ(QStringList({uuids[1]}), scheduler.active());
+    EXPECT_EQ(QStringList({uuids[2]}), scheduler.preparing());
+
+    scheduler.set_finished(uuids[0]);
+    scheduler.set_finished(uuids[1]);
+    ASSERT_EQ(1, promoted_spy.count());
+    EXPECT_EQ(uuids[2], promoted_spy.takeFirst().at(0).toString());
+    EXPECT_TRUE(scheduler.is_last(uuids[2]));
+
+    scheduler.set_finished(uuids[2]);
+    EXPECT_EQ(1, finished_spy.count());
+}
+
+TEST(TaskScheduler, FailedPreparedTaskIsReplaced)
+{
+    QStringList started;
+    TaskScheduler scheduler([&started](QString const & uuid){ started << uuid; return true; });
+    scheduler.set_max_running(1);
+    scheduler.set_max_preparing(1);
+    QSignalSpy promoted_spy(&scheduler, &TaskScheduler::task_promoted);
+
+    auto const uuids = create_uuids(3);
+    scheduler.start(uuids);
+
+    // the prepared helper fails before it gets a slot
+    scheduler.set_finished(uuids[1]);
+    EXPECT_EQ(uuids, started);
+    EXPECT_EQ(QStringList({uuids[2]}), scheduler.preparing());
+
+    scheduler.set_finished(uuids[0]);
+    ASSERT_EQ(1, promoted_spy.count());
+    EXPECT_EQ(uuids[2], promoted_spy.takeFirst().at(0).toString());
+}
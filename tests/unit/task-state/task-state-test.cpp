@@ -0,0 +1,98 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *   Xavi Garcia Mena <xavi.garcia.mena@canonical.com>
+ */
+
+#include <service/keeper-task.h>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+    KeeperTask::TaskData create_task_data(QString const & action)
+    {
+        KeeperTask::TaskData td;
+        td.action = action;
+        td.error = keeper::Error::OK;
+        td.metadata = Metadata(QStringLiteral("uuid-1"), QStringLiteral("Music"));
+        return td;
+    }
+}
+
+TEST(TaskState, InitialState)
+{
+    auto const td = create_task_data(QStringLiteral("queued"));
+    auto const state = KeeperTask::get_initial_state(td);
+
+    EXPECT_FALSE(state.is_empty());
+    EXPECT_TRUE(KeeperTask::TaskState().is_empty());
+
+    auto const item = state.to_item();
+    EXPECT_EQ(QStringLiteral("uuid-1"), item.get_uuid());
+    EXPECT_EQ(QStringLiteral("Music"), item.get_display_name());
+    EXPECT_EQ(QStringLiteral("queued"), item.get_status());
+    EXPECT_EQ(0.0, item.get_percent_done());
+    EXPECT_EQ(0, item[keeper::Item::SPEED_KEY].toInt());
+    EXPECT_FALSE(item.contains(keeper::Item::ERROR_KEY));
+}
+
+TEST(TaskState, ErrorOnlyWhenFailedOrCancelled)
+{
+    auto td = create_task_data(QStringLiteral("saving"));
+    auto state = KeeperTask::calculate_state(td, 0.5, 1024, keeper::Error::HELPER_WRITE);
+    EXPECT_FALSE(state.has_error);
+    EXPECT_FALSE(state.to_item().contains(keeper::Item::ERROR_KEY));
+    EXPECT_EQ(0.5, state.to_item().get_percent_done());
+    EXPECT_EQ(1024, state.to_item()[keeper::Item::SPEED_KEY].toInt());
+
+    // the helper error is used unless the task has its own
+    td.action = QStringLiteral("failed");
+    state = KeeperTask::calculate_state(td, 0.5, 0, keeper::Error::HELPER_WRITE);
+    ASSERT_TRUE(state.has_error);
+    EXPECT_EQ(keeper::Error::HELPER_WRITE, state.to_item()[keeper::Item::ERROR_KEY].value<keeper::Error>());
+
+    td.error = keeper::Error::HELPER_SOCKET;
+    state = KeeperTask::calculate_state(td, 0.5, 0, keeper::Error::HELPER_WRITE);
+    EXPECT_EQ(keeper::Error::HELPER_SOCKET, state.to_item()[keeper::Item::ERROR_KEY].value<keeper::Error>());
+}
+
+TEST(TaskState, Compare)
+{
+    auto const td = create_task_data(QStringLiteral("saving"));
+    auto const state = KeeperTask::calculate_state(td, 0.25, 100, keeper::Error::OK);
+
+    EXPECT_EQ(state, KeeperTask::calculate_state(td, 0.25, 100, keeper::Error::OK));
+    EXPECT_NE(state, KeeperTask::calculate_state(td, 0.5, 100, keeper::Error::OK));
+    EXPECT_NE(state, KeeperTask::calculate_state(td, 0.25, 200, keeper::Error::OK));
+    EXPECT_NE(state, KeeperTask::get_initial_state(td));
+}
+
+TEST(TaskState, ComparedWithThePublishedItem)
+{
+    auto td = create_task_data(QStringLiteral("saving"));
+    auto const state = KeeperTask::calculate_state(td, 0.25, 100, keeper::Error::OK);
+
+    EXPECT_TRUE(state.is_published_in(state.to_item()));
+    EXPECT_FALSE(state.is_published_in(QVariantMap()));
+    EXPECT_FALSE(state.is_published_in(KeeperTask::calculate_state(td, 0.5, 100, keeper::Error::OK).to_item()));
+
+    td.action = QStringLiteral("failed");
+    auto const failed = KeeperTask::calculate_state(td, 0.25, 100, keeper::Error::HELPER_WRITE);
+    EXPECT_TRUE(failed.is_published_in(failed.to_item()));
+    EXPECT_FALSE(failed.is_published_in(KeeperTask::calculate_state(td, 0.25, 100, keeper::Error::HELPER_SOCKET).to_item()));
+    EXPECT_FALSE(state.is_published_in(failed.to_item()));
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Xavi Garcia <xavi.garcia.mena@canonical.com>
+ */
+
+#include "util/tracing.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QThread>
+
+#include <gtest/gtest.h>
+#include <glib.h>
+
+#include <unistd.h>
+
+namespace
+{
+    // the events of a trace file, closed the way trace viewers do
+    QJsonArray read_events(QString const & trace_id)
+    {
+        QFile file(util::Tracing::trace_file_path(trace_id));
+        if (!file.open(QIODevice::ReadOnly))
+            return QJsonArray();
+
+        auto data = file.readAll().trimmed();
+        if (data.endsWith(','))
+            data.chop(1);
+        data += ']';
+
+        QJsonParseError error;
+        auto const doc = QJsonDocument::fromJson(data, &error);
+        EXPECT_EQ(QJsonParseError::NoError, error.error) << qPrintable(error.errorString());
+        return doc.array();
+    }
+
+    QJsonObject find_event(QJsonArray const & events, QString const & name)
+    {
+        for (auto const & event : events)
+        {
+            auto const obj = event.toObject();
+            if (obj[QStringLiteral("name")].toString() == name)
+                return obj;
+        }
+        return QJsonObject();
+    }
+
+    class TracingTest : public ::testing::Test
+    {
+    protected:
+        void SetUp() override
+        {
+            g_setenv("XDG_CACHE_HOME", cache_dir_.path().toLatin1().data(), true);
+        }
+
+        void TearDown() override
+        {
+            util::Tracing::set_trace_id(QString());
+            g_unsetenv("XDG_CACHE_HOME");
+            g_unsetenv("KEEPER_TRACE");
+        }
+
+        QTemporaryDir cache_dir_;
+    };
+}
+
+TEST_F(TracingTest, SpansAreChromeTraceEvents)
+{
+    auto const trace_id = QStringLiteral("spans");
+    util::Tracing::set_trace_id(trace_id);
+    EXPECT_TRUE(util::Tracing::trace_file_path(trace_id).startsWith(cache_dir_.path()));
+
+    {
+        util::TraceSpan outer(QStringLiteral("outer"), {{QStringLiteral("uuid"), QStringLiteral("1234")}});
+        util::TraceSpan inner(QStringLiteral("inner"));
+        QThread::msleep(20);
+        inner.set_arg(QStringLiteral("bytes"), 100);
+        inner.end();
+    }
+
+    auto const events = read_events(trace_id);
+    ASSERT_EQ(3, events.size());
+
+    auto const process = find_event(events, QStringLiteral("process_name"));
+    EXPECT_EQ(QStringLiteral("M"), process[QStringLiteral("ph")].toString());
+    EXPECT_EQ(getpid(), process[QStringLiteral("pid")].toInt());
+
+    auto const outer = find_event(events, QStringLiteral("outer"));
+    auto const inner = find_event(events, QStringLiteral("inner"));
+    EXPECT_EQ(QStringLiteral("X"), outer[QStringLiteral("ph")].toString());
+    EXPECT_EQ(QStringLiteral("X"), inner[QStringLiteral("ph")].toString());
+    EXPECT_EQ(getpid(), inner[QStringLiteral("pid")].toInt());
+    EXPECT_EQ(QStringLiteral("1234"), outer[QStringLiteral("args")].toObject()[QStringLiteral("uuid")].toString());
+    EXPECT_EQ(100, inner[QStringLiteral("args")].toObject()[QStringLiteral("bytes")].toInt());
+
+    // microseconds, and the inner span is within the outer one
+    auto const outer_ts = outer[QStringLiteral("ts")].toDouble();
+    auto const inner_ts = inner[QStringLiteral("ts")].toDouble();
+    auto const outer_dur = outer[QStringLiteral("dur")].toDouble();
+    auto const inner_dur = inner[QStringLiteral("dur")].toDouble();
+    EXPECT_LE(20000, inner_dur);
+    EXPECT_LE(outer_ts, inner_ts);
+    EXPECT_GE(outer_ts + outer_dur, inner_ts + inner_dur);
+}
+
+TEST_F(TracingTest, ProcessesAppendToTheSameFile)
+{
+    auto const trace_id = QStringLiteral("shared");
+
+    // another process started the trace
+    auto const path = util::Tracing::trace_file_path(trace_id);
+    ASSERT_TRUE(QDir().mkpath(QFileInfo(path).absolutePath()));
+    QFile file(path);
+    ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+    file.write("[\n{\"name\":\"backup\",\"ph\":\"X\",\"ts\":1,\"dur\":1,\"pid\":1,\"tid\":1},\n");
+    file.close();
+
+    util::Tracing::set_trace_id(trace_id);
+    util::TraceSpan(QStringLiteral("streaming")).end();
+
+    auto const events = read_events(trace_id);
+    EXPECT_EQ(3, events.size());
+    EXPECT_FALSE(find_event(events, QStringLiteral("backup")).isEmpty());
+    EXPECT_FALSE(find_event(events, QStringLiteral("streaming")).isEmpty());
+}
+
+TEST_F(TracingTest, NothingIsWrittenWithoutATrace)
+{
+    util::Tracing::set_trace_id(QString());
+    util::TraceSpan(QStringLiteral("untraced")).end();
+
+    EXPECT_FALSE(QFileInfo(cache_dir_.path() + QStringLiteral("/keeper")).exists());
+}
+
+TEST_F(TracingTest, StartTrace)
+{
+    g_unsetenv("KEEPER_TRACE");
+    EXPECT_TRUE(util::Tracing::start_trace().isEmpty());
+    EXPECT_TRUE(util::Tracing::trace_id().isEmpty());
+
+    g_setenv("KEEPER_TRACE", "1", true);
+    auto const first = util::Tracing::start_trace();
+    EXPECT_FALSE(first.isEmpty());
+    EXPECT_EQ(first, util::Tracing::trace_id());
+
+    // every run has its own trace
+    auto const second = util::Tracing::start_trace();
+    EXPECT_NE(first, second);
+
+    // the id goes in the helper urls, so it must not need quoting
+    EXPECT_FALSE(second.contains(QLatin1Char(' ')));
+    EXPECT_FALSE(second.contains(QLatin1Char('\'')));
+}
@@ -0,0 +1,329 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Xavi Garcia <xavi.garcia.mena@canonical.com>
+ */
+
+#include "tests/utils/dataset-generator.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
+
+#include <algorithm> // std::min(), std::max(), std::sort(), std::swap()
+#include <cmath> // std::exp(), std::log()
+#include <cstring> // memcpy()
+
+namespace
+{
+    constexpr qint64 BLOCK_SIZE {64 * 1024};
+
+    // the compressibility is applied to every chunk, so even small files
+    // and small compression windows get the expected ratio
+    constexpr qint64 CHUNK_SIZE {4 * 1024};
+
+    // the compressible part of the chunks repeats this text
+    constexpr const char PATTERN[] = "keeper dataset generator ";
+    constexpr int PATTERN_SIZE {sizeof(PATTERN) - 1};
+
+    // the biggest edit done by a mutation
+    constexpr qint64 MAX_EDIT_SIZE {64 * 1024};
+
+    // splitmix64, so the seeds of consecutive files are not correlated
+    quint64 file_seed(quint64 seed, int i)
+    {
+        auto z = seed + (quint64(i) + 1) * 0x9e3779b97f4a7c15ull;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+}
+
+DatasetGenerator::DatasetGenerator(Options const & options)
+    : options_(options)
+    , engine_(options.seed)
+{
+}
+
+DatasetGenerator::~DatasetGenerator() = default;
+
+// std::uniform_int_distribution and friends are implementation defined,
+// so the generator does its own arithmetic on the engine output to give
+// the same trees with every standard library
+quint64
+DatasetGenerator::next(quint64 range)
+{
+    return range > 0 ? engine_() % range : 0;
+}
+
+double
+DatasetGenerator::next_ratio()
+{
+    // 53 random bits, the precision of a double
+    return double(engine_() >> 11) / double(quint64(1) << 53);
+}
+
+qint64
+DatasetGenerator::next_file_size()
+{
+    auto const min_size = std::max(qint64(0), options_.min_file_size);
+    auto const max_size = std::max(min_size, options_.max_file_size);
+    auto const ratio = next_ratio();
+
+    if (options_.distribution == SizeDistribution::LOG_UNIFORM)
+    {
+        auto const low = std::log(double(std::max(qint64(1), min_size)));
+        auto const high = std::log(double(max_size + 1));
+        auto const size = qint64(std::exp(low + ratio * (high - low)));
+        return std::min(max_size, std::max(min_size, size));
+    }
+
+    return min_size + std::min(max_size - min_size, qint64(ratio * double(max_size - min_size + 1)));
+}
+
+QString
+DatasetGenerator::next_dir(QString const & root)
+{
+    auto dir = root;
+    for (int level = 0; level < options_.depth; ++level)
+        dir += QStringLiteral("/dir-%1").arg(next(quint64(std::max(1, options_.fan_out))));
+    return dir;
+}
+
+void
+DatasetGenerator::fill(char * data, qint64 n_bytes)
+{
+    auto const compressibility = std::min(1.0, std::max(0.0, options_.compressibility));
+    for (qint64 chunk = 0; chunk < n_bytes; chunk += CHUNK_SIZE)
+    {
+        auto const chunk_size = std::min(CHUNK_SIZE, n_bytes - chunk);
+        auto const n_random = qint64((1.0 - compressibility) * double(chunk_size) + 0.5);
+
+        qint64 i = 0;
+        for (; i + 8 <= n_random; i += 8)
+        {
+            auto const value = engine_();
+            memcpy(data + chunk + i, &value, 8);
+        }
+        if (i < n_random)
+        {
+            auto const value = engine_();
+            memcpy(data + chunk + i, &value, size_t(n_random - i));
+        }
+
+        for (i = n_random; i < chunk_size; ++i)
+            data[chunk + i] = PATTERN[(chunk + i) % PATTERN_SIZE];
+    }
+}
+
+bool
+DatasetGenerator::write_file(QString const & path, qint64 size, bool sparse)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qWarning() << "Error creating" << path << ":" << file.errorString();
+        return false;
+    }
+
+    QByteArray block(int(BLOCK_SIZE), '\0');
+
+    // sparse files only get a block at each end, the rest is a hole
+    if (sparse)
+    {
+        auto const n_head = std::min(size, BLOCK_SIZE);
+        fill(block.data(), n_head);
+        if (file.write(block.constData(), n_head) != n_head)
+            return false;
+
+        auto const n_tail = std::min(size - n_head, BLOCK_SIZE);
+        if (n_tail > 0)
+        {
+            fill(block.data(), n_tail);
+            if (!file.seek(size - n_tail) || file.write(block.constData(), n_tail) != n_tail)
+                return false;
+        }
+        return true;
+    }
+
+    for (auto left = size; left > 0;)
+    {
+        auto const n = std::min(left, BLOCK_SIZE);
+        fill(block.data(), n);
+        if (file.write(block.constData(), n) != n)
+        {
+            qWarning() << "Error writing" << path << ":" << file.errorString();
+            return false;
+        }
+        left -= n;
+    }
+    return true;
+}
+
+bool
+DatasetGenerator::generate(QString const & root, Stats * stats)
+{
+    Stats ret;
+    QSet<QString> dirs;
+    QStringList written;
+
+    for (int i = 0; i < options_.n_files; ++i)
+    {
+        // every file draws from its own engine, so an option that changes
+        // how much one file takes from it doesn't move the files after it
+        engine_.seed(file_seed(options_.seed, i));
+        auto const dir = next_dir(root);
+        auto const size = next_file_size();
+        auto const duplicate = next_ratio() < options_.duplicate_ratio && !written.isEmpty();
+        auto const sparse = next_ratio() < options_.sparse_ratio;
+        auto const original = next(quint64(written.size()));
+
+        if (!dirs.contains(dir))
+        {
+            if (!QDir().mkpath(dir))
+            {
+                qWarning() << "Error creating directory" << dir;
+                return false;
+            }
+            dirs.insert(dir);
+        }
+
+        auto const path = QStringLiteral("%1/file-%2%3").arg(dir).arg(i).arg(options_.suffix);
+        QFile::remove(path);
+        if (duplicate)
+        {
+            if (!QFile::copy(written[int(original)], path))
+            {
+                qWarning() << "Error copying" << written[int(original)] << "to" << path;
+                return false;
+            }
+            ++ret.n_duplicates;
+            ret.n_bytes += QFileInfo(path).size();
+        }
+        else
+        {
+            if (!write_file(path, size, sparse))
+                return false;
+            if (sparse)
+                ++ret.n_sparse;
+            ret.n_bytes += size;
+        }
+
+        written << path;
+        ++ret.n_files;
+    }
+
+    dirs.remove(root);
+    ret.n_dirs = dirs.size();
+
+    if (stats)
+        *stats = ret;
+    return true;
+}
+
+bool
+DatasetGenerator::mutate(QString const & root, double ratio, MutationStats * stats)
+{
+    QStringList files;
+    QDirIterator iter(root, QDir::Files | QDir::Hidden, QDirIterator::Subdirectories);
+    while (iter.hasNext())
+        files << iter.next();
+    files.sort();
+
+    // pick the files to edit, and edit them in path order
+    QVector<int> indexes(files.size());
+    for (int i = 0; i < indexes.size(); ++i)
+        indexes[i] = i;
+    auto const n_edits = std::min(indexes.size(), int(std::min(1.0, std::max(0.0, ratio)) * files.size() + 0.5));
+    for (int i = 0; i < n_edits; ++i)
+        std::swap(indexes[i], indexes[i + int(next(quint64(indexes.size() - i)))]);
+    indexes.resize(n_edits);
+    std::sort(indexes.begin(), indexes.end());
+
+    MutationStats ret;
+    QByteArray block(int(MAX_EDIT_SIZE), '\0');
+
+    for (auto const index : indexes)
+    {
+        auto const & path = files[index];
+        auto const size = QFileInfo(path).size();
+        auto const action = next(10);
+        auto const edit_size = qint64(next(quint64(MAX_EDIT_SIZE))) + 1;
+        auto const position = next(quint64(size));
+
+        if (action < 5 && size > 0)
+        {
+            // overwrite a range inside the file
+            QFile file(path);
+            auto const n = std::min(edit_size, size - qint64(position));
+            fill(block.data(), n);
+            if (!file.open(QIODevice::ReadWrite) || !file.seek(qint64(position)) || file.write(block.constData(), n) != n)
+            {
+                qWarning() << "Error modifying" << path << ":" << file.errorString();
+                return false;
+            }
+            ++ret.n_modified;
+        }
+        else if (action < 7)
+        {
+            // also the empty files picked for a modification
+            QFile file(path);
+            fill(block.data(), edit_size);
+            if (!file.open(QIODevice::Append) || file.write(block.constData(), edit_size) != edit_size)
+            {
+                qWarning() << "Error appending to" << path << ":" << file.errorString();
+                return false;
+            }
+            ++ret.n_appended;
+        }
+        else if (action == 7)
+        {
+            if (!QFile::resize(path, qint64(position)))
+            {
+                qWarning() << "Error truncating" << path;
+                return false;
+            }
+            ++ret.n_truncated;
+        }
+        else if (action == 8)
+        {
+            if (!QFile::remove(path))
+            {
+                qWarning() << "Error removing" << path;
+                return false;
+            }
+            ++ret.n_removed;
+        }
+        else
+        {
+            // a new file next to the edited one
+            auto const info = QFileInfo(path);
+            auto const new_path = QStringLiteral("%1/%2-new%3").arg(info.absolutePath()).arg(info.completeBaseName()).arg(options_.suffix);
+            if (!write_file(new_path, next_file_size(), false))
+                return false;
+            ++ret.n_created;
+        }
+    }
+
+    if (stats)
+        *stats = ret;
+    return true;
+}
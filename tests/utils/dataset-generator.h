@@ -0,0 +1,105 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Xavi Garcia <xavi.garcia.mena@canonical.com>
+ */
+
+#pragma once
+
+#include <QString>
+
+#include <random>
+
+/**
+ * Creates reproducible directory trees to back up.
+ *
+ * The same options and seed always give the same tree, byte by byte,
+ * so throughput, deduplication and incremental measurements can be
+ * compared between builds and machines.
+ */
+class DatasetGenerator
+{
+public:
+
+    enum class SizeDistribution
+    {
+        UNIFORM,
+        // as many files between 1 KiB and 2 KiB as between 1 MiB and 2 MiB,
+        // which is closer to real user folders
+        LOG_UNIFORM
+    };
+
+    struct Options
+    {
+        quint64 seed {0x6b656570}; // "keep"
+        int n_files {100};
+        qint64 min_file_size {0};
+        qint64 max_file_size {64 * 1024};
+        SizeDistribution distribution {SizeDistribution::UNIFORM};
+        // levels of subdirectories and subdirectories per level.
+        // Files are spread over the leaves
+        int depth {0};
+        int fan_out {1};
+        // 0.0 is random data, 1.0 compresses almost completely
+        double compressibility {0.0};
+        // share of the files that repeat the contents of an earlier file
+        double duplicate_ratio {0.0};
+        // share of the files that only have data at the start and the end
+        double sparse_ratio {0.0};
+        QString suffix {QStringLiteral(".dat")};
+    };
+
+    struct Stats
+    {
+        int n_files {0};
+        // directories holding files
+        int n_dirs {0};
+        qint64 n_bytes {0};
+        int n_duplicates {0};
+        int n_sparse {0};
+    };
+
+    struct MutationStats
+    {
+        int n_modified {0};
+        int n_appended {0};
+        int n_truncated {0};
+        int n_removed {0};
+        int n_created {0};
+    };
+
+    explicit DatasetGenerator(Options const & options);
+    ~DatasetGenerator();
+
+    // creates the tree below root, which is created if needed
+    bool generate(QString const & root, Stats * stats = nullptr);
+
+    // edits ratio (0.0 to 1.0) of the files found below root.
+    // The files are visited in path order, so a given seed always
+    // edits the same files of the same tree
+    bool mutate(QString const & root, double ratio, MutationStats * stats = nullptr);
+
+private:
+    quint64 next(quint64 range);
+    double next_ratio();
+    qint64 next_file_size();
+    QString next_dir(QString const & root);
+    void fill(char * data, qint64 n_bytes);
+    bool write_file(QString const & path, qint64 size, bool sparse);
+
+    Options const options_;
+    std::mt19937_64 engine_;
+};
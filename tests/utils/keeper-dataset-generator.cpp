@@ -0,0 +1,129 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Xavi Garcia <xavi.garcia.mena@canonical.com>
+ */
+
+#include "tests/utils/dataset-generator.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+
+#include <iostream>
+
+namespace
+{
+    constexpr const char OPTION_SEED[]            = "seed";
+    constexpr const char OPTION_FILES[]           = "files";
+    constexpr const char OPTION_MIN_SIZE[]        = "min-size";
+    constexpr const char OPTION_MAX_SIZE[]        = "max-size";
+    constexpr const char OPTION_LOG_SIZES[]       = "log-sizes";
+    constexpr const char OPTION_DEPTH[]           = "depth";
+    constexpr const char OPTION_FAN_OUT[]         = "fan-out";
+    constexpr const char OPTION_COMPRESSIBILITY[] = "compressibility";
+    constexpr const char OPTION_DUPLICATES[]      = "duplicates";
+    constexpr const char OPTION_SPARSE[]          = "sparse";
+    constexpr const char OPTION_SUFFIX[]          = "suffix";
+    constexpr const char OPTION_MUTATE[]          = "mutate";
+
+    // percentages are easier to type than ratios
+    double percentage(QCommandLineParser const & parser, char const * option)
+    {
+        return parser.value(QString::fromLatin1(option)).toDouble() / 100.0;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    DatasetGenerator::Options defaults;
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Creates reproducible datasets to measure backups.\n"
+                                     "The same options always create the same files.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("dir", "Directory where the dataset is created or mutated");
+    parser.addOptions({
+        {OPTION_SEED, "Seed of the dataset", "n", QString::number(defaults.seed)},
+        {OPTION_FILES, "Number of files", "n", QString::number(defaults.n_files)},
+        {OPTION_MIN_SIZE, "Minimum file size in bytes", "bytes", QString::number(defaults.min_file_size)},
+        {OPTION_MAX_SIZE, "Maximum file size in bytes", "bytes", QString::number(defaults.max_file_size)},
+        {OPTION_LOG_SIZES, "Spread the file sizes logarithmically instead of uniformly"},
+        {OPTION_DEPTH, "Levels of subdirectories", "n", QString::number(defaults.depth)},
+        {OPTION_FAN_OUT, "Subdirectories per level", "n", QString::number(defaults.fan_out)},
+        {OPTION_COMPRESSIBILITY, "Compressible part of the data, in %", "percent", "0"},
+        {OPTION_DUPLICATES, "Files that repeat the contents of another one, in %", "percent", "0"},
+        {OPTION_SPARSE, "Sparse files, in %", "percent", "0"},
+        {OPTION_SUFFIX, "File name suffix", "suffix", defaults.suffix},
+        {OPTION_MUTATE, "Edits this % of the files of an existing dataset instead of creating one", "percent"}
+    });
+    parser.process(app);
+
+    auto const args = parser.positionalArguments();
+    if (args.size() != 1)
+    {
+        std::cerr << "Please give the directory of the dataset." << std::endl;
+        parser.showHelp(1);
+    }
+    auto const dir = args.first();
+
+    DatasetGenerator::Options options;
+    options.seed = parser.value(OPTION_SEED).toULongLong();
+    options.n_files = parser.value(OPTION_FILES).toInt();
+    options.min_file_size = parser.value(OPTION_MIN_SIZE).toLongLong();
+    options.max_file_size = parser.value(OPTION_MAX_SIZE).toLongLong();
+    options.distribution = parser.isSet(OPTION_LOG_SIZES)
+                         ? DatasetGenerator::SizeDistribution::LOG_UNIFORM
+                         : DatasetGenerator::SizeDistribution::UNIFORM;
+    options.depth = parser.value(OPTION_DEPTH).toInt();
+    options.fan_out = parser.value(OPTION_FAN_OUT).toInt();
+    options.compressibility = percentage(parser, OPTION_COMPRESSIBILITY);
+    options.duplicate_ratio = percentage(parser, OPTION_DUPLICATES);
+    options.sparse_ratio = percentage(parser, OPTION_SPARSE);
+    options.suffix = parser.value(OPTION_SUFFIX);
+
+    DatasetGenerator generator(options);
+
+    if (parser.isSet(OPTION_MUTATE))
+    {
+        DatasetGenerator::MutationStats stats;
+        if (!generator.mutate(dir, percentage(parser, OPTION_MUTATE), &stats))
+        {
+            std::cerr << "Error mutating the dataset in " << dir.toStdString() << std::endl;
+            return 1;
+        }
+        std::cout << "modified: " << stats.n_modified << std::endl
+                  << "appended: " << stats.n_appended << std::endl
+                  << "truncated: " << stats.n_truncated << std::endl
+                  << "removed: " << stats.n_removed << std::endl
+                  << "created: " << stats.n_created << std::endl;
+        return 0;
+    }
+
+    DatasetGenerator::Stats stats;
+    if (!generator.generate(dir, &stats))
+    {
+        std::cerr << "Error generating the dataset in " << dir.toStdString() << std::endl;
+        return 1;
+    }
+    std::cout << "files: " << stats.n_files << std::endl
+              << "directories: " << stats.n_dirs << std::endl
+              << "bytes: " << stats.n_bytes << std::endl
+              << "duplicates: " << stats.n_duplicates << std::endl
+              << "sparse: " << stats.n_sparse << std::endl;
+    return 0;
+}